@@ -0,0 +1,79 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef ACTIVE_RING_H
+#define ACTIVE_RING_H
+
+/*
+ * Round robin over the slots of a per-flow table that currently have
+ * something queued.  The active slots are linked into a ring by
+ * index, so serving the next flow never steps over idle ones and
+ * nothing is allocated as flows come and go.  A slot that becomes
+ * active joins just behind the one that's next to be served, so it
+ * gets its turn after the flows already waiting.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+
+class ActiveRing {
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    ActiveRing() : _current(NONE) {}
+
+    // make room for slots [0, slots)
+    void resize(size_t slots) {
+        if (slots > _links.size())
+            _links.resize(slots, Link{NONE, NONE});
+    }
+    size_t size() const {return _links.size();}
+
+    bool empty() const {return _current == NONE;}
+    bool active(uint32_t slot) const {return _links[slot].next != NONE;}
+    // the slot to serve next, or NONE
+    uint32_t current() const {return _current;}
+
+    void insert(uint32_t slot) {
+        assert(slot < _links.size() && !active(slot));
+        Link& l = _links[slot];
+        if (_current == NONE) {
+            l.prev = l.next = slot;
+            _current = slot;
+            return;
+        }
+        Link& next = _links[_current];
+        l.next = _current;
+        l.prev = next.prev;
+        _links[next.prev].next = slot;
+        next.prev = slot;
+    }
+
+    void remove(uint32_t slot) {
+        assert(active(slot));
+        Link& l = _links[slot];
+        if (l.next == slot) {
+            _current = NONE;
+        } else {
+            _links[l.prev].next = l.next;
+            _links[l.next].prev = l.prev;
+            if (_current == slot)
+                _current = l.next;
+        }
+        l.prev = l.next = NONE;
+    }
+
+    // the current slot has had its turn
+    void advance() {
+        assert(_current != NONE);
+        _current = _links[_current].next;
+    }
+
+private:
+    struct Link {
+        uint32_t prev, next; // NONE when not in the ring
+    };
+    std::vector<Link> _links;
+    uint32_t _current;
+};
+
+#endif
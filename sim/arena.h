@@ -0,0 +1,80 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+ * Bump allocator for objects that live as long as the simulation,
+ * such as a topology's queues and pipes.  Objects are constructed in
+ * large contiguous chunks rather than one malloc each, which saves
+ * the per-allocation overhead and keeps neighbouring links close in
+ * memory.  Nothing is freed individually: when the Arena is destroyed
+ * it runs the objects' destructors, newest first, and releases the
+ * chunks.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class Arena {
+public:
+    Arena(size_t chunk_size = 1 << 20) : _chunk_size(chunk_size), _next(NULL), _end(NULL), _used(0), _reserved(0) {}
+    ~Arena() {
+        for (size_t i = _dtors.size(); i-- > 0; )
+            _dtors[i].destroy(_dtors[i].obj);
+        for (size_t i = 0; i < _chunks.size(); i++)
+            free(_chunks[i]);
+    }
+    Arena(const Arena&) = delete;
+    void operator=(const Arena&) = delete;
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        T* obj = new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            _dtors.push_back(Dtor{obj, &destroy<T>});
+        return obj;
+    }
+
+    // bytes handed out, and bytes reserved from the system
+    size_t used() const {return _used;}
+    size_t reserved() const {return _reserved;}
+
+private:
+    struct Dtor {
+        void* obj;
+        void (*destroy)(void*);
+    };
+    template <class T>
+    static void destroy(void* obj) {((T*)obj)->~T();}
+
+    void* alloc(size_t size, size_t align) {
+        uintptr_t p = ((uintptr_t)_next + align - 1) & ~(uintptr_t)(align - 1);
+        if (!_next || p + size > (uintptr_t)_end) {
+            size_t n = size + align > _chunk_size ? size + align : _chunk_size;
+            char* chunk = (char*)malloc(n);
+            if (!chunk)
+                throw std::bad_alloc();
+            _chunks.push_back(chunk);
+            _reserved += n;
+            _end = chunk + n;
+            p = ((uintptr_t)chunk + align - 1) & ~(uintptr_t)(align - 1);
+        }
+        _next = (char*)(p + size);
+        _used += size;
+        return (void*)p;
+    }
+
+    size_t _chunk_size;
+    char* _next;
+    char* _end;
+    size_t _used;
+    size_t _reserved;
+    std::vector<char*> _chunks;
+    std::vector<Dtor> _dtors;
+};
+
+#endif
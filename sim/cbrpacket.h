@@ -9,7 +9,7 @@
 
 class CbrPacket : public Packet {
 public:
-    static PacketDB<CbrPacket> _packetdb;
+    static thread_local PacketDB<CbrPacket> _packetdb;
     inline static CbrPacket* newpkt(PacketFlow &flow, route_t &route, int id, int size) {
         CbrPacket* p = _packetdb.allocPacket();
         p->set_route(flow,route,size,id);
@@ -0,0 +1,259 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+//
+// Packet layout benchmark.  Runs EQDS over a FatTree, as bench_switch
+// does, and reports the bytes each in-flight packet took at peak, both
+// with Packet as it is and with the layout Packet had before its
+// per-hop fields were packed into one cache line (OldPacket below).
+// It then takes that many packets in each layout and times reading the
+// fields every hop reads, visiting the packets in random order as
+// queues and pipes do.
+#include <string.h>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include "network.h"
+#include "eventlist.h"
+#include "eqds.h"
+#include "connection_matrix.h"
+
+#include "fat_tree_topology.h"
+#include "fat_tree_switch.h"
+
+#include "main.h"
+
+// Packet's fields in the order they were before the hot/cold split;
+// the cold ones were inline and every packet carried them.
+class OldPacket {
+public:
+    virtual ~OldPacket() {}
+    uint16_t size() const {return _size;}
+    packet_type type() const {return _type;}
+    bool header_only() const {return _is_header;}
+    bool bounced() const {return _bounced;}
+    PacketFlow& flow() const {return *_flow;}
+    uint32_t dst() const {return _dst;}
+    uint32_t pathid() const {return _pathid;}
+    uint32_t flags() const {return _flags;}
+    uint32_t nexthop() const {return _nexthop;}
+    const Route* route() const {return _route;}
+
+    packet_type _type;
+    uint16_t _size, _oldsize;
+    bool _is_header;
+    bool _bounced;
+    uint32_t _flags;
+    uint32_t _dst;
+    uint32_t _pathid;
+    packet_direction _direction;
+    const Route* _route;
+    uint32_t _nexthop, _oldnexthop;
+    uint8_t _refcount;
+    PacketSink* _next_routed_hop;
+    packetid_t _id;
+    PacketFlow* _flow;
+    LosslessInputQueue* _ingressqueue;
+    uint32_t _path_len;
+};
+
+// An EqdsDataPacket laid out over OldPacket
+struct OldEqdsDataPacket : public OldPacket {
+    char _subclass[sizeof(EqdsDataPacket) - sizeof(Packet)];
+};
+
+// what sendOn, the queues, pipes and switches read at each hop
+template <class P> inline uint64_t read_hop_fields(P* p) {
+    return (uintptr_t)p->route() + p->nexthop() + (uintptr_t)&p->flow() + p->size() + p->type()
+        + p->flags() + p->dst() + p->pathid() + p->header_only() + p->bounced();
+}
+
+template <class P> double ns_per_packet(const vector<P*>& pkts, uint32_t passes) {
+    uint64_t sum = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t pass = 0; pass < passes; pass++)
+        for (size_t i = 0; i < pkts.size(); i++)
+            sum += read_hop_fields(pkts[i]);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (sum == 42) // keep the reads
+        cout << "";
+    return secs * 1e9 / passes / pkts.size();
+}
+
+void exit_error(char* progr) {
+    cout << "Usage " << progr << " -tm traffic_matrix_file [-topo topology_file | -nodes N]\n\t[-q queue_size] in packets\n\t[-cwnd cwnd] in packets\n\t[-paths N]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-passes N] times to read every packet's fields" << endl;
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    EventList eventlist;
+    linkspeed_bps linkspeed = speedFromMbps((double)HOST_NIC);
+    uint32_t no_of_nodes = 0;
+    uint32_t queuesize = 35;
+    uint32_t cwnd = 50;
+    int packet_size = 4150;
+    int end_time = 100; // in microseconds
+    uint32_t passes = 20;
+    char* tm_file = NULL;
+    char* topo_file = NULL;
+
+    int i = 1;
+    while (i<argc) {
+        if (i + 1 >= argc) {
+            exit_error(argv[0]);
+        } else if (!strcmp(argv[i],"-tm")){
+            tm_file = argv[i+1];
+        } else if (!strcmp(argv[i],"-topo")){
+            topo_file = argv[i+1];
+        } else if (!strcmp(argv[i],"-nodes")){
+            no_of_nodes = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-q")){
+            queuesize = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-cwnd")){
+            cwnd = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-paths")){
+            EqdsSrc::_path_entropy_size = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-end")){
+            end_time = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-mtu")){
+            packet_size = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-passes")){
+            passes = atoi(argv[i+1]);
+        } else {
+            cout << "Unknown parameter " << argv[i] << endl;
+            exit_error(argv[0]);
+        }
+        i += 2;
+    }
+    if (!tm_file || passes == 0)
+        exit_error(argv[0]);
+
+    Packet::set_packet_size(packet_size);
+    FatTreeSwitch::set_strategy(FatTreeSwitch::ECMP);
+    eventlist.setEndtime(timeFromUs((uint32_t)end_time));
+    mem_b q = memFromPkt(queuesize);
+    EqdsSrc::_min_rto = timeFromUs(150 + q * 6.0 * 8 * 1000000 / linkspeed);
+
+    ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
+    if (!conns->load(tm_file)){
+        cout << "Failed to load connection matrix " << tm_file << endl;
+        exit(-1);
+    }
+
+    FatTreeTopology* top;
+    if (topo_file) {
+        top = FatTreeTopology::load(topo_file, NULL, eventlist, q, COMPOSITE, FAIR_PRIO);
+    } else {
+        if (no_of_nodes == 0)
+            no_of_nodes = conns->N;
+        FatTreeTopology::set_tiers(3);
+        top = new FatTreeTopology(no_of_nodes, linkspeed, q, NULL, &eventlist, NULL, COMPOSITE,
+                                  timeFromUs(1.0), 0, FAIR_PRIO);
+    }
+    no_of_nodes = top->no_of_nodes();
+    if (conns->N != no_of_nodes) {
+        cerr << "Mismatch between connection matrix (" << conns->N << " nodes) and topology ("
+             << no_of_nodes << " nodes)" << endl;
+        exit(1);
+    }
+
+    vector<EqdsPullPacer*> pacers;
+    vector<EqdsNIC*> nics;
+    for (size_t ix = 0; ix < no_of_nodes; ix++){
+        pacers.push_back(new EqdsPullPacer(linkspeed, 0.99, EqdsSrc::_default_mtu, eventlist));
+        nics.push_back(new EqdsNIC(eventlist, linkspeed));
+    }
+
+    vector<connection*>* all_conns = conns->getAllConnections();
+    for (size_t c = 0; c < all_conns->size(); c++){
+        connection* crt = all_conns->at(c);
+        int src = crt->src;
+        int dest = crt->dst;
+
+        EqdsSrc* eqds_src = new EqdsSrc(NULL, eventlist, *nics.at(src));
+        eqds_src->setCwnd(cwnd*Packet::data_packet_size());
+        eqds_src->setDst(dest);
+        EqdsSink* eqds_snk = new EqdsSink(NULL, pacers[dest], *nics.at(dest));
+        eqds_snk->setSrc(src);
+        if (crt->flowid) {
+            eqds_src->setFlowId(crt->flowid);
+            eqds_snk->setFlowId(crt->flowid);
+        }
+        if (crt->size>0){
+            eqds_src->setFlowsize(crt->size);
+        }
+
+        Route* srctotor = new Route();
+        srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
+        srctotor->push_back(top->pipes_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
+        srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]->getRemoteEndpoint());
+
+        Route* dsttotor = new Route();
+        dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
+        dsttotor->push_back(top->pipes_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
+        dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]->getRemoteEndpoint());
+
+        eqds_src->connect(*srctotor, *dsttotor, *eqds_snk, crt->start);
+
+        top->switches_lp[top->HOST_POD_SWITCH(src)]->addHostPort(src,eqds_snk->flowId(),eqds_src);
+        top->switches_lp[top->HOST_POD_SWITCH(dest)]->addHostPort(dest,eqds_src->flowId(),eqds_snk);
+    }
+
+    while (eventlist.doNextEvent()) {
+    }
+
+    // Bytes per packet in flight at peak, per packet type.  The old
+    // layout is estimated by growing each type by the difference in base
+    // class size, which is what moving the fields back would do; its
+    // packets were only aligned for their type, not to a cache line.
+    const size_t old_extra = sizeof(OldPacket) - sizeof(Packet);
+    uint64_t peak = 0, bytes = 0, old_bytes = 0;
+    cout << "Packet " << sizeof(Packet) << " bytes, cold state " << sizeof(PacketColdState)
+         << " bytes when used; old layout " << sizeof(OldPacket) << " bytes" << endl;
+    for (const PacketDBStats* s = PacketDBStats::first(); s; s = s->next()) {
+        if (s->peak() == 0)
+            continue;
+        size_t old_slot = (s->object_size() + old_extra + alignof(OldPacket) - 1)
+            / alignof(OldPacket) * alignof(OldPacket);
+        cout << "  " << setw(16) << left << s->type_name() << right
+             << " peak " << setw(8) << s->peak()
+             << " size " << setw(4) << s->slot_size()
+             << " old size " << setw(4) << old_slot << endl;
+        peak += s->peak();
+        bytes += s->peak() * s->slot_size();
+        old_bytes += s->peak() * old_slot;
+    }
+    if (peak == 0) {
+        cout << "No packets in flight" << endl;
+        return 0;
+    }
+    cout << "In flight at peak: " << peak << " packets, " << bytes / peak << " bytes per packet, old layout "
+         << old_bytes / peak << " bytes per packet" << endl;
+
+    // Per-hop reads over that many packets.  The current layout's
+    // packets come from the PacketDB free list, so they're spread over
+    // the slabs as the run left them.
+    PacketFlow flow(NULL);
+    Route route;
+    vector<EqdsDataPacket*> pkts;
+    for (uint64_t n = 0; n < peak; n++)
+        pkts.push_back(EqdsDataPacket::newpkt(flow, route, n, packet_size, EqdsDataPacket::DATA_PULL, 0, false, n % no_of_nodes));
+    vector<OldEqdsDataPacket> old_storage(peak);
+    vector<OldEqdsDataPacket*> old_pkts;
+    for (uint64_t n = 0; n < peak; n++) {
+        OldEqdsDataPacket* p = &old_storage[n];
+        p->_route = &route;
+        p->_flow = &flow;
+        p->_dst = n % no_of_nodes;
+        old_pkts.push_back(p);
+    }
+    mt19937 rng(1);
+    shuffle(pkts.begin(), pkts.end(), rng);
+    shuffle(old_pkts.begin(), old_pkts.end(), rng);
+
+    double ns = ns_per_packet(pkts, passes);
+    double old_ns = ns_per_packet(old_pkts, passes);
+    cout << "Per-hop field reads: " << ns << " ns per packet, old layout " << old_ns << " ns per packet" << endl;
+
+    for (size_t n = 0; n < pkts.size(); n++)
+        pkts[n]->free();
+}
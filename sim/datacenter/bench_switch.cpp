@@ -0,0 +1,160 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+//
+// Switch forwarding benchmark.  Runs EQDS over a FatTree with the
+// switches routing every packet from their FIBs (as htsim_eqds
+// -strat ecmp_host does), and reports how many packets the switches
+// forwarded, and how many events the simulation ran, per second of
+// wall-clock time.
+#include <string.h>
+#include <chrono>
+#include "network.h"
+#include "eventlist.h"
+#include "eqds.h"
+#include "connection_matrix.h"
+
+#include "fat_tree_topology.h"
+#include "fat_tree_switch.h"
+
+#include "main.h"
+
+void exit_error(char* progr) {
+    cout << "Usage " << progr << " -tm traffic_matrix_file [-topo topology_file | -nodes N]\n\t[-q queue_size] in packets\n\t[-cwnd cwnd] in packets\n\t[-paths N]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]" << endl;
+    exit(1);
+}
+
+uint64_t switch_hops(vector<Switch*>& switches) {
+    uint64_t hops = 0;
+    for (size_t i = 0; i < switches.size(); i++) {
+        if (switches[i])
+            hops += ((FatTreeSwitch*)switches[i])->packets_forwarded();
+    }
+    return hops;
+}
+
+int main(int argc, char **argv) {
+    EventList eventlist;
+    linkspeed_bps linkspeed = speedFromMbps((double)HOST_NIC);
+    uint32_t no_of_nodes = 0;
+    uint32_t queuesize = 35;
+    uint32_t cwnd = 50;
+    int packet_size = 4150;
+    int end_time = 100; // in microseconds
+    char* tm_file = NULL;
+    char* topo_file = NULL;
+
+    int i = 1;
+    while (i<argc) {
+        if (i + 1 >= argc) {
+            exit_error(argv[0]);
+        } else if (!strcmp(argv[i],"-tm")){
+            tm_file = argv[i+1];
+        } else if (!strcmp(argv[i],"-topo")){
+            topo_file = argv[i+1];
+        } else if (!strcmp(argv[i],"-nodes")){
+            no_of_nodes = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-q")){
+            queuesize = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-cwnd")){
+            cwnd = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-paths")){
+            EqdsSrc::_path_entropy_size = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-end")){
+            end_time = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-mtu")){
+            packet_size = atoi(argv[i+1]);
+        } else {
+            cout << "Unknown parameter " << argv[i] << endl;
+            exit_error(argv[0]);
+        }
+        i += 2;
+    }
+    if (!tm_file)
+        exit_error(argv[0]);
+
+    Packet::set_packet_size(packet_size);
+    FatTreeSwitch::set_strategy(FatTreeSwitch::ECMP);
+    eventlist.setEndtime(timeFromUs((uint32_t)end_time));
+    mem_b q = memFromPkt(queuesize);
+    EqdsSrc::_min_rto = timeFromUs(150 + q * 6.0 * 8 * 1000000 / linkspeed);
+
+    ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
+    if (!conns->load(tm_file)){
+        cout << "Failed to load connection matrix " << tm_file << endl;
+        exit(-1);
+    }
+
+    chrono::steady_clock::time_point setup_start = chrono::steady_clock::now();
+    FatTreeTopology* top;
+    if (topo_file) {
+        top = FatTreeTopology::load(topo_file, NULL, eventlist, q, COMPOSITE, FAIR_PRIO);
+    } else {
+        if (no_of_nodes == 0)
+            no_of_nodes = conns->N;
+        FatTreeTopology::set_tiers(3);
+        top = new FatTreeTopology(no_of_nodes, linkspeed, q, NULL, &eventlist, NULL, COMPOSITE,
+                                  timeFromUs(1.0), 0, FAIR_PRIO);
+    }
+    no_of_nodes = top->no_of_nodes();
+    if (conns->N != no_of_nodes) {
+        cerr << "Mismatch between connection matrix (" << conns->N << " nodes) and topology ("
+             << no_of_nodes << " nodes)" << endl;
+        exit(1);
+    }
+
+    vector<EqdsPullPacer*> pacers;
+    vector<EqdsNIC*> nics;
+    for (size_t ix = 0; ix < no_of_nodes; ix++){
+        pacers.push_back(new EqdsPullPacer(linkspeed, 0.99, EqdsSrc::_default_mtu, eventlist));
+        nics.push_back(new EqdsNIC(eventlist, linkspeed));
+    }
+
+    vector<connection*>* all_conns = conns->getAllConnections();
+    for (size_t c = 0; c < all_conns->size(); c++){
+        connection* crt = all_conns->at(c);
+        int src = crt->src;
+        int dest = crt->dst;
+
+        EqdsSrc* eqds_src = new EqdsSrc(NULL, eventlist, *nics.at(src));
+        eqds_src->setCwnd(cwnd*Packet::data_packet_size());
+        eqds_src->setDst(dest);
+        EqdsSink* eqds_snk = new EqdsSink(NULL, pacers[dest], *nics.at(dest));
+        eqds_snk->setSrc(src);
+        if (crt->flowid) {
+            eqds_src->setFlowId(crt->flowid);
+            eqds_snk->setFlowId(crt->flowid);
+        }
+        if (crt->size>0){
+            eqds_src->setFlowsize(crt->size);
+        }
+
+        Route* srctotor = new Route();
+        srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
+        srctotor->push_back(top->pipes_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
+        srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]->getRemoteEndpoint());
+
+        Route* dsttotor = new Route();
+        dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
+        dsttotor->push_back(top->pipes_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
+        dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]->getRemoteEndpoint());
+
+        eqds_src->connect(*srctotor, *dsttotor, *eqds_snk, crt->start);
+
+        top->switches_lp[top->HOST_POD_SWITCH(src)]->addHostPort(src,eqds_snk->flowId(),eqds_src);
+        top->switches_lp[top->HOST_POD_SWITCH(dest)]->addHostPort(dest,eqds_src->flowId(),eqds_snk);
+    }
+
+    chrono::steady_clock::time_point run_start = chrono::steady_clock::now();
+    uint64_t events = 0;
+    while (eventlist.doNextEvent()) {
+        events++;
+    }
+    chrono::steady_clock::time_point run_end = chrono::steady_clock::now();
+
+    uint64_t hops = switch_hops(top->switches_lp) + switch_hops(top->switches_up) + switch_hops(top->switches_c);
+    double setup_secs = chrono::duration<double>(run_start - setup_start).count();
+    double run_secs = chrono::duration<double>(run_end - run_start).count();
+    cout << "Setup: " << setup_secs << "s" << endl;
+    cout << "Run: " << run_secs << "s simulated " << end_time << "us" << endl;
+    cout << "Switch hops: " << hops << " " << hops / run_secs / 1e6 << " Mhops/s" << endl;
+    cout << "Events: " << events << " " << events / run_secs / 1e6 << " Mevents/s" << endl;
+}
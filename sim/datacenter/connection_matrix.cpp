@@ -932,22 +932,7 @@ ConnectionMatrix::getTrigger(triggerid_t id, EventList& eventlist) {
     struct trigger* t = triggers.at(id);
     if (t->trigger == 0) {
         // the actual trigger doesn't exist yet, so create it now
-        switch (t->type) {
-        case SINGLE_SHOT:
-            t->trigger = new SingleShotTrigger(eventlist, t->id);
-            //cout << "creating single_shot with id " << id << endl;
-            break;
-        case MULTI_SHOT:
-            t->trigger = new MultiShotTrigger(eventlist, t->id);
-            //cout << "creating single_shot with id " << id << endl;
-            break;
-        case BARRIER:
-            t->trigger = new BarrierTrigger(eventlist, t->id, t->count);
-            cout << "creating barrier with id " << id << endl;
-            break;
-        case UNSPECIFIED:
-            abort();
-        }
+        t->trigger = createTrigger(id, eventlist);
         /*
         vector <flowid_t>::iterator i;
         for (i = t->flows.begin(); i != t->flows.end(); i++) {
@@ -959,3 +944,22 @@ ConnectionMatrix::getTrigger(triggerid_t id, EventList& eventlist) {
     return t->trigger;
 }
 
+Trigger*
+ConnectionMatrix::createTrigger(triggerid_t id, EventList& eventlist) const {
+    struct trigger* t = triggers.at(id);
+    switch (t->type) {
+    case SINGLE_SHOT:
+        //cout << "creating single_shot with id " << id << endl;
+        return new SingleShotTrigger(eventlist, t->id);
+    case MULTI_SHOT:
+        //cout << "creating single_shot with id " << id << endl;
+        return new MultiShotTrigger(eventlist, t->id);
+    case BARRIER:
+        SimContext::current().log() << "creating barrier with id " << id << endl;
+        return new BarrierTrigger(eventlist, t->id, t->count);
+    case UNSPECIFIED:
+        break;
+    }
+    abort();
+}
+
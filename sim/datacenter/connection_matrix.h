@@ -73,6 +73,9 @@ public:
   
     vector<connection*>* getAllConnections();
     Trigger* getTrigger(triggerid_t id, EventList& eventlist);
+    // a new trigger that isn't remembered by the matrix, for when
+    // several simulations share one matrix
+    Trigger* createTrigger(triggerid_t id, EventList& eventlist) const;
     void bindTriggers(connection* c, EventList& eventlist);
 
     uint32_t N;
@@ -0,0 +1,192 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "fat_tree_partition.h"
+#include "fat_tree_switch.h"
+
+#define CROSSING_PIPE 0x80000000
+
+FatTreePartition::FatTreePartition(FatTreeTopology& top) : _top(top)
+{
+    _window = 0;
+    _events = 0;
+    _unassigned_events = 0;
+    _busiest_lp_events = 0;
+    _windows = 0;
+    _crossings = 0;
+    _lookahead = 0;
+
+    if (FatTreeTopology::get_tiers() != 3) {
+        // leaf-spine: a single pod, so nothing to split
+        _no_of_lps = 1;
+        _window_events.resize(_no_of_lps, 0);
+        return;
+    }
+
+    uint32_t tors_per_pod = top.tor_switches_per_pod();
+    _no_of_lps = top.no_of_pods() + 1;
+    _window_events.resize(_no_of_lps, 0);
+
+    for (uint32_t tor = 0; tor < top.switches_lp.size(); tor++) {
+        uint32_t pod = tor / tors_per_pod;
+        assign_switch(top.switches_lp[tor], pod);
+        // the link tables only hold links that exist, and the queue
+        // and pipe tables of a tier hold the same links
+        for (uint32_t i = 0; i < top.queues_nlp_ns[tor].links(); i++) {
+            uint32_t srv = top.queues_nlp_ns[tor].to(i);
+            for (uint32_t b = 0; b < top.queues_nlp_ns[tor][srv].size(); b++) {
+                assign_queue(top.queues_nlp_ns[tor][srv][b], pod);
+                assign_pipe(top.pipes_nlp_ns[tor][srv][b], pod, false);
+            }
+        }
+        for (uint32_t i = 0; i < top.queues_nlp_nup[tor].links(); i++) {
+            uint32_t agg = top.queues_nlp_nup[tor].to(i);
+            for (uint32_t b = 0; b < top.queues_nlp_nup[tor][agg].size(); b++) {
+                assign_queue(top.queues_nlp_nup[tor][agg][b], pod);
+                assign_pipe(top.pipes_nlp_nup[tor][agg][b], pod, false);
+            }
+        }
+    }
+    for (uint32_t srv = 0; srv < top.queues_ns_nlp.size(); srv++) {
+        for (uint32_t i = 0; i < top.queues_ns_nlp[srv].links(); i++) {
+            uint32_t tor = top.queues_ns_nlp[srv].to(i);
+            for (uint32_t b = 0; b < top.queues_ns_nlp[srv][tor].size(); b++) {
+                assign_queue(top.queues_ns_nlp[srv][tor][b], tor / tors_per_pod);
+                assign_pipe(top.pipes_ns_nlp[srv][tor][b], tor / tors_per_pod, false);
+            }
+        }
+    }
+    for (uint32_t agg = 0; agg < top.switches_up.size(); agg++) {
+        uint32_t pod = top.AGG_SWITCH_POD_ID(agg);
+        assign_switch(top.switches_up[agg], pod);
+        for (uint32_t i = 0; i < top.queues_nup_nlp[agg].links(); i++) {
+            uint32_t tor = top.queues_nup_nlp[agg].to(i);
+            for (uint32_t b = 0; b < top.queues_nup_nlp[agg][tor].size(); b++) {
+                assign_queue(top.queues_nup_nlp[agg][tor][b], pod);
+                assign_pipe(top.pipes_nup_nlp[agg][tor][b], pod, false);
+            }
+        }
+        // the agg's uplink queue is in the pod, but the pipe delivers to the core
+        for (uint32_t i = 0; i < top.queues_nup_nc[agg].links(); i++) {
+            uint32_t core = top.queues_nup_nc[agg].to(i);
+            for (uint32_t b = 0; b < top.queues_nup_nc[agg][core].size(); b++) {
+                assign_queue(top.queues_nup_nc[agg][core][b], pod);
+                assign_pipe(top.pipes_nup_nc[agg][core][b], core_lp(), true);
+            }
+        }
+    }
+    for (uint32_t core = 0; core < top.switches_c.size(); core++) {
+        assign_switch(top.switches_c[core], core_lp());
+        for (uint32_t i = 0; i < top.queues_nc_nup[core].links(); i++) {
+            uint32_t agg = top.queues_nc_nup[core].to(i);
+            for (uint32_t b = 0; b < top.queues_nc_nup[core][agg].size(); b++) {
+                assign_queue(top.queues_nc_nup[core][agg][b], core_lp());
+                assign_pipe(top.pipes_nc_nup[core][agg][b], top.AGG_SWITCH_POD_ID(agg), true);
+            }
+        }
+    }
+}
+
+uint32_t
+FatTreePartition::host_lp(uint32_t host)
+{
+    if (_no_of_lps == 1)
+        return 0;
+    return _top.HOST_POD_SWITCH(host) / _top.tor_switches_per_pod();
+}
+
+void
+FatTreePartition::assign(EventSource& src, uint32_t lp)
+{
+    assert(lp < _no_of_lps);
+    _lps[&src] = lp;
+}
+
+void
+FatTreePartition::assign_switch(Switch* sw, uint32_t lp)
+{
+    if (!sw)
+        return;
+    assign(*sw, lp);
+    // the switch's internal pipe carries packets from its inputs to its outputs
+    assign_pipe(((FatTreeSwitch*)sw)->pipe(), lp, false);
+}
+
+void
+FatTreePartition::assign_queue(BaseQueue* q, uint32_t lp)
+{
+    if (q)
+        assign(*q, lp);
+}
+
+void
+FatTreePartition::assign_pipe(Pipe* p, uint32_t lp, bool crosses_lps)
+{
+    if (!p)
+        return;
+    assign(*p, lp);
+    if (crosses_lps) {
+        _lps[p] |= CROSSING_PIPE;
+        if (_lookahead == 0 || p->delay() < _lookahead)
+            _lookahead = p->delay();
+    }
+}
+
+int
+FatTreePartition::lp_of(EventSource& src) const
+{
+    auto i = _lps.find(&src);
+    if (i == _lps.end())
+        return -1;
+    return i->second & ~CROSSING_PIPE;
+}
+
+void
+FatTreePartition::end_window()
+{
+    uint64_t busiest = 0;
+    for (uint32_t lp = 0; lp < _no_of_lps; lp++) {
+        if (_window_events[lp] > busiest)
+            busiest = _window_events[lp];
+        _window_events[lp] = 0;
+    }
+    if (busiest > 0) {
+        _busiest_lp_events += busiest;
+        _windows++;
+    }
+}
+
+void
+FatTreePartition::eventDispatched(EventSource& src, simtime_picosec when)
+{
+    uint64_t window = _lookahead ? when / _lookahead : 0;
+    if (window != _window) {
+        end_window();
+        _window = window;
+    }
+    _events++;
+    auto i = _lps.find(&src);
+    if (i == _lps.end()) {
+        // we don't know where this runs, so assume it serializes everything
+        _unassigned_events++;
+        return;
+    }
+    if (i->second & CROSSING_PIPE)
+        _crossings++;
+    _window_events[i->second & ~CROSSING_PIPE]++;
+}
+
+void
+FatTreePartition::print_stats(ostream& os)
+{
+    end_window();
+    os << "Partition: " << _no_of_lps << " LPs";
+    if (_no_of_lps == 1) {
+        os << " (only 3-tier fat trees can be partitioned)" << endl;
+        return;
+    }
+    os << ", lookahead " << timeAsUs(_lookahead) << "us" << endl;
+    uint64_t serial = _busiest_lp_events + _unassigned_events;
+    os << "Partition events: " << _events << " total, " << _unassigned_events << " unassigned, "
+       << _crossings << " crossing LPs, " << _windows << " windows" << endl;
+    if (serial > 0)
+        os << "Partition estimated speedup: " << (double)_events / serial << endl;
+}
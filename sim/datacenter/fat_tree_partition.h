@@ -0,0 +1,66 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef FAT_TREE_PARTITION_H
+#define FAT_TREE_PARTITION_H
+
+/*
+ * Splits a 3-tier FatTreeTopology into logical processes (LPs) for
+ * conservative parallel simulation: one LP per pod (ToRs, aggs, the
+ * hosts below them and the links between them), plus one LP for the
+ * core tier.  The only links between LPs are the agg<->core pipes, so
+ * the smallest of their latencies is the lookahead: an event in one LP
+ * can't affect another LP any sooner than that.
+ *
+ * This observes a normal sequential run and measures how much
+ * parallelism a YAWNS-style windowed execution would find: within
+ * each lookahead-sized window, the LPs' events are independent, so a
+ * window takes as long as its busiest LP.  To actually run the LPs on
+ * their own threads, build the FatTreeTopology with a ParallelSim
+ * (see parallelsim.h), which partitions it the same way.
+ */
+
+#include <unordered_map>
+#include <vector>
+#include <ostream>
+#include "eventlist.h"
+#include "fat_tree_topology.h"
+
+class FatTreePartition : public EventObserver {
+public:
+    FatTreePartition(FatTreeTopology& top);
+
+    uint32_t no_of_lps() const {return _no_of_lps;}
+    uint32_t core_lp() const {return _no_of_lps - 1;}
+    uint32_t host_lp(uint32_t host);
+    simtime_picosec lookahead() const {return _lookahead;}
+
+    // sources the topology doesn't know about, eg transport endpoints
+    void assign(EventSource& src, uint32_t lp);
+    void assignHost(EventSource& src, uint32_t host) {assign(src, host_lp(host));}
+    int lp_of(EventSource& src) const; // -1 if unassigned
+
+    virtual void eventDispatched(EventSource& src, simtime_picosec when);
+    void print_stats(ostream& os);
+
+private:
+    void assign_switch(Switch* sw, uint32_t lp);
+    void assign_queue(BaseQueue* q, uint32_t lp);
+    void assign_pipe(Pipe* p, uint32_t lp, bool crosses_lps);
+    void end_window();
+
+    FatTreeTopology& _top;
+    uint32_t _no_of_lps;
+    simtime_picosec _lookahead;  // zero if there's only one LP
+    // LP of each source; the top bit is set for pipes between LPs
+    unordered_map<EventSource*, uint32_t> _lps;
+
+    // window accounting
+    uint64_t _window;
+    vector<uint64_t> _window_events;  // events per LP in the current window
+    uint64_t _events;
+    uint64_t _unassigned_events;
+    uint64_t _busiest_lp_events;  // sum over windows of the busiest LP's events
+    uint64_t _windows;
+    uint64_t _crossings;  // pipe deliveries between LPs
+};
+
+#endif
@@ -6,12 +6,12 @@
 #include "queue_lossless.h"
 #include "queue_lossless_output.h"
 
-unordered_map<BaseQueue*,uint32_t> FatTreeSwitch::_port_flow_counts;
+thread_local unordered_map<BaseQueue*,uint32_t> FatTreeSwitch::_port_flow_counts;
 
-FatTreeSwitch::FatTreeSwitch(EventList& eventlist, string s, switch_type t, uint32_t id,simtime_picosec delay, FatTreeTopology* ft): Switch(eventlist, s) {
+FatTreeSwitch::FatTreeSwitch(EventList& eventlist, string s, switch_type t, uint32_t id,simtime_picosec delay, FatTreeTopology* ft): Switch(eventlist, s), _egress(s + "_egress") {
     _id = id;
     _type = t;
-    _pipe = new CallbackPipe(delay,eventlist, this);
+    _pipe = new CallbackPipe(delay,eventlist, &_egress);
     _uproutes = NULL;
     _ft = ft;
     _crt_route = 0;
@@ -20,6 +20,17 @@ FatTreeSwitch::FatTreeSwitch(EventList& eventlist, string s, switch_type t, uint
     _fib = new RouteTable();
 }
 
+FatTreeSwitch::~FatTreeSwitch() {
+    delete _pipe;
+    delete _fib;
+    for (auto& f : _flowlet_maps)
+        delete f.second;
+    // the counts are kept per thread, and a later simulation on this
+    // thread may get queues at the same addresses
+    for (size_t i = 0; i < _ports.size(); i++)
+        _port_flow_counts.erase(_ports[i]);
+}
+
 void FatTreeSwitch::receivePacket(Packet& pkt){
     if (pkt.type()==ETH_PAUSE){
         EthPausePacket* p = (EthPausePacket*)&pkt;
@@ -36,25 +47,14 @@ void FatTreeSwitch::receivePacket(Packet& pkt){
         return;
     }
 
-    if (_packets.find(&pkt)==_packets.end()){
-        //ingress pipeline processing.
-
-        _packets[&pkt] = true;
-
-        const Route * nh = getNextHop(pkt,NULL);
-        //set next hop which is peer switch.
-        pkt.set_route(*nh);
+    //ingress pipeline processing.
+    const Route * nh = getNextHop(pkt,NULL);
+    //set next hop which is peer switch.
+    pkt.set_route(*nh);
 
-        //emulate the switching latency between ingress and packet arriving at the egress queue.
-        _pipe->receivePacket(pkt); 
-    }
-    else {
-        _packets.erase(&pkt);
-        
-        //egress queue processing.
-        //cout << "Switch type " << _type <<  " id " << _id << " pkt dst " << pkt.dst() << " dir " << pkt.get_direction() << endl;
-        pkt.sendOn();
-    }
+    //emulate the switching latency between ingress and packet arriving at the egress queue.
+    //_egress does the egress queue processing.
+    _pipe->receivePacket(pkt); 
 };
 
 void FatTreeSwitch::addHostPort(int addr, int flowid, PacketSink* transport){
@@ -72,7 +72,7 @@ uint32_t mhash(uint32_t x) {
     return x;
 }
 
-uint32_t FatTreeSwitch::adaptive_route_p2c(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*)){
+uint32_t FatTreeSwitch::adaptive_route_p2c(vector<FibEntry>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*)){
     uint32_t choice = 0, min = UINT32_MAX;
     uint32_t start, i = 0;
     static const uint16_t nr_choices = 2;
@@ -80,9 +80,7 @@ uint32_t FatTreeSwitch::adaptive_route_p2c(vector<FibEntry*>* ecmp_set, int8_t (
     do {
         start = random()%ecmp_set->size();
 
-        Route * r= (*ecmp_set)[start]->getEgressPort();
-        assert(r && r->size()>1);
-        BaseQueue* q = (BaseQueue*)(r->at(0));
+        BaseQueue* q = (*ecmp_set)[start].getEgressQueue();
         assert(q);
         if (q->queuesize()<min){
             choice = start;
@@ -93,22 +91,22 @@ uint32_t FatTreeSwitch::adaptive_route_p2c(vector<FibEntry*>* ecmp_set, int8_t (
     return choice;
 }
 
-uint32_t FatTreeSwitch::adaptive_route(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*)){
+uint32_t FatTreeSwitch::adaptive_route(vector<FibEntry>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*)){
     //cout << "adaptive_route" << endl;
     uint32_t choice = 0;
 
     uint32_t best_choices[256];
     uint32_t best_choices_count = 0;
   
-    FibEntry* min = (*ecmp_set)[choice];
+    FibEntry* min = &(*ecmp_set)[choice];
     best_choices[best_choices_count++] = choice;
 
     for (uint32_t i = 1; i< ecmp_set->size(); i++){
-        int8_t c = cmp(min,(*ecmp_set)[i]);
+        int8_t c = cmp(min,&(*ecmp_set)[i]);
 
         if (c < 0){
             choice = i;
-            min = (*ecmp_set)[choice];
+            min = &(*ecmp_set)[choice];
             best_choices_count = 0;
             best_choices[best_choices_count++] = choice;
         }
@@ -125,31 +123,31 @@ uint32_t FatTreeSwitch::adaptive_route(vector<FibEntry*>* ecmp_set, int8_t (*cmp
 
     if (cmp==compare_flow_count){
         //for (uint32_t i = 0; i<best_choices_count;i++)
-          //  cout << "pathcnt " << best_choices[i] << "="<< _port_flow_counts[(BaseQueue*)( (*ecmp_set)[best_choices[i]]->getEgressPort()->at(0))]<< " ";
+          //  cout << "pathcnt " << best_choices[i] << "="<< _port_flow_counts[(*ecmp_set)[best_choices[i]].getEgressQueue()]<< " ";
         
-        _port_flow_counts[(BaseQueue*)((*ecmp_set)[choice]->getEgressPort()->at(0))]++;
+        _port_flow_counts[(*ecmp_set)[choice].getEgressQueue()]++;
     }
 
     return choice;
 }
 
-uint32_t FatTreeSwitch::replace_worst_choice(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*),uint32_t my_choice){
+uint32_t FatTreeSwitch::replace_worst_choice(vector<FibEntry>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*),uint32_t my_choice){
     uint32_t best_choice = 0;
     uint32_t worst_choice = 0;
 
     uint32_t best_choices[256];
     uint32_t best_choices_count = 0;
 
-    FibEntry* min = (*ecmp_set)[best_choice];
-    FibEntry* max = (*ecmp_set)[worst_choice];
+    FibEntry* min = &(*ecmp_set)[best_choice];
+    FibEntry* max = &(*ecmp_set)[worst_choice];
     best_choices[best_choices_count++] = best_choice;
 
     for (uint32_t i = 1; i< ecmp_set->size(); i++){
-        int8_t c = cmp(min,(*ecmp_set)[i]);
+        int8_t c = cmp(min,&(*ecmp_set)[i]);
 
         if (c < 0){
             best_choice = i;
-            min = (*ecmp_set)[best_choice];
+            min = &(*ecmp_set)[best_choice];
             best_choices_count = 0;
             best_choices[best_choices_count++] = best_choice;
         }
@@ -158,14 +156,14 @@ uint32_t FatTreeSwitch::replace_worst_choice(vector<FibEntry*>* ecmp_set, int8_t
             best_choices[best_choices_count++] = i;
         }        
 
-        if (cmp(max,(*ecmp_set)[i])>0){
+        if (cmp(max,&(*ecmp_set)[i])>0){
             worst_choice = i;
-            max = (*ecmp_set)[worst_choice];
+            max = &(*ecmp_set)[worst_choice];
         }
     }
 
     //might need to play with different alternatives here, compare to worst rather than just to worst index.
-    int8_t r = cmp((*ecmp_set)[my_choice],(*ecmp_set)[worst_choice]);
+    int8_t r = cmp(&(*ecmp_set)[my_choice],&(*ecmp_set)[worst_choice]);
     assert(r>=0);
 
     if (r==0){
@@ -177,12 +175,8 @@ uint32_t FatTreeSwitch::replace_worst_choice(vector<FibEntry*>* ecmp_set, int8_t
 
 
 int8_t FatTreeSwitch::compare_pause(FibEntry* left, FibEntry* right){
-    Route * r1= left->getEgressPort();
-    assert(r1 && r1->size()>1);
-    LosslessOutputQueue* q1 = dynamic_cast<LosslessOutputQueue*>(r1->at(0));
-    Route * r2= right->getEgressPort();
-    assert(r2 && r2->size()>1);
-    LosslessOutputQueue* q2 = dynamic_cast<LosslessOutputQueue*>(r2->at(0));
+    LosslessOutputQueue* q1 = dynamic_cast<LosslessOutputQueue*>(left->getEgressQueue());
+    LosslessOutputQueue* q2 = dynamic_cast<LosslessOutputQueue*>(right->getEgressQueue());
 
     if (!q1->is_paused()&&q2->is_paused())
         return 1;
@@ -193,12 +187,8 @@ int8_t FatTreeSwitch::compare_pause(FibEntry* left, FibEntry* right){
 }
 
 int8_t FatTreeSwitch::compare_flow_count(FibEntry* left, FibEntry* right){
-    Route * r1= left->getEgressPort();
-    assert(r1 && r1->size()>1);
-    BaseQueue* q1 = (BaseQueue*)(r1->at(0));
-    Route * r2= right->getEgressPort();
-    assert(r2 && r2->size()>1);
-    BaseQueue* q2 = (BaseQueue*)(r2->at(0));
+    BaseQueue* q1 = left->getEgressQueue();
+    BaseQueue* q2 = right->getEgressQueue();
 
     if (_port_flow_counts.find(q1)==_port_flow_counts.end())
         _port_flow_counts[q1] = 0;
@@ -217,12 +207,8 @@ int8_t FatTreeSwitch::compare_flow_count(FibEntry* left, FibEntry* right){
 }
 
 int8_t FatTreeSwitch::compare_queuesize(FibEntry* left, FibEntry* right){
-    Route * r1= left->getEgressPort();
-    assert(r1 && r1->size()>1);
-    BaseQueue* q1 = dynamic_cast<BaseQueue*>(r1->at(0));
-    Route * r2= right->getEgressPort();
-    assert(r2 && r2->size()>1);
-    BaseQueue* q2 = dynamic_cast<BaseQueue*>(r2->at(0));
+    BaseQueue* q1 = left->getEgressQueue();
+    BaseQueue* q2 = right->getEgressQueue();
 
     if (q1->quantized_queuesize() < q2->quantized_queuesize())
         return 1;
@@ -233,12 +219,8 @@ int8_t FatTreeSwitch::compare_queuesize(FibEntry* left, FibEntry* right){
 }
 
 int8_t FatTreeSwitch::compare_bandwidth(FibEntry* left, FibEntry* right){
-    Route * r1= left->getEgressPort();
-    assert(r1 && r1->size()>1);
-    BaseQueue* q1 = dynamic_cast<BaseQueue*>(r1->at(0));
-    Route * r2= right->getEgressPort();
-    assert(r2 && r2->size()>1);
-    BaseQueue* q2 = dynamic_cast<BaseQueue*>(r2->at(0));
+    BaseQueue* q1 = left->getEgressQueue();
+    BaseQueue* q2 = right->getEgressQueue();
 
     if (q1->quantized_utilization() < q2->quantized_utilization())
         return 1;
@@ -300,26 +282,64 @@ int8_t FatTreeSwitch::compare_pb(FibEntry* left, FibEntry* right){
     return compare_bandwidth(left,right);
 }
 
-void FatTreeSwitch::permute_paths(vector<FibEntry *>* uproutes) {
+void FatTreeSwitch::permute_paths(vector<FibEntry>* uproutes) {
     int len = uproutes->size();
     for (int i = 0; i < len; i++) {
         int ix = random() % (len - i);
-        FibEntry* tmppath = (*uproutes)[ix];
+        FibEntry tmppath = (*uproutes)[ix];
         (*uproutes)[ix] = (*uproutes)[len-1-i];
         (*uproutes)[len-1-i] = tmppath;
     }
 }
 
+// Compact path mode: the packet's pathid is an index into the paths
+// FatTreeTopology::get_bidir_paths() enumerates between the packet's
+// source and destination, most significant digit first: upper switch,
+// core uplink bundle, ToR->agg link, agg->ToR link, agg->core link,
+// core->agg link.  Each switch decodes the digit for its own hop and
+// returns the matching entry of its (unpermuted) FIB set.
+uint32_t FatTreeSwitch::path_index_route(Packet& pkt) {
+    uint32_t p = pkt.pathid();
+    uint32_t dst = pkt.dst();
+    uint32_t b1 = _ft->bundlesize(AGG_TIER);
+    uint32_t b2 = _ft->bundlesize(CORE_TIER);
+    uint32_t cores = _ft->radix_up(AGG_TIER) / b2;
+
+    switch (_type) {
+    case TOR:
+        {
+            uint32_t first_host = _id * _ft->radix_down(TOR_TIER);
+            if (_ft->HOST_POD(dst) == _ft->HOST_POD(first_host)) {
+                // intra-pod: upper, b_up, b_down
+                return p % _ft->no_of_paths(first_host, dst) / b1;
+            }
+            p %= _ft->no_of_paths(first_host, dst);
+            return (p / (cores * b1 * b1 * b2 * b2)) * b1 + (p / (b1 * b2 * b2)) % b1;
+        }
+    case AGG:
+        if (_ft->get_tiers()==2 || _ft->HOST_POD(dst) == _ft->AGG_SWITCH_POD_ID(_id)) {
+            if (pkt.get_direction() == DOWN) // came from a core switch
+                return (p / (b2 * b2)) % b1;
+            return p % b1;
+        }
+        return ((p / (b1 * b1 * b2 * b2)) % cores) * b2 + (p / b2) % b2;
+    case CORE:
+        return p % b2;
+    default:
+        abort();
+    }
+}
+
 FatTreeSwitch::routing_strategy FatTreeSwitch::_strategy = FatTreeSwitch::NIX;
 uint16_t FatTreeSwitch::_ar_fraction = 0;
 uint16_t FatTreeSwitch::_ar_sticky = FatTreeSwitch::PER_PACKET;
 simtime_picosec FatTreeSwitch::_sticky_delta = timeFromUs((uint32_t)10);
-double FatTreeSwitch::_ecn_threshold_fraction = 1.0;
+thread_local double FatTreeSwitch::_ecn_threshold_fraction = 1.0;
 double FatTreeSwitch::_speculative_threshold_fraction = 0.2;
 int8_t (*FatTreeSwitch::fn)(FibEntry*,FibEntry*)= &FatTreeSwitch::compare_queuesize;
 
 Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
-    vector<FibEntry*> * available_hops = _fib->getRoutes(pkt.dst());
+    vector<FibEntry>* available_hops = _fib->getRoutes(pkt.dst());
 
     if (available_hops){
         //implement a form of ECMP hashing; might need to revisit based on measured performance.
@@ -346,7 +366,7 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
                         if (eventlist().now() - f->_last > _sticky_delta && /*eventlist().now() - _last_choice > _pipe->delay() + BaseQueue::_update_period  &&*/ random()%2==0){ 
                             //cout << "AR 1 " << timeAsUs(eventlist().now()) << endl;
                             uint32_t new_route = adaptive_route(available_hops,fn); 
-                            if (fn(available_hops->at(f->_egress),available_hops->at(new_route)) < 0){
+                            if (fn(&available_hops->at(f->_egress),&available_hops->at(new_route)) < 0){
                                 f->_egress = new_route;
                                 _last_choice = eventlist().now();
                                 //cout << "Switch " << _type << ":" << _id << " choosing new path "<<  f->_egress << " for " << pkt.flow_id() << " at " << timeAsUs(eventlist().now()) << " last is " << timeAsUs(f->_last) << endl;
@@ -390,13 +410,17 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
                 }
                 else ecmp_choice = freeBSDHash(pkt.flow_id(),pkt.pathid(),_hash_salt) % available_hops->size();
                 
+                break;
+            case PATH_INDEX:
+                // the FIB only falls short of the full set after link failures
+                ecmp_choice = path_index_route(pkt) % available_hops->size();
                 break;
             }
         
-        FibEntry* e = (*available_hops)[ecmp_choice];
-        pkt.set_direction(e->getDirection());
+        FibEntry& e = (*available_hops)[ecmp_choice];
+        pkt.set_direction(e.getDirection());
         
-        return e->getEgressPort();
+        return e.getEgressPort();
     }
 
     //no route table entries for this destination. Add them to FIB or fail. 
@@ -441,7 +465,8 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
                     */
                 }
                 _uproutes = _fib->getRoutes(pkt.dst());
-                permute_paths(_uproutes);
+                if (_strategy != PATH_INDEX)
+                    permute_paths(_uproutes);
             }
         }
     } else if (_type == AGG) {
@@ -487,7 +512,8 @@ Route* FatTreeSwitch::getNextHop(Packet& pkt, BaseQueue* ingress_port){
                     }
                 }
                 //_uproutes = _fib->getRoutes(pkt.dst());
-                permute_paths(_fib->getRoutes(pkt.dst()));
+                if (_strategy != PATH_INDEX)
+                    permute_paths(_fib->getRoutes(pkt.dst()));
             }
         }
     } else if (_type == CORE) {
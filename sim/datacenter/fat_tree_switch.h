@@ -81,6 +81,23 @@ public:
 
 };
 
+// The egress stage of a FatTreeSwitch.  The switch's internal pipe
+// delivers each packet here once the switching latency has passed, so
+// the switch itself only ever sees packets arriving at ingress.
+class FatTreeSwitchEgress : public PacketSink {
+public:
+    FatTreeSwitchEgress(const string& name) : _nodename(name), _forwarded(0) {}
+    virtual void receivePacket(Packet& pkt) {
+        _forwarded++;
+        pkt.sendOn();
+    }
+    virtual const string& nodename() {return _nodename;}
+    uint64_t forwarded() const {return _forwarded;}
+private:
+    string _nodename;
+    uint64_t _forwarded;
+};
+
 class FatTreeSwitch : public Switch {
 public:
     enum switch_type {
@@ -88,7 +105,7 @@ public:
     };
 
     enum routing_strategy {
-        NIX = 0, ECMP = 1, ADAPTIVE_ROUTING = 2, ECMP_ADAPTIVE = 3, RR = 4, RR_ECMP = 5
+        NIX = 0, ECMP = 1, ADAPTIVE_ROUTING = 2, ECMP_ADAPTIVE = 3, RR = 4, RR_ECMP = 5, PATH_INDEX = 6
     };
 
     enum sticky_choices {
@@ -96,14 +113,16 @@ public:
     };
 
     FatTreeSwitch(EventList& eventlist, string s, switch_type t, uint32_t id,simtime_picosec switch_delay, FatTreeTopology* ft);
+    ~FatTreeSwitch();
   
     virtual void receivePacket(Packet& pkt);
     virtual Route* getNextHop(Packet& pkt, BaseQueue* ingress_port);
     virtual uint32_t getType() {return _type;}
 
-    uint32_t adaptive_route(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*));
-    uint32_t replace_worst_choice(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*),uint32_t my_choice);
-    uint32_t adaptive_route_p2c(vector<FibEntry*>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*));
+    uint32_t adaptive_route(vector<FibEntry>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*));
+    uint32_t replace_worst_choice(vector<FibEntry>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*),uint32_t my_choice);
+    uint32_t adaptive_route_p2c(vector<FibEntry>* ecmp_set, int8_t (*cmp)(FibEntry*,FibEntry*));
+    uint32_t path_index_route(Packet& pkt);
 
     static int8_t compare_flow_count(FibEntry* l, FibEntry* r);
     static int8_t compare_pause(FibEntry* l, FibEntry* r);
@@ -118,7 +137,10 @@ public:
 
     virtual void addHostPort(int addr, int flowid, PacketSink* transport);
 
-    virtual void permute_paths(vector<FibEntry*>* uproutes);
+    virtual void permute_paths(vector<FibEntry>* uproutes);
+
+    Pipe* pipe() const {return _pipe;}  // models the switching latency
+    uint64_t packets_forwarded() const {return _egress.forwarded();}
 
     static void set_strategy(routing_strategy s) { assert (_strategy==NIX); _strategy = s; }
     static void set_ar_fraction(uint16_t f) { assert(f>=1);_ar_fraction = f;} 
@@ -127,25 +149,24 @@ public:
     static uint16_t _ar_fraction;
     static uint16_t _ar_sticky;
     static simtime_picosec _sticky_delta;
-    static double _ecn_threshold_fraction;
+    static thread_local double _ecn_threshold_fraction;  // per-thread, see SimContext
     static double _speculative_threshold_fraction;
 private:
     switch_type _type;
     Pipe* _pipe;
+    FatTreeSwitchEgress _egress;
     FatTreeTopology* _ft;
     
     //CAREFUL: can't always have a single FIB for all up destinations when there are failures!
-    vector<FibEntry*>* _uproutes;
+    vector<FibEntry>* _uproutes;
 
     unordered_map<uint32_t,FlowletInfo*> _flowlet_maps;
 
-    static unordered_map<BaseQueue*,uint32_t> _port_flow_counts;
+    static thread_local unordered_map<BaseQueue*,uint32_t> _port_flow_counts;
 
     uint32_t _crt_route;
     uint32_t _hash_salt;
     simtime_picosec _last_choice;
-
-    unordered_map<Packet*,bool> _packets;
 };
 
 #endif
@@ -17,6 +17,7 @@
 #include "queue_lossless_output.h"
 #include "swift_scheduler.h"
 #include "ecnqueue.h"
+#include "parallelsim.h"
 
 // use tokenize from connection matrix
 extern void tokenize(string const &str, const char delim, vector<string> &out);
@@ -51,12 +52,19 @@ FatTreeTopology::set_tier_parameters(int tier, int radix_up, int radix_down, mem
 }
 
 // load a config file and use it to create a FatTreeTopology
-FatTreeTopology* FatTreeTopology::load(const char * filename, QueueLoggerFactory* logger_factory, EventList& eventlist, mem_b queuesize, queue_type q_type, queue_type sender_q_type){
+FatTreeTopology* FatTreeTopology::load(const char * filename, QueueLoggerFactory* logger_factory, EventList& eventlist, mem_b queuesize, queue_type q_type, queue_type sender_q_type, ParallelSim* parallel){
+    uint32_t no_of_nodes = load_config(filename, queuesize);
+    FatTreeTopology* ft = new FatTreeTopology(no_of_nodes, 0, 0, logger_factory, &eventlist, NULL, q_type, 0, 0, sender_q_type, parallel);
+    SimContext::current().log() << "FatTree constructor done, " << ft->no_of_nodes() << " nodes created\n";
+    return ft;
+}
+
+uint32_t FatTreeTopology::load_config(const char * filename, mem_b queuesize){
     std::ifstream file(filename);
     if (file.is_open()) {
-        FatTreeTopology* ft = load(file, logger_factory, eventlist, queuesize, q_type, sender_q_type);
+        uint32_t no_of_nodes = load_config(file, queuesize);
         file.close();
-	return ft;
+	return no_of_nodes;
     } else {
         cerr << "Failed to open FatTree config file " << filename << endl;
         exit(1);
@@ -73,7 +81,7 @@ void to_lower(string& s) {
         //[](unsigned char c){ return std::tolower(c); });
 }
 
-FatTreeTopology* FatTreeTopology::load(istream& file, QueueLoggerFactory* logger_factory, EventList& eventlist, mem_b queuesize, queue_type q_type, queue_type sender_q_type){
+uint32_t FatTreeTopology::load_config(istream& file, mem_b queuesize){
     //cout << "topo load start\n";
     std::string line;
     int linecount = 0;
@@ -238,14 +246,13 @@ FatTreeTopology* FatTreeTopology::load(istream& file, QueueLoggerFactory* logger
     }
 
     cout << "Topology load done\n";
-    FatTreeTopology* ft = new FatTreeTopology(no_of_nodes, 0, 0, logger_factory, &eventlist, NULL, q_type, 0, 0, sender_q_type);
-    cout << "FatTree constructor done, " << ft->no_of_nodes() << " nodes created\n";
-    return ft;
+    return no_of_nodes;
 }
 
 FatTreeTopology::FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed, mem_b queuesize,
                                  QueueLoggerFactory* logger_factory,
-                                 EventList* ev,FirstFit * fit,queue_type q, simtime_picosec latency, simtime_picosec switch_latency, queue_type snd){
+                                 EventList* ev,FirstFit * fit,queue_type q, simtime_picosec latency, simtime_picosec switch_latency, queue_type snd,
+                                 ParallelSim* parallel){
     
     set_linkspeeds(linkspeed);
     set_queue_sizes(queuesize);
@@ -262,25 +269,42 @@ FatTreeTopology::FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed,
     _hop_latency = latency;
     _switch_latency = switch_latency;
 
+    ostream& log = SimContext::current().log();
     if (_link_latencies[TOR_TIER] == 0) {
-        cout << "Fat Tree topology with " << timeAsUs(_hop_latency) << "us links and " << timeAsUs(_switch_latency) <<"us switching latency." <<endl;
+        log << "Fat Tree topology with " << timeAsUs(_hop_latency) << "us links and " << timeAsUs(_switch_latency) <<"us switching latency." <<endl;
     } else {
-        cout << "Fat Tree topology with "
-             << timeAsUs(_link_latencies[TOR_TIER]) << "us Src-ToR links, "
-             << timeAsUs(_link_latencies[AGG_TIER]) << "us ToR-Agg links, ";
+        log << "Fat Tree topology with "
+            << timeAsUs(_link_latencies[TOR_TIER]) << "us Src-ToR links, "
+            << timeAsUs(_link_latencies[AGG_TIER]) << "us ToR-Agg links, ";
         if (_tiers == 3) {
-            cout << timeAsUs(_link_latencies[CORE_TIER]) << "us Agg-Core links, ";
+            log << timeAsUs(_link_latencies[CORE_TIER]) << "us Agg-Core links, ";
         }
-        cout << timeAsUs(_switch_latencies[TOR_TIER]) << "us ToR switch latency, "
-             << timeAsUs(_switch_latencies[AGG_TIER]) << "us Agg switch latency";
+        log << timeAsUs(_switch_latencies[TOR_TIER]) << "us ToR switch latency, "
+            << timeAsUs(_switch_latencies[AGG_TIER]) << "us Agg switch latency";
         if (_tiers == 3) {
-            cout << ", " << timeAsUs(_switch_latencies[CORE_TIER]) << "us Core switch latency." << endl;
+            log << ", " << timeAsUs(_switch_latencies[CORE_TIER]) << "us Core switch latency." << endl;
         } else {
-            cout << "." << endl;
+            log << "." << endl;
         }
     }
     set_params(no_of_nodes);
 
+    if (parallel) {
+        if (_tiers != 3 || _qt == LOSSLESS || _qt == LOSSLESS_INPUT || _qt == LOSSLESS_INPUT_ECN) {
+            cerr << "Running in parallel needs a 3-tier FatTree without lossless queues" << endl;
+            exit(1);
+        }
+        if (_hop_latency == 0 && _link_latencies[CORE_TIER] == 0) {
+            cerr << "Running in parallel needs a non-zero Agg-Core link latency" << endl;
+            exit(1);
+        }
+        _parallel = parallel;
+        _first_lp = _parallel->no_of_lps();
+        for (uint32_t pod = 0; pod <= NPOD; pod++)
+            _parallel->addLP();
+        log << "Running " << NPOD << " pods and the core as " << NPOD + 1 << " parallel LPs" << endl;
+    }
+
     init_network();
 }
 
@@ -302,7 +326,7 @@ FatTreeTopology::FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed,
     }
     _switch_latency = timeFromUs((uint32_t)0); 
  
-    cout << "Fat tree topology (1) with " << no_of_nodes << " nodes" << endl;
+    SimContext::current().log() << "Fat tree topology (1) with " << no_of_nodes << " nodes" << endl;
     set_params(no_of_nodes);
 
     init_network();
@@ -328,7 +352,7 @@ FatTreeTopology::FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed,
 
     failed_links = num_failed;
   
-    cout << "Fat tree topology (2) with " << no_of_nodes << " nodes" << endl;
+    SimContext::current().log() << "Fat tree topology (2) with " << no_of_nodes << " nodes" << endl;
     set_params(no_of_nodes);
 
     init_network();
@@ -355,12 +379,24 @@ FatTreeTopology::FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed,
 
     failed_links = num_failed;
 
-    cout << "Fat tree topology (3) with " << no_of_nodes << " nodes" << endl;
+    SimContext::current().log() << "Fat tree topology (3) with " << no_of_nodes << " nodes" << endl;
     set_params(no_of_nodes);
 
     init_network();
 }
 
+// The queues and pipes go with _pool.  The LosslessInputQueues that
+// init_network makes for lossless queue types aren't tracked, and
+// aren't freed.
+FatTreeTopology::~FatTreeTopology() {
+    for (size_t j = 0; j < switches_lp.size(); j++)
+        delete switches_lp[j];
+    for (size_t j = 0; j < switches_up.size(); j++)
+        delete switches_up[j];
+    for (size_t j = 0; j < switches_c.size(); j++)
+        delete switches_c[j];
+}
+
 void FatTreeTopology::set_linkspeeds(linkspeed_bps linkspeed) {
     if (linkspeed != 0 && _downlink_speeds[TOR_TIER] != 0) {
         cerr << "Don't set linkspeeds using both the constructor and set_tier_parameters - use only one of the two\n";
@@ -377,17 +413,16 @@ void FatTreeTopology::set_linkspeeds(linkspeed_bps linkspeed) {
 }
 
 void FatTreeTopology::set_queue_sizes(mem_b queuesize) {
-    if (queuesize != 0) {
-        // all tiers use the same queuesize
-        for (int tier = TOR_TIER; tier <= CORE_TIER; tier++) {
-            _queue_down[tier] = queuesize;
-            if (tier != CORE_TIER)
-                _queue_up[tier] = queuesize;
-        }
-    } else {
+    if (queuesize == 0) {
         // the tier queue sizes must have already been set
         assert(_queue_down[TOR_TIER] != 0);
     }
+    // if queuesize is set, all tiers use the same queuesize
+    for (int tier = TOR_TIER; tier <= CORE_TIER; tier++) {
+        _queuesize_down[tier] = queuesize ? queuesize : _queue_down[tier];
+        if (tier != CORE_TIER)
+            _queuesize_up[tier] = queuesize ? queuesize : _queue_up[tier];
+    }
 }
 
 void FatTreeTopology::set_custom_params(uint32_t no_of_nodes) {
@@ -439,7 +474,7 @@ void FatTreeTopology::set_custom_params(uint32_t no_of_nodes) {
 
     assert((no_of_nodes * _downlink_speeds[TOR_TIER]) % (_downlink_speeds[AGG_TIER] * _oversub[TOR_TIER]) == 0);
     no_of_tor_uplinks = (no_of_nodes * _downlink_speeds[TOR_TIER]) / (_downlink_speeds[AGG_TIER] *  _oversub[TOR_TIER]);
-    cout << "no_of_tor_uplinks: " << no_of_tor_uplinks << endl;
+    SimContext::current().log() << "no_of_tor_uplinks: " << no_of_tor_uplinks << endl;
 
     if (_radix_down[TOR_TIER]/_radix_up[TOR_TIER] != _oversub[TOR_TIER]) {
         cerr << "Mismatch between TOR linkspeeds (" << speedAsGbps(_downlink_speeds[TOR_TIER]) << "Gbps down, "
@@ -467,7 +502,7 @@ void FatTreeTopology::set_custom_params(uint32_t no_of_nodes) {
     if (_tiers == 3) {
         assert((no_of_tor_uplinks * _downlink_speeds[AGG_TIER]) % (_downlink_speeds[CORE_TIER] * _oversub[AGG_TIER]) == 0);
         no_of_agg_uplinks = (no_of_tor_uplinks * _downlink_speeds[AGG_TIER]) / (_downlink_speeds[CORE_TIER] * _oversub[AGG_TIER]);
-        cout << "no_of_agg_uplinks: " << no_of_agg_uplinks << endl;
+        SimContext::current().log() << "no_of_agg_uplinks: " << no_of_agg_uplinks << endl;
 
         assert(no_of_agg_uplinks % _radix_down[CORE_TIER] == 0);
         no_of_core_switches = no_of_agg_uplinks / _radix_down[CORE_TIER];
@@ -495,17 +530,18 @@ void FatTreeTopology::set_custom_params(uint32_t no_of_nodes) {
         }
     }
 
-    cout << "No of nodes: " << no_of_nodes << endl;
-    cout << "No of pods: " << no_of_pods << endl;
-    cout << "Hosts per pod: " << _hosts_per_pod << endl;
-    cout << "Hosts per pod: " << _hosts_per_pod << endl;
-    cout << "ToR switches per pod: " << _tor_switches_per_pod << endl;
-    cout << "Agg switches per pod: " << _agg_switches_per_pod << endl;
-    cout << "No of core switches: " << no_of_core_switches << endl;
+    ostream& log = SimContext::current().log();
+    log << "No of nodes: " << no_of_nodes << endl;
+    log << "No of pods: " << no_of_pods << endl;
+    log << "Hosts per pod: " << _hosts_per_pod << endl;
+    log << "Hosts per pod: " << _hosts_per_pod << endl;
+    log << "ToR switches per pod: " << _tor_switches_per_pod << endl;
+    log << "Agg switches per pod: " << _agg_switches_per_pod << endl;
+    log << "No of core switches: " << no_of_core_switches << endl;
     for (uint32_t tier = TOR_TIER; tier < _tiers; tier++) {
-        cout << "Tier " << tier << " QueueSize Down " << _queue_down[tier] << " bytes" << endl;
+        log << "Tier " << tier << " QueueSize Down " << _queuesize_down[tier] << " bytes" << endl;
         if (tier < CORE_TIER)
-            cout << "Tier " << tier << " QueueSize Up " << _queue_up[tier] << " bytes" << endl;
+            log << "Tier " << tier << " QueueSize Up " << _queuesize_up[tier] << " bytes" << endl;
     }
 
     // looks like we're OK, lets build it
@@ -525,11 +561,11 @@ void FatTreeTopology::set_params(uint32_t no_of_nodes) {
         return;
     }
     
-    cout << "Set params " << no_of_nodes << endl;
+    SimContext::current().log() << "Set params " << no_of_nodes << endl;
     for (int tier = TOR_TIER; tier <= CORE_TIER; tier++) {
-        cout << "Tier " << tier << " QueueSize Down " << _queue_down[tier] << " bytes" << endl;
+        SimContext::current().log() << "Tier " << tier << " QueueSize Down " << _queuesize_down[tier] << " bytes" << endl;
         if (tier < CORE_TIER)
-            cout << "Tier " << tier << " QueueSize Up " << _queue_up[tier] << " bytes" << endl;
+            SimContext::current().log() << "Tier " << tier << " QueueSize Up " << _queuesize_up[tier] << " bytes" << endl;
     }
     _no_of_nodes = 0;
     int K = 0;
@@ -572,9 +608,9 @@ void FatTreeTopology::set_params(uint32_t no_of_nodes) {
     }
     
     
-    cout << "_no_of_nodes " << _no_of_nodes << endl;
-    cout << "K " << K << endl;
-    cout << "Queue type " << _qt << endl;
+    SimContext::current().log() << "_no_of_nodes " << _no_of_nodes << endl;
+    SimContext::current().log() << "K " << K << endl;
+    SimContext::current().log() << "Queue type " << _qt << endl;
 
     // if these are set, we should be in the custom code, not here
     assert(_radix_down[TOR_TIER] == 0); 
@@ -600,70 +636,68 @@ void FatTreeTopology::alloc_vectors() {
     switches_c.resize(NCORE,NULL);
 
 
-    // These vectors are sparse - we won't use all the entries
+    // rows x columns x bundle, but only the links init_network adds take space
     if (_tiers == 3) {
-        // resizing 3d vectors is scary magic
-        pipes_nc_nup.resize(NCORE, vector< vector<Pipe*> >(NAGG, vector<Pipe*>(_bundlesize[CORE_TIER])));
-        queues_nc_nup.resize(NCORE, vector< vector<BaseQueue*> >(NAGG, vector<BaseQueue*>(_bundlesize[CORE_TIER])));
+        pipes_nc_nup.resize(NCORE, NAGG, _bundlesize[CORE_TIER]);
+        queues_nc_nup.resize(NCORE, NAGG, _bundlesize[CORE_TIER]);
+        pipes_nup_nc.resize(NAGG, NCORE, _bundlesize[CORE_TIER]);
+        queues_nup_nc.resize(NAGG, NCORE, _bundlesize[CORE_TIER]);
     }
 
-    pipes_nup_nlp.resize(NAGG, vector< vector<Pipe*> >(NTOR, vector<Pipe*>(_bundlesize[AGG_TIER])));
-    queues_nup_nlp.resize(NAGG, vector< vector<BaseQueue*> >(NTOR, vector<BaseQueue*>(_bundlesize[AGG_TIER])));
-
-    pipes_nlp_ns.resize(NTOR, vector< vector<Pipe*> >(NSRV, vector<Pipe*>(_bundlesize[TOR_TIER])));
-    queues_nlp_ns.resize(NTOR, vector< vector<BaseQueue*> >(NSRV, vector<BaseQueue*>(_bundlesize[TOR_TIER])));
-
+    pipes_nup_nlp.resize(NAGG, NTOR, _bundlesize[AGG_TIER]);
+    queues_nup_nlp.resize(NAGG, NTOR, _bundlesize[AGG_TIER]);
+    pipes_nlp_nup.resize(NTOR, NAGG, _bundlesize[AGG_TIER]);
+    queues_nlp_nup.resize(NTOR, NAGG, _bundlesize[AGG_TIER]);
 
-    if (_tiers == 3) {
-        pipes_nup_nc.resize(NAGG, vector< vector<Pipe*> >(NCORE, vector<Pipe*>(_bundlesize[CORE_TIER])));
-        queues_nup_nc.resize(NAGG, vector< vector<BaseQueue*> >(NCORE, vector<BaseQueue*>(_bundlesize[CORE_TIER])));
-    }
-    
-    pipes_nlp_nup.resize(NTOR, vector< vector<Pipe*> >(NAGG, vector<Pipe*>(_bundlesize[AGG_TIER])));
-    pipes_ns_nlp.resize(NSRV, vector< vector<Pipe*> >(NTOR, vector<Pipe*>(_bundlesize[TOR_TIER])));
-    queues_nlp_nup.resize(NTOR, vector< vector<BaseQueue*> >(NAGG, vector<BaseQueue*>(_bundlesize[AGG_TIER])));
-    queues_ns_nlp.resize(NSRV, vector< vector<BaseQueue*> >(NTOR, vector<BaseQueue*>(_bundlesize[TOR_TIER])));
+    pipes_nlp_ns.resize(NTOR, NSRV, _bundlesize[TOR_TIER]);
+    queues_nlp_ns.resize(NTOR, NSRV, _bundlesize[TOR_TIER]);
+    pipes_ns_nlp.resize(NSRV, NTOR, _bundlesize[TOR_TIER]);
+    queues_ns_nlp.resize(NSRV, NTOR, _bundlesize[TOR_TIER]);
 }
 
-BaseQueue* FatTreeTopology::alloc_src_queue(QueueLogger* queueLogger){
+BaseQueue* FatTreeTopology::alloc_src_queue(QueueLogger* queueLogger, EventList& eventlist){
     linkspeed_bps linkspeed = _downlink_speeds[TOR_TIER]; // linkspeeds are symmetric
     switch (_sender_qt) {
     case SWIFT_SCHEDULER:
-        return new FairScheduler(linkspeed, *_eventlist, queueLogger);
+        return _pool.make<FairScheduler>(linkspeed, eventlist, queueLogger);
+    case SWIFT_RR_SCHEDULER:
+        return _pool.make<RoundRobinScheduler>(linkspeed, eventlist, queueLogger);
+    case SWIFT_FIFO_SCHEDULER:
+        return _pool.make<FifoScheduler>(linkspeed, eventlist, queueLogger);
     case PRIORITY:
-        return new PriorityQueue(linkspeed,
-                                 memFromPkt(FEEDER_BUFFER), *_eventlist, queueLogger);
+        return _pool.make<PriorityQueue>(linkspeed,
+                                 memFromPkt(FEEDER_BUFFER), eventlist, queueLogger);
     case FAIR_PRIO:
-        return new FairPriorityQueue(linkspeed,
-                                     memFromPkt(FEEDER_BUFFER), *_eventlist, queueLogger);
+        return _pool.make<FairPriorityQueue>(linkspeed,
+                                     memFromPkt(FEEDER_BUFFER), eventlist, queueLogger);
     default:
         abort();
     }
 }
 
-BaseQueue* FatTreeTopology::alloc_queue(QueueLogger* queueLogger, mem_b queuesize,
+BaseQueue* FatTreeTopology::alloc_queue(QueueLogger* queueLogger, EventList& eventlist, mem_b queuesize,
                                         link_direction dir, int switch_tier, bool tor = false){
     if (dir == UPLINK) {
         switch_tier++; // _downlink_speeds is set for the downlinks, so uplinks need to use the tier above's linkspeed
     }
-    return alloc_queue(queueLogger, _downlink_speeds[switch_tier], queuesize, dir, switch_tier, tor);
+    return alloc_queue(queueLogger, eventlist, _downlink_speeds[switch_tier], queuesize, dir, switch_tier, tor);
 }
 
 BaseQueue*
-FatTreeTopology::alloc_queue(QueueLogger* queueLogger, linkspeed_bps speed, mem_b queuesize,
+FatTreeTopology::alloc_queue(QueueLogger* queueLogger, EventList& eventlist, linkspeed_bps speed, mem_b queuesize,
                              link_direction dir, int switch_tier, bool tor){
     switch (_qt) {
     case RANDOM:
-        return new RandomQueue(speed, queuesize, *_eventlist, queueLogger, memFromPkt(RANDOM_BUFFER));
+        return _pool.make<RandomQueue>(speed, queuesize, eventlist, queueLogger, memFromPkt(RANDOM_BUFFER));
     case COMPOSITE:
-        return new CompositeQueue(speed, queuesize, *_eventlist, queueLogger);
+        return _pool.make<CompositeQueue>(speed, queuesize, eventlist, queueLogger);
     case CTRL_PRIO:
-        return new CtrlPrioQueue(speed, queuesize, *_eventlist, queueLogger);
+        return _pool.make<CtrlPrioQueue>(speed, queuesize, eventlist, queueLogger);
     case AEOLUS:
-        return new AeolusQueue(speed, queuesize, FatTreeSwitch::_speculative_threshold_fraction * queuesize,  *_eventlist, queueLogger);
+        return _pool.make<AeolusQueue>(speed, queuesize, FatTreeSwitch::_speculative_threshold_fraction * queuesize,  eventlist, queueLogger);
     case AEOLUS_ECN:
         {
-            AeolusQueue* q = new AeolusQueue(speed, queuesize, FatTreeSwitch::_speculative_threshold_fraction * queuesize ,  *_eventlist, queueLogger);
+            AeolusQueue* q = _pool.make<AeolusQueue>(speed, queuesize, FatTreeSwitch::_speculative_threshold_fraction * queuesize ,  eventlist, queueLogger);
             if (!tor || dir == UPLINK) {
                 // don't use ECN on ToR downlinks
                 q->set_ecn_threshold(FatTreeSwitch::_ecn_threshold_fraction * queuesize);
@@ -671,26 +705,26 @@ FatTreeTopology::alloc_queue(QueueLogger* queueLogger, linkspeed_bps speed, mem_
             return q;
         }
     case ECN:
-        return new ECNQueue(speed, queuesize, *_eventlist, queueLogger, memFromPkt(15));
+        return _pool.make<ECNQueue>(speed, queuesize, eventlist, queueLogger, memFromPkt(15));
     case ECN_PRIO:
-        return new ECNPrioQueue(speed, queuesize, queuesize,
-                                FatTreeSwitch::_ecn_threshold_fraction * queuesize,
-                                FatTreeSwitch::_ecn_threshold_fraction * queuesize,
-                                *_eventlist, queueLogger);
+        return _pool.make<ECNPrioQueue>(speed, queuesize, queuesize,
+                                         FatTreeSwitch::_ecn_threshold_fraction * queuesize,
+                                         FatTreeSwitch::_ecn_threshold_fraction * queuesize,
+                                         eventlist, queueLogger);
     case LOSSLESS:
-        return new LosslessQueue(speed, queuesize, *_eventlist, queueLogger, NULL);
+        return _pool.make<LosslessQueue>(speed, queuesize, eventlist, queueLogger, (Switch*)NULL);
     case LOSSLESS_INPUT:
-        return new LosslessOutputQueue(speed, queuesize, *_eventlist, queueLogger);
+        return _pool.make<LosslessOutputQueue>(speed, queuesize, eventlist, queueLogger);
     case LOSSLESS_INPUT_ECN: 
-        return new LosslessOutputQueue(speed, memFromPkt(10000), *_eventlist, queueLogger,1,memFromPkt(16));
+        return _pool.make<LosslessOutputQueue>(speed, memFromPkt(10000), eventlist, queueLogger,1,memFromPkt(16));
     case COMPOSITE_ECN:
         if (tor && dir == DOWNLINK) 
-            return new CompositeQueue(speed, queuesize, *_eventlist, queueLogger);
+            return _pool.make<CompositeQueue>(speed, queuesize, eventlist, queueLogger);
         else
-            return new ECNQueue(speed, memFromPkt(2*SWITCH_BUFFER), *_eventlist, queueLogger, memFromPkt(15));
+            return _pool.make<ECNQueue>(speed, memFromPkt(2*SWITCH_BUFFER), eventlist, queueLogger, memFromPkt(15));
     case COMPOSITE_ECN_LB:
         {
-            CompositeQueue* q = new CompositeQueue(speed, queuesize, *_eventlist, queueLogger);
+            CompositeQueue* q = _pool.make<CompositeQueue>(speed, queuesize, eventlist, queueLogger);
             if (!tor || dir == UPLINK) {
                 // don't use ECN on ToR downlinks
                 q->set_ecn_threshold(FatTreeSwitch::_ecn_threshold_fraction * queuesize);
@@ -704,55 +738,21 @@ FatTreeTopology::alloc_queue(QueueLogger* queueLogger, linkspeed_bps speed, mem_
 
 void FatTreeTopology::init_network(){
     QueueLogger* queueLogger;
-    if (_tiers == 3) {
-        for (uint32_t j=0;j<NCORE;j++) {
-            for (uint32_t k=0;k<NAGG;k++) {
-                for (uint32_t b = 0; b < _bundlesize[CORE_TIER]; b++) {
-                    queues_nc_nup[j][k][b] = NULL;
-                    pipes_nc_nup[j][k][b] = NULL;
-                    queues_nup_nc[k][j][b] = NULL;
-                    pipes_nup_nc[k][j][b] = NULL;
-                }
-            }
-        }
-    }
-    
-    for (uint32_t j=0;j<NAGG;j++) {
-        for (uint32_t k=0;k<NTOR;k++) {
-            for (uint32_t b = 0; b < _bundlesize[AGG_TIER]; b++) {
-                queues_nup_nlp[j][k][b] = NULL;
-                pipes_nup_nlp[j][k][b] = NULL;
-                queues_nlp_nup[k][j][b] = NULL;
-                pipes_nlp_nup[k][j][b] = NULL;
-            }
-        }
-    }
-    
-    for (uint32_t j=0;j<NTOR;j++) {
-        for (uint32_t k=0;k<NSRV;k++) {
-            for (uint32_t b = 0; b < _bundlesize[TOR_TIER]; b++) { 
-                queues_nlp_ns[j][k][b] = NULL;
-                pipes_nlp_ns[j][k][b] = NULL;
-                queues_ns_nlp[k][j][b] = NULL;
-                pipes_ns_nlp[k][j][b] = NULL;
-            }
-        }
-    }
 
     //create switches if we have lossless operation
     //if (_qt==LOSSLESS)
     // changed to always create switches
     for (uint32_t j=0;j<NTOR;j++){
         simtime_picosec switch_latency = (_switch_latencies[TOR_TIER] > 0) ? _switch_latencies[TOR_TIER] : _switch_latency;
-        switches_lp[j] = new FatTreeSwitch(*_eventlist, "Switch_LowerPod_"+ntoa(j),FatTreeSwitch::TOR,j,switch_latency,this);
+        switches_lp[j] = new FatTreeSwitch(tor_eventlist(j), "Switch_LowerPod_"+ntoa(j),FatTreeSwitch::TOR,j,switch_latency,this);
     }
     for (uint32_t j=0;j<NAGG;j++){
         simtime_picosec switch_latency = (_switch_latencies[AGG_TIER] > 0) ? _switch_latencies[AGG_TIER] : _switch_latency;
-        switches_up[j] = new FatTreeSwitch(*_eventlist, "Switch_UpperPod_"+ntoa(j), FatTreeSwitch::AGG,j,switch_latency,this);
+        switches_up[j] = new FatTreeSwitch(agg_eventlist(j), "Switch_UpperPod_"+ntoa(j), FatTreeSwitch::AGG,j,switch_latency,this);
     }
     for (uint32_t j=0;j<NCORE;j++){
         simtime_picosec switch_latency = (_switch_latencies[CORE_TIER] > 0) ? _switch_latencies[CORE_TIER] : _switch_latency;
-        switches_c[j] = new FatTreeSwitch(*_eventlist, "Switch_Core_"+ntoa(j), FatTreeSwitch::CORE,j,switch_latency,this);
+        switches_c[j] = new FatTreeSwitch(core_eventlist(), "Switch_Core_"+ntoa(j), FatTreeSwitch::CORE,j,switch_latency,this);
     }
       
     // links from lower layer pod switch to server
@@ -760,6 +760,11 @@ void FatTreeTopology::init_network(){
         uint32_t link_bundles = _radix_down[TOR_TIER]/_bundlesize[TOR_TIER];
         for (uint32_t l = 0; l < link_bundles; l++) {
             uint32_t srv = tor * link_bundles + l;
+            EventList& eventlist = tor_eventlist(tor);
+            queues_nlp_ns.add(tor, srv);
+            pipes_nlp_ns.add(tor, srv);
+            queues_ns_nlp.add(srv, tor);
+            pipes_ns_nlp.add(srv, tor);
             for (uint32_t b = 0; b < _bundlesize[TOR_TIER]; b++) {
                 // Downlink
                 if (_logger_factory) {
@@ -768,11 +773,11 @@ void FatTreeTopology::init_network(){
                     queueLogger = NULL;
                 }
             
-                queues_nlp_ns[tor][srv][b] = alloc_queue(queueLogger, _queue_down[TOR_TIER], DOWNLINK, TOR_TIER, true);
+                queues_nlp_ns[tor][srv][b] = alloc_queue(queueLogger, eventlist, _queuesize_down[TOR_TIER], DOWNLINK, TOR_TIER, true);
                 queues_nlp_ns[tor][srv][b]->setName("LS" + ntoa(tor) + "->DST" +ntoa(srv) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(queues_nlp_ns[tor][srv]));
                 simtime_picosec hop_latency = (_hop_latency == 0) ? _link_latencies[TOR_TIER] : _hop_latency;
-                pipes_nlp_ns[tor][srv][b] = new Pipe(hop_latency, *_eventlist);
+                pipes_nlp_ns[tor][srv][b] = _pool.make<Pipe>(hop_latency, eventlist);
                 pipes_nlp_ns[tor][srv][b]->setName("Pipe-LS" + ntoa(tor)  + "->DST" + ntoa(srv) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_nlp_ns[tor][srv]));
             
@@ -782,7 +787,7 @@ void FatTreeTopology::init_network(){
                 } else {
                     queueLogger = NULL;
                 }
-                queues_ns_nlp[srv][tor][b] = alloc_src_queue(queueLogger);   
+                queues_ns_nlp[srv][tor][b] = alloc_src_queue(queueLogger, eventlist);   
                 queues_ns_nlp[srv][tor][b]->setName("SRC" + ntoa(srv) + "->LS" +ntoa(tor) + "(" + ntoa(b) + ")");
                 //cout << queues_ns_nlp[srv][tor][b]->str() << endl;
                 //if (logfile) logfile->writeName(*(queues_ns_nlp[srv][tor]));
@@ -796,7 +801,7 @@ void FatTreeTopology::init_network(){
                     new LosslessInputQueue(*_eventlist, queues_ns_nlp[srv][tor][b], switches_lp[tor], _hop_latency);
                 }
         
-                pipes_ns_nlp[srv][tor][b] = new Pipe(hop_latency, *_eventlist);
+                pipes_ns_nlp[srv][tor][b] = _pool.make<Pipe>(hop_latency, eventlist);
                 pipes_ns_nlp[srv][tor][b]->setName("Pipe-SRC" + ntoa(srv) + "->LS" + ntoa(tor) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_ns_nlp[srv][tor]));
             
@@ -822,7 +827,12 @@ void FatTreeTopology::init_network(){
             agg_min = 0;
             agg_max = NAGG-1;
         }
+        EventList& eventlist = tor_eventlist(tor); // the aggs are in the same pod
         for (uint32_t agg=agg_min; agg<=agg_max; agg++){
+            queues_nup_nlp.add(agg, tor);
+            pipes_nup_nlp.add(agg, tor);
+            queues_nlp_nup.add(tor, agg);
+            pipes_nlp_nup.add(tor, agg);
             for (uint32_t b = 0; b < _bundlesize[AGG_TIER]; b++) {
                 // Downlink
                 if (_logger_factory) {
@@ -830,12 +840,12 @@ void FatTreeTopology::init_network(){
                 } else {
                     queueLogger = NULL;
                 }
-                queues_nup_nlp[agg][tor][b] = alloc_queue(queueLogger, _queue_down[AGG_TIER], DOWNLINK, AGG_TIER);
+                queues_nup_nlp[agg][tor][b] = alloc_queue(queueLogger, eventlist, _queuesize_down[AGG_TIER], DOWNLINK, AGG_TIER);
                 queues_nup_nlp[agg][tor][b]->setName("US" + ntoa(agg) + "->LS_" + ntoa(tor) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(queues_nup_nlp[agg][tor]));
             
                 simtime_picosec hop_latency = (_hop_latency == 0) ? _link_latencies[AGG_TIER] : _hop_latency;
-                pipes_nup_nlp[agg][tor][b] = new Pipe(hop_latency, *_eventlist);
+                pipes_nup_nlp[agg][tor][b] = _pool.make<Pipe>(hop_latency, eventlist);
                 pipes_nup_nlp[agg][tor][b]->setName("Pipe-US" + ntoa(agg) + "->LS" + ntoa(tor) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_nup_nlp[agg][tor]));
             
@@ -845,7 +855,7 @@ void FatTreeTopology::init_network(){
                 } else {
                     queueLogger = NULL;
                 }
-                queues_nlp_nup[tor][agg][b] = alloc_queue(queueLogger, _queue_up[TOR_TIER], UPLINK, TOR_TIER, true);
+                queues_nlp_nup[tor][agg][b] = alloc_queue(queueLogger, eventlist, _queuesize_up[TOR_TIER], UPLINK, TOR_TIER, true);
                 queues_nlp_nup[tor][agg][b]->setName("LS" + ntoa(tor) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
                 //cout << queues_nlp_nup[tor][agg][b]->str() << endl;
                 //if (logfile) logfile->writeName(*(queues_nlp_nup[tor][agg]));
@@ -864,7 +874,7 @@ void FatTreeTopology::init_network(){
                     new LosslessInputQueue(*_eventlist, queues_nup_nlp[agg][tor][b],switches_lp[tor],_hop_latency);
                 }
         
-                pipes_nlp_nup[tor][agg][b] = new Pipe(hop_latency, *_eventlist);
+                pipes_nlp_nup[tor][agg][b] = _pool.make<Pipe>(hop_latency, eventlist);
                 pipes_nlp_nup[tor][agg][b]->setName("Pipe-LS" + ntoa(tor) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
                 //if (logfile) logfile->writeName(*(pipes_nlp_nup[tor][agg]));
         
@@ -890,6 +900,10 @@ void FatTreeTopology::init_network(){
             for (uint32_t l = 0; l < _radix_up[AGG_TIER]/_bundlesize[CORE_TIER]; l++) {
                 uint32_t core = podpos +  _agg_switches_per_pod * l;
                 assert(core < NCORE);
+                queues_nup_nc.add(agg, core);
+                pipes_nup_nc.add(agg, core);
+                queues_nc_nup.add(core, agg);
+                pipes_nc_nup.add(core, agg);
                 for (uint32_t b = 0; b < _bundlesize[CORE_TIER]; b++) {
                 
                     // Downlink
@@ -899,13 +913,18 @@ void FatTreeTopology::init_network(){
                         queueLogger = NULL;
                     }
                     assert(queues_nup_nc[agg][core][b] == NULL);
-                    queues_nup_nc[agg][core][b] = alloc_queue(queueLogger, _queue_up[AGG_TIER], UPLINK, AGG_TIER);
+                    queues_nup_nc[agg][core][b] = alloc_queue(queueLogger, agg_eventlist(agg), _queuesize_up[AGG_TIER], UPLINK, AGG_TIER);
                     queues_nup_nc[agg][core][b]->setName("US" + ntoa(agg) + "->CS" + ntoa(core) + "(" + ntoa(b) + ")");
                     //cout << queues_nup_nc[agg][core][b]->str() << endl;
                     //if (logfile) logfile->writeName(*(queues_nup_nc[agg][core]));
         
                     simtime_picosec hop_latency = (_hop_latency == 0) ? _link_latencies[CORE_TIER] : _hop_latency;
-                    pipes_nup_nc[agg][core][b] = new Pipe(hop_latency, *_eventlist);
+                    if (_parallel) {
+                        uint32_t pod_lp = _first_lp + AGG_SWITCH_POD_ID(agg);
+                        pipes_nup_nc[agg][core][b] = _pool.make<MailboxPipe>(hop_latency, *_parallel, pod_lp, _first_lp + NPOD);
+                    } else {
+                        pipes_nup_nc[agg][core][b] = _pool.make<Pipe>(hop_latency, *_eventlist);
+                    }
                     pipes_nup_nc[agg][core][b]->setName("Pipe-US" + ntoa(agg) + "->CS" + ntoa(core) + "(" + ntoa(b) + ")");
                     //if (logfile) logfile->writeName(*(pipes_nup_nc[agg][core]));
         
@@ -917,11 +936,11 @@ void FatTreeTopology::init_network(){
                     }
         
                     if ((l+agg*_agg_switches_per_pod)<failed_links){
-                        queues_nc_nup[core][agg][b] = alloc_queue(queueLogger, _downlink_speeds[CORE_TIER]/10, _queue_down[CORE_TIER],
+                        queues_nc_nup[core][agg][b] = alloc_queue(queueLogger, core_eventlist(), _downlink_speeds[CORE_TIER]/10, _queuesize_down[CORE_TIER],
                                                                DOWNLINK, CORE_TIER, false);
-                        cout << "Adding link failure for agg_sw " << ntoa(agg) << " l " << ntoa(l) << " b " << ntoa(b) << endl;
+                        SimContext::current().log() << "Adding link failure for agg_sw " << ntoa(agg) << " l " << ntoa(l) << " b " << ntoa(b) << endl;
                     } else {
-                        queues_nc_nup[core][agg][b] = alloc_queue(queueLogger, _queue_down[CORE_TIER], DOWNLINK, CORE_TIER);
+                        queues_nc_nup[core][agg][b] = alloc_queue(queueLogger, core_eventlist(), _queuesize_down[CORE_TIER], DOWNLINK, CORE_TIER);
                     }
         
                     queues_nc_nup[core][agg][b]->setName("CS" + ntoa(core) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
@@ -942,7 +961,12 @@ void FatTreeTopology::init_network(){
                     }
                     //if (logfile) logfile->writeName(*(queues_nc_nup[core][agg]));
             
-                    pipes_nc_nup[core][agg][b] = new Pipe(hop_latency, *_eventlist);
+                    if (_parallel) {
+                        uint32_t pod_lp = _first_lp + AGG_SWITCH_POD_ID(agg);
+                        pipes_nc_nup[core][agg][b] = _pool.make<MailboxPipe>(hop_latency, *_parallel, _first_lp + NPOD, pod_lp);
+                    } else {
+                        pipes_nc_nup[core][agg][b] = _pool.make<Pipe>(hop_latency, *_eventlist);
+                    }
                     pipes_nc_nup[core][agg][b]->setName("Pipe-CS" + ntoa(core) + "->US" + ntoa(agg) + "(" + ntoa(b) + ")");
                     //if (logfile) logfile->writeName(*(pipes_nc_nup[core][agg]));
             
@@ -974,6 +998,33 @@ void FatTreeTopology::init_network(){
             switches_c[j]->configureLossless();
         }
     }
+
+    // memory held by the links, for the run summary
+    size_t link_bytes = pipes_nc_nup.bytes() + pipes_nup_nlp.bytes() + pipes_nlp_ns.bytes()
+        + queues_nc_nup.bytes() + queues_nup_nlp.bytes() + queues_nlp_ns.bytes()
+        + pipes_nup_nc.bytes() + pipes_nlp_nup.bytes() + pipes_ns_nlp.bytes()
+        + queues_nup_nc.bytes() + queues_nlp_nup.bytes() + queues_ns_nlp.bytes();
+    _eventlist->setStat("link_table_bytes", link_bytes);
+    _eventlist->setStat("link_pool_used_bytes", _pool.used());
+    _eventlist->setStat("link_pool_reserved_bytes", _pool.reserved());
+}
+
+EventList& FatTreeTopology::tor_eventlist(uint32_t tor){
+    if (!_parallel)
+        return *_eventlist;
+    return _parallel->eventlist(_first_lp + tor / _tor_switches_per_pod);
+}
+
+EventList& FatTreeTopology::agg_eventlist(uint32_t agg){
+    if (!_parallel)
+        return *_eventlist;
+    return _parallel->eventlist(_first_lp + AGG_SWITCH_POD_ID(agg));
+}
+
+EventList& FatTreeTopology::core_eventlist(){
+    if (!_parallel)
+        return *_eventlist;
+    return _parallel->eventlist(_first_lp + NPOD);
 }
 
 void FatTreeTopology::add_failed_link(uint32_t type, uint32_t switch_id, uint32_t link_id){
@@ -996,6 +1047,29 @@ void FatTreeTopology::add_failed_link(uint32_t type, uint32_t switch_id, uint32_
 }
 
 
+uint32_t FatTreeTopology::no_of_paths(uint32_t src, uint32_t dest) {
+    if (HOST_POD_SWITCH(src)==HOST_POD_SWITCH(dest))
+        return 1;
+    uint32_t pod = HOST_POD(src);
+    uint32_t aggs = MAX_POD_AGG_SWITCH(pod) - MIN_POD_AGG_SWITCH(pod) + 1;
+    uint32_t b1 = _bundlesize[AGG_TIER];
+    if (HOST_POD(src)==HOST_POD(dest))
+        return aggs * b1 * b1;
+    uint32_t b2 = _bundlesize[CORE_TIER];
+    return aggs * (_radix_up[AGG_TIER]/b2) * b1 * b1 * b2 * b2;
+}
+
+simtime_picosec FatTreeTopology::diameter_rtt() const {
+    simtime_picosec one_way = 0;
+    for (uint32_t tier = 0; tier < _tiers; tier++) {
+        simtime_picosec link = (_hop_latency == 0) ? _link_latencies[tier] : _hop_latency;
+        simtime_picosec sw = (_switch_latencies[tier] > 0) ? _switch_latencies[tier] : _switch_latency;
+        // up and back down through each tier; the top switch is crossed once
+        one_way += 2 * link + (tier == _tiers - 1 ? sw : 2 * sw);
+    }
+    return 2 * one_way;
+}
+
 vector<const Route*>* FatTreeTopology::get_bidir_paths(uint32_t src, uint32_t dest, bool reverse){
     vector<const Route*>* paths = new vector<const Route*>();
 
@@ -1120,7 +1194,7 @@ vector<const Route*>* FatTreeTopology::get_bidir_paths(uint32_t src, uint32_t de
                 }
             }
         }
-        cout << "pathcount " << paths->size() << endl;
+        SimContext::current().log() << "pathcount " << paths->size() << endl;
         return paths;
     } else {
         assert(_tiers == 3);
@@ -1236,7 +1310,7 @@ vector<const Route*>* FatTreeTopology::get_bidir_paths(uint32_t src, uint32_t de
                 }
             }
         }
-        cout << "pathcount " << paths->size() << endl;
+        SimContext::current().log() << "pathcount " << paths->size() << endl;
         return paths;
     }
 }
@@ -12,6 +12,8 @@
 #include "logfile.h"
 #include "eventlist.h"
 #include "switch.h"
+#include "arena.h"
+#include "link_table.h"
 #include <ostream>
 
 //#define N K*K*K/4
@@ -20,7 +22,8 @@
 #define QT
 typedef enum {UNDEFINED, RANDOM, ECN, COMPOSITE, PRIORITY,
               CTRL_PRIO, FAIR_PRIO, LOSSLESS, LOSSLESS_INPUT, LOSSLESS_INPUT_ECN,
-              COMPOSITE_ECN, COMPOSITE_ECN_LB, SWIFT_SCHEDULER, ECN_PRIO, AEOLUS, AEOLUS_ECN} queue_type;
+              COMPOSITE_ECN, COMPOSITE_ECN_LB, SWIFT_SCHEDULER, ECN_PRIO, AEOLUS, AEOLUS_ECN,
+              SWIFT_RR_SCHEDULER, SWIFT_FIFO_SCHEDULER} queue_type;
 typedef enum {UPLINK, DOWNLINK} link_direction;
 #endif
 
@@ -29,26 +32,29 @@ typedef enum {UPLINK, DOWNLINK} link_direction;
 #define AGG_TIER 1
 #define CORE_TIER 2
 
+class ParallelSim;
+
 class FatTreeTopology: public Topology{
 public:
     vector <Switch*> switches_lp;
     vector <Switch*> switches_up;
     vector <Switch*> switches_c;
 
-    // 3rd index is link number in bundle
-    vector< vector< vector<Pipe*> > > pipes_nc_nup;
-    vector< vector< vector<Pipe*> > > pipes_nup_nlp;
-    vector< vector< vector<Pipe*> > > pipes_nlp_ns;
-    vector< vector< vector<BaseQueue*> > > queues_nc_nup;
-    vector< vector< vector<BaseQueue*> > > queues_nup_nlp;
-    vector< vector< vector<BaseQueue*> > > queues_nlp_ns;
-
-    vector< vector< vector<Pipe*> > > pipes_nup_nc;
-    vector< vector< vector<Pipe*> > > pipes_nlp_nup;
-    vector< vector< vector<Pipe*> > > pipes_ns_nlp;
-    vector< vector< vector<BaseQueue*> > > queues_nup_nc;
-    vector< vector< vector<BaseQueue*> > > queues_nlp_nup;
-    vector< vector< vector<BaseQueue*> > > queues_ns_nlp;
+    // 3rd index is link number in bundle.  Only links that exist are
+    // stored; reading any other entry gives NULL.
+    LinkTable<Pipe*> pipes_nc_nup;
+    LinkTable<Pipe*> pipes_nup_nlp;
+    LinkTable<Pipe*> pipes_nlp_ns;
+    LinkTable<BaseQueue*> queues_nc_nup;
+    LinkTable<BaseQueue*> queues_nup_nlp;
+    LinkTable<BaseQueue*> queues_nlp_ns;
+
+    LinkTable<Pipe*> pipes_nup_nc;
+    LinkTable<Pipe*> pipes_nlp_nup;
+    LinkTable<Pipe*> pipes_ns_nlp;
+    LinkTable<BaseQueue*> queues_nup_nc;
+    LinkTable<BaseQueue*> queues_nlp_nup;
+    LinkTable<BaseQueue*> queues_ns_nlp;
   
     FirstFit* ff;
     QueueLoggerFactory* _logger_factory;
@@ -59,25 +65,39 @@ public:
 
     // For regular topologies, just use the constructor.  For custom topologies, load from a config file.
     static FatTreeTopology* load(const char * filename, QueueLoggerFactory* logger_factory, EventList& eventlist,
-                                 mem_b queuesize, queue_type q_type, queue_type sender_q_type);
+                                 mem_b queuesize, queue_type q_type, queue_type sender_q_type,
+                                 ParallelSim* parallel = NULL);
+    // Just read the config file into the tier parameters, returning
+    // the number of nodes.  Use this to build several topologies from
+    // one config: construct them with a linkspeed and latencies of zero.
+    static uint32_t load_config(const char * filename, mem_b queuesize);
 
     FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed, mem_b queuesize, QueueLoggerFactory* logger_factory,
-                    EventList* ev,FirstFit* f, queue_type qt, simtime_picosec latency, simtime_picosec switch_latency, queue_type snd = FAIR_PRIO);
+                    EventList* ev,FirstFit* f, queue_type qt, simtime_picosec latency, simtime_picosec switch_latency, queue_type snd = FAIR_PRIO,
+                    ParallelSim* parallel = NULL);
     FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed, mem_b queuesize, QueueLoggerFactory* logger_factory,
                     EventList* ev,FirstFit* f, queue_type qt);      
     FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed, mem_b queuesize, QueueLoggerFactory* logger_factory,
                     EventList* ev,FirstFit* f, queue_type qt, uint32_t fail);
     FatTreeTopology(uint32_t no_of_nodes, linkspeed_bps linkspeed, mem_b queuesize, QueueLoggerFactory* logger_factory,
                     EventList* ev,FirstFit* f, queue_type qt, queue_type sender_qt, uint32_t fail);
+    ~FatTreeTopology();
 
     static void set_tier_parameters(int tier, int radix_up, int radix_down, mem_b queue_up, mem_b queue_down, int bundlesize, linkspeed_bps downlink_speed, int oversub);
 
     void init_network();
     virtual vector<const Route*>* get_bidir_paths(uint32_t src, uint32_t dest, bool reverse);
+    // Number of paths get_bidir_paths() returns for src->dest.  In
+    // compact path mode (FatTreeSwitch::PATH_INDEX) a packet's pathid
+    // p names get_bidir_paths(src,dest)[p % no_of_paths(src,dest)],
+    // and the switches resolve it hop by hop without any Route.
+    uint32_t no_of_paths(uint32_t src, uint32_t dest);
+    // unloaded RTT across the top tier, excluding serialization
+    simtime_picosec diameter_rtt() const;
 
-    BaseQueue* alloc_src_queue(QueueLogger* q);
-    BaseQueue* alloc_queue(QueueLogger* q, mem_b queuesize, link_direction dir, int switch_tier, bool tor);
-    BaseQueue* alloc_queue(QueueLogger* q, uint64_t speed, mem_b queuesize,
+    BaseQueue* alloc_src_queue(QueueLogger* q, EventList& eventlist);
+    BaseQueue* alloc_queue(QueueLogger* q, EventList& eventlist, mem_b queuesize, link_direction dir, int switch_tier, bool tor);
+    BaseQueue* alloc_queue(QueueLogger* q, EventList& eventlist, uint64_t speed, mem_b queuesize,
                            link_direction dir,  int switch_tier, bool tor);
     static void set_tiers(uint32_t tiers) {_tiers = tiers;}
     static uint32_t get_tiers() {return _tiers;}
@@ -106,11 +126,17 @@ public:
     uint32_t bundlesize(int tier) const {return _bundlesize[tier];}
     uint32_t radix_up(int tier) const {return _radix_up[tier];}
     uint32_t radix_down(int tier) const {return _radix_down[tier];}
-    uint32_t queue_up(int tier) const {return _queue_up[tier];}
-    uint32_t queue_down(int tier) const {return _queue_down[tier];}
+    uint32_t queue_up(int tier) const {return _queuesize_up[tier];}
+    uint32_t queue_down(int tier) const {return _queuesize_down[tier];}
 
     void add_failed_link(uint32_t type, uint32_t switch_id, uint32_t link_id);
 
+    // When built with a ParallelSim, each pod (its ToRs, aggs, hosts and
+    // the links between them) is an LP, and the core switches are
+    // another; the agg<->core pipes are MailboxPipes.  A host's
+    // endpoints must be built on host_eventlist(host).
+    EventList& host_eventlist(uint32_t host) {return tor_eventlist(HOST_POD_SWITCH(host));}
+
     // add loggers to record total queue size at switches
     virtual void add_switch_loggers(Logfile& log, simtime_picosec sample_period); 
 
@@ -169,8 +195,9 @@ public:
     uint32_t getNAGG() const {return NAGG;}
 private:
     map<Queue*,int> _link_usage;
-    static FatTreeTopology* load(istream& file, QueueLoggerFactory* logger_factory, EventList& eventlist,
-                                 mem_b queuesize, queue_type q_type, queue_type sender_q_type);
+    // the queues and pipes of all the links
+    Arena _pool;
+    static uint32_t load_config(istream& file, mem_b queuesize);
     void set_linkspeeds(linkspeed_bps linkspeed);
     void set_queue_sizes(mem_b queuesize);
     int64_t find_lp_switch(Queue* queue);
@@ -180,6 +207,11 @@ private:
     void set_params(uint32_t no_of_nodes);
     void set_custom_params(uint32_t no_of_nodes);
     void alloc_vectors();
+    EventList& tor_eventlist(uint32_t tor);
+    EventList& agg_eventlist(uint32_t agg);
+    EventList& core_eventlist();
+    ParallelSim* _parallel = NULL;
+    uint32_t _first_lp = 0;  // pod 0's LP; the core's follows the pods'
     uint32_t NCORE, NAGG, NTOR, NSRV, NPOD;
     uint32_t _tor_switches_per_pod, _agg_switches_per_pod;
     static uint32_t _tiers;
@@ -216,6 +248,11 @@ private:
 
     // number of hosts in a pod.  
     static uint32_t _hosts_per_pod; 
+
+    // the queue sizes this topology was built with: the constructor's
+    // queuesize if set, otherwise _queue_down and _queue_up
+    mem_b _queuesize_down[3];
+    mem_b _queuesize_up[2];
     
     uint32_t _no_of_nodes;
     simtime_picosec _hop_latency,_switch_latency;
@@ -0,0 +1,143 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef LINK_TABLE_H
+#define LINK_TABLE_H
+
+/*
+ * The queues or pipes of one tier of a fat tree, indexed like the
+ * vector< vector< vector<T*> > > it replaces: links[from][to][b] is
+ * the b'th link of the bundle from switch (or host) 'from' to 'to'.
+ *
+ * Only links that exist take space.  A dense table is rows x columns
+ * x bundlesize, which for the host<->ToR tiers is hosts x ToRs: tens
+ * of GB for 100k hosts, nearly all of it NULL.  Here each row keeps
+ * the columns it links to, in order, and their bundles.  Reading a
+ * link that doesn't exist gives NULL, as it did in the dense table;
+ * a link has to be added before it can be set to anything else.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+template <class T>
+class LinkTable {
+public:
+    // One entry of a bundle, used like the T* it holds.
+    class Link {
+    public:
+        Link(T* link) : _link(link) {}
+        operator T() const {return _link ? *_link : NULL;}
+        // for casts to a subclass, as in (HostQueue*)queues[a][b][0]
+        template <class U> explicit operator U*() const {return (U*)(T)*this;}
+        T operator->() const {assert(_link && *_link); return *_link;}
+        Link& operator=(T v) {
+            if (_link)
+                *_link = v;
+            else
+                assert(v == NULL); // the link was never added
+            return *this;
+        }
+        Link& operator=(const Link& l) {return *this = (T)l;}
+    private:
+        T* _link; // NULL if there's no such link
+    };
+
+    class Bundle {
+    public:
+        Bundle(T* links, uint32_t size) : _links(links), _size(size) {}
+        // size 0 if there's no such link
+        uint32_t size() const {return _size;}
+        Link operator[](uint32_t b) {
+            if (!_links)
+                return Link(NULL);
+            assert(b < _size);
+            return Link(&_links[b]);
+        }
+    private:
+        T* _links;
+        uint32_t _size;
+    };
+
+    class Row {
+    public:
+        Row(LinkTable& table, uint32_t from) : _table(table), _from(from) {}
+        // columns, including those with no link, as for the dense table
+        uint32_t size() const {return _table._columns;}
+        Bundle operator[](uint32_t to) {
+            return Bundle(_table.find(_from, to), _table._bundlesize);
+        }
+        // the links that exist, in column order
+        uint32_t links() const {return _table._rows[_from]._to.size();}
+        uint32_t to(uint32_t i) const {return _table._rows[_from]._to[i];}
+        Bundle bundle(uint32_t i) {
+            return Bundle(&_table._rows[_from]._links[i * _table._bundlesize], _table._bundlesize);
+        }
+    private:
+        LinkTable& _table;
+        uint32_t _from;
+    };
+
+    LinkTable() : _columns(0), _bundlesize(0) {}
+
+    void resize(uint32_t rows, uint32_t columns, uint32_t bundlesize) {
+        _rows.clear();
+        _rows.resize(rows);
+        _columns = columns;
+        _bundlesize = bundlesize;
+    }
+    uint32_t size() const {return _rows.size();}
+    Row operator[](uint32_t from) {
+        assert(from < _rows.size());
+        return Row(*this, from);
+    }
+
+    // Make room for the bundle from->to, all NULL.  Adding links in
+    // column order (as init_network does for most tiers) is cheapest.
+    void add(uint32_t from, uint32_t to) {
+        assert(from < _rows.size() && to < _columns);
+        RowLinks& row = _rows[from];
+        typename std::vector<uint32_t>::iterator i = std::lower_bound(row._to.begin(), row._to.end(), to);
+        if (i != row._to.end() && *i == to)
+            return;
+        size_t pos = i - row._to.begin();
+        row._to.insert(i, to);
+        row._links.insert(row._links.begin() + pos * _bundlesize, _bundlesize, (T)NULL);
+    }
+
+    // approximate heap use, for reporting
+    size_t bytes() const {
+        size_t total = _rows.capacity() * sizeof(RowLinks);
+        for (size_t r = 0; r < _rows.size(); r++)
+            total += _rows[r]._to.capacity() * sizeof(uint32_t) + _rows[r]._links.capacity() * sizeof(T);
+        return total;
+    }
+
+private:
+    struct RowLinks {
+        std::vector<uint32_t> _to;
+        std::vector<T> _links; // bundlesize per entry of _to
+    };
+
+    T* find(uint32_t from, uint32_t to) {
+        assert(from < _rows.size());
+        RowLinks& row = _rows[from];
+        size_t n = row._to.size();
+        if (n == 0)
+            return NULL;
+        // most rows link to a run of consecutive columns
+        uint32_t first = row._to[0];
+        if (to >= first && to - first < n && row._to[to - first] == to)
+            return &row._links[(to - first) * _bundlesize];
+        typename std::vector<uint32_t>::iterator i = std::lower_bound(row._to.begin(), row._to.end(), to);
+        if (i == row._to.end() || *i != to)
+            return NULL;
+        return &row._links[(i - row._to.begin()) * _bundlesize];
+    }
+
+    std::vector<RowLinks> _rows;
+    uint32_t _columns;
+    uint32_t _bundlesize;
+};
+
+#endif
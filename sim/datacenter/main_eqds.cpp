@@ -16,8 +16,11 @@
 #include "topology.h"
 #include "connection_matrix.h"
 
+#include "flowstats.h"
 #include "fat_tree_topology.h"
 #include "fat_tree_switch.h"
+#include "fat_tree_partition.h"
+#include "parallelsim.h"
 
 #include <list>
 
@@ -34,7 +37,7 @@ int DEFAULT_NODES = 128;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]\n\t[-logtime dt] sample time for sinklogger, etc" << endl;
+    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,path_index,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-lazy_loggers] only create queue loggers for queues that log something\n\t[-log_sync] write the logfile from the simulation thread rather than a background one\n\t[-pull_batch n] pulls the receiver pacer chooses at a time, each still sent in its own slot, default 1\n\t[-logformat raw|columnar]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]\n\t[-logtime dt] sample time for sinklogger, etc\n\t[-evqueue calendar|map] pending event data structure\n\t[-parallel] run each pod, and the core, on its own thread\n\t[-partition_stats] estimate parallelism from partitioning by pod, or with -parallel, report it\n\t[-packet_stats] print packet memory use by type\n\t[-fct_stats] print flow completion time percentiles" << endl;
     exit(1);
 }
 
@@ -56,6 +59,7 @@ int main(int argc, char **argv) {
     bool log_flow_events = true;
 
     bool log_tor_downqueue = false;
+    bool lazy_loggers = false;
     bool log_tor_upqueue = false;
     bool log_traffic = false;
     bool log_switches = false;
@@ -69,6 +73,10 @@ int main(int argc, char **argv) {
     int i = 1;
 
     bool oversubscribed_congestion_control = false;
+    bool partition_stats = false;
+    bool parallel = false;
+    bool packet_stats = false;
+    bool fct_stats = false;
 
     filename << "logout.dat";
     int end_time = 1000;//in microseconds
@@ -127,6 +135,25 @@ int main(int argc, char **argv) {
             }
             cout << "queue_type "<< qt << endl;
             i++;
+        } else if (!strcmp(argv[i],"-evqueue")) {
+            if (!strcmp(argv[i+1], "calendar")) {
+                eventlist.setQueueType(EventList::CALENDAR_QUEUE);
+            } else if (!strcmp(argv[i+1], "map")) {
+                eventlist.setQueueType(EventList::MAP_QUEUE);
+            } else {
+                cout << "Unknown event queue type " << argv[i+1] << " expecting one of calendar|map" << endl;
+                exit_error(argv[0]);
+            }
+            cout << "event queue " << argv[i+1] << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-partition_stats")) {
+            partition_stats = true;
+        } else if (!strcmp(argv[i],"-parallel")) {
+            parallel = true;
+        } else if (!strcmp(argv[i],"-packet_stats")) {
+            packet_stats = true;
+        } else if (!strcmp(argv[i],"-fct_stats")) {
+            fct_stats = true;
         } else if (!strcmp(argv[i],"-debug")) {
             EqdsSrc::_debug = true;
         } else if (!strcmp(argv[i],"-host_queue_type")) {
@@ -145,6 +172,23 @@ int main(int argc, char **argv) {
             }
             cout << "host queue_type "<< snd_type << endl;
             i++;
+        } else if (!strcmp(argv[i],"-logformat")){
+            if (!strcmp(argv[i+1], "raw")) {
+                Logfile::set_format(Logfile::RAW);
+            } else if (!strcmp(argv[i+1], "columnar")) {
+                Logfile::set_format(Logfile::COLUMNAR);
+            } else {
+                exit_error(argv[0]);
+            }
+            i++;
+        } else if (!strcmp(argv[i],"-lazy_loggers")){
+            lazy_loggers = true;
+        } else if (!strcmp(argv[i],"-log_sync")){
+            Logfile::set_async_writer(false);
+        } else if (!strcmp(argv[i],"-pull_batch")){
+            EqdsPullPacer::setPullBatch(atoi(argv[i+1]));
+            cout << "pull batch " << argv[i+1] << endl;
+            i++;
         } else if (!strcmp(argv[i],"-log")){
             if (!strcmp(argv[i+1], "flow_events")) {
                 log_flow_events = true;
@@ -304,6 +348,10 @@ int main(int argc, char **argv) {
                 //FatTreeSwitch::set_ar_fraction(atoi(argv[i+2]));
                 //cout << "AR fraction: " << atoi(argv[i+2]) << endl;
                 //i++;
+            } else if (!strcmp(argv[i+1], "path_index")) {
+                // compact paths: the switches resolve each hop from the path index in the packet
+                route_strategy = ECMP_FIB;
+                FatTreeSwitch::set_strategy(FatTreeSwitch::PATH_INDEX);
             } else if (!strcmp(argv[i+1], "ecmp_rr")) {
                 // switch round robin
                 route_strategy = ECMP_FIB;
@@ -373,6 +421,22 @@ int main(int argc, char **argv) {
         break;
     }
 
+    ParallelSim* par = NULL;
+    if (parallel) {
+        // loggers write to one Logfile, which the LPs' threads can't share
+        if (log_sink || log_traffic || log_switches || log_tor_downqueue || log_tor_upqueue || log_queue_usage) {
+            cerr << "Logging isn't supported with -parallel" << endl;
+            exit(1);
+        }
+        if (log_flow_events)
+            cout << "Not logging flow events with -parallel" << endl;
+        log_flow_events = false;
+        par = new ParallelSim();
+        par->setEndtime(timeFromUs((uint32_t)end_time));
+        simtime_picosec min_rto = EqdsSrc::_min_rto;
+        par->setThreadSetup([min_rto]() {EqdsSrc::_min_rto = min_rto;});
+    }
+
     // prepare the loggers
 
     cout << "Logging to " << filename.str() << endl;
@@ -417,6 +481,8 @@ int main(int argc, char **argv) {
         qlf = new QueueLoggerFactory(&logfile, QueueLoggerFactory::LOGGER_EMPTY, eventlist);
         qlf->set_sample_period(timeFromUs(10.0));
     }
+    if (qlf && lazy_loggers)
+        qlf->set_lazy(true);
 
     ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
 
@@ -443,7 +509,7 @@ int main(int argc, char **argv) {
 
     FatTreeTopology* top;
     if (topo_file) {
-        top = FatTreeTopology::load(topo_file, qlf, eventlist, queuesize, qt, snd_type);
+        top = FatTreeTopology::load(topo_file, qlf, eventlist, queuesize, qt, snd_type, par);
         if (top->no_of_nodes() != no_of_nodes) {
             cerr << "Mismatch between connection matrix (" << no_of_nodes << " nodes) and topology ("
                  << top->no_of_nodes() << " nodes)" << endl;
@@ -454,7 +520,7 @@ int main(int argc, char **argv) {
         top = new FatTreeTopology(no_of_nodes, linkspeed, queuesize, qlf, 
                                   &eventlist, NULL, qt, hop_latency,
                                   switch_latency,
-                                  snd_type);
+                                  snd_type, par);
     }
 
     if (log_switches) {
@@ -473,8 +539,17 @@ int main(int argc, char **argv) {
     vector<EqdsNIC*> nics;
 
     for (size_t ix = 0; ix < no_of_nodes; ix++){
-        pacers.push_back(new EqdsPullPacer(linkspeed, 0.99, EqdsSrc::_mtu, eventlist));   
-        nics.push_back(new EqdsNIC(eventlist,linkspeed));
+        pacers.push_back(new EqdsPullPacer(linkspeed, 0.99, EqdsSrc::_default_mtu, top->host_eventlist(ix)));
+        nics.push_back(new EqdsNIC(top->host_eventlist(ix),linkspeed));
+    }
+
+    FatTreePartition* partition = NULL;
+    if (partition_stats && !par) {
+        partition = new FatTreePartition(*top);
+        for (size_t ix = 0; ix < no_of_nodes; ix++){
+            partition->assignHost(*pacers[ix], ix);
+            partition->assignHost(*nics[ix], ix);
+        }
     }
 
     // used just to print out stats data at the end
@@ -491,10 +566,12 @@ int main(int argc, char **argv) {
         int dest = crt->dst;
         //cout << "Connection " << crt->src << "->" <<crt->dst << " starting at " << crt->start << " size " << crt->size << endl;
 
-        eqds_src = new EqdsSrc(traffic_logger, eventlist, *nics.at(src));
+        eqds_src = new EqdsSrc(traffic_logger, top->host_eventlist(src), *nics.at(src));
         eqds_src->setCwnd(cwnd*Packet::data_packet_size());
         eqds_srcs.push_back(eqds_src);
         eqds_src->setDst(dest);
+        if (partition)
+            partition->assignHost(*eqds_src, src);
 
         if (log_flow_events) {
             eqds_src->logFlowEvents(*event_logger);
@@ -519,6 +596,10 @@ int main(int argc, char **argv) {
             eqds_src->setFlowsize(crt->size);
         }
 
+        if (par && (crt->trigger || crt->send_done_trigger || crt->recv_done_trigger)) {
+            cerr << "Triggers aren't supported with -parallel" << endl;
+            exit(1);
+        }
         if (crt->trigger) {
             Trigger* trig = conns->getTrigger(crt->trigger, eventlist);
             trig->add_target(*eqds_src);
@@ -587,10 +668,26 @@ int main(int argc, char **argv) {
     
     // GO!
     cout << "Starting simulation" << endl;
-    while (eventlist.doNextEvent()) {
+    if (partition)
+        eventlist.setObserver(partition);
+    if (fct_stats)
+        SimContext::current().flowStats().set_ideal(linkspeed, top->diameter_rtt());
+    if (par) {
+        par->run();
+    } else {
+        while (eventlist.doNextEvent()) {
+        }
     }
 
     cout << "Done" << endl;
+    if (fct_stats)
+        SimContext::current().flowStats().report(cout);
+    if (partition)
+        partition->print_stats(cout);
+    if (par && partition_stats)
+        par->print_stats(cout);
+    if (packet_stats)
+        PacketDBStats::print(cout);
     int new_pkts = 0, rtx_pkts = 0, bounce_pkts = 0, rts_pkts = 0;
     for (size_t ix = 0; ix < eqds_srcs.size(); ix++) {
         new_pkts += eqds_srcs[ix]->_new_packets_sent;
@@ -20,7 +20,9 @@
 #include "topology.h"
 #include "queue_lossless_input.h"
 #include "connection_matrix.h"
+#include "path_store.h"
 
+#include "flowstats.h"
 #include "fat_tree_topology.h"
 #include "fat_tree_switch.h"
 
@@ -44,7 +46,7 @@ int DEFAULT_NODES = 432;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]" << endl;
+    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-cwnd cwnd_size]\n\t[-q queue_size]\n\t[-oversubscribed_cc] Use receiver-driven AIMD to reduce total window when trims are not last hop\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,rand,perm,pull,ecmp,\n\tecmp_host path_count,ecmp_ar,ecmp_rr,path_index,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-lazy_loggers] only create queue loggers for queues that log something\n\t[-log_sync] write the logfile from the simulation thread rather than a background one\n\t[-pull_batch n] pulls the receiver pacer chooses at a time, each still sent in its own slot, default 1\n\t[-pull_order flowid|active] round robin pulls in flow id order (default) or the order flows became active\n\t[-logformat raw|columnar]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-host_queue_type  swift|prio|fair_prio]\n\t[-rtx_scan_all] scan every source for RTO expiry (for validation)\n\t[-packet_stats] print packet memory use by type\n\t[-fct_stats] print flow completion time percentiles" << endl;
     exit(1);
 }
 
@@ -88,7 +90,11 @@ int main(int argc, char **argv) {
 
     bool log_sink = false;
     bool rts = false;
+    bool rtx_scan_all = false;
+    bool packet_stats = false;
+    bool fct_stats = false;
     bool log_tor_downqueue = false;
+    bool lazy_loggers = false;
     bool log_tor_upqueue = false;
     bool log_traffic = false;
     bool log_switches = false;
@@ -131,6 +137,12 @@ int main(int argc, char **argv) {
         } else if (!strcmp(argv[i],"-rts")) {
             rts = true;
             cout << "rts enabled "<< endl;
+        } else if (!strcmp(argv[i],"-rtx_scan_all")) {
+            rtx_scan_all = true;
+        } else if (!strcmp(argv[i],"-packet_stats")) {
+            packet_stats = true;
+        } else if (!strcmp(argv[i],"-fct_stats")) {
+            fct_stats = true;
         } else if (!strcmp(argv[i],"-nodes")) {
             no_of_nodes = atoi(argv[i+1]);
             cout << "no_of_nodes "<<no_of_nodes << endl;
@@ -175,6 +187,32 @@ int main(int argc, char **argv) {
             }
             cout << "host queue_type "<< snd_type << endl;
             i++;
+        } else if (!strcmp(argv[i],"-logformat")){
+            if (!strcmp(argv[i+1], "raw")) {
+                Logfile::set_format(Logfile::RAW);
+            } else if (!strcmp(argv[i+1], "columnar")) {
+                Logfile::set_format(Logfile::COLUMNAR);
+            } else {
+                exit_error(argv[0]);
+            }
+            i++;
+        } else if (!strcmp(argv[i],"-lazy_loggers")){
+            lazy_loggers = true;
+        } else if (!strcmp(argv[i],"-log_sync")){
+            Logfile::set_async_writer(false);
+        } else if (!strcmp(argv[i],"-pull_order")){
+            if (!strcmp(argv[i+1], "flowid")) {
+                NdpPullPacer::set_active_order(false);
+            } else if (!strcmp(argv[i+1], "active")) {
+                NdpPullPacer::set_active_order(true);
+            } else {
+                exit_error(argv[0]);
+            }
+            i++;
+        } else if (!strcmp(argv[i],"-pull_batch")){
+            NdpPullPacer::set_pull_batch(atoi(argv[i+1]));
+            cout << "pull batch " << argv[i+1] << endl;
+            i++;
         } else if (!strcmp(argv[i],"-log")){
             if (!strcmp(argv[i+1], "sink")) {
                 log_sink = true;
@@ -345,6 +383,10 @@ int main(int argc, char **argv) {
                 //FatTreeSwitch::set_ar_fraction(atoi(argv[i+2]));
                 //cout << "AR fraction: " << atoi(argv[i+2]) << endl;
                 //i++;
+            } else if (!strcmp(argv[i+1], "path_index")) {
+                // compact paths: the switches resolve each hop from the path index in the packet
+                route_strategy = ECMP_FIB;
+                FatTreeSwitch::set_strategy(FatTreeSwitch::PATH_INDEX);
             } else if (!strcmp(argv[i+1], "ecmp_rr")) {
                 // switch round robin
                 route_strategy = ECMP_FIB;
@@ -453,6 +495,7 @@ int main(int argc, char **argv) {
 
     // scanner interval must be less than min RTO
     NdpRtxTimerScanner ndpRtxScanner(timeFromUs((uint32_t)9), eventlist);
+    ndpRtxScanner.setScanAll(rtx_scan_all);
    
     QueueLoggerFactory *qlf = 0;
     if (log_tor_downqueue || log_tor_upqueue) {
@@ -462,6 +505,8 @@ int main(int argc, char **argv) {
         qlf = new QueueLoggerFactory(&logfile, QueueLoggerFactory::LOGGER_EMPTY, eventlist);
         qlf->set_sample_period(timeFromUs(10.0));
     }
+    if (qlf && lazy_loggers)
+        qlf->set_lazy(true);
 #ifdef FAT_TREE
     FatTreeTopology* top;
     if (topo_file) {
@@ -501,22 +546,12 @@ int main(int argc, char **argv) {
         top->add_switch_loggers(logfile, timeFromUs(20.0));
     }
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
-
-    int **path_refcounts;
-    path_refcounts = new int*[no_of_nodes];
+    PathStore* net_paths = new PathStore(top, false);
 
     int* is_dest = new int[no_of_nodes];
     
     for (size_t s = 0; s < no_of_nodes; s++) {
         is_dest[s] = 0;
-        net_paths[s] = new vector<const Route*>*[no_of_nodes];
-        path_refcounts[s] = new int[no_of_nodes];
-        for (size_t d = 0; d < no_of_nodes; d++) {
-            net_paths[s][d] = NULL;
-            path_refcounts[s][d] = 0;
-        }
     }
     
     ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
@@ -562,33 +597,9 @@ int main(int argc, char **argv) {
         connection* crt = all_conns->at(c);
         int src = crt->src;
         int dest = crt->dst;
-        path_refcounts[src][dest]++;
-        path_refcounts[dest][src]++;
-                        
-        if (!net_paths[src][dest]
-            && route_strategy!=ECMP_FIB
-            && route_strategy!=ECMP_FIB_ECN
-            && route_strategy!=REACTIVE_ECN ) {
-            vector<const Route*>* paths = top->get_bidir_paths(src,dest,false);
-            net_paths[src][dest] = paths;
-            /*
-            for (unsigned int i = 0; i < paths->size(); i++) {
-              routes.push_back((*paths)[i]);
-            }
-            */
-        }
-        if (!net_paths[dest][src]
-            && route_strategy!=ECMP_FIB
-            && route_strategy!=ECMP_FIB_ECN
-            && route_strategy!=REACTIVE_ECN ) {
-            vector<const Route*>* paths = top->get_bidir_paths(dest,src,false);
-            net_paths[dest][src] = paths;
-            /*
-            for (unsigned int i = 0; i < paths->size(); i++) {
-              routes.push_back((*paths)[i]);
-            }
-            */
-        }
+        // paths are only built when a source-routed strategy asks for them
+        net_paths->add_ref(src,dest);
+        net_paths->add_ref(dest,src);
     }
 
     map <flowid_t, TriggerTarget*> flowmap;
@@ -649,8 +660,8 @@ int main(int argc, char **argv) {
         case SCATTER_ECMP:
         case PULL_BASED:
             ndpSrc->connect(NULL, NULL, *ndpSnk, crt->start);
-            ndpSrc->set_paths(net_paths[src][dest]);
-            ndpSnk->set_paths(net_paths[dest][src]);
+            ndpSrc->set_paths(net_paths->get(src,dest));
+            ndpSnk->set_paths(net_paths->get(dest,src));
             break;
         case ECMP_FIB:
         case ECMP_FIB_ECN:
@@ -681,11 +692,11 @@ int main(int argc, char **argv) {
         case SINGLE_PATH:
             {
                 assert(route_strategy==SINGLE_PATH);
-                int choice = rand()%net_paths[src][dest]->size();
-                routeout = new Route(*(net_paths[src][dest]->at(choice)));
+                int choice = rand()%net_paths->get(src,dest)->size();
+                routeout = new Route(*(net_paths->get(src,dest)->at(choice)));
                 routeout->add_endpoints(ndpSrc, ndpSnk);
                                 
-                routein = new Route(*top->get_bidir_paths(dest,src,false)->at(choice));
+                routein = new Route(*net_paths->get(dest,src)->at(choice));
                 routein->add_endpoints(ndpSnk, ndpSrc);
                 ndpSrc->connect(routeout, routein, *ndpSnk, crt->start);
                 break;
@@ -694,42 +705,18 @@ int main(int argc, char **argv) {
             abort();
         }
 
-        path_refcounts[src][dest]--;
-        path_refcounts[dest][src]--;
-
-
         // set up the triggers
         // xxx
 
         // free up the routes if no other connection needs them 
-        if (path_refcounts[src][dest] == 0 && net_paths[src][dest]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[src][dest]->begin(); i != net_paths[src][dest]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[src][dest];
-        }
-        if (path_refcounts[dest][src] == 0 && net_paths[dest][src]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[dest][src]->begin(); i != net_paths[dest][src]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[dest][src];
-        }
+        net_paths->release(src,dest);
+        net_paths->release(dest,src);
 
         if (log_sink) {
             sinkLogger.monitorSink(ndpSnk);
         }
     }
 
-    for (size_t ix = 0; ix < no_of_nodes; ix++) {
-        delete path_refcounts[ix];
-    }
-
     Logged::dump_idmap();
     // Record the setup
     int pktsize = Packet::data_packet_size();
@@ -740,12 +727,20 @@ int main(int argc, char **argv) {
     double rtt = timeAsSec(timeFromUs(RTT));
     logfile.write("# rtt =" + ntoa(rtt));
     
+#ifdef FAT_TREE
+    if (fct_stats)
+        SimContext::current().flowStats().set_ideal(linkspeed, top->diameter_rtt());
+#endif
     // GO!
     cout << "Starting simulation" << endl;
     while (eventlist.doNextEvent()) {
     }
 
     cout << "Done" << endl;
+    if (fct_stats)
+        SimContext::current().flowStats().report(cout);
+    if (packet_stats)
+        PacketDBStats::print(cout);
     int new_pkts = 0, rtx_pkts = 0, bounce_pkts = 0;
     for (size_t ix = 0; ix < ndp_srcs.size(); ix++) {
         new_pkts += ndp_srcs[ix]->_new_packets_sent;
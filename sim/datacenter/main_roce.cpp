@@ -20,7 +20,9 @@
 #include "firstfit.h"
 #include "topology.h"
 #include "connection_matrix.h"
+#include "path_store.h"
 
+#include "flowstats.h"
 #include "fat_tree_topology.h"
 #include "fat_tree_switch.h"
 
@@ -44,7 +46,7 @@ int DEFAULT_NODES = 432;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-q queue_size]\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,\n\tecmp_host,ecmp_ar,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-start_delta] time in us to randomly delay the start of connections\n\t[-pfc_thresholds low high]" << endl;
+    cout << "Usage " << progr << " [-nodes N]\n\t[-conns C]\n\t[-q queue_size]\n\t[-queue_type composite|random|lossless|lossless_input|]\n\t[-tm traffic_matrix_file]\n\t[-strat route_strategy (single,\n\tecmp_host,ecmp_ar,\n\tecmp_host_ar ar_thresh)]\n\t[-log log_level]\n\t[-lazy_loggers] only create queue loggers for queues that log something\n\t[-log_sync] write the logfile from the simulation thread rather than a background one\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-hop_latency x] per hop wire latency in us,default 1\n\t[-switch_latency x] switching latency in us, default 0\n\t[-start_delta] time in us to randomly delay the start of connections\n\t[-pfc_thresholds low high]\n\t[-packet_stats] print packet memory use by type\n\t[-fct_stats] print flow completion time percentiles" << endl;
     exit(1);
 }
 
@@ -70,6 +72,7 @@ int main(int argc, char **argv) {
 
     bool log_sink = false;
     bool log_tor_downqueue = false;
+    bool lazy_loggers = false;
     bool log_tor_upqueue = false;
     bool log_traffic = false;
     bool log_switches = false;
@@ -79,6 +82,8 @@ int main(int argc, char **argv) {
     int i = 1;
     filename << "logout.dat";
     int end_time = 1000;//in microseconds
+    bool packet_stats = false;
+    bool fct_stats = false;
 
     char* tm_file = NULL;
     char* topo_file = NULL;
@@ -92,6 +97,10 @@ int main(int argc, char **argv) {
             no_of_conns = atoi(argv[i+1]);
             cout << "no_of_conns "<<no_of_conns << endl;
             i++;
+        } else if (!strcmp(argv[i],"-packet_stats")) {
+            packet_stats = true;
+        } else if (!strcmp(argv[i],"-fct_stats")) {
+            fct_stats = true;
         } else if (!strcmp(argv[i],"-end")) {
             end_time = atoi(argv[i+1]);
             cout << "endtime(us) "<< end_time << endl;
@@ -140,6 +149,10 @@ int main(int argc, char **argv) {
             }
             cout << "host queue_type "<< snd_type << endl;
             i++;
+        } else if (!strcmp(argv[i],"-lazy_loggers")){
+            lazy_loggers = true;
+        } else if (!strcmp(argv[i],"-log_sync")){
+            Logfile::set_async_writer(false);
         } else if (!strcmp(argv[i],"-log")){
             if (!strcmp(argv[i+1], "sink")) {
                 log_sink = true;
@@ -360,6 +373,8 @@ int main(int argc, char **argv) {
         qlf = new QueueLoggerFactory(&logfile, QueueLoggerFactory::LOGGER_EMPTY, eventlist);
         qlf->set_sample_period(timeFromUs(10.0));
     }
+    if (qlf && lazy_loggers)
+        qlf->set_lazy(true);
 #ifdef FAT_TREE
     FatTreeTopology* top;
     if (topo_file) {
@@ -396,22 +411,12 @@ int main(int argc, char **argv) {
         top->add_switch_loggers(logfile, timeFromUs(20.0));
     }
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
-
-    int **path_refcounts;
-    path_refcounts = new int*[no_of_nodes];
+    PathStore* net_paths = new PathStore(top, false);
 
     int* is_dest = new int[no_of_nodes];
     
     for (size_t s = 0; s < no_of_nodes; s++) {
         is_dest[s] = 0;
-        net_paths[s] = new vector<const Route*>*[no_of_nodes];
-        path_refcounts[s] = new int[no_of_nodes];
-        for (size_t d = 0; d < no_of_nodes; d++) {
-            net_paths[s][d] = NULL;
-            path_refcounts[s][d] = 0;
-        }
     }
     
     ConnectionMatrix* conns = new ConnectionMatrix(no_of_nodes);
@@ -444,22 +449,9 @@ int main(int argc, char **argv) {
         connection* crt = all_conns->at(c);
         int src = crt->src;
         int dest = crt->dst;
-        path_refcounts[src][dest]++;
-        path_refcounts[dest][src]++;
-                        
-        if (!net_paths[src][dest]&&route_strategy!=ECMP_FIB) {
-            vector<const Route*>* paths = top->get_bidir_paths(src,dest,false);
-            net_paths[src][dest] = paths;
-            /*
-              for (unsigned int i = 0; i < paths->size(); i++) {
-              routes.push_back((*paths)[i]);
-              }
-            */
-        }
-        if (!net_paths[dest][src]&&route_strategy!=ECMP_FIB) {
-            vector<const Route*>* paths = top->get_bidir_paths(dest,src,false);
-            net_paths[dest][src] = paths;
-        }
+        // paths are only built when a source-routed strategy asks for them
+        net_paths->add_ref(src,dest);
+        net_paths->add_ref(dest,src);
     }
 
     map <flowid_t, TriggerTarget*> flowmap;
@@ -534,46 +526,24 @@ int main(int argc, char **argv) {
             top->switches_lp[top->HOST_POD_SWITCH(src)]->addHostPort(src,roceSrc->flow_id(),roceSrc);
             top->switches_lp[top->HOST_POD_SWITCH(dest)]->addHostPort(dest,roceSrc->flow_id(),roceSnk);
         } else {
-            int choice = rand()%net_paths[src][dest]->size();
-            routeout = new Route(*(net_paths[src][dest]->at(choice)));
+            int choice = rand()%net_paths->get(src,dest)->size();
+            routeout = new Route(*(net_paths->get(src,dest)->at(choice)));
             routeout->add_endpoints(roceSrc, roceSnk);
                                 
-            routein = new Route(*top->get_bidir_paths(dest,src,false)->at(choice));
+            routein = new Route(*net_paths->get(dest,src)->at(choice));
             routein->add_endpoints(roceSnk, roceSrc);
             roceSrc->connect(routeout, routein, *roceSnk, timeFromUs((uint32_t)rand()%20));
         }
 
-        path_refcounts[src][dest]--;
-        path_refcounts[dest][src]--;
-
         // free up the routes if no other connection needs them 
-        if (path_refcounts[src][dest] == 0 && net_paths[src][dest]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[src][dest]->begin(); i != net_paths[src][dest]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[src][dest];
-        }
-        if (path_refcounts[dest][src] == 0 && net_paths[dest][src]) {
-            vector<const Route*>::iterator i;
-            for (i = net_paths[dest][src]->begin(); i != net_paths[dest][src]->end(); i++) {
-                if ((*i)->reverse())
-                    delete (*i)->reverse();
-                delete *i;
-            }
-            delete net_paths[dest][src];
-        }
+        net_paths->release(src,dest);
+        net_paths->release(dest,src);
 
         if (log_sink) {
             sinkLogger.monitorSink(roceSnk);
         }
     }
 
-    for (size_t ix = 0; ix < no_of_nodes; ix++) {
-        delete path_refcounts[ix];
-    }
 
     Logged::dump_idmap();
     // Record the setup
@@ -585,12 +555,20 @@ int main(int argc, char **argv) {
     double rtt = timeAsSec(timeFromUs(RTT));
     logfile.write("# rtt =" + ntoa(rtt));
     
+#ifdef FAT_TREE
+    if (fct_stats)
+        SimContext::current().flowStats().set_ideal(linkspeed, top->diameter_rtt());
+#endif
     // GO!
     cout << "Starting simulation" << endl;
     while (eventlist.doNextEvent()) {
     }
 
     cout << "Done" << endl;
+    if (fct_stats)
+        SimContext::current().flowStats().report(cout);
+    if (packet_stats)
+        PacketDBStats::print(cout);
     int new_pkts = 0, rtx_pkts = 0;
     for (size_t ix = 0; ix < roce_srcs.size(); ix++) {
         new_pkts += roce_srcs[ix]->_new_packets_sent;
@@ -0,0 +1,371 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+//
+// Parameter sweep for EQDS: runs one simulation per point of a grid of
+// -q, -cwnd and -ecn_thresh values, several at a time on a pool of
+// threads.  Each simulation has its own SimContext.
+//
+// The connection matrix and the FatTree config are read once and
+// shared, read-only, by all the points.  Queues, pipes and switches hold
+// per-run state, and the queue sizes vary per point, so each point
+// builds its own network from the shared description on its worker
+// thread, and frees it when it finishes.  Packets still in flight when
+// a point ends stay in its thread's packet pools, to be reused by the
+// thread's next point.
+//
+// Each point prints the same "Flow ... finished at" lines as
+// htsim_eqds, after a "Sweep point" header line.  Points are printed in
+// grid order.  The simulations' progress messages are discarded.
+#include <sstream>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "network.h"
+#include "pipe.h"
+#include "eventlist.h"
+#include "simcontext.h"
+#include "eqds.h"
+#include "compositequeue.h"
+#include "topology.h"
+#include "connection_matrix.h"
+
+#include "fat_tree_topology.h"
+#include "fat_tree_switch.h"
+
+#include "main.h"
+
+#define DEFAULT_QUEUE_SIZE 35
+#define DEFAULT_CWND 50
+
+// use tokenize from connection matrix
+extern void tokenize(string const &str, const char delim, vector<string> &out);
+
+struct sweep_point {
+    uint32_t queuesize; // packets
+    uint32_t cwnd;      // packets
+    double ecn_thresh;
+    stringstream out;
+    bool done;
+};
+
+// settings shared by all points
+ConnectionMatrix* conns = NULL;
+uint32_t no_of_nodes = 0;
+linkspeed_bps linkspeed = speedFromMbps((double)HOST_NIC);
+int end_time = 1000; // in microseconds
+int seed = 13;
+queue_type qt = COMPOSITE;
+queue_type snd_type = FAIR_PRIO;
+
+vector<sweep_point*> points;
+atomic<size_t> next_point(0);
+mutex done_mutex;
+condition_variable done_cond;
+
+void exit_error(char* progr) {
+    cout << "Usage " << progr << " -tm traffic_matrix_file -topo topology_file\n\t[-q q1,q2,...] queue sizes in packets\n\t[-cwnd c1,c2,...] cwnds in packets\n\t[-ecn_thresh e1,e2,...] fractions of queuesize\n\t[-threads N] default one per core\n\t[-queue_type composite|composite_ecn|aeolus|aeolus_ecn]\n\t[-host_queue_type swift|prio|fair_prio]\n\t[-strat ecmp_host|ecmp_host_ecn|reactive_ecn]\n\t[-paths N]\n\t[-seed random_seed]\n\t[-end end_time_in_usec]\n\t[-mtu MTU]\n\t[-linkspeed Mbps] host NIC speed" << endl;
+    exit(1);
+}
+
+template <class T>
+void parse_list(const char* arg, T (*convert)(const char*), vector<T>& values) {
+    vector<string> tokens;
+    tokenize(arg, ',', tokens);
+    values.clear();
+    for (size_t i = 0; i < tokens.size(); i++)
+        values.push_back(convert(tokens[i].c_str()));
+    if (values.empty()) {
+        cout << "Empty parameter list " << arg << endl;
+        exit(1);
+    }
+}
+
+uint32_t to_uint(const char* s) {return atoi(s);}
+double to_double(const char* s) {return atof(s);}
+
+// build and run one point's simulation; called on a worker thread
+void run_point(sweep_point& pt) {
+    ostream discard(NULL);
+    SimContext context;
+    SimContext::setCurrent(&context);
+    context.setOut(&pt.out);
+    context.setLog(&discard);
+    srand(seed);
+    srandom(seed);
+
+    EventList eventlist;
+    eventlist.setEndtime(timeFromUs((uint32_t)end_time));
+
+    mem_b queuesize = memFromPkt(pt.queuesize);
+    EqdsSrc::_min_rto = timeFromUs(150 + queuesize * 6.0 * 8 * 1000000 / linkspeed);
+    EqdsSrc::_global_node_count = 0;
+    FatTreeSwitch::_ecn_threshold_fraction = pt.ecn_thresh;
+
+    FatTreeTopology* top = new FatTreeTopology(no_of_nodes, 0, queuesize, NULL, &eventlist, NULL, qt, 0, 0, snd_type);
+
+    for (size_t c = 0; c < conns->failures.size(); c++){
+        failure* crt = conns->failures.at(c);
+        top->add_failed_link(crt->switch_type, crt->switch_id, crt->link_id);
+    }
+
+    vector<EqdsPullPacer*> pacers;
+    vector<EqdsNIC*> nics;
+    for (size_t ix = 0; ix < no_of_nodes; ix++){
+        pacers.push_back(new EqdsPullPacer(linkspeed, 0.99, EqdsSrc::_default_mtu, eventlist));
+        nics.push_back(new EqdsNIC(eventlist, linkspeed));
+    }
+
+    vector<connection*>* all_conns = conns->getAllConnections();
+    vector<EqdsSrc*> eqds_srcs;
+    vector<EqdsSink*> eqds_sinks;
+    vector<Route*> routes;
+    map<triggerid_t, Trigger*> triggers;  // the matrix's own triggers are shared
+
+    for (size_t c = 0; c < all_conns->size(); c++){
+        connection* crt = all_conns->at(c);
+        int src = crt->src;
+        int dest = crt->dst;
+
+        EqdsSrc* eqds_src = new EqdsSrc(NULL, eventlist, *nics.at(src));
+        eqds_src->setCwnd(pt.cwnd*Packet::data_packet_size());
+        eqds_srcs.push_back(eqds_src);
+        eqds_src->setDst(dest);
+
+        EqdsSink* eqds_snk = new EqdsSink(NULL, pacers[dest], *nics.at(dest));
+        eqds_sinks.push_back(eqds_snk);
+        eqds_src->setName("Eqds_" + ntoa(src) + "_" + ntoa(dest));
+        eqds_snk->setSrc(src);
+        eqds_snk->setName("Eqds_sink_" + ntoa(src) + "_" + ntoa(dest));
+
+        if (crt->flowid) {
+            eqds_src->setFlowId(crt->flowid);
+            eqds_snk->setFlowId(crt->flowid);
+        }
+        if (crt->size>0){
+            eqds_src->setFlowsize(crt->size);
+        }
+
+        triggerid_t trigger_ids[3] = {crt->trigger, crt->send_done_trigger, crt->recv_done_trigger};
+        for (int t = 0; t < 3; t++) {
+            if (trigger_ids[t] && triggers.find(trigger_ids[t]) == triggers.end())
+                triggers[trigger_ids[t]] = conns->createTrigger(trigger_ids[t], eventlist);
+        }
+        if (crt->trigger)
+            triggers[crt->trigger]->add_target(*eqds_src);
+        if (crt->send_done_trigger)
+            eqds_src->setEndTrigger(*triggers[crt->send_done_trigger]);
+        if (crt->recv_done_trigger)
+            eqds_snk->setEndTrigger(*triggers[crt->recv_done_trigger]);
+
+        Route* srctotor = new Route();
+        srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
+        srctotor->push_back(top->pipes_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]);
+        srctotor->push_back(top->queues_ns_nlp[src][top->HOST_POD_SWITCH(src)][0]->getRemoteEndpoint());
+
+        Route* dsttotor = new Route();
+        dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
+        dsttotor->push_back(top->pipes_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]);
+        dsttotor->push_back(top->queues_ns_nlp[dest][top->HOST_POD_SWITCH(dest)][0]->getRemoteEndpoint());
+
+        routes.push_back(srctotor);
+        routes.push_back(dsttotor);
+
+        eqds_src->connect(*srctotor, *dsttotor, *eqds_snk, crt->start);
+
+        top->switches_lp[top->HOST_POD_SWITCH(src)]->addHostPort(src,eqds_snk->flowId(),eqds_src);
+        top->switches_lp[top->HOST_POD_SWITCH(dest)]->addHostPort(dest,eqds_src->flowId(),eqds_snk);
+    }
+
+    while (eventlist.doNextEvent()) {
+    }
+
+    int new_pkts = 0, rtx_pkts = 0, bounce_pkts = 0, rts_pkts = 0;
+    for (size_t ix = 0; ix < eqds_srcs.size(); ix++) {
+        new_pkts += eqds_srcs[ix]->_new_packets_sent;
+        rtx_pkts += eqds_srcs[ix]->_rtx_packets_sent;
+        rts_pkts += eqds_srcs[ix]->_rts_packets_sent;
+        bounce_pkts += eqds_srcs[ix]->_bounces_received;
+    }
+    pt.out << "New: " << new_pkts << " Rtx: " << rtx_pkts << " RTS: " << rts_pkts << " Bounced: " << bounce_pkts << endl;
+
+    // free the point's network while its context is still current;
+    // the EventList and the context go when we return
+    for (size_t ix = 0; ix < eqds_srcs.size(); ix++) {
+        delete eqds_srcs[ix];
+        delete eqds_sinks[ix];
+    }
+    for (size_t ix = 0; ix < routes.size(); ix++)
+        delete routes[ix];
+    for (auto& t : triggers)
+        delete t.second;
+    for (size_t ix = 0; ix < no_of_nodes; ix++) {
+        delete pacers[ix];
+        delete nics[ix];
+    }
+    delete top;
+
+    SimContext::setCurrent(NULL);
+}
+
+void worker() {
+    while (true) {
+        size_t i = next_point++;
+        if (i >= points.size())
+            return;
+        run_point(*points[i]);
+        {
+            lock_guard<mutex> lock(done_mutex);
+            points[i]->done = true;
+        }
+        done_cond.notify_all();
+    }
+}
+
+int main(int argc, char **argv) {
+    int packet_size = 4150;
+    uint32_t path_entropy_size = 64;
+    uint32_t threads = thread::hardware_concurrency();
+    vector<uint32_t> queuesizes(1, DEFAULT_QUEUE_SIZE);
+    vector<uint32_t> cwnds(1, DEFAULT_CWND);
+    vector<double> ecn_threshs(1, 0.5);
+    bool ecn_lb = false;
+    char* tm_file = NULL;
+    char* topo_file = NULL;
+
+    int i = 1;
+    while (i<argc) {
+        if (i + 1 >= argc) {
+            exit_error(argv[0]);
+        } else if (!strcmp(argv[i],"-tm")){
+            tm_file = argv[i+1];
+        } else if (!strcmp(argv[i],"-topo")){
+            topo_file = argv[i+1];
+        } else if (!strcmp(argv[i],"-q")){
+            parse_list(argv[i+1], to_uint, queuesizes);
+        } else if (!strcmp(argv[i],"-cwnd")){
+            parse_list(argv[i+1], to_uint, cwnds);
+        } else if (!strcmp(argv[i],"-ecn_thresh")){
+            parse_list(argv[i+1], to_double, ecn_threshs);
+        } else if (!strcmp(argv[i],"-threads")){
+            threads = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-queue_type")) {
+            if (!strcmp(argv[i+1], "composite")) {
+                qt = COMPOSITE;
+            } else if (!strcmp(argv[i+1], "composite_ecn")) {
+                qt = COMPOSITE_ECN;
+            } else if (!strcmp(argv[i+1], "aeolus")){
+                qt = AEOLUS;
+            } else if (!strcmp(argv[i+1], "aeolus_ecn")){
+                qt = AEOLUS_ECN;
+            } else {
+                cout << "Unknown queue type " << argv[i+1] << endl;
+                exit_error(argv[0]);
+            }
+        } else if (!strcmp(argv[i],"-host_queue_type")) {
+            if (!strcmp(argv[i+1], "swift")) {
+                snd_type = SWIFT_SCHEDULER;
+            } else if (!strcmp(argv[i+1], "prio")) {
+                snd_type = PRIORITY;
+            } else if (!strcmp(argv[i+1], "fair_prio")) {
+                snd_type = FAIR_PRIO;
+            } else {
+                cout << "Unknown host queue type " << argv[i+1] << " expecting one of swift|prio|fair_prio" << endl;
+                exit_error(argv[0]);
+            }
+        } else if (!strcmp(argv[i],"-strat")){
+            if (!strcmp(argv[i+1], "ecmp_host")) {
+                ecn_lb = false;
+            } else if (!strcmp(argv[i+1], "ecmp_host_ecn") || !strcmp(argv[i+1], "reactive_ecn")) {
+                ecn_lb = true;
+            } else {
+                cout << "Unknown route strategy " << argv[i+1] << endl;
+                exit_error(argv[0]);
+            }
+        } else if (!strcmp(argv[i],"-paths")){
+            path_entropy_size = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-seed")){
+            seed = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-end")) {
+            end_time = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-mtu")){
+            packet_size = atoi(argv[i+1]);
+        } else if (!strcmp(argv[i],"-linkspeed")){
+            linkspeed = speedFromMbps(atof(argv[i+1]));
+        } else {
+            cout << "Unknown parameter " << argv[i] << endl;
+            exit_error(argv[0]);
+        }
+        i += 2;
+    }
+    if (!tm_file || !topo_file)
+        exit_error(argv[0]);
+    if (threads == 0)
+        threads = 1;
+
+    // class-wide settings, which must be set before any threads start
+    Packet::set_packet_size(packet_size);
+    FatTreeSwitch::set_strategy(FatTreeSwitch::ECMP);
+    if (ecn_lb) {
+        qt = COMPOSITE_ECN_LB;
+        for (size_t e = 0; e < ecn_threshs.size(); e++) {
+            if (ecn_threshs[e] <= 0 || ecn_threshs[e] >= 1) {
+                cerr << "Route Strategy is ECMP ECN.  ecn_thresh must be between 0 and 1\n";
+                exit(1);
+            }
+        }
+    }
+    EqdsSrc::_path_entropy_size = path_entropy_size;
+
+    conns = new ConnectionMatrix(0);
+    cout << "Loading connection matrix from  " << tm_file << endl;
+    if (!conns->load(tm_file)){
+        cout << "Failed to load connection matrix " << tm_file << endl;
+        exit(-1);
+    }
+    no_of_nodes = FatTreeTopology::load_config(topo_file, memFromPkt(queuesizes[0]));
+    if (conns->N != no_of_nodes) {
+        cerr << "Mismatch between connection matrix (" << conns->N << " nodes) and topology ("
+             << no_of_nodes << " nodes)" << endl;
+        exit(1);
+    }
+
+    for (size_t q = 0; q < queuesizes.size(); q++) {
+        for (size_t c = 0; c < cwnds.size(); c++) {
+            for (size_t e = 0; e < ecn_threshs.size(); e++) {
+                sweep_point* pt = new sweep_point();
+                pt->queuesize = queuesizes[q];
+                pt->cwnd = cwnds[c];
+                pt->ecn_thresh = ecn_threshs[e];
+                pt->done = false;
+                points.push_back(pt);
+            }
+        }
+    }
+    if (threads > points.size())
+        threads = points.size();
+    cout << "Running " << points.size() << " points on " << threads << " threads" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (uint32_t t = 0; t < threads; t++)
+        pool.push_back(thread(worker));
+
+    for (size_t p = 0; p < points.size(); p++) {
+        sweep_point& pt = *points[p];
+        {
+            unique_lock<mutex> lock(done_mutex);
+            done_cond.wait(lock, [&pt]{return pt.done;});
+        }
+        cout << "Sweep point " << p << " -q " << pt.queuesize << " -cwnd " << pt.cwnd
+             << " -ecn_thresh " << pt.ecn_thresh << endl;
+        cout << pt.out.str();
+    }
+    for (uint32_t t = 0; t < threads; t++)
+        pool[t].join();
+
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Done: " << points.size() << " points in " << elapsed << "s" << endl;
+}
@@ -19,8 +19,10 @@
 //#include "firstfit.h"
 #include "topology.h"
 #include "connection_matrix.h"
+#include "path_store.h"
 //#include "vl2_topology.h"
 
+#include "flowstats.h"
 #include "fat_tree_topology.h"
 //#include "generic_topology.h"
 //#include "oversubscribed_fat_tree_topology.h"
@@ -52,7 +54,7 @@ EventList eventlist;
 Logfile* lg;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP" << endl;
+    cout << "Usage " << progr << " [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP\n\t[-host_queue_type swift|swift_rr|swift_fifo]\n\t[-rtx_scan_all] scan every source for RTO expiry (for validation)\n\t[-packet_stats] print packet memory use by type\n\t[-fct_stats] print flow completion time percentiles" << endl;
     exit(1);
 }
 
@@ -64,6 +66,10 @@ int main(int argc, char **argv) {
     stringstream filename(ios_base::out);
     uint32_t packet_size = 4000;
     bool plb = false;
+    bool rtx_scan_all = false;
+    bool packet_stats = false;
+    bool fct_stats = false;
+    queue_type snd_type = SWIFT_SCHEDULER;
     uint32_t no_of_subflows = 1;
     simtime_picosec tput_sample_time = timeFromUs((uint32_t)12);
     simtime_picosec endtime = timeFromMs(1.2);
@@ -126,6 +132,23 @@ int main(int argc, char **argv) {
                 exit_error(argv[0]);
             }
             i++;            
+        } else if (!strcmp(argv[i],"-host_queue_type")){
+            if (!strcmp(argv[i+1], "swift")) {
+                snd_type = SWIFT_SCHEDULER;
+            } else if (!strcmp(argv[i+1], "swift_rr")) {
+                snd_type = SWIFT_RR_SCHEDULER;
+            } else if (!strcmp(argv[i+1], "swift_fifo")) {
+                snd_type = SWIFT_FIFO_SCHEDULER;
+            } else {
+                exit_error(argv[0]);
+            }
+            i++;
+        } else if (!strcmp(argv[i],"-rtx_scan_all")){
+            rtx_scan_all = true;
+        } else if (!strcmp(argv[i],"-packet_stats")){
+            packet_stats = true;
+        } else if (!strcmp(argv[i],"-fct_stats")) {
+            fct_stats = true;
         } else {
             exit_error(argv[i]);
         }
@@ -176,6 +199,7 @@ int main(int argc, char **argv) {
     Route* routeout, *routein;
 
     SwiftRtxTimerScanner swiftRtxScanner(timeFromMs(10), eventlist);
+    swiftRtxScanner.setScanAll(rtx_scan_all);
    
 #ifdef FAT_TREE
     /*
@@ -183,7 +207,7 @@ int main(int argc, char **argv) {
                                                &logfile, &eventlist, NULL, RANDOM, SWIFT_SCHEDULER, 0);
     */
     FatTreeTopology* top = new FatTreeTopology(no_of_nodes, linkspeed, queuesize, 
-                                               NULL, &eventlist, NULL, RANDOM, SWIFT_SCHEDULER, 0);
+                                               NULL, &eventlist, NULL, RANDOM, snd_type, 0);
 #endif
 
 #ifdef OV_FAT_TREE
@@ -217,16 +241,12 @@ int main(int argc, char **argv) {
     no_of_nodes = top->no_of_nodes();
     cout << "actual nodes " << no_of_nodes << endl;
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
+    PathStore* net_paths = new PathStore(top, true);
 
     int* is_dest = new int[no_of_nodes];
     
     for (uint32_t i=0; i<no_of_nodes; i++){
 is_dest[i] = 0;
-        net_paths[i] = new vector<const Route*>*[no_of_nodes];
-        for (uint32_t j = 0; j<no_of_nodes; j++)
-            net_paths[i][j] = NULL;
     }
 
     // Permutation connections
@@ -265,17 +285,13 @@ is_dest[i] = 0;
         uint32_t dest = crt->dst;
         
         connID++;
-        if (!net_paths[src][dest]) {
-            vector<const Route*>* paths = top->get_paths(src,dest);
-            net_paths[src][dest] = paths;
-            for (uint32_t p = 0; p < paths->size(); p++) {
-                routes.push_back((*paths)[p]);
+        bool new_pair = !net_paths->has_paths(src,dest);
+        vector<const Route*>* src_paths = net_paths->get(src,dest);
+        if (new_pair) {
+            for (uint32_t p = 0; p < src_paths->size(); p++) {
+                routes.push_back((*src_paths)[p]);
             }
         }
-        if (!net_paths[dest][src]) {
-            vector<const Route*>* paths = top->get_paths(dest,src);
-            net_paths[dest][src] = paths;
-        }
 
         swiftSrc = new SwiftSrc(swiftRtxScanner, NULL, NULL, eventlist);
         swiftSrc->set_cwnd(cwnd*Packet::data_packet_size());
@@ -308,24 +324,24 @@ is_dest[i] = 0;
         uint32_t choice = 0;
           
 #ifdef FAT_TREE
-        choice = rand()%net_paths[src][dest]->size();
+        choice = rand()%src_paths->size();
 #endif
           
 #ifdef OV_FAT_TREE
-        choice = rand()%net_paths[src][dest]->size();
+        choice = rand()%src_paths->size();
 #endif
           
 #ifdef MH_FAT_TREE
-        int use_all = it_sub==net_paths[src][dest]->size();
+        int use_all = it_sub==src_paths->size();
 
         if (use_all)
             choice = inter;
         else
-            choice = rand()%net_paths[src][dest]->size();
+            choice = rand()%src_paths->size();
 #endif
           
 #ifdef VL2
-        choice = rand()%net_paths[src][dest]->size();
+        choice = rand()%src_paths->size();
 #endif
           
 #ifdef STAR
@@ -338,43 +354,43 @@ is_dest[i] = 0;
         int min = -1, max = -1,minDist = 1000,maxDist = 0;
         if (subflow_count==1){
             //find shortest and longest path 
-            for (uint32_t dd=0;dd<net_paths[src][dest]->size();dd++){
-                if (net_paths[src][dest]->at(dd)->size()<minDist){
-                    minDist = net_paths[src][dest]->at(dd)->size();
+            for (uint32_t dd=0;dd<src_paths->size();dd++){
+                if (src_paths->at(dd)->size()<minDist){
+                    minDist = src_paths->at(dd)->size();
                     min = dd;
                 }
-                if (net_paths[src][dest]->at(dd)->size()>maxDist){
-                    maxDist = net_paths[src][dest]->at(dd)->size();
+                if (src_paths->at(dd)->size()>maxDist){
+                    maxDist = src_paths->at(dd)->size();
                     max = dd;
                 }
             }
             choice = min;
         } 
         else
-            choice = rand()%net_paths[src][dest]->size();
+            choice = rand()%src_paths->size();
 #endif
-        if (choice>=net_paths[src][dest]->size()){
-            printf("Weird path choice %d out of %lu\n",choice,net_paths[src][dest]->size());
+        if (choice>=src_paths->size()){
+            printf("Weird path choice %d out of %lu\n",choice,src_paths->size());
             exit(1);
         }
           
 #if PRINT_PATHS
-        for (uint32_t ll=0;ll<net_paths[src][dest]->size();ll++){
+        for (uint32_t ll=0;ll<src_paths->size();ll++){
             paths << "Route from "<< ntoa(src) << " to " << ntoa(dest) << "  (" << ll << ") -> " ;
-            print_path(paths,net_paths[src][dest]->at(ll));
+            print_path(paths,src_paths->at(ll));
         }
 #endif
           
-        routeout = new Route(*(net_paths[src][dest]->at(choice)));
+        routeout = new Route(*(src_paths->at(choice)));
         //routeout->push_back(swiftSnk);
           
-        routein = new Route(*top->get_paths(dest,src)->at(choice));
+        routein = new Route(*net_paths->get(dest,src)->at(choice));
         //routein->push_back(swiftSrc);
 
         if (no_of_subflows == 1) {
             swiftSrc->connect(*routeout, *routein, *swiftSnk, timeFromUs((uint32_t)crt->start));
         }
-        swiftSrc->set_paths(net_paths[src][dest]);
+        swiftSrc->set_paths(src_paths);
         if (no_of_subflows > 1) {
             // could probably use this for single-path case too, but historic reasons
             cout << "will start subflow " << c << " at " << crt->start << endl;
@@ -400,11 +416,19 @@ is_dest[i] = 0;
     // enable logging on the first source - for debugging purposes
     //(*(swift_srcs.begin()))->log_me();
 
+#ifdef FAT_TREE
+    if (fct_stats)
+        SimContext::current().flowStats().set_ideal(linkspeed, top->diameter_rtt());
+#endif
     // GO!
     while (eventlist.doNextEvent()) {
     }
 
     cout << "Done" << endl;
+    if (fct_stats)
+        SimContext::current().flowStats().report(cout);
+    if (packet_stats)
+        PacketDBStats::print(cout);
 
 #if PRINT_PATHS
     list <const Route*>::iterator rt_i;
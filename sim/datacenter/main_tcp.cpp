@@ -21,7 +21,9 @@
 #include "firstfit.h"
 #include "topology.h"
 #include "connection_matrix.h"
+#include "path_store.h"
 //#include "vl2_topology.h"
+#include "flowstats.h"
 #include "fat_tree_topology.h"
 //#include "oversubscribed_fat_tree_topology.h"
 //#include "multihomed_fat_tree_topology.h"
@@ -50,7 +52,7 @@ size_t subflow_count = 1;
 EventList eventlist;
 
 void exit_error(char* progr) {
-    cout << "Usage " << progr << " [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP" << endl;
+    cout << "Usage " << progr << " [UNCOUPLED(DEFAULT)|COUPLED_INC|FULLY_COUPLED|COUPLED_EPSILON] [epsilon][COUPLED_SCALABLE_TCP\n\t[-end end_time_in_usec]\n\t[-rtx_scan_all] scan every source for RTO expiry (for validation)\n\t[-packet_stats] print packet memory use by type\n\t[-fct_stats] print flow completion time percentiles" << endl;
     exit(1);
 }
 
@@ -75,6 +77,9 @@ int main(int argc, char **argv) {
     uint32_t no_of_conns = 0, no_of_nodes = DEFAULT_NODES;
     stringstream filename(ios_base::out);
 
+    bool rtx_scan_all = false;
+    bool packet_stats = false;
+    bool fct_stats = false;
     int i = 1;
     filename << "logout.dat";
 
@@ -95,6 +100,16 @@ int main(int argc, char **argv) {
             no_of_nodes = atoi(argv[i+1]);
             cout << "no_of_nodes "<<no_of_nodes << endl;
             i++;
+        } else if (!strcmp(argv[i],"-end")){
+            eventlist.setEndtime(timeFromUs((uint32_t)atoi(argv[i+1])));
+            cout << "endtime(us) " << argv[i+1] << endl;
+            i++;
+        } else if (!strcmp(argv[i],"-rtx_scan_all")){
+            rtx_scan_all = true;
+        } else if (!strcmp(argv[i],"-packet_stats")){
+            packet_stats = true;
+        } else if (!strcmp(argv[i],"-fct_stats")) {
+            fct_stats = true;
         } else if (!strcmp(argv[i], "UNCOUPLED"))
             algo = UNCOUPLED;
         else if (!strcmp(argv[i], "COUPLED_INC"))
@@ -163,6 +178,7 @@ int main(int argc, char **argv) {
     double extrastarttime;
 
     TcpRtxTimerScanner tcpRtxScanner(timeFromMs(10), eventlist);
+    tcpRtxScanner.setScanAll(rtx_scan_all);
    
     MultipathTcpSrc* mtcp;
     
@@ -204,16 +220,12 @@ int main(int argc, char **argv) {
     no_of_nodes = top->no_of_nodes();
     cout << "actual nodes " << no_of_nodes << endl;
 
-    vector<const Route*>*** net_paths;
-    net_paths = new vector<const Route*>**[no_of_nodes];
+    PathStore* net_paths = new PathStore(top, true);
 
     int* is_dest = new int[no_of_nodes];
     
     for (uint32_t i=0;i<no_of_nodes;i++){
         is_dest[i] = 0;
-        net_paths[i] = new vector<const Route*>*[no_of_nodes];
-        for (uint32_t j = 0;j<no_of_nodes;j++)
-            net_paths[i][j] = NULL;
     }
     
     if (ff)
@@ -250,8 +262,7 @@ int main(int argc, char **argv) {
         for (uint32_t dst_id = 0;dst_id<destinations->size();dst_id++){
             connID++;
             dest = destinations->at(dst_id);
-            if (!net_paths[src][dest])
-                net_paths[src][dest] = top->get_paths(src,dest);
+            vector<const Route*>* src_paths = net_paths->get(src,dest);
 
             /*bool cbr = 1;
               if (cbr){
@@ -265,14 +276,14 @@ int main(int argc, char **argv) {
               logfile.writeName(*cbrSnk);
               
               // tell it the route
-              if (net_paths[src][dest]->size()==1){
+              if (src_paths->size()==1){
               choice = 0;
               }
               else {
-              choice = rand()%net_paths[src][dest]->size();
+              choice = rand()%src_paths->size();
               }
               
-              routeout = new Route(*(net_paths[src][dest]->at(choice)));
+              routeout = new Route(*(src_paths->at(choice)));
               routeout->push_back(cbrSnk);
           
               cbrSrc->connect(*routeout, *cbrSnk, timeFromMs(0));
@@ -301,10 +312,10 @@ int main(int argc, char **argv) {
                     tot_subs += crt_subflow_count;
                     cnt_con ++;
 
-                    it_sub = crt_subflow_count > net_paths[src][dest]->size()?net_paths[src][dest]->size():crt_subflow_count;
+                    it_sub = crt_subflow_count > src_paths->size()?src_paths->size():crt_subflow_count;
 
 #ifdef MH_FAT_TREE
-                    int use_all = it_sub==net_paths[src][dest]->size();
+                    int use_all = it_sub==src_paths->size();
 #endif
                     //if (connID%10!=0)
                     //it_sub = 1;
@@ -315,7 +326,7 @@ int main(int argc, char **argv) {
                         tcpSnk = new TcpSink();
                         /*}
                           else {
-                          tcpSrc = new TcpSrcTransfer(NULL,NULL,eventlist,bb,net_paths[src][dest]);
+                          tcpSrc = new TcpSrcTransfer(NULL,NULL,eventlist,bb,src_paths);
                           tcpSnk = new TcpSinkTransfer();
                           }*/
 
@@ -334,10 +345,10 @@ int main(int argc, char **argv) {
                           do {
                           found = 0;
                 
-                          //if (net_paths[src][dest]->size()==K*K/4 && it_sub <= K/2)
+                          //if (src_paths->size()==K*K/4 && it_sub <= K/2)
                           //choice = rand()%(K/2);
                           //else 
-                          choice = rand()%net_paths[src][dest]->size();
+                          choice = rand()%src_paths->size();
                 
                           for (uint32_t cnt = 0;cnt<subflows_chosen.size();cnt++){
                           if (subflows_chosen.at(cnt)==choice){
@@ -350,22 +361,22 @@ int main(int argc, char **argv) {
                         size_t choice = 0;
 
 #ifdef FAT_TREE
-                        choice = rand()%net_paths[src][dest]->size();
+                        choice = rand()%src_paths->size();
 #endif
 
 #ifdef OV_FAT_TREE
-                        choice = rand()%net_paths[src][dest]->size();
+                        choice = rand()%src_paths->size();
 #endif
 
 #ifdef MH_FAT_TREE
                         if (use_all)
                             choice = inter;
                         else
-                            choice = rand()%net_paths[src][dest]->size();
+                            choice = rand()%src_paths->size();
 #endif
 
 #ifdef VL2
-                        choice = rand()%net_paths[src][dest]->size();
+                        choice = rand()%src_paths->size();
 #endif
 
 #ifdef STAR
@@ -378,37 +389,37 @@ int main(int argc, char **argv) {
                         int min = -1, max = -1,minDist = 1000,maxDist = 0;
                         if (subflow_count==1){
                             //find shortest and longest path 
-                            for (uint32_t dd=0;dd<net_paths[src][dest]->size();dd++){
-                                if (net_paths[src][dest]->at(dd)->size()<minDist){
-                                    minDist = net_paths[src][dest]->at(dd)->size();
+                            for (uint32_t dd=0;dd<src_paths->size();dd++){
+                                if (src_paths->at(dd)->size()<minDist){
+                                    minDist = src_paths->at(dd)->size();
                                     min = dd;
                                 }
-                                if (net_paths[src][dest]->at(dd)->size()>maxDist){
-                                    maxDist = net_paths[src][dest]->at(dd)->size();
+                                if (src_paths->at(dd)->size()>maxDist){
+                                    maxDist = src_paths->at(dd)->size();
                                     max = dd;
                                 }
                             }
                             choice = min;
                         } else
-                            choice = rand()%net_paths[src][dest]->size();
+                            choice = rand()%src_paths->size();
 #endif
-                        //cout << "Choice "<<choice<<" out of "<<net_paths[src][dest]->size();
+                        //cout << "Choice "<<choice<<" out of "<<src_paths->size();
                         subflows_chosen.push_back(choice);
 
-                        /*if (net_paths[src][dest]->size()==K*K/4 && it_sub<=K/2){
+                        /*if (src_paths->size()==K*K/4 && it_sub<=K/2){
                           uint32_t choice2 = rand()%(K/2);*/
 
-                        if (choice>=net_paths[src][dest]->size()){
-                            printf("Weird path choice %lu out of %lu\n",choice,net_paths[src][dest]->size());
+                        if (choice>=src_paths->size()){
+                            printf("Weird path choice %lu out of %lu\n",choice,src_paths->size());
                             exit(1);
                         }
                 
 #if PRINT_PATHS
                         paths << "Route from "<< ntoa(src) << " to " << ntoa(dest) << "  (" << choice << ") -> " ;
-                        print_path(paths,net_paths[src][dest]->at(choice));
+                        print_path(paths,src_paths->at(choice));
 #endif
 
-                        routeout = new Route(*(net_paths[src][dest]->at(choice)));
+                        routeout = new Route(*(src_paths->at(choice)));
                         routeout->push_back(tcpSnk);
               
                         routein = new Route();
@@ -427,7 +438,7 @@ int main(int argc, char **argv) {
                         tcpSrc->connect(*routeout, *routein, *tcpSnk, timeFromMs(extrastarttime));
             
 #ifdef PACKET_SCATTER
-                        tcpSrc->set_paths(net_paths[src][dest]);
+                        tcpSrc->set_paths(src_paths);
                         cout << "Using PACKET SCATTER!!!!"<<endl;
 #endif
               
@@ -454,7 +465,15 @@ int main(int argc, char **argv) {
     double rtt = timeAsSec(timeFromUs(RTT));
     logfile.write("# rtt =" + ntoa(rtt));
 
+#ifdef FAT_TREE
+    if (fct_stats)
+        SimContext::current().flowStats().set_ideal(linkspeed, top->diameter_rtt());
+#endif
     // GO!
     while (eventlist.doNextEvent()) {
     }
+    if (fct_stats)
+        SimContext::current().flowStats().report(cout);
+    if (packet_stats)
+        PacketDBStats::print(cout);
 }
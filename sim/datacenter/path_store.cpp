@@ -0,0 +1,54 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "path_store.h"
+
+PathStore::PathStore(Topology* top, bool reverse)
+    : _top(top), _reverse(reverse), _routes(0)
+{
+}
+
+PathStore::~PathStore() {
+    unordered_map<uint64_t, PathEntry>::iterator i;
+    for (i = _entries.begin(); i != _entries.end(); i++) {
+        free_paths(i->second);
+    }
+}
+
+void PathStore::add_ref(uint32_t src, uint32_t dest) {
+    _entries[key(src, dest)]._refcount++;
+}
+
+vector<const Route*>* PathStore::get(uint32_t src, uint32_t dest) {
+    PathEntry& entry = _entries[key(src, dest)];
+    if (!entry._paths) {
+        if (_reverse)
+            entry._paths = _top->get_paths(src, dest);
+        else
+            entry._paths = _top->get_bidir_paths(src, dest, false);
+        _routes += entry._paths->size();
+    }
+    return entry._paths;
+}
+
+void PathStore::release(uint32_t src, uint32_t dest) {
+    unordered_map<uint64_t, PathEntry>::iterator i = _entries.find(key(src, dest));
+    assert(i != _entries.end() && i->second._refcount > 0);
+    i->second._refcount--;
+    if (i->second._refcount == 0) {
+        free_paths(i->second);
+        _entries.erase(i);
+    }
+}
+
+void PathStore::free_paths(PathEntry& entry) {
+    if (!entry._paths)
+        return;
+    vector<const Route*>::iterator i;
+    for (i = entry._paths->begin(); i != entry._paths->end(); i++) {
+        if ((*i)->reverse())
+            delete (*i)->reverse();
+        delete *i;
+    }
+    _routes -= entry._paths->size();
+    delete entry._paths;
+    entry._paths = NULL;
+}
@@ -0,0 +1,57 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef PATH_STORE_H
+#define PATH_STORE_H
+
+/*
+ * PathStore: the source routes between the host pairs a simulation
+ * actually uses.  Replaces the dense no_of_nodes x no_of_nodes
+ * net_paths matrix the datacenter mains used to allocate: only pairs
+ * that have been referenced get an entry, their paths are built from
+ * the topology on first use, and they are freed again once every
+ * connection that referenced them has been set up.
+ */
+
+#include <unordered_map>
+#include "topology.h"
+
+class PathStore {
+public:
+    // reverse selects whether the stored routes carry reverse routes
+    // (Topology::get_paths) or not (get_bidir_paths(...,false)).
+    PathStore(Topology* top, bool reverse);
+    ~PathStore();
+
+    // Note that a connection will use the paths from src to dest.
+    void add_ref(uint32_t src, uint32_t dest);
+
+    // Paths from src to dest, built on the first call.
+    vector<const Route*>* get(uint32_t src, uint32_t dest);
+    bool has_paths(uint32_t src, uint32_t dest) const {
+        unordered_map<uint64_t, PathEntry>::const_iterator i = _entries.find(key(src, dest));
+        return i != _entries.end() && i->second._paths;
+    }
+
+    // Drop a reference taken with add_ref.  The paths are freed when
+    // the last reference goes; routes already copied out stay valid.
+    void release(uint32_t src, uint32_t dest);
+
+    size_t pairs() const {return _entries.size();}
+    size_t routes() const {return _routes;}
+private:
+    struct PathEntry {
+        PathEntry() : _paths(NULL), _refcount(0) {}
+        vector<const Route*>* _paths;
+        int _refcount;
+    };
+    static uint64_t key(uint32_t src, uint32_t dest) {
+        return ((uint64_t)src << 32) | dest;
+    }
+    void free_paths(PathEntry& entry);
+
+    Topology* _top;
+    bool _reverse;
+    unordered_map<uint64_t, PathEntry> _entries;
+    size_t _routes; // routes currently held
+};
+
+#endif
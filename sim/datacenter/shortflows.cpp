@@ -4,7 +4,7 @@
 string ntoa(double n);
 string itoa(uint64_t n);
 
-ShortFlows::ShortFlows(double lambda, EventList& eventlist, vector<const Route*>*** n,
+ShortFlows::ShortFlows(double lambda, EventList& eventlist, PathStore* n,
                        ConnectionMatrix* conns,Logfile* logfile,TcpRtxTimerScanner * rtx)
   : EventSource(eventlist,"ShortFlows")
 {
@@ -19,7 +19,7 @@ ShortFlows::ShortFlows(double lambda, EventList& eventlist, vector<const Route*>
 
 ShortFlow* ShortFlows::createConnection(int src, int dst, simtime_picosec starttime){
     ShortFlow* f = new ShortFlow();
-    f->src = new TcpSrcTransfer(NULL,NULL,eventlist(),70000,net_paths[src][dst]);
+    f->src = new TcpSrcTransfer(NULL,NULL,eventlist(),70000,net_paths->get(src,dst));
     f->snk = new TcpSinkTransfer();
 
     int pos = connections[src][dst].size();
@@ -32,9 +32,9 @@ ShortFlow* ShortFlows::createConnection(int src, int dst, simtime_picosec startt
     
     tcpRtxScanner->registerTcp(*(f->src));
 
-    int choice = rand()%net_paths[src][dst]->size();
+    int choice = rand()%net_paths->get(src,dst)->size();
 
-    Route* routeout = new Route(*(net_paths[src][dst]->at(choice)));
+    Route* routeout = new Route(*(net_paths->get(src,dst)->at(choice)));
     routeout->push_back(f->snk);
     
     Route* routein = new Route();
@@ -11,6 +11,7 @@
 #include <list>
 #include <map>
 #include "connection_matrix.h"
+#include "path_store.h"
 
 struct ShortFlow{
     TcpSrcTransfer* src;
@@ -19,7 +20,7 @@ struct ShortFlow{
 
 class ShortFlows: public EventSource{
 public:
-    ShortFlows(double l, EventList& eventlist, vector<const Route*>*** np, ConnectionMatrix* c,
+    ShortFlows(double l, EventList& eventlist, PathStore* np, ConnectionMatrix* c,
                Logfile* logfile,TcpRtxTimerScanner* r);
     void doNextEvent();
 
@@ -27,7 +28,7 @@ public:
 
 
     ShortFlow* createConnection(int src, int dst, simtime_picosec starttime);
-    vector<const Route*>*** net_paths;
+    PathStore* net_paths;
 private:
     vector<ShortFlow*> connections[1024][1024];
     vector<connection*>* _traffic_matrix;
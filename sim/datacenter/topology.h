@@ -6,6 +6,7 @@
 
 class Topology {
 public:
+    virtual ~Topology() {}
     virtual vector<const Route*>* get_paths(uint32_t src, uint32_t dest) {
         return get_bidir_paths(src, dest, true);
     }
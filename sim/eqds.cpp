@@ -1,6 +1,7 @@
 // -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
 #include <math.h>
 #include "eqds.h"
+#include "flowstats.h"
 #include "eqds_logger.h"
 #include "circular_buffer.h"
 
@@ -10,10 +11,10 @@ using namespace std;
 
 // _path_entropy_size is the number of paths we spray across.  If you don't set it, it will default to all paths.
 uint32_t EqdsSrc::_path_entropy_size = 256;
-int EqdsSrc::_global_node_count = 0;
+thread_local int EqdsSrc::_global_node_count = 0;
 
 /* _min_rto can be tuned using setMinRTO. Don't change it here.  */
-simtime_picosec EqdsSrc::_min_rto = timeFromUs((uint32_t)DEFAULT_EQDS_RTO_MIN);
+thread_local simtime_picosec EqdsSrc::_min_rto = timeFromUs((uint32_t)DEFAULT_EQDS_RTO_MIN);
 
 mem_b EqdsSink::_bytes_unacked_threshold = 16384;
 int EqdsSink::TGT_EV_SIZE = 7;
@@ -23,8 +24,7 @@ EqdsBasePacket::pull_quanta EqdsSink::_credit_per_pull = 8; // uints of typicall
 
 /* this default will be overridden from packet size*/
 uint16_t EqdsSrc::_hdr_size = 64;
-uint16_t EqdsSrc::_mss = 4096;
-uint16_t EqdsSrc::_mtu = _mss + _hdr_size;
+uint16_t EqdsSrc::_default_mtu = 4096 + _hdr_size;
 
 bool EqdsSrc::_debug = false; 
 
@@ -243,21 +243,23 @@ void EqdsNIC::doNextEvent() {
 ////////////////////////////////////////////////////////////////   
 
 EqdsSrc::EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &nic, bool rts) :
-    EventSource(eventList, "eqdsSrc"), _nic(nic), _flow(trafficLogger)
+    EventSource(eventList, "eqdsSrc"), _nic(nic), _rto_timer(*this), _flow(trafficLogger)
 {
     _node_num = _global_node_count++;
     _nodename = "eqdsSrc " + to_string(_node_num);
     _rtx_timeout_pending = false;
     _rtx_timeout = timeInf;
-    _rto_timer_handle = eventlist().nullHandle();
     _rtt = _min_rto;
     _mdev = 0;
     _rto = _min_rto;
     _logger = NULL;
 
+    _mtu = Packet::data_packet_size();
+    _mss = _mtu - _hdr_size;
     _maxwnd = 50 * _mtu;
     _cwnd = _maxwnd;
     _flow_size = 0;
+    _flow_start_time = 0;
     _done_sending = false;
     _backlog = 0;
     _unsent = 0;
@@ -270,6 +272,8 @@ EqdsSrc::EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &ni
     _credit_spec = _maxwnd;
     _in_flight = 0;
     _highest_sent = 0;
+    _oldest_sent = NO_SEQ;
+    _newest_sent = NO_SEQ;
     _send_blocked_on_nic = false;
     _no_of_paths = _path_entropy_size;
     _path_random = rand() % 0xffff; // random upper bits of EV
@@ -292,11 +296,10 @@ EqdsSrc::EqdsSrc(TrafficLogger *trafficLogger, EventList &eventList, EqdsNIC &ni
     
     // by default, end silently
     _end_trigger = 0;
+    _flow_logger = NULL;
 
     _dstaddr = UINT32_MAX;
     _route = NULL;
-    _mtu = Packet::data_packet_size();
-    _mss = _mtu - _hdr_size;
 
     _debug_src = EqdsSrc::_debug;
     //if (_node_num == 490) _debug_src = true; // use this to enable debugging on one flow at a time
@@ -391,20 +394,18 @@ void EqdsSrc::receivePacket(Packet &pkt) {
 }
 
 void EqdsSrc::handleAckno(EqdsDataPacket::seq_t ackno) {
-    auto i = _tx_bitmap.find(ackno);
-    if (i == _tx_bitmap.end())
+    sendRecord* rec = _tx_bitmap.find(ackno);
+    if (!rec)
         return;
-    //mem_b pkt_size = i->second.pkt_size;
-    simtime_picosec send_time = i->second.send_time;
+    simtime_picosec send_time = rec->send_time;
 
     //computeRTO(send_time);
 
-    mem_b pkt_size = i->second.pkt_size;
+    mem_b pkt_size = rec->pkt_size;
     _in_flight -= pkt_size;
     assert(_in_flight >= 0);
     if (_debug_src) cout << _nodename << " handleAck " << ackno << " flow " << _flow.str() << endl;
-    _tx_bitmap.erase(i);
-    _send_times.erase(send_time);
+    eraseSendRecord(ackno);
 
     if (send_time == _rto_send_time) {
         recalculateRTO();
@@ -414,33 +415,30 @@ void EqdsSrc::handleAckno(EqdsDataPacket::seq_t ackno) {
 void EqdsSrc::handleCumulativeAck(EqdsDataPacket::seq_t cum_ack) {
     // free up anything cumulatively acked
     while (!_rtx_queue.empty()) {
-        auto seqno = _rtx_queue.begin()->first;
+        auto seqno = _rtx_queue.first_seq();
 
         if (seqno < cum_ack) {
-            _rtx_queue.erase(_rtx_queue.begin());
+            _rtx_queue.erase(seqno);
         }
         else break;
     }
 
-    auto i = _tx_bitmap.begin();
-    while (i != _tx_bitmap.end()) {
-        auto seqno = i->first;
+    while (!_tx_bitmap.empty()) {
+        auto seqno = _tx_bitmap.first_seq();
         // cumulative ack is next expected packet, not yet received
         if (seqno >= cum_ack) {
             // nothing else acked
             break;
         }
-        mem_b pkt_size = i->second.pkt_size;
-        simtime_picosec send_time = i->second.send_time;
+        mem_b pkt_size = _tx_bitmap.first().pkt_size;
+        simtime_picosec send_time = _tx_bitmap.first().send_time;
 
         //computeRTO(send_time);
 
         _in_flight -= pkt_size;
         assert(_in_flight >= 0);
         if (_debug_src) cout << _nodename << " handleCumAck " << seqno << " flow " << _flow.str() << endl;
-        _tx_bitmap.erase(i);
-        i = _tx_bitmap.begin();
-        _send_times.erase(send_time);
+        eraseSendRecord(seqno);
         if (send_time == _rto_send_time) {
             recalculateRTO();
         }
@@ -465,7 +463,7 @@ bool EqdsSrc::checkFinished(EqdsDataPacket::seq_t cum_ack) {
         cout << _nodename << " checkFinished " << " cum_acc " << cum_ack << " mss " << _mss << " RTS sent " << _rts_packets_sent << " total bytes " << (cum_ack - _rts_packets_sent) * _mss << " flow_size " << _flow_size << " done_sending " << _done_sending << endl;
 
     if ((((mem_b)cum_ack -_rts_packets_sent) * _mss) >= _flow_size) {
-        cout << "Flow " << _name << " flowId " << flowId() << " " << _nodename << " finished at " << timeAsUs(eventlist().now()) << " total packets " << cum_ack << " RTS " << _rts_packets_sent << " total bytes " << ((mem_b)cum_ack - _rts_packets_sent) * _mss << endl;
+        SimContext::current().out() << "Flow " << _name << " flowId " << flowId() << " " << _nodename << " finished at " << timeAsUs(eventlist().now()) << " total packets " << cum_ack << " RTS " << _rts_packets_sent << " total bytes " << ((mem_b)cum_ack - _rts_packets_sent) * _mss << endl;
         _state = IDLE;
         if (_end_trigger) {
             _end_trigger->activate();
@@ -473,6 +471,7 @@ bool EqdsSrc::checkFinished(EqdsDataPacket::seq_t cum_ack) {
         if (_flow_logger) {
             _flow_logger->logEvent(_flow, *this, FlowEventLogger::FINISH, _flow_size, cum_ack);
         }
+        SimContext::current().flowStats().flow_finished(_flow_size, _flow_start_time, eventlist().now());
         _done_sending = true;
         return true;
     }
@@ -531,8 +530,8 @@ void EqdsSrc::processNack(const EqdsNackPacket& pkt) {
     //bool ecn_echo = pkt.ecn_echo();
 
     // move the packet to the RTX queue
-    auto i = _tx_bitmap.find(nacked_seqno);
-    if (i == _tx_bitmap.end()) {
+    sendRecord* rec = _tx_bitmap.find(nacked_seqno);
+    if (!rec) {
         if (_debug_src) 
             cout << "Didn't find NACKed packet in _active_packets flow " << _flow.str() << endl;
 
@@ -544,26 +543,24 @@ void EqdsSrc::processNack(const EqdsNackPacket& pkt) {
         // this can happen when the NACK arrives later than a cumulative ACK covering the NACKed packet.
         //return;
     }
-    mem_b pkt_size = i->second.pkt_size;
+    mem_b pkt_size = rec->pkt_size;
     
     assert(pkt_size >= _hdr_size); // check we're not seeing NACKed RTS packets.
     if (pkt_size == _hdr_size){
         _stats.rts_nacks ++;
     } 
     
-    auto seqno = i->first;
-    simtime_picosec send_time = i->second.send_time;
+    auto seqno = nacked_seqno;
+    simtime_picosec send_time = rec->send_time;
 
     //computeDynamicRTO(send_time);
 
     if (_debug_src) cout << _nodename << " erasing send record, seqno: " << seqno << " flow " << _flow.str() << endl;
-    _tx_bitmap.erase(i);
-    assert(_tx_bitmap.find(seqno) == _tx_bitmap.end()); // xxx remove when working
+    eraseSendRecord(seqno);
 
     _in_flight -= pkt_size;
     assert(_in_flight >= 0);
     
-    _send_times.erase(send_time);
     queueForRtx(seqno, pkt_size);
 
     if (send_time == _rto_send_time) {
@@ -587,7 +584,7 @@ void EqdsSrc::processPull(const EqdsPullPacket& pkt) {
 
 void EqdsSrc::doNextEvent() {
     // a timer event fired.  Can either be a timeout, or the timed start of the flow.
-    if (_rtx_timeout_pending) {
+    if (_rto_timer.expired()) {
         clearRTO();
         assert(_logger == 0);
 
@@ -607,6 +604,7 @@ void EqdsSrc::setFlowsize(uint64_t flow_size_in_bytes) {
 void EqdsSrc::startFlow() {
     _cwnd = _maxwnd;
     _credit_spec = _maxwnd;
+    _flow_start_time = eventlist().now();
     if (_debug_src) cout << "startflow " <<  _flow._name <<  " CWND " << _cwnd << " at " << timeAsUs(eventlist().now()) << " flow " << _flow.str() << endl;
     if (_flow_logger) {
         _flow_logger->logEvent(_flow, *this, FlowEventLogger::START, _flow_size, 0);
@@ -718,7 +716,7 @@ void EqdsSrc::sendIfPermitted() {
         }
         pkt_size = payload_size + _hdr_size;
     } else {
-        pkt_size = _rtx_queue.begin()->second;
+        pkt_size = _rtx_queue.first();
     }
 
 #ifdef USE_CWND
@@ -773,8 +771,7 @@ void EqdsSrc::startRTO(simtime_picosec send_time) {
        
         if (_debug) cout << "Start timer at " << timeAsUs(eventlist().now()) << " source " << _flow.str() << " expires at " << timeAsUs(_rtx_timeout) << " flow " << _flow.str() << endl;
 
-        _rto_timer_handle = eventlist().sourceIsPendingGetHandle(*this, _rtx_timeout);
-        if (_rto_timer_handle == eventlist().nullHandle()) {
+        if (!_rto_timer.arm(_rtx_timeout)) {
             // this happens when _rtx_timeout is past the configured simulation end time.
             _rtx_timeout_pending = false;
             if (_debug) cout << "Cancel timer because too late for flow " << _flow.str() << endl;
@@ -791,7 +788,6 @@ void EqdsSrc::startRTO(simtime_picosec send_time) {
 
 void EqdsSrc::clearRTO() {
     // clear the state
-    _rto_timer_handle = eventlist().nullHandle();
     _rtx_timeout_pending = false;
 
     if (_debug) cout << "Clear RTO " << timeAsUs(eventlist().now()) << " source " << _flow.str() << endl;
@@ -800,7 +796,7 @@ void EqdsSrc::clearRTO() {
 void EqdsSrc::cancelRTO() {
     if (_rtx_timeout_pending) {
         // cancel the timer
-        eventlist().cancelPendingSourceByHandle(*this, _rto_timer_handle);
+        _rto_timer.cancel();
         clearRTO();
     }
 }
@@ -890,8 +886,8 @@ mem_b EqdsSrc::sendNewPacket() {
 
 mem_b EqdsSrc::sendRtxPacket() {
     assert(!_rtx_queue.empty());
-    auto seq_no = _rtx_queue.begin()->first;
-    mem_b full_pkt_size = _rtx_queue.begin()->second;
+    auto seq_no = _rtx_queue.first_seq();
+    mem_b full_pkt_size = _rtx_queue.first();
     bool speculative = false;
     bool can_send = spendCredit(full_pkt_size, speculative);
     assert(!speculative); // I don't think this can happen, but remove this assert if we decide it can
@@ -900,7 +896,7 @@ mem_b EqdsSrc::sendRtxPacket() {
         return 0;
     }
     
-    _rtx_queue.erase(_rtx_queue.begin());
+    _rtx_queue.erase(seq_no);
     _in_flight += full_pkt_size;
     auto *p = EqdsDataPacket::newpkt(_flow, *_route, seq_no, full_pkt_size,
                                      EqdsDataPacket::DATA_RTX, _pull_target, /*unordered=*/true, _dstaddr);
@@ -945,14 +941,35 @@ void EqdsSrc::sendRTS() {
 void EqdsSrc::createSendRecord(EqdsBasePacket::seq_t seqno, mem_b full_pkt_size) {
     //assert(full_pkt_size > 64);
     if (_debug_src) cout << _nodename << " createSendRecord seqno: " << seqno << " size " << full_pkt_size << endl;
-    assert(_tx_bitmap.find(seqno) == _tx_bitmap.end());
-    _tx_bitmap.emplace(seqno, sendRecord(full_pkt_size, eventlist().now()));
-    _send_times.emplace(eventlist().now(), seqno);
+    sendRecord& rec = _tx_bitmap.insert(seqno, sendRecord(full_pkt_size, eventlist().now()));
+    rec.prev_sent = _newest_sent;
+    rec.next_sent = NO_SEQ;
+    if (_newest_sent == NO_SEQ) {
+        _oldest_sent = seqno;
+    } else {
+        _tx_bitmap.find(_newest_sent)->next_sent = seqno;
+    }
+    _newest_sent = seqno;
+}
+
+void EqdsSrc::eraseSendRecord(EqdsBasePacket::seq_t seqno) {
+    sendRecord* rec = _tx_bitmap.find(seqno);
+    assert(rec);
+    if (rec->prev_sent == NO_SEQ) {
+        _oldest_sent = rec->next_sent;
+    } else {
+        _tx_bitmap.find(rec->prev_sent)->next_sent = rec->next_sent;
+    }
+    if (rec->next_sent == NO_SEQ) {
+        _newest_sent = rec->prev_sent;
+    } else {
+        _tx_bitmap.find(rec->next_sent)->prev_sent = rec->prev_sent;
+    }
+    _tx_bitmap.erase(seqno);
 }
 
 void EqdsSrc::queueForRtx(EqdsBasePacket::seq_t seqno, mem_b pkt_size) {
-    assert(_rtx_queue.find(seqno) == _rtx_queue.end());
-    _rtx_queue.emplace(seqno, pkt_size);
+    _rtx_queue.insert(seqno, pkt_size);
     sendIfPermitted();
 }
 
@@ -985,7 +1002,7 @@ void EqdsSrc::timeToSend() {
         full_pkt_size = payload_size + _hdr_size;
     } else {
         // we want to retransmit
-        full_pkt_size = _rtx_queue.begin()->second;
+        full_pkt_size = _rtx_queue.first();
     }
 #ifdef USE_CWND
     if (_cwnd < full_pkt_size) {
@@ -1047,11 +1064,11 @@ void EqdsSrc::recalculateRTO() {
     // we're no longer waiting for the packet we set the timer for -
     // figure out what the timer should be now.
     cancelRTO();
-    if (_send_times.empty()) {
+    if (_oldest_sent == NO_SEQ) {
         // nothing left that we're waiting for
         return;
     }
-    auto earliest_send_time = _send_times.begin()->first;
+    auto earliest_send_time = _tx_bitmap.find(_oldest_sent)->send_time;
     startRTO(earliest_send_time);
 }
 
@@ -1059,19 +1076,14 @@ void EqdsSrc::rtxTimerExpired() {
     assert(eventlist().now() == _rtx_timeout);
     clearRTO();
 
-    auto first_entry = _send_times.begin();
-    assert(first_entry != _send_times.end());
-    auto seqno = first_entry->second;
-
-    auto send_record = _tx_bitmap.find(seqno);
-    assert(send_record != _tx_bitmap.end());
-    mem_b pkt_size = send_record->second.pkt_size;
+    auto seqno = _oldest_sent;
+    assert(seqno != NO_SEQ);
+    mem_b pkt_size = _tx_bitmap.find(seqno)->pkt_size;
 
     //update flightsize?
 
-    _send_times.erase(first_entry);
     if (_debug_src) cout << _nodename << " rtx timer expired for " << seqno << " flow " << _flow.str() << endl;
-    _tx_bitmap.erase(send_record);
+    eraseSendRecord(seqno);
     recalculateRTO();
 
     if (!_rtx_queue.empty()) {
@@ -1159,6 +1171,7 @@ EqdsSink::EqdsSink(TrafficLogger *trafficLogger, EqdsPullPacer* pullPacer, EqdsN
     _stats = {0,0,0,0,0};
     _in_pull = false;
     _in_slow_pull = false;
+    _pacer_rtx = _pacer_active = _pacer_idle = 0;
 }
 
 EqdsSink::EqdsSink(TrafficLogger* trafficLogger, linkspeed_bps linkSpeed, double rate_modifier, uint16_t mtu, EventList &eventList, EqdsNIC& nic) :
@@ -1181,6 +1194,7 @@ EqdsSink::EqdsSink(TrafficLogger* trafficLogger, linkspeed_bps linkSpeed, double
     _stats = {0,0,0,0,0};
     _in_pull = false;
     _in_slow_pull = false;
+    _pacer_rtx = _pacer_active = _pacer_idle = 0;
 } 
 
 void EqdsSink::connect(EqdsSrc* src, Route* route){
@@ -1312,7 +1326,7 @@ void EqdsSink::processTrimmed(const EqdsDataPacket& pkt){
     bool was_retransmitting = _retx_backlog > 0;
 
     //prioritize credits to this sender! Unclear by how much we should increase here. Assume MTU for now.
-    _retx_backlog += EqdsBasePacket::quantize_ceil(EqdsSrc::_mtu);
+    _retx_backlog += EqdsBasePacket::quantize_ceil(_src->mtu());
 
     if (_src->debug()) 
         cout << "RTX_backlog++ trim: " << pkt.epsn() << " from " << getSrc()->nodename() << " rtx_backlog " << rtx_backlog() << " at " << timeAsUs(getSrc()->eventlist().now()) << " flow " << _src->flow()->str() << endl;
@@ -1555,46 +1569,69 @@ EqdsPullPacer::EqdsPullPacer(linkspeed_bps linkSpeed, double pull_rate_modifier,
     _active = false;
 }
 
+uint32_t EqdsPullPacer::_pull_batch = 1;
+
+void EqdsPullPacer::push(SinkQueue& q, uint32_t EqdsSink::*count, EqdsSink* sink) {
+    q.push(sink);
+    (sink->*count)++;
+}
+
+EqdsSink* EqdsPullPacer::pop(SinkQueue& q, uint32_t EqdsSink::*count) {
+    EqdsSink* sink = q.pop();
+    assert(sink->*count > 0);
+    (sink->*count)--;
+    return sink;
+}
+
 void EqdsPullPacer::doNextEvent() {
-    if (_rtx_senders.empty() && _active_senders.empty() && _idle_senders.empty()) {
-        _active = false;
-        return;
+    if (_batch.empty()) {
+        while ((uint32_t)_batch.size() < _pull_batch && havePulls()) {
+            ChosenPull pull = choosePull();
+            _batch.push(pull);
+        }
+        if (_batch.empty()) {
+            _active = false;
+            return;
+        }
     }
+    _active = true;
 
+    sendPull(_batch.pop());
+    eventlist().sourceIsPendingRel(*this, _pktTime);
+}
+
+EqdsPullPacer::ChosenPull EqdsPullPacer::choosePull() {
     EqdsSink* sink = NULL;
     EqdsPullPacket *pullPkt;
 
     if (!_rtx_senders.empty()){
-        sink = _rtx_senders.front();
-        _rtx_senders.pop_front();
+        sink = pop(_rtx_senders, &EqdsSink::_pacer_rtx);
 
         pullPkt = sink->pull();
         if (EqdsSrc::_debug) cout << "PullPacer: RTX: " << sink->getSrc()->nodename() << " rtx_backlog " << sink->rtx_backlog() << " at " << timeAsUs(eventlist().now()) << endl;
         // TODO if more pulls are needed, enqueue again
         if (sink->rtx_backlog()>0)
-            _rtx_senders.push_back(sink);
+            push(_rtx_senders, &EqdsSink::_pacer_rtx, sink);
     }
     else if (!_active_senders.empty()){
-        sink = _active_senders.front();
+        sink = pop(_active_senders, &EqdsSink::_pacer_active);
 
         assert(sink->inPullQueue());
 
-        _active_senders.pop_front();
         pullPkt = sink->pull();
 
         // TODO if more pulls are needed, enqueue again
         if (EqdsSrc::_debug) cout << "PullPacer: Active: " << sink->getSrc()->nodename() << " backlog " << sink->backlog() << " at " << timeAsUs(eventlist().now()) << endl;
         if (sink->backlog()>0)
-            _active_senders.push_back(sink);
+            push(_active_senders, &EqdsSink::_pacer_active, sink);
         else { //this sink has had its demand satisfied, move it to idle senders list.
-            _idle_senders.push_back(sink);
+            push(_idle_senders, &EqdsSink::_pacer_idle, sink);
             sink->removeFromPullQueue();
             sink->addToSlowPullQueue();
         }
     }
     else { //no active senders, we must have at least one idle sender
-        sink = _idle_senders.front();
-        _idle_senders.pop_front();
+        sink = pop(_idle_senders, &EqdsSink::_pacer_idle);
         if(!sink->inSlowPullQueue())
             sink->addToSlowPullQueue();
 
@@ -1605,43 +1642,33 @@ void EqdsPullPacer::doNextEvent() {
         if (sink->backlog() == 0 && sink->slowCredit() < EqdsBasePacket::quantize_floor(sink->getMaxCwnd())){
             //only send upto 1BDP worth of speculative credit.
             //backlog will be negative once this source starts receiving speculative credit. 
-            _idle_senders.push_back(sink);
+            push(_idle_senders, &EqdsSink::_pacer_idle, sink);
         }
         else
             sink->removeFromSlowPullQueue();
     }
 
-    pullPkt->flow().logTraffic(*pullPkt, *this, TrafficLogger::PKT_SEND);
+    ChosenPull pull = {pullPkt, sink};
+    return pull;
+}
 
-    //pullPkt->sendOn();
-    sink->getNIC()->sendControlPacket(pullPkt);
-    _active = true;
+void EqdsPullPacer::sendPull(ChosenPull& pull) {
+    pull.pkt->flow().logTraffic(*pull.pkt, *this, TrafficLogger::PKT_SEND);
 
-    eventlist().sourceIsPendingRel(*this, _pktTime);
+    //pullPkt->sendOn();
+    pull.sink->getNIC()->sendControlPacket(pull.pkt);
 }
 
 bool EqdsPullPacer::isActive(EqdsSink* sink){
-    for (auto i = _active_senders.begin(); i != _active_senders.end(); i++) {
-        if(*i == sink)
-            return true;
-    }
-    return false;
+    return sink->_pacer_active > 0;
 }
 
 bool EqdsPullPacer::isRetransmitting(EqdsSink* sink){
-    for (auto i = _rtx_senders.begin(); i != _rtx_senders.end(); i++) {
-        if(*i == sink)
-            return true;
-    }
-    return false;
+    return sink->_pacer_rtx > 0;
 }
 
 bool EqdsPullPacer::isIdle(EqdsSink* sink){
-    for (auto i = _idle_senders.begin(); i != _idle_senders.end(); i++) {
-        if(*i == sink)
-            return true;
-    }
-    return false;
+    return sink->_pacer_idle > 0;
 }
 
 
@@ -1651,7 +1678,7 @@ void EqdsPullPacer::requestPull(EqdsSink *sink) {
     }
     assert (sink->inPullQueue());
 
-    _active_senders.push_back(sink);
+    push(_active_senders, &EqdsSink::_pacer_active, sink);
     // TODO ack timer
 
     if (!_active) {
@@ -1663,7 +1690,7 @@ void EqdsPullPacer::requestPull(EqdsSink *sink) {
 void EqdsPullPacer::requestRetransmit(EqdsSink *sink) {
     assert (!isRetransmitting(sink));
     
-    _rtx_senders.push_back(sink);
+    push(_rtx_senders, &EqdsSink::_pacer_rtx, sink);
     // TODO ack timer
 
     if (!_active) {
@@ -7,6 +7,7 @@
 #include <list>
 
 #include "eventlist.h"
+#include "timerwheel.h"
 #include "trigger.h"
 #include "eqdspacket.h"
 #include "circular_buffer.h"
@@ -33,6 +34,98 @@ class ModularVector {
 };
 
 static const unsigned eqdsMaxInFlightPkts = 1 << 12;
+
+// Per-packet state for a window of sequence numbers, indexed by seqno
+// modulo a power-of-2 capacity.  Insert, find and erase are O(1) and
+// allocation-free; the capacity only doubles if the window between
+// the lowest and highest entries outgrows it.  The lowest entry is
+// tracked so it can be read in O(1), as begin() of a map.  No space
+// is allocated until the first insert, as many flows never send.
+template <typename T>
+class SeqRing {
+public:
+    typedef uint64_t seq_t;
+    SeqRing(unsigned initial_size = 16) : _initial_size(initial_size), _base(0), _top(0), _count(0) {
+        assert(initial_size && !(initial_size & (initial_size - 1)));
+    }
+
+    bool empty() const {return _count == 0;}
+    size_t size() const {return _count;}
+
+    T* find(seq_t seq) {
+        if (_count == 0 || seq < _base || seq >= _top)
+            return NULL;
+        Slot& s = slot(seq);
+        return s.used ? &s.value : NULL;
+    }
+    T& insert(seq_t seq, const T& value) {
+        if (_slots.empty())
+            _slots.resize(_initial_size);
+        if (_count == 0) {
+            _base = seq;
+            _top = seq + 1;
+        } else {
+            seq_t base = seq < _base ? seq : _base;
+            seq_t top = seq >= _top ? seq + 1 : _top;
+            if (top - base > _slots.size())
+                grow(top - base);
+            _base = base;
+            _top = top;
+        }
+        Slot& s = slot(seq);
+        assert(!s.used);
+        s.used = true;
+        s.value = value;
+        _count++;
+        return s.value;
+    }
+    void erase(seq_t seq) {
+        Slot& s = slot(seq);
+        assert(seq >= _base && seq < _top && s.used);
+        s.used = false;
+        _count--;
+        if (_count == 0) {
+            _base = _top;
+        } else if (seq == _base) {
+            // each slot is only skipped once as the window moves up
+            while (!slot(_base).used)
+                _base++;
+        }
+    }
+
+    // the entry with the lowest seqno
+    seq_t first_seq() const {assert(_count > 0); return _base;}
+    T& first() {assert(_count > 0); return slot(_base).value;}
+
+private:
+    struct Slot {
+        Slot() : used(false) {}
+        T value;
+        bool used;
+    };
+    Slot& slot(seq_t seq) {return _slots[seq & (_slots.size() - 1)];}
+    const Slot& slot(seq_t seq) const {return _slots[seq & (_slots.size() - 1)];}
+
+    void grow(seq_t span) {
+        size_t size = _slots.size();
+        while (size < span)
+            size *= 2;
+        vector<Slot> old(size);
+        old.swap(_slots);
+        for (seq_t seq = _base; seq < _top; seq++) {
+            Slot& s = old[seq & (old.size() - 1)];
+            if (s.used)
+                slot(seq) = s;
+        }
+    }
+
+    vector<Slot> _slots;
+    unsigned _initial_size;
+    seq_t _base; // lowest entry, if there are any
+    seq_t _top;  // above the highest entry
+    size_t _count;
+};
+
 class EqdsPullPacer;
 class EqdsSink;
 class EqdsSrc;
@@ -98,11 +191,13 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
     virtual void activate();
 
     static uint32_t _path_entropy_size; // now many paths do we include in our path set
-    static int _global_node_count;
-    static simtime_picosec _min_rto;
+    // per-thread, so simulations on different threads can differ
+    static thread_local int _global_node_count;
+    static thread_local simtime_picosec _min_rto;
     static uint16_t _hdr_size;
-    static uint16_t _mss; // does not include header
-    static uint16_t _mtu; // does include header
+    // the MTU before any source has set its own from the packet size
+    static uint16_t _default_mtu;
+    uint16_t mtu() const {return _mtu;}
     
     virtual const string& nodename() { return _nodename; }
     inline void setFlowId(flowid_t flow_id) { _flow.set_flowid(flow_id);}
@@ -125,12 +220,16 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
    
  private:
     EqdsNIC& _nic;
+    uint16_t _mss; // does not include header
+    uint16_t _mtu; // does include header
     struct sendRecord {
-        // need a constructor to be able to put this in a map
+        sendRecord() {}
         sendRecord(mem_b psize, simtime_picosec stime) :
             pkt_size(psize), send_time(stime) {};
         mem_b pkt_size;
         simtime_picosec send_time;
+        // send order of the records still in flight, by seqno
+        EqdsDataPacket::seq_t prev_sent, next_sent;
     };
     EqdsLogger* _logger;
     TrafficLogger* _pktlogger;
@@ -140,11 +239,16 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
     // TODO in-flight packet storage - acks and sacks clear it
     //list<EqdsDataPacket*> _activePackets;
 
-    // we need to access the in_flight packet list quickly by sequence number, or by send time.
-    map <EqdsDataPacket::seq_t, sendRecord> _tx_bitmap;
-    map <simtime_picosec, EqdsDataPacket::seq_t> _send_times;
-    
-    map <EqdsDataPacket::seq_t, mem_b> _rtx_queue;
+    // we need to access the in_flight packet list quickly by sequence
+    // number, or by send time.  Records are sent in time order, so
+    // the send time order is a list threaded through _tx_bitmap, from
+    // _oldest_sent to _newest_sent.
+    static const EqdsDataPacket::seq_t NO_SEQ = UINT64_MAX;
+    SeqRing<sendRecord> _tx_bitmap;
+    EqdsDataPacket::seq_t _oldest_sent, _newest_sent;
+    void eraseSendRecord(EqdsDataPacket::seq_t seqno);
+
+    SeqRing<mem_b> _rtx_queue;
     void startFlow();
     bool isSpeculative();
     uint16_t nextEntropy();
@@ -162,10 +266,7 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
 
     // not used, except for debugging timer issues
     void checkRTO() {
-        if (_rtx_timeout_pending )
-            assert(_rto_timer_handle != eventlist().nullHandle());
-        else
-            assert(_rto_timer_handle == eventlist().nullHandle());
+        assert(_rtx_timeout_pending == _rto_timer.pending());
     }
     
     void rtxTimerExpired();
@@ -184,6 +285,7 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
 
     // unlike in the NDP simulator, we maintain all the main quantities in bytes
     mem_b _flow_size;
+    simtime_picosec _flow_start_time;
     bool _done_sending; // make sure we only trigger once
     mem_b _backlog; // how much we need to send, including retransmissions
     mem_b _unsent;  // how much new stuff we need to send, ignoring retransmissions
@@ -215,7 +317,7 @@ class EqdsSrc : public EventSource, public PacketSink, public TriggerTarget {
     simtime_picosec _rto_send_time; // when we sent the oldest packet that the RTO is waiting on.
     simtime_picosec _rtx_timeout; // when the RTO is currently set to expire
     simtime_picosec _last_rts;  // time when we last sent an RTS (or zero if never sent)
-    EventList::Handle _rto_timer_handle;
+    Timer _rto_timer;
 
     simtime_picosec _last_credit_move;
 
@@ -321,6 +423,10 @@ private:
     bool _in_pull;//this tunnel is in the pull queue.
     bool _in_slow_pull;//this tunnel is in the slow pull queue.
 
+    // how many times we're queued in each of the pacer's queues
+    friend class EqdsPullPacer;
+    uint32_t _pacer_rtx, _pacer_active, _pacer_idle;
+
     const Route* _route;
 
     mem_b _received_bytes;
@@ -339,17 +445,40 @@ private:
     string _nodename;
 };
 
+// A sink can be queued more than once: it can ask for pulls again
+// while still on the idle list.  Each sink counts its own entries, so
+// checking whether it's queued doesn't search the queues.
 class EqdsPullPacer : public EventSource {
-    list<EqdsSink*> _rtx_senders; // TODO priorities?
-    list<EqdsSink*> _active_senders; // TODO priorities?
-    list<EqdsSink*> _idle_senders; // TODO priorities?
+    typedef CircularBuffer<EqdsSink*> SinkQueue;
+    SinkQueue _rtx_senders; // TODO priorities?
+    SinkQueue _active_senders; // TODO priorities?
+    SinkQueue _idle_senders; // TODO priorities?
 
     const simtime_picosec _pktTime;
     bool _active;
 
+    // pulls already chosen, each waiting for its own slot
+    struct ChosenPull {
+        EqdsPullPacket* pkt;
+        EqdsSink* sink;
+    };
+    CircularBuffer<ChosenPull> _batch;
+    static uint32_t _pull_batch;
+
+    void push(SinkQueue& q, uint32_t EqdsSink::*count, EqdsSink* sink);
+    EqdsSink* pop(SinkQueue& q, uint32_t EqdsSink::*count);
+    bool havePulls() {return !(_rtx_senders.empty() && _active_senders.empty() && _idle_senders.empty());}
+    ChosenPull choosePull();
+    void sendPull(ChosenPull& pull);
+
  public:
     EqdsPullPacer(linkspeed_bps linkSpeed, double pull_rate_modifier, uint16_t mtu, EventList &eventList);
     void doNextEvent() ;
+    // Choose up to this many pulls at a time, rather than one per
+    // event.  Each is still sent in its own slot, a pull time apart,
+    // so only the choice of which senders get pulled is made early.
+    // Default 1.
+    static void setPullBatch(uint32_t batch) {assert(batch > 0); _pull_batch = batch;}
     void requestPull(EqdsSink *sink);
     void requestRetransmit(EqdsSink *sink);
 
@@ -1,10 +1,10 @@
 #include "eqdspacket.h"
 
-PacketDB<EqdsDataPacket> EqdsDataPacket::_packetdb;
-PacketDB<EqdsAckPacket> EqdsAckPacket::_packetdb;
-PacketDB<EqdsNackPacket> EqdsNackPacket::_packetdb;
-PacketDB<EqdsPullPacket> EqdsPullPacket::_packetdb;
-PacketDB<EqdsRtsPacket> EqdsRtsPacket::_packetdb;
+thread_local PacketDB<EqdsDataPacket> EqdsDataPacket::_packetdb;
+thread_local PacketDB<EqdsAckPacket> EqdsAckPacket::_packetdb;
+thread_local PacketDB<EqdsNackPacket> EqdsNackPacket::_packetdb;
+thread_local PacketDB<EqdsPullPacket> EqdsPullPacket::_packetdb;
+thread_local PacketDB<EqdsRtsPacket> EqdsRtsPacket::_packetdb;
 
 EqdsBasePacket::pull_quanta
 EqdsBasePacket::quantize_floor(mem_b bytes) {
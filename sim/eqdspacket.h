@@ -75,7 +75,7 @@ public:
         //only change the IP packet size, not the approximate one in the EQDS header. 
         Packet::_size = ACKSIZE;
         _trim_hop = _nexthop;
-        _trim_direction = _direction;
+        _trim_direction = get_direction();
     };
 
     virtual inline void set_route(const Route &route) {
@@ -138,7 +138,7 @@ protected:
     //trim information, need to see if this stays here or goes to separate header.
     int32_t _trim_hop;
     packet_direction _trim_direction;
-    static PacketDB<EqdsDataPacket> _packetdb;
+    static thread_local PacketDB<EqdsDataPacket> _packetdb;
 };
 
 class EqdsPullPacket : public EqdsBasePacket {
@@ -182,7 +182,7 @@ protected:
 
     bool _rnr;
 
-    static PacketDB<EqdsPullPacket> _packetdb;
+    static thread_local PacketDB<EqdsPullPacket> _packetdb;
 };
 
 class EqdsAckPacket : public EqdsBasePacket {
@@ -236,7 +236,7 @@ protected:
     bool _ecn_echo;
     simtime_picosec _residency_time;
 
-    static PacketDB<EqdsAckPacket> _packetdb;
+    static thread_local PacketDB<EqdsAckPacket> _packetdb;
 };
 
 class EqdsNackPacket : public EqdsBasePacket {
@@ -280,7 +280,7 @@ protected:
     uint16_t _ev;
     bool _rnr;
     bool _ecn_echo;
-    static PacketDB<EqdsNackPacket> _packetdb;
+    static thread_local PacketDB<EqdsNackPacket> _packetdb;
 };
 
 class EqdsRtsPacket : public EqdsDataPacket {
@@ -321,7 +321,7 @@ protected:
     pull_quanta _retx_backlog;
     bool _to;
 
-    static PacketDB<EqdsRtsPacket> _packetdb;
+    static thread_local PacketDB<EqdsRtsPacket> _packetdb;
 };
 
 #endif
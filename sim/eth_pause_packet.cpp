@@ -1,4 +1,4 @@
 #include "eth_pause_packet.h"
 
-PacketDB<EthPausePacket> EthPausePacket::_packetdb;
+thread_local PacketDB<EthPausePacket> EthPausePacket::_packetdb;
 
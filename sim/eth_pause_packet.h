@@ -23,7 +23,7 @@ class EthPausePacket : public Packet {
         p->_sleepTime = sleep;
         p->_senderID = senderid;
         p->_size = PAUSESIZE;
-        p->_flow = &(Packet::_defaultFlow);
+        p->_flow = &(Packet::defaultFlow());
         return p;
     }
   
@@ -36,7 +36,7 @@ class EthPausePacket : public Packet {
  protected:
     uint32_t _sleepTime;
     uint32_t _senderID;
-    static PacketDB<EthPausePacket> _packetdb;
+    static thread_local PacketDB<EthPausePacket> _packetdb;
 };
 
 #endif
@@ -2,40 +2,118 @@
 
 #include "eventlist.h"
 #include "trigger.h"
-
-simtime_picosec EventList::_endtime = 0;
-simtime_picosec EventList::_lasteventtime = 0;
-EventList::pendingsources_t EventList::_pendingsources;
-vector <TriggerTarget*> EventList::_pending_triggers;
-int EventList::_instanceCount = 0;
-EventList* EventList::_theEventList = nullptr;
+#include <fstream>
+#include <stdlib.h>
+#include <sys/resource.h>
+#ifdef EVENT_PROFILE
+#include "eventprofiler.h"
+#endif
 
 EventList::EventList()
 {
-    if (EventList::_instanceCount != 0) 
+    _context = &SimContext::current();
+    if (_context->_eventlist != nullptr) 
     {
-        std::cerr << "There should be only one instance of EventList. Abort." << std::endl;
+        std::cerr << "There should be only one instance of EventList per simulation. Abort." << std::endl;
         abort();
     }
+    _context->_eventlist = this;
+
+    _endtime = 0;
+    _lasteventtime = 0;
+    _lasteventorder = 0;
+    _pendingsources = new CalendarEventQueue();
+    _observer = NULL;
+    _events = 0;
+    _created = _first_event = std::chrono::steady_clock::now();
+#ifdef EVENT_PROFILE
+    _profiler = new EventProfiler();
+#else
+    _profiler = NULL;
+#endif
+}
+
+EventList::~EventList()
+{
+    if (_context->_eventlist == this)
+        _context->_eventlist = nullptr;
+    delete _pendingsources;
+#ifdef EVENT_PROFILE
+    _profiler->report(cout);
+    delete _profiler;
+#endif
+
+    // If HTSIM_STATS names a file, append a one-line JSON summary of
+    // the run to it, for benchmarking (see tests/bench.py).  Setup is
+    // the wall time from creating the EventList to the first event.
+    const char* stats = getenv("HTSIM_STATS");
+    if (stats && *stats) {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (_events == 0)
+            _first_event = end;
+        double setup = std::chrono::duration<double>(_first_event - _created).count();
+        double run = std::chrono::duration<double>(end - _first_event).count();
+        // events scheduled before setEndtime() can still run after the end
+        simtime_picosec simulated = _lasteventtime;
+        if (_endtime && simulated > _endtime)
+            simulated = _endtime;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        ofstream out(stats, ios_base::app);
+        out << "{\"events\": " << _events
+            << ", \"sim_s\": " << timeAsSec(simulated)
+            << ", \"setup_s\": " << setup
+            << ", \"run_s\": " << run;
+        for (size_t i = 0; i < _stats.size(); i++)
+            out << ", \"" << _stats[i].first << "\": " << _stats[i].second;
+        out << ", \"peak_rss_kb\": " << usage.ru_maxrss << "}" << endl;
+    }
+}
 
-    EventList::_theEventList = this;
-    EventList::_instanceCount += 1;
+void
+EventList::setStat(const string& name, uint64_t value)
+{
+    for (size_t i = 0; i < _stats.size(); i++) {
+        if (_stats[i].first == name) {
+            _stats[i].second = value;
+            return;
+        }
+    }
+    _stats.push_back(make_pair(name, value));
 }
 
 EventList& 
 EventList::getTheEventList()
 {
-    if (EventList::_theEventList == nullptr) 
+    SimContext& context = SimContext::current();
+    if (context._eventlist == nullptr) 
     {
-        EventList::_theEventList = new EventList();
+        new EventList();
+    }
+    return *context._eventlist;
+}
+
+void
+EventList::setQueueType(queue_type_t type)
+{
+    EventQueue* q = NULL;
+    switch (type) {
+    case CALENDAR_QUEUE:
+        q = new CalendarEventQueue();
+        break;
+    case MAP_QUEUE:
+        q = new MapEventQueue();
+        break;
     }
-    return *EventList::_theEventList;
+    _pendingsources->moveTo(*q);
+    delete _pendingsources;
+    _pendingsources = q;
 }
 
 void
 EventList::setEndtime(simtime_picosec endtime)
 {
-    EventList::_endtime = endtime;
+    _endtime = endtime;
 }
 
 bool
@@ -46,29 +124,57 @@ EventList::doNextEvent()
     if (!_pending_triggers.empty()) {
         TriggerTarget *target = _pending_triggers.back();
         _pending_triggers.pop_back();
+#ifdef EVENT_PROFILE
+        _profiler->trigger();
+#endif
         target->activate();
         return true;
     }
     
-    if (_pendingsources.empty())
+    if (_pendingsources->empty())
         return false;
     
-    simtime_picosec nexteventtime = _pendingsources.begin()->first;
-    EventSource* nextsource = _pendingsources.begin()->second;
-    _pendingsources.erase(_pendingsources.begin());
+    simtime_picosec nexteventtime;
+    EventSource* nextsource = _pendingsources->pop(nexteventtime, _lasteventorder);
     assert(nexteventtime >= _lasteventtime);
     _lasteventtime = nexteventtime; // set this before calling doNextEvent, so that this::now() is accurate
+    if (_events++ == 0)
+        _first_event = std::chrono::steady_clock::now();
+    if (_observer)
+        _observer->eventDispatched(*nextsource, nexteventtime);
+#ifdef EVENT_PROFILE
+    EventProfiler::timer_t started = _profiler->start(*nextsource, nexteventtime, _pendingsources->size());
+    nextsource->doNextEvent();
+    _profiler->stop(started);
+#else
     nextsource->doNextEvent();
+#endif
     return true;
 }
 
+bool
+EventList::doNextEvent(simtime_picosec before)
+{
+    if (_pending_triggers.empty() && nextEventTime() >= before)
+        return false;
+    return doNextEvent();
+}
+
+simtime_picosec
+EventList::nextEventTime() const
+{
+    if (!_pending_triggers.empty())
+        return _lasteventtime;
+    EventQueue::Event* ev = _pendingsources->peek();
+    return ev ? ev->time : UINT64_MAX;
+}
 
 void 
 EventList::sourceIsPending(EventSource &src, simtime_picosec when) 
 {
     assert(when>=now());
     if (_endtime==0 || when<_endtime)
-        _pendingsources.insert(make_pair(when,&src));
+        _pendingsources->insert(when, &src);
 }
 
 EventList::Handle
@@ -76,10 +182,21 @@ EventList::sourceIsPendingGetHandle(EventSource &src, simtime_picosec when)
 {
     assert(when>=now());
     if (_endtime==0 || when<_endtime) {
-        EventList::Handle handle =_pendingsources.insert(make_pair(when,&src));
+        EventList::Handle handle = _pendingsources->insert(when, &src);
+        return handle;
+    }
+    return nullHandle();
+}
+
+EventList::Handle
+EventList::sourceIsPendingGetHandle(EventSource &src, simtime_picosec when, uint64_t order) 
+{
+    assert(when>=now());
+    if (_endtime==0 || when<_endtime) {
+        EventList::Handle handle = _pendingsources->insert(when, &src, order);
         return handle;
     }
-    return _pendingsources.end();
+    return nullHandle();
 }
 
 void
@@ -89,14 +206,10 @@ EventList::triggerIsPending(TriggerTarget &target) {
 
 void 
 EventList::cancelPendingSource(EventSource &src) {
-    pendingsources_t::iterator i = _pendingsources.begin();
-    while (i != _pendingsources.end()) {
-        if (i->second == &src) {
-            _pendingsources.erase(i);
-            return;
-        }
-        i++;
-    }
+    // slow: this has to search all pending events
+    EventList::Handle handle = _pendingsources->find(&src);
+    if (handle)
+        _pendingsources->erase(handle);
 }
 
 void 
@@ -104,15 +217,10 @@ EventList::cancelPendingSourceByTime(EventSource &src, simtime_picosec when) {
     // fast cancellation of a timer - the timer MUST exist
     // this should normally be fast, except if we have a lot of events with exactly the same time value
 
-    auto range = _pendingsources.equal_range(when);
-
-    for (auto i = range.first; i != range.second; ++i) {
-        if (i->second == &src) {
-            _pendingsources.erase(i);
-            return;
-        }
-    }
-    abort();
+    EventList::Handle handle = _pendingsources->find(&src, when);
+    if (!handle)
+        abort();
+    _pendingsources->erase(handle);
 }
 
 
@@ -120,11 +228,11 @@ void EventList::cancelPendingSourceByHandle(EventSource &src, EventList::Handle
     // If we're cancelling timers often, cancel them by handle.  But
     // be careful - cancelling a handle that has already been
     // cancelled or has already expired is undefined behaviour
-    assert(handle->second == &src);
-    assert(handle != _pendingsources.end());
-    assert(handle->first >= now());
+    assert(handle != nullHandle());
+    assert(handle->src == &src);
+    assert(handle->time >= now());
     
-    _pendingsources.erase(handle);
+    _pendingsources->erase(handle);
 }
 
 void 
@@ -3,12 +3,15 @@
 #define EVENTLIST_H
 
 #include <map>
+#include <chrono>
 #include <sys/time.h>
 #include "config.h"
 #include "loggertypes.h"
+#include "eventqueue.h"
 
 class EventList;
 class TriggerTarget;
+class EventProfiler;
 
 class EventSource : public Logged {
 public:
@@ -21,40 +24,76 @@ protected:
     EventList& _eventlist;
 };
 
+// Sees every event as it's dispatched, for analysis.  Costs a little
+// on every event, so there's normally no observer.
+class EventObserver {
+public:
+    virtual ~EventObserver() {}
+    virtual void eventDispatched(EventSource& src, simtime_picosec when) = 0;
+};
+
 class EventList {
 public:
-    typedef multimap <simtime_picosec, EventSource*>::iterator Handle;
+    typedef EventQueue::Event* Handle;
+    // which data structure holds pending events.  Both give identical event ordering.
+    enum queue_type_t {CALENDAR_QUEUE, MAP_QUEUE};
+    // There's one EventList per simulation, see SimContext
     EventList();
-    static void setEndtime(simtime_picosec endtime); // end simulation at endtime (rather than forever)
-    static bool doNextEvent(); // returns true if it did anything, false if there's nothing to do
-    static void sourceIsPending(EventSource &src, simtime_picosec when);
-    static Handle sourceIsPendingGetHandle(EventSource &src, simtime_picosec when);
-    static void sourceIsPendingRel(EventSource &src, simtime_picosec timefromnow)
-    { sourceIsPending(src, EventList::now()+timefromnow); }
-    static void cancelPendingSource(EventSource &src);
+    ~EventList();
+    void setQueueType(queue_type_t type); // pending events are kept, but handles become invalid
+    void setEndtime(simtime_picosec endtime); // end simulation at endtime (rather than forever)
+    simtime_picosec endtime() const {return _endtime;}
+    bool doNextEvent(); // returns true if it did anything, false if there's nothing to do
+    // as doNextEvent(), but leaves events at or after before pending
+    bool doNextEvent(simtime_picosec before);
+    // time of the earliest pending event; UINT64_MAX if there are none
+    simtime_picosec nextEventTime() const;
+    void sourceIsPending(EventSource &src, simtime_picosec when);
+    Handle sourceIsPendingGetHandle(EventSource &src, simtime_picosec when);
+    // Reserve a place in the ordering of events that happen at the
+    // same time, and schedule an event later as if it had been
+    // scheduled when the order was reserved.  Used by TimerWheel so
+    // timers fire in the same order as if they'd been scheduled directly.
+    uint64_t reserveOrder() {return _pendingsources->reserveSeq();}
+    Handle sourceIsPendingGetHandle(EventSource &src, simtime_picosec when, uint64_t order);
+    void sourceIsPendingRel(EventSource &src, simtime_picosec timefromnow)
+    { sourceIsPending(src, now()+timefromnow); }
+    void cancelPendingSource(EventSource &src);
     // optimized cancel, if we know the expiry time
-    static void cancelPendingSourceByTime(EventSource &src, simtime_picosec when);   
+    void cancelPendingSourceByTime(EventSource &src, simtime_picosec when);   
     // optimized cancel by handle - be careful to ensure handle is still valid
-    static void cancelPendingSourceByHandle(EventSource &src, Handle handle);       
-    static void reschedulePendingSource(EventSource &src, simtime_picosec when);
-    static void triggerIsPending(TriggerTarget &target);
-    static inline simtime_picosec now() {return EventList::_lasteventtime;}
-    static Handle nullHandle() {return _pendingsources.end();}
+    void cancelPendingSourceByHandle(EventSource &src, Handle handle);       
+    void reschedulePendingSource(EventSource &src, simtime_picosec when);
+    void triggerIsPending(TriggerTarget &target);
+    void setObserver(EventObserver* observer) {_observer = observer;}
+    inline simtime_picosec now() const {return _lasteventtime;}
+    // order of the event currently being processed, see reserveOrder()
+    inline uint64_t currentOrder() const {return _lasteventorder;}
+    static Handle nullHandle() {return NULL;}
+    // events dispatched so far (not counting triggers)
+    uint64_t eventsDispatched() const {return _events;}
+    // add a figure to the $HTSIM_STATS run summary, replacing any of the same name
+    void setStat(const string& name, uint64_t value);
 
 
+    // the current simulation's EventList
     static EventList& getTheEventList();
     EventList(const EventList&)      = delete;  // disable Copy Constructor
     void operator=(const EventList&) = delete;  // disable Assign Constructor
 
 private:
-    static simtime_picosec _endtime;
-    static simtime_picosec _lasteventtime;
-    typedef multimap <simtime_picosec, EventSource*> pendingsources_t;
-    static pendingsources_t _pendingsources;
-    static vector <TriggerTarget*> _pending_triggers;
-
-    static int _instanceCount;
-    static EventList* _theEventList;
+    simtime_picosec _endtime;
+    simtime_picosec _lasteventtime;
+    uint64_t _lasteventorder;
+    EventQueue* _pendingsources;
+    vector <TriggerTarget*> _pending_triggers;
+    EventObserver* _observer;
+    EventProfiler* _profiler; // only with -DEVENT_PROFILE
+    // for the run summary written to $HTSIM_STATS, see ~EventList()
+    uint64_t _events;
+    std::chrono::steady_clock::time_point _created, _first_event;
+    vector<pair<string, uint64_t> > _stats;
+    SimContext* _context;
 };
 
 #endif
@@ -0,0 +1,97 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "eventprofiler.h"
+#include "eventlist.h"
+#include <cxxabi.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <typeinfo>
+#include <algorithm>
+#include <iomanip>
+
+EventProfiler::EventProfiler(simtime_picosec sample_period)
+    : _current(NULL), _triggers(0), _sample_period(sample_period), _next_sample(0),
+      _max_pending(0), _pending_sum(0)
+{
+    assert(_sample_period > 0);
+}
+
+uint32_t EventProfiler::lookup(vector<Stats>& stats, unordered_map<string, uint32_t>& index,
+                               const string& name) {
+    unordered_map<string, uint32_t>::iterator i = index.find(name);
+    if (i != index.end())
+        return i->second;
+    index[name] = stats.size();
+    stats.push_back(Stats(name));
+    return stats.size() - 1;
+}
+
+EventProfiler::SourceEntry& EventProfiler::add_source(EventSource& src) {
+    const char* mangled = typeid(src).name();
+    int status;
+    char* demangled = abi::__cxa_demangle(mangled, NULL, NULL, &status);
+    string type = status == 0 ? demangled : mangled;
+    free(demangled);
+
+    // names look like "Queue(...)", "eqds_src_12" or "Switch_LowerPod_3"
+    const string& name = src.str();
+    size_t len = 0;
+    while (len < name.size() && isalpha(name[len]))
+        len++;
+    string prefix = len ? name.substr(0, len) : "(unnamed)";
+
+    SourceEntry e;
+    e._type = lookup(_types, _type_index, type);
+    e._prefix = lookup(_prefixes, _prefix_index, prefix);
+    return _sources[&src] = e;
+}
+
+static bool by_time(const pair<string, pair<uint64_t, uint64_t> >& a,
+                    const pair<string, pair<uint64_t, uint64_t> >& b) {
+    return a.second.second > b.second.second;
+}
+
+void EventProfiler::report_table(ostream& out, const char* title, const vector<Stats>& stats) const {
+    vector<pair<string, pair<uint64_t, uint64_t> > > rows;
+    uint64_t events = 0, ns = 0;
+    for (size_t i = 0; i < stats.size(); i++) {
+        rows.push_back(make_pair(stats[i]._name, make_pair(stats[i]._events, stats[i]._ns)));
+        events += stats[i]._events;
+        ns += stats[i]._ns;
+    }
+    sort(rows.begin(), rows.end(), by_time);
+    out << "Event profile by " << title << ": " << events << " events, "
+        << ns / 1e9 << "s in handlers" << endl;
+    out << setw(12) << "events" << setw(8) << "%" << setw(12) << "ms" << setw(8) << "%"
+        << setw(10) << "ns/event" << "  " << title << endl;
+    for (size_t i = 0; i < rows.size(); i++) {
+        uint64_t ev = rows[i].second.first, t = rows[i].second.second;
+        out << setw(12) << ev
+            << setw(8) << fixed << setprecision(2) << (events ? 100.0 * ev / events : 0)
+            << setw(12) << setprecision(1) << t / 1e6
+            << setw(8) << setprecision(2) << (ns ? 100.0 * t / ns : 0)
+            << setw(10) << setprecision(0) << (ev ? (double)t / ev : 0)
+            << "  " << rows[i].first << endl;
+    }
+    out.unsetf(ios_base::floatfield);
+    out << setprecision(6);
+}
+
+void EventProfiler::report(ostream& out) const {
+    report_table(out, "class", _types);
+    report_table(out, "name prefix", _prefixes);
+    uint64_t events = 0;
+    for (size_t i = 0; i < _types.size(); i++)
+        events += _types[i]._events;
+    out << "Triggers: " << _triggers << endl;
+    out << "Pending events: max " << _max_pending
+        << " mean " << (events ? (double)_pending_sum / events : 0) << endl;
+
+    // at most 20 evenly spaced rows of the depth samples
+    size_t step = (_samples.size() + 19) / 20;
+    if (step == 0)
+        return;
+    out << "Pending events over time (us depth):";
+    for (size_t i = 0; i < _samples.size(); i += step)
+        out << " " << timeAsUs(_samples[i].first) << " " << _samples[i].second;
+    out << endl;
+}
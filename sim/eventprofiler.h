@@ -0,0 +1,95 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef EVENTPROFILER_H
+#define EVENTPROFILER_H
+
+/*
+ * Attributes events and the wall-clock time spent handling them to
+ * each EventSource class (Queue, Pipe, EqdsNIC, ...) and to each name
+ * prefix (the leading letters of the source's name), and samples the
+ * depth of the pending event queue over simulated time.  EventList
+ * reports on destruction.
+ *
+ * Only used when htsim is built with -DEVENT_PROFILE (see the
+ * Makefile); otherwise EventList never creates one and dispatch costs
+ * nothing extra.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "config.h"
+
+class EventSource;
+
+class EventProfiler {
+public:
+    // depth samples are taken every sample_period of simulated time
+    EventProfiler(simtime_picosec sample_period = timeFromUs((uint32_t)100));
+
+    typedef std::chrono::steady_clock::time_point timer_t;
+
+    // around each dispatch: start() before the source's doNextEvent(), stop() after
+    inline timer_t start(EventSource& src, simtime_picosec when, size_t pending) {
+        _current = &entry(src);
+        if (pending > _max_pending)
+            _max_pending = pending;
+        _pending_sum += pending;
+        if (when >= _next_sample) {
+            _samples.push_back(std::make_pair(when, pending));
+            _next_sample = when - when % _sample_period + _sample_period;
+        }
+        return std::chrono::steady_clock::now();
+    }
+    inline void stop(timer_t started) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count();
+        _types[_current->_type]._events++;
+        _types[_current->_type]._ns += ns;
+        _prefixes[_current->_prefix]._events++;
+        _prefixes[_current->_prefix]._ns += ns;
+    }
+    void trigger() {_triggers++;}
+
+    void report(std::ostream& out) const;
+
+private:
+    struct Stats {
+        Stats(const std::string& name) : _name(name), _events(0), _ns(0) {}
+        std::string _name;
+        uint64_t _events;
+        uint64_t _ns;
+    };
+    struct SourceEntry {
+        uint32_t _type;
+        uint32_t _prefix;
+    };
+
+    inline SourceEntry& entry(EventSource& src) {
+        std::unordered_map<EventSource*, SourceEntry>::iterator i = _sources.find(&src);
+        if (i != _sources.end())
+            return i->second;
+        return add_source(src);
+    }
+    SourceEntry& add_source(EventSource& src);
+    static uint32_t lookup(std::vector<Stats>& stats, std::unordered_map<std::string, uint32_t>& index,
+                           const std::string& name);
+    void report_table(std::ostream& out, const char* title, const std::vector<Stats>& stats) const;
+
+    std::unordered_map<EventSource*, SourceEntry> _sources;
+    std::vector<Stats> _types;
+    std::vector<Stats> _prefixes;
+    std::unordered_map<std::string, uint32_t> _type_index;
+    std::unordered_map<std::string, uint32_t> _prefix_index;
+    SourceEntry* _current;
+    uint64_t _triggers;
+
+    simtime_picosec _sample_period;
+    simtime_picosec _next_sample;
+    std::vector<std::pair<simtime_picosec, size_t> > _samples;
+    size_t _max_pending;
+    uint64_t _pending_sum;
+};
+
+#endif
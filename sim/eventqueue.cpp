@@ -0,0 +1,418 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "eventqueue.h"
+
+#define EVENT_CHUNK_SIZE 1024
+
+EventQueue::EventQueue() : _size(0), _next_seq(0), _freelist(NULL)
+{
+}
+
+EventQueue::~EventQueue()
+{
+    for (size_t i = 0; i < _chunks.size(); i++)
+        delete[] _chunks[i];
+}
+
+EventQueue::Event*
+EventQueue::allocEvent(simtime_picosec when, EventSource* src, uint64_t seq)
+{
+    if (!_freelist) {
+        Event* chunk = new Event[EVENT_CHUNK_SIZE];
+        _chunks.push_back(chunk);
+        for (int i = 0; i < EVENT_CHUNK_SIZE; i++) {
+            chunk[i].next = _freelist;
+            _freelist = &chunk[i];
+        }
+    }
+    Event* ev = _freelist;
+    _freelist = ev->next;
+    ev->time = when;
+    ev->seq = seq;
+    ev->src = src;
+    ev->prev = NULL;
+    ev->next = NULL;
+    return ev;
+}
+
+void
+EventQueue::freeEvent(Event* ev)
+{
+    ev->src = NULL;
+    ev->next = _freelist;
+    _freelist = ev;
+}
+
+void
+EventQueue::moveTo(EventQueue& dst)
+{
+    if (dst._next_seq < _next_seq)
+        dst._next_seq = _next_seq;
+    while (!empty()) {
+        Event* ev = popEvent();
+        dst.insert(ev->time, ev->src, ev->seq);
+        freeEvent(ev);
+    }
+}
+
+/*
+ * MapEventQueue
+ */
+
+EventQueue::Event*
+MapEventQueue::insertEvent(Event* ev)
+{
+    _events.insert(ev);
+    _size++;
+    return ev;
+}
+
+EventQueue::Event*
+MapEventQueue::peek()
+{
+    return _events.empty() ? NULL : *_events.begin();
+}
+
+EventQueue::Event*
+MapEventQueue::popEvent()
+{
+    assert(!_events.empty());
+    Event* ev = *_events.begin();
+    _events.erase(_events.begin());
+    _size--;
+    return ev;
+}
+
+void
+MapEventQueue::erase(Event* ev)
+{
+    size_t erased = _events.erase(ev);
+    assert(erased == 1);
+    (void)erased;
+    _size--;
+    freeEvent(ev);
+}
+
+EventQueue::Event*
+MapEventQueue::find(EventSource* src)
+{
+    for (auto i = _events.begin(); i != _events.end(); i++) {
+        if ((*i)->src == src)
+            return *i;
+    }
+    return NULL;
+}
+
+EventQueue::Event*
+MapEventQueue::find(EventSource* src, simtime_picosec when)
+{
+    Event key;
+    key.time = when;
+    key.seq = 0;
+    for (auto i = _events.lower_bound(&key); i != _events.end() && (*i)->time == when; i++) {
+        if ((*i)->src == src)
+            return *i;
+    }
+    return NULL;
+}
+
+/*
+ * CalendarEventQueue
+ *
+ * R. Brown, "Calendar queues: a fast O(1) priority queue
+ * implementation for the simulation event set problem", CACM 1988.
+ *
+ * Each bucket holds a doubly linked list sorted by (time, seq).  The
+ * number of buckets tracks the number of pending events, and the
+ * bucket width is re-estimated from the spacing of the earliest
+ * events each time we resize.  Bucket widths are powers of two so
+ * the bucket index is a shift and mask.
+ */
+
+#define CQ_MIN_BUCKETS 2
+#define CQ_INITIAL_WIDTH_SHIFT 20  // ~1us
+#define CQ_MAX_WIDTH_SHIFT 50
+#define CQ_SAMPLES 25
+#define CQ_MAX_COST 4  // average buckets scanned per pop, or entries walked per insert
+
+CalendarEventQueue::CalendarEventQueue()
+{
+    _buckets.resize(CQ_MIN_BUCKETS);
+    for (size_t i = 0; i < _buckets.size(); i++) {
+        _buckets[i].head = NULL;
+        _buckets[i].tail = NULL;
+    }
+    _bucket_mask = CQ_MIN_BUCKETS - 1;
+    _width_shift = CQ_INITIAL_WIDTH_SHIFT;
+    _last_time = 0;
+    _resize_enabled = true;
+    _pops = _inserts = _scan_steps = _link_steps = 0;
+    _span_start = 0;
+    setPosition(0);
+}
+
+void
+CalendarEventQueue::setPosition(simtime_picosec t)
+{
+    _current = bucketOf(t);
+    _bucket_top = ((t >> _width_shift) + 1) << _width_shift;
+}
+
+void
+CalendarEventQueue::link(Event* ev)
+{
+    Bucket& b = _buckets[bucketOf(ev->time)];
+    // new events are usually the latest in their bucket, so search backwards from the tail.
+    Event* p = b.tail;
+    while (p && before(ev, p)) {
+        p = p->prev;
+        _link_steps++;
+    }
+    ev->prev = p;
+    if (p) {
+        ev->next = p->next;
+        p->next = ev;
+    } else {
+        ev->next = b.head;
+        b.head = ev;
+    }
+    if (ev->next)
+        ev->next->prev = ev;
+    else
+        b.tail = ev;
+}
+
+void
+CalendarEventQueue::unlink(Event* ev)
+{
+    Bucket& b = _buckets[bucketOf(ev->time)];
+    if (ev->prev)
+        ev->prev->next = ev->next;
+    else
+        b.head = ev->next;
+    if (ev->next)
+        ev->next->prev = ev->prev;
+    else
+        b.tail = ev->prev;
+}
+
+EventQueue::Event*
+CalendarEventQueue::insertEvent(Event* ev)
+{
+    link(ev);
+    _size++;
+    _inserts++;
+    if (_resize_enabled && _size > 2 * _buckets.size())
+        resize(_buckets.size() * 2);
+    return ev;
+}
+
+// unlink and return the earliest event; doesn't update _size or _last_time.
+EventQueue::Event*
+CalendarEventQueue::popNext()
+{
+    for (uint32_t n = 0; n <= _bucket_mask; n++) {
+        Event* ev = _buckets[_current].head;
+        if (ev && ev->time < _bucket_top) {
+            _scan_steps += n;
+            unlink(ev);
+            return ev;
+        }
+        _current = (_current + 1) & _bucket_mask;
+        _bucket_top += (simtime_picosec)1 << _width_shift;
+    }
+
+    // nothing in the next "year" - find the earliest event directly.
+    Event* best = NULL;
+    for (uint32_t i = 0; i <= _bucket_mask; i++) {
+        Event* ev = _buckets[i].head;
+        if (ev && (!best || before(ev, best)))
+            best = ev;
+    }
+    assert(best);
+    _scan_steps += 2 * _buckets.size();
+    setPosition(best->time);
+    unlink(best);
+    return best;
+}
+
+// as popNext, but leaves the queue as it is, so an earlier event can
+// still be inserted afterwards.
+EventQueue::Event*
+CalendarEventQueue::peek()
+{
+    if (_size == 0)
+        return NULL;
+    uint32_t current = _current;
+    simtime_picosec top = _bucket_top;
+    for (uint32_t n = 0; n <= _bucket_mask; n++) {
+        Event* ev = _buckets[current].head;
+        if (ev && ev->time < top)
+            return ev;
+        current = (current + 1) & _bucket_mask;
+        top += (simtime_picosec)1 << _width_shift;
+    }
+    Event* best = NULL;
+    for (uint32_t i = 0; i <= _bucket_mask; i++) {
+        Event* ev = _buckets[i].head;
+        if (ev && (!best || before(ev, best)))
+            best = ev;
+    }
+    return best;
+}
+
+EventQueue::Event*
+CalendarEventQueue::popEvent()
+{
+    assert(_size > 0);
+    Event* ev = popNext();
+    _size--;
+    _pops++;
+    _last_time = ev->time;
+
+    if (_resize_enabled) {
+        if (_buckets.size() > CQ_MIN_BUCKETS && _size < _buckets.size() / 2)
+            resize(_buckets.size() / 2);
+        else if (_pops + _inserts >= _buckets.size() && _pops >= CQ_SAMPLES)
+            checkCost();
+    }
+    return ev;
+}
+
+// Brown's sampling only sees the spacing of the next few events, and
+// gets it badly wrong when they're dominated by ties or by a few
+// far-future timers.  So periodically check how much work we're
+// actually doing, and re-estimate the width if it's too much.
+void
+CalendarEventQueue::checkCost()
+{
+    if (_scan_steps > CQ_MAX_COST * _pops) {
+        resize(_buckets.size(), 1);   // buckets too narrow
+    } else if (_link_steps > CQ_MAX_COST * _inserts) {
+        resize(_buckets.size(), -1);  // buckets too wide
+    } else {
+        _pops = _inserts = _scan_steps = _link_steps = 0;
+        _span_start = _last_time;
+    }
+}
+
+void
+CalendarEventQueue::erase(Event* ev)
+{
+    assert(ev->src);
+    unlink(ev);
+    _size--;
+    freeEvent(ev);
+}
+
+EventQueue::Event*
+CalendarEventQueue::find(EventSource* src)
+{
+    Event* best = NULL;
+    for (uint32_t i = 0; i <= _bucket_mask; i++) {
+        for (Event* ev = _buckets[i].head; ev; ev = ev->next) {
+            if (ev->src == src) {
+                // buckets are sorted, so this is the earliest in this bucket
+                if (!best || before(ev, best))
+                    best = ev;
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+EventQueue::Event*
+CalendarEventQueue::find(EventSource* src, simtime_picosec when)
+{
+    for (Event* ev = _buckets[bucketOf(when)].head; ev && ev->time <= when; ev = ev->next) {
+        if (ev->time == when && ev->src == src)
+            return ev;
+    }
+    return NULL;
+}
+
+// Brown's heuristic: take the spacing of the first few events,
+// discard outliers, and use three times the average.  Returns zero
+// if there's nothing to go on.
+simtime_picosec
+CalendarEventQueue::sampleWidth()
+{
+    if (_size < 2)
+        return 0;
+
+    uint32_t nsamples = _size < CQ_SAMPLES ? _size : CQ_SAMPLES;
+    Event* samples[CQ_SAMPLES];
+    for (uint32_t i = 0; i < nsamples; i++)
+        samples[i] = popNext();
+    for (uint32_t i = 0; i < nsamples; i++)
+        link(samples[i]);
+    setPosition(_last_time);
+
+    simtime_picosec avg = (samples[nsamples-1]->time - samples[0]->time) / (nsamples - 1);
+    if (avg == 0)
+        return 0;
+
+    simtime_picosec total = 0;
+    uint32_t count = 0;
+    for (uint32_t i = 1; i < nsamples; i++) {
+        simtime_picosec gap = samples[i]->time - samples[i-1]->time;
+        if (gap <= 2 * avg) {
+            total += gap;
+            count++;
+        }
+    }
+    simtime_picosec width = count ? 3 * total / count : 0;
+    return width ? width : avg;
+}
+
+// nudge is +1/-1 if we know the current width is too small/large,
+// in case the new estimate doesn't change anything.
+void
+CalendarEventQueue::resize(uint32_t nbuckets, int nudge)
+{
+    _resize_enabled = false;
+
+    // Prefer the rate we've actually been dequeuing at - three events
+    // per bucket - and only fall back to sampling if we've no history.
+    simtime_picosec width = 0;
+    if (_pops >= CQ_SAMPLES && _last_time > _span_start)
+        width = 3 * (_last_time - _span_start) / _pops;
+    if (width == 0)
+        width = sampleWidth();
+
+    uint32_t shift = _width_shift;
+    if (width > 0) {
+        shift = 0;
+        while (shift < CQ_MAX_WIDTH_SHIFT && ((simtime_picosec)1 << shift) < width)
+            shift++;
+    }
+    if (shift == _width_shift) {
+        if (nudge > 0 && shift < CQ_MAX_WIDTH_SHIFT)
+            shift++;
+        else if (nudge < 0 && shift > 0)
+            shift--;
+    }
+
+    vector<Event*> events;
+    events.reserve(_size);
+    for (size_t i = 0; i < _buckets.size(); i++) {
+        for (Event* ev = _buckets[i].head; ev; ev = ev->next)
+            events.push_back(ev);
+    }
+    assert(events.size() == _size);
+
+    _buckets.resize(nbuckets);
+    for (size_t i = 0; i < _buckets.size(); i++) {
+        _buckets[i].head = NULL;
+        _buckets[i].tail = NULL;
+    }
+    _bucket_mask = nbuckets - 1;
+    _width_shift = shift;
+    for (size_t i = 0; i < events.size(); i++)
+        link(events[i]);
+    setPosition(_last_time);
+
+    _pops = _inserts = _scan_steps = _link_steps = 0;
+    _span_start = _last_time;
+    _resize_enabled = true;
+}
@@ -0,0 +1,150 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+/*
+ * Pending-event storage for EventList.
+ *
+ * Events are ordered by time, and events with the same time are
+ * ordered by when they were scheduled (FIFO), which is what the
+ * original multimap-based EventList did.  Keeping that tie-break
+ * identical matters - the reference outputs in tests/htsim-tests
+ * depend on it.
+ *
+ * Two backends are provided:
+ *  - CalendarEventQueue: Brown's calendar queue, O(1) amortized insert/pop.  The default.
+ *  - MapEventQueue: a balanced tree, O(log n).  Mainly kept for validation.
+ *
+ * Event records are pooled, so scheduling an event doesn't hit malloc
+ * in steady state, and a pointer to an Event is a stable handle that
+ * can be used to cancel it in O(1) (calendar) or O(log n) (map).
+ */
+
+#include <set>
+#include <vector>
+#include "config.h"
+
+class EventSource;
+
+class EventQueue {
+public:
+    struct Event {
+        simtime_picosec time;
+        uint64_t seq;      // tie-breaker for events at the same time
+        EventSource* src;
+        Event* prev;       // bucket list links, only used by the calendar queue
+        Event* next;
+    };
+
+    EventQueue();
+    virtual ~EventQueue();
+
+    // insert returns a handle that stays valid until the event is popped or erased
+    Event* insert(simtime_picosec when, EventSource* src) {
+        return insertEvent(allocEvent(when, src, _next_seq++));
+    }
+    // insert ordered as if it had been inserted when seq was reserved
+    Event* insert(simtime_picosec when, EventSource* src, uint64_t seq) {
+        assert(seq < _next_seq);
+        return insertEvent(allocEvent(when, src, seq));
+    }
+    inline uint64_t reserveSeq() {return _next_seq++;}
+
+    // remove the earliest event.  Queue must not be empty.
+    EventSource* pop(simtime_picosec& when, uint64_t& seq) {
+        Event* ev = popEvent();
+        when = ev->time;
+        seq = ev->seq;
+        EventSource* src = ev->src;
+        freeEvent(ev);
+        return src;
+    }
+    // the earliest event, without removing it, or NULL if there are none
+    virtual Event* peek() = 0;
+    virtual void erase(Event* ev) = 0;
+    // earliest pending event for src, or NULL.  O(n) - avoid on the fast path.
+    virtual Event* find(EventSource* src) = 0;
+    // earliest pending event for src at exactly time when, or NULL.
+    virtual Event* find(EventSource* src, simtime_picosec when) = 0;
+
+    inline size_t size() const {return _size;}
+    inline bool empty() const {return _size == 0;}
+
+    // move all pending events to another queue, preserving their
+    // order and any reserved seqs.  Handles become invalid.
+    void moveTo(EventQueue& dst);
+
+protected:
+    virtual Event* insertEvent(Event* ev) = 0;
+    virtual Event* popEvent() = 0;  // caller frees
+    Event* allocEvent(simtime_picosec when, EventSource* src, uint64_t seq);
+    void freeEvent(Event* ev);
+    static inline bool before(const Event* a, const Event* b) {
+        return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+    }
+
+    size_t _size;
+    uint64_t _next_seq;
+private:
+    EventQueue(const EventQueue&) = delete;
+    void operator=(const EventQueue&) = delete;
+    Event* _freelist;
+    vector<Event*> _chunks;
+};
+
+class MapEventQueue : public EventQueue {
+public:
+    virtual Event* peek();
+    virtual void erase(Event* ev);
+    virtual Event* find(EventSource* src);
+    virtual Event* find(EventSource* src, simtime_picosec when);
+protected:
+    virtual Event* insertEvent(Event* ev);
+    virtual Event* popEvent();
+private:
+    struct EventOrder {
+        bool operator()(const Event* a, const Event* b) const {return before(a, b);}
+    };
+    set<Event*, EventOrder> _events;
+};
+
+class CalendarEventQueue : public EventQueue {
+public:
+    CalendarEventQueue();
+    virtual Event* peek();
+    virtual void erase(Event* ev);
+    virtual Event* find(EventSource* src);
+    virtual Event* find(EventSource* src, simtime_picosec when);
+protected:
+    virtual Event* insertEvent(Event* ev);
+    virtual Event* popEvent();
+private:
+    struct Bucket {
+        Event* head;
+        Event* tail;
+    };
+    inline uint32_t bucketOf(simtime_picosec t) const {return (t >> _width_shift) & _bucket_mask;}
+    void link(Event* ev);
+    void unlink(Event* ev);
+    Event* popNext();
+    void setPosition(simtime_picosec t);
+    void resize(uint32_t nbuckets, int nudge = 0);
+    void checkCost();
+    simtime_picosec sampleWidth();
+
+    vector<Bucket> _buckets;
+    uint32_t _bucket_mask;
+    uint32_t _width_shift;       // bucket width is 1<<_width_shift picoseconds
+    uint32_t _current;           // bucket we're dequeuing from
+    simtime_picosec _bucket_top; // exclusive upper bound of _current in the current "year"
+    simtime_picosec _last_time;  // time of last event popped
+    bool _resize_enabled;
+
+    // work done since the last resize, used to re-estimate the bucket width
+    uint64_t _pops, _inserts;
+    uint64_t _scan_steps;        // buckets examined when popping
+    uint64_t _link_steps;        // list entries walked when inserting
+    simtime_picosec _span_start; // _last_time at the last resize
+};
+
+#endif
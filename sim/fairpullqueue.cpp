@@ -154,14 +154,90 @@ FairPullQueue<PullPkt>::create_queue(const PullPkt& pkt) {
     return new_queue;
 }
 
+template<class PullPkt>
+FlowSlotPullQueue<PullPkt>::FlowSlotPullQueue() {
+}
+
+template<class PullPkt>
+uint32_t
+FlowSlotPullQueue<PullPkt>::add_flow(flowid_t flow_id) {
+    uint32_t slot = _pulls.size();
+    _pulls.push_back(CircularBuffer<PullPkt*>());
+    _active.resize(_pulls.size());
+    _slots[flow_id] = slot;
+    return slot;
+}
+
+template<class PullPkt>
+void
+FlowSlotPullQueue<PullPkt>::enqueue(PullPkt& pkt, int priority) {
+    typename unordered_map<flowid_t, uint32_t>::iterator i = _slots.find(pkt.flow_id());
+    uint32_t slot = i == _slots.end() ? add_flow(pkt.flow_id()) : i->second;
+    enqueue_slot(pkt, slot, priority);
+}
+
+template<class PullPkt>
+void
+FlowSlotPullQueue<PullPkt>::enqueue_slot(PullPkt& pkt, uint32_t slot, int /*priority*/) {
+    assert(slot < _pulls.size());
+    CircularBuffer<PullPkt*>& pull_queue = _pulls[slot];
+    if (pull_queue.empty())
+        _active.insert(slot);
+    PullPkt* pkt_p = &pkt;
+    pull_queue.push(pkt_p);
+    this->_pull_count++;
+}
+
+template<class PullPkt>
+PullPkt* 
+FlowSlotPullQueue<PullPkt>::dequeue() {
+    if (this->_pull_count == 0)
+        return 0;
+    uint32_t slot = _active.current();
+    CircularBuffer<PullPkt*>& pull_queue = _pulls[slot];
+    PullPkt* packet = pull_queue.pop();
+    this->_pull_count--;
+    if (pull_queue.empty())
+        _active.remove(slot);
+    else
+        _active.advance();
+    return packet;
+}
+
+template<class PullPkt>
+void
+FlowSlotPullQueue<PullPkt>::flush_flow(flowid_t flow_id, int priority) {
+    typename unordered_map<flowid_t, uint32_t>::iterator i = _slots.find(flow_id);
+    if (i != _slots.end())
+        flush_slot(i->second, flow_id, priority);
+}
+
+template<class PullPkt>
+void
+FlowSlotPullQueue<PullPkt>::flush_slot(uint32_t slot, flowid_t /*flow_id*/, int /*priority*/) {
+    assert(slot < _pulls.size());
+    CircularBuffer<PullPkt*>& pull_queue = _pulls[slot];
+    if (pull_queue.empty())
+        return;
+    _active.remove(slot);
+    while (!pull_queue.empty()) {
+        PullPkt* packet = pull_queue.pop();
+        packet->free();
+        this->_pull_count--;
+    }
+}
+
 template class BasePullQueue<NdpPull>;
 template class FifoPullQueue<NdpPull>;
 template class FairPullQueue<NdpPull>;
+template class FlowSlotPullQueue<NdpPull>;
 
 template class BasePullQueue<NdpRTS>;
 template class FifoPullQueue<NdpRTS>;
 template class FairPullQueue<NdpRTS>;
+template class FlowSlotPullQueue<NdpRTS>;
 
 template class BasePullQueue<Packet>;
 template class FairPullQueue<Packet>;
+template class FlowSlotPullQueue<Packet>;
 
@@ -7,10 +7,12 @@
  */
 
 #include <list>
+#include <unordered_map>
 #include "config.h"
 #include "eventlist.h"
 #include "network.h"
 #include "circular_buffer.h"
+#include "active_ring.h"
 
 
 template<class PullPkt>
@@ -21,6 +23,12 @@ class BasePullQueue {
     virtual void enqueue(PullPkt& pkt, int priority = 0) = 0;
     virtual PullPkt* dequeue() = 0;
     virtual void flush_flow(flowid_t flow_id, int priority = 0) = 0;
+    // Queues that keep per-flow state hand a flow a slot when it
+    // registers, and the flow passes it back so the queue needn't look
+    // the flow up on every pull.  Other queues ignore the slot.
+    virtual uint32_t add_flow(flowid_t /*flow_id*/) {return 0;}
+    virtual void enqueue_slot(PullPkt& pkt, uint32_t /*slot*/, int priority = 0) {enqueue(pkt, priority);}
+    virtual void flush_slot(uint32_t /*slot*/, flowid_t flow_id, int priority = 0) {flush_flow(flow_id, priority);}
     virtual void set_preferred_flow(flowid_t preferred_flow) {
             _preferred_flow = preferred_flow;
     }
@@ -57,4 +65,26 @@ class FairPullQueue : public BasePullQueue<PullPkt>{
     typename map<flowid_t, CircularBuffer<PullPkt*>*>::iterator _current_queue;
 };
 
+// Also round robin between flows, but for pacers with many flows.
+// Each flow gets a slot in a dense array when it registers (or, if
+// it never does, on its first pull), and keeps it, so there's no
+// per-flow allocation after that.  Flows are served in the order
+// they became active rather than flow id order, so the interleaving
+// differs from FairPullQueue.
+template<class PullPkt>
+class FlowSlotPullQueue : public BasePullQueue<PullPkt>{
+ public:
+    FlowSlotPullQueue();
+    virtual void enqueue(PullPkt& pkt, int priority = 0);
+    virtual PullPkt* dequeue();
+    virtual void flush_flow(flowid_t flow_id, int priority = 0);
+    virtual uint32_t add_flow(flowid_t flow_id);
+    virtual void enqueue_slot(PullPkt& pkt, uint32_t slot, int priority = 0);
+    virtual void flush_slot(uint32_t slot, flowid_t flow_id, int priority = 0);
+ protected:
+    vector<CircularBuffer<PullPkt*> > _pulls; // by slot
+    ActiveRing _active; // slots with pulls queued
+    unordered_map<flowid_t, uint32_t> _slots; // for flows that don't pass a slot
+};
+
 #endif
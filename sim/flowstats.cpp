@@ -0,0 +1,130 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "flowstats.h"
+#include <math.h>
+#include <assert.h>
+#include <sstream>
+
+void Histogram::record(uint64_t value) {
+    size_t b = bucket(value);
+    if (b >= _buckets.size())
+        _buckets.resize(b + 1, 0);
+    _buckets[b]++;
+    _count++;
+    _sum += value;
+    if (value < _min)
+        _min = value;
+    if (value > _max)
+        _max = value;
+}
+
+void Histogram::merge(const Histogram& other) {
+    if (other._buckets.size() > _buckets.size())
+        _buckets.resize(other._buckets.size(), 0);
+    for (size_t b = 0; b < other._buckets.size(); b++)
+        _buckets[b] += other._buckets[b];
+    _count += other._count;
+    _sum += other._sum;
+    if (other._min < _min)
+        _min = other._min;
+    if (other._max > _max)
+        _max = other._max;
+}
+
+uint64_t Histogram::bucket_value(size_t bucket) {
+    if (bucket < (2 << SUB_BITS))
+        return bucket;
+    int shift = (bucket >> SUB_BITS) - 1;
+    uint64_t low = (uint64_t)(bucket - ((size_t)shift << SUB_BITS)) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+uint64_t Histogram::percentile(double p) const {
+    if (_count == 0)
+        return 0;
+    uint64_t rank = (uint64_t)ceil(p * _count);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < _buckets.size(); b++) {
+        seen += _buckets[b];
+        if (seen >= rank) {
+            // never report beyond the samples actually seen
+            uint64_t v = bucket_value(b);
+            return v < _min ? _min : (v > _max ? _max : v);
+        }
+    }
+    return _max;
+}
+
+FlowStats::FlowStats() : _linkspeed(0), _base_rtt(0) {
+    vector<mem_b> bounds;
+    bounds.push_back(10000);
+    bounds.push_back(100000);
+    bounds.push_back(1000000);
+    bounds.push_back(10000000);
+    set_size_buckets(bounds);
+}
+
+void FlowStats::set_size_buckets(const vector<mem_b>& bounds) {
+    assert(_all._fct.count() == 0);
+    _bounds = bounds;
+    _buckets.clear();
+    _buckets.resize(_bounds.size() + 1);
+}
+
+void FlowStats::flow_finished(mem_b flow_size, simtime_picosec start, simtime_picosec finish) {
+    assert(finish >= start);
+    size_t b = 0;
+    while (b < _bounds.size() && flow_size > _bounds[b])
+        b++;
+    simtime_picosec fct = finish - start;
+    _buckets[b]._fct.record(fct);
+    _all._fct.record(fct);
+    if (_linkspeed) {
+        double ideal = _base_rtt + (double)flow_size * 8 * 1000000000000.0 / _linkspeed;
+        uint64_t slowdown = llround(fct / ideal * SLOWDOWN_SCALE);
+        _buckets[b]._slowdown.record(slowdown);
+        _all._slowdown.record(slowdown);
+    }
+}
+
+void FlowStats::merge(const FlowStats& other) {
+    assert(_bounds == other._bounds);
+    for (size_t b = 0; b < _buckets.size(); b++) {
+        _buckets[b]._fct.merge(other._buckets[b]._fct);
+        _buckets[b]._slowdown.merge(other._buckets[b]._slowdown);
+    }
+    _all._fct.merge(other._all._fct);
+    _all._slowdown.merge(other._all._slowdown);
+}
+
+void FlowStats::report_bucket(ostream& out, const string& label, const Bucket& b) const {
+    out << "FCT " << label << " flows " << b._fct.count()
+        << " fct_us p50 " << timeAsUs(b._fct.percentile(0.5))
+        << " p99 " << timeAsUs(b._fct.percentile(0.99))
+        << " p99.9 " << timeAsUs(b._fct.percentile(0.999))
+        << " max " << timeAsUs(b._fct.max());
+    if (_linkspeed) {
+        double s = SLOWDOWN_SCALE;
+        out << " slowdown p50 " << b._slowdown.percentile(0.5) / s
+            << " p99 " << b._slowdown.percentile(0.99) / s
+            << " p99.9 " << b._slowdown.percentile(0.999) / s
+            << " max " << b._slowdown.max() / s;
+    }
+    out << endl;
+}
+
+void FlowStats::report(ostream& out) const {
+    for (size_t i = 0; i < _buckets.size() && !_bounds.empty(); i++) {
+        if (_buckets[i]._fct.count() == 0)
+            continue;
+        stringstream label;
+        if (i == _bounds.size()) {
+            label << "size >" << _bounds[i-1];
+        } else {
+            label << "size " << (i ? _bounds[i-1] + 1 : 0) << "-" << _bounds[i];
+        }
+        report_bucket(out, label.str(), _buckets[i]);
+    }
+    report_bucket(out, "all", _all);
+}
@@ -0,0 +1,89 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef FLOWSTATS_H
+#define FLOWSTATS_H
+
+/*
+ * Flow completion statistics gathered while the simulation runs, so
+ * tail FCTs don't need a trace.  Sources report each flow as it
+ * finishes (SimContext::current().flowStats().flow_finished(...)), and
+ * the registry keeps a latency and a slowdown histogram per flow-size
+ * bucket.
+ */
+
+#include <iostream>
+#include <vector>
+#include "config.h"
+
+// Log-bucketed histogram of non-negative integers, in the style of
+// HdrHistogram: values are exact below 2^SUB_BITS, and above that each
+// power of two is split into 2^SUB_BITS buckets, so a reported
+// percentile is within 1/2^SUB_BITS of the true value.  Recording is
+// O(1) and the size is bounded by the largest value seen.
+class Histogram {
+public:
+    static const int SUB_BITS = 7;
+
+    Histogram() : _count(0), _min(UINT64_MAX), _max(0), _sum(0) {}
+
+    void record(uint64_t value);
+    // add other's samples to this one
+    void merge(const Histogram& other);
+    uint64_t count() const {return _count;}
+    uint64_t min() const {return _count ? _min : 0;}
+    uint64_t max() const {return _max;}
+    double mean() const {return _count ? (double)_sum / _count : 0;}
+    // value at or below which fraction p of the samples lie
+    uint64_t percentile(double p) const;
+private:
+    static inline size_t bucket(uint64_t value) {
+        if (value < (1 << SUB_BITS))
+            return value;
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return ((size_t)shift << SUB_BITS) + (value >> shift);
+    }
+    // the middle of a bucket's range
+    static uint64_t bucket_value(size_t bucket);
+
+    std::vector<uint64_t> _buckets;
+    uint64_t _count, _min, _max;
+    double _sum;
+};
+
+class FlowStats {
+public:
+    FlowStats();
+
+    void flow_finished(mem_b flow_size, simtime_picosec start, simtime_picosec finish);
+
+    // Slowdown is FCT over the ideal: base_rtt plus the flow's
+    // serialization time at linkspeed.  Not reported until set.
+    void set_ideal(linkspeed_bps linkspeed, simtime_picosec base_rtt) {
+        _linkspeed = linkspeed;
+        _base_rtt = base_rtt;
+    }
+    // Upper bounds (bytes) of the flow-size buckets; a final bucket
+    // takes every larger flow.
+    void set_size_buckets(const std::vector<mem_b>& bounds);
+
+    uint64_t flows() const {return _all._fct.count();}
+    // add the flows other has seen; it must have the same size buckets
+    void merge(const FlowStats& other);
+    // p50/p99/p99.9/max FCT and slowdown, per size bucket and overall
+    void report(std::ostream& out) const;
+
+private:
+    struct Bucket {
+        Histogram _fct;       // picoseconds
+        Histogram _slowdown;  // scaled by SLOWDOWN_SCALE
+    };
+    static const uint64_t SLOWDOWN_SCALE = 1000;
+    void report_bucket(std::ostream& out, const std::string& label, const Bucket& b) const;
+
+    std::vector<mem_b> _bounds;
+    std::vector<Bucket> _buckets;
+    Bucket _all;
+    linkspeed_bps _linkspeed;
+    simtime_picosec _base_rtt;
+};
+
+#endif
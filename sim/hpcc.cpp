@@ -3,6 +3,7 @@
 #include <iostream>
 #include <algorithm>
 #include "hpcc.h"
+#include "flowstats.h"
 #include "queue.h"
 #include <stdio.h>
 #include "switch.h"
@@ -58,6 +59,7 @@ HPCCSrc::HPCCSrc(HPCCLogger* logger, TrafficLogger* pktlogger, EventList &eventl
 
     _drops = 0;
     _flow_size = ((uint64_t)1)<<63;
+    _flow_start_time = 0;
   
     _node_num = _global_node_count++;
     _nodename = "HPCCsrc " + to_string(_node_num);
@@ -115,6 +117,7 @@ void HPCCSrc::log_me() {
 void HPCCSrc::startflow(){
     cout << "startflow " << _flow._name << " at " << timeAsUs(eventlist().now()) << endl;
     _flow_started = true;
+    _flow_start_time = eventlist().now();
     _highest_sent = 0;
     _last_acked = 0;
     
@@ -209,6 +212,8 @@ void HPCCSrc::processAck(const HPCCAck& ack) {
 
     if (ackno >= _flow_size){
         cout << "Flow " << _name << " finished at " << timeAsUs(eventlist().now()) << " total bytes " << ackno << endl;
+        if (!_done)
+            SimContext::current().flowStats().flow_finished(_flow_size, _flow_start_time, eventlist().now());
         _done = true;
         if (_end_trigger) {
             _end_trigger->activate();
@@ -89,7 +89,7 @@ protected:
     bool _last_packet;  // set to true in the last packet in a flow.
 
     //area to aggregate switch INT information
-    static PacketDB<HPCCPacket> _packetdb;
+    static thread_local PacketDB<HPCCPacket> _packetdb;
 };
 
 class HPCCAck : public Packet {
@@ -125,7 +125,7 @@ public:
 protected:
     seq_t _ackno;
     simtime_picosec _ts;
-    static PacketDB<HPCCAck> _packetdb;
+    static thread_local PacketDB<HPCCAck> _packetdb;
 };
 
 
@@ -157,7 +157,7 @@ public:
 protected:
     seq_t _ackno;
     simtime_picosec _ts;
-    static PacketDB<HPCCNack> _packetdb;
+    static thread_local PacketDB<HPCCNack> _packetdb;
 };
 
 
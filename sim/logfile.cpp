@@ -1,10 +1,179 @@
 // -*- c-basic-offset: 4; indent-tabs-mode: nil -*-        
 #define _CRT_SECURE_NO_DEPRECATE  // For Visual Studio: this allows the unsafe operation fopen() without issuing a warning
 #include "logfile.h"
+#include "trace_codec.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <ios>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/*
+ * LogWriter collects trace records into large batches and writes each
+ * full batch with a single fwrite.  In async mode the writes happen on
+ * a background thread, so the simulation thread only ever copies a
+ * record into memory; it waits only if the writer falls more than
+ * MAX_PENDING batches behind.  Given an encoder, each batch is written
+ * as one columnar block instead, encoded on the writer thread.  A
+ * failed write is only recorded there; the simulation thread reports
+ * it the next time it hands over a batch or flushes.
+ */
+class LogWriter {
+public:
+    static const size_t BATCH_RECORDS = 1 << 16;
+    static const size_t MAX_PENDING = 16;
+
+    LogWriter(FILE* file, bool async, TraceEncoder* encoder);
+    ~LogWriter();
+
+    inline LogRecord* next() {
+        if (_used == BATCH_RECORDS)
+            submit();
+        return &_batch[_used++];
+    }
+    // hand over the current batch and wait until everything is on disk
+    void flush();
+private:
+    struct Batch {
+        LogRecord* _records;
+        size_t _count;
+    };
+    void submit();
+    void write(Batch& batch);
+    void run();
+    void check_failed();
+
+    FILE* _file;
+    bool _async;
+    TraceEncoder* _encoder;
+    string _block;
+    LogRecord* _batch;
+    size_t _used;
+
+    // shared with the writer thread
+    mutex _lock;
+    condition_variable _work;
+    condition_variable _done;
+    deque<Batch> _pending;
+    vector<LogRecord*> _spare;
+    bool _writing;
+    bool _stop;
+    atomic<bool> _failed; // a write failed; nothing more is written
+    thread _thread;
+};
+
+LogWriter::LogWriter(FILE* file, bool async, TraceEncoder* encoder)
+    : _file(file), _async(async), _encoder(encoder), _used(0), _writing(false), _stop(false), _failed(false)
+{
+    _batch = new LogRecord[BATCH_RECORDS];
+    if (_async)
+        _thread = thread(&LogWriter::run, this);
+}
+
+LogWriter::~LogWriter() {
+    flush();
+    if (_async) {
+        {
+            lock_guard<mutex> l(_lock);
+            _stop = true;
+        }
+        _work.notify_one();
+        _thread.join();
+    }
+    delete[] _batch;
+    for (size_t i = 0; i < _spare.size(); i++)
+        delete[] _spare[i];
+}
+
+void LogWriter::write(Batch& batch) {
+    if (_failed)
+        return;
+    size_t written;
+    if (_encoder) {
+        _block.clear();
+        _encoder->encode_block(batch._records, batch._count, _block);
+        written = fwrite(_block.data(), 1, _block.size(), _file) == _block.size() ? batch._count : 0;
+    } else {
+        written = fwrite(batch._records, sizeof(LogRecord), batch._count, _file);
+    }
+    if (written != batch._count)
+        _failed = true;
+}
+
+// on the simulation thread
+void LogWriter::check_failed() {
+    if (_failed) {
+        cerr << "Failed to write log records" << endl;
+        exit(1);
+    }
+}
+
+void LogWriter::submit() {
+    check_failed();
+    Batch batch = {_batch, _used};
+    if (!_async) {
+        write(batch);
+        _used = 0;
+        check_failed();
+        return;
+    }
+    {
+        unique_lock<mutex> l(_lock);
+        while (_pending.size() >= MAX_PENDING)
+            _done.wait(l);
+        _pending.push_back(batch);
+        if (_spare.empty()) {
+            _batch = new LogRecord[BATCH_RECORDS];
+        } else {
+            _batch = _spare.back();
+            _spare.pop_back();
+        }
+    }
+    _used = 0;
+    _work.notify_one();
+}
+
+void LogWriter::flush() {
+    if (_used > 0)
+        submit();
+    if (_async) {
+        unique_lock<mutex> l(_lock);
+        while (!_pending.empty() || _writing)
+            _done.wait(l);
+    }
+    if (fflush(_file) != 0)
+        _failed = true;
+    check_failed();
+}
+
+void LogWriter::run() {
+    unique_lock<mutex> l(_lock);
+    while (true) {
+        while (_pending.empty() && !_stop)
+            _work.wait(l);
+        if (_pending.empty())
+            return;
+        Batch batch = _pending.front();
+        _pending.pop_front();
+        _writing = true;
+        l.unlock();
+        write(batch);
+        l.lock();
+        _writing = false;
+        _spare.push_back(batch._records);
+        _done.notify_all();
+    }
+}
+
+static_assert(sizeof(LogRecord) == 4*sizeof(double) + 3*sizeof(uint32_t),
+              "LogRecord must match the on-disk record layout");
+
+bool Logfile::_async_writer = true;
+Logfile::format Logfile::_format = Logfile::RAW;
 
 RawLogEvent::RawLogEvent(double time, uint32_t type, uint32_t id, uint32_t ev, 
                          double val1, double val2, double val3, string name = "") :
@@ -25,19 +194,28 @@ string RawLogEvent::str() {
 Logfile::Logfile(const string& filename, EventList& eventlist) 
 : _starttime(0), _eventlist(eventlist), 
   _preamble(ios_base::out | ios_base::in), 
-  _logfilename(filename), _numRecords(0)
+  _logfilename(filename), _encoder(NULL), _numRecords(0)
 {
-    _logfile = fopen(_logfilename.c_str(), "wbS");
+    // records go to a side file until the preamble is complete.  It's
+    // unlinked straight away so nothing is left behind if the run
+    // exits before the logfile is written out.
+    _recordfilename = _logfilename + ".records";
+    _logfile = fopen(_recordfilename.c_str(), "w+bS");
     if (_logfile==NULL) {
-        cerr << "Failed to open logfile " << _logfilename << endl;
+        cerr << "Failed to open logfile " << _recordfilename << endl;
         exit(1);
     }
+    remove(_recordfilename.c_str());
+    if (_format == COLUMNAR)
+        _encoder = new TraceEncoder();
+    _writer = new LogWriter(_logfile, _async_writer, _encoder);
 }
 
 Logfile::~Logfile() {
     if (_logfile != NULL) {
-        fclose(_logfile);
+        delete _writer;
         transposeLog();
+        delete _encoder;
     }
 }
 
@@ -68,55 +246,24 @@ Logfile::writeRecord(uint32_t type, uint32_t id, uint32_t ev,
                      double val1, double val2, double val3) {
     uint64_t time = _eventlist.now();
     if (time<_starttime) return;
-    double time_sec = timeAsSec(time);
-    fwrite(&time_sec, sizeof(double), 1, _logfile);
-    fwrite(&type, sizeof(uint32_t), 1, _logfile);
-    fwrite(&id, sizeof(uint32_t), 1, _logfile);
-    fwrite(&ev, sizeof(uint32_t), 1, _logfile);
-    fwrite(&val1, sizeof(double), 1, _logfile);
-    fwrite(&val2, sizeof(double), 1, _logfile);
-    fwrite(&val3, sizeof(double), 1, _logfile);
+    LogRecord* rec = _writer->next();
+    rec->_time = timeAsSec(time);
+    rec->_type = type;
+    rec->_id = id;
+    rec->_ev = ev + 100*type;
+    rec->_val1 = val1;
+    rec->_val2 = val2;
+    rec->_val3 = val3;
     _numRecords++;
 }
 
+// Write the preamble, then stream the records across from the side
+// file a batch at a time, so finishing a run needs one sequential pass
+// and O(batch) memory however long the trace is.
 void
 Logfile::transposeLog() {
-    double* timeRec = new double[_numRecords];
-    uint32_t* typeRec = new uint32_t[_numRecords];
-    uint32_t* idRec = new uint32_t[_numRecords];
-    uint32_t* evRec = new uint32_t[_numRecords];
-    double* val1Rec = new double[_numRecords];
-    double* val2Rec = new double[_numRecords];
-    double *val3Rec = new double[_numRecords];
+    _preamble << "# numrecords=" << _numRecords << endl;
     FILE* logfile;
-    logfile = fopen(_logfilename.c_str(),"rbS");
-    if (logfile==NULL) {
-        cerr << "Failed to open logfile " << _logfilename << endl;
-        exit(1);
-    }
-    size_t read;
-    double rd;
-    uint32_t ri;
-    int numread;
-    for (numread=0; numread<_numRecords; numread++) {
-        read = fread(&rd, sizeof(double), 1, logfile); if (read<1) break;
-        timeRec[numread] = rd;
-        read = fread(&ri, sizeof(uint32_t), 1, logfile); if (read<1) break;
-        typeRec[numread] = ri;
-        read = fread(&ri, sizeof(uint32_t), 1, logfile); if (read<1) break;
-        idRec[numread] = ri;
-        read = fread(&ri, sizeof(uint32_t), 1, logfile); if (read<1) break;
-        evRec[numread] = ri + 100*typeRec[numread];
-        read = fread(&rd, sizeof(double), 1, logfile); if (read<1) break;
-        val1Rec[numread] = rd;
-        read = fread(&rd, sizeof(double), 1, logfile); if (read<1) break;
-        val2Rec[numread] = rd;
-        read = fread(&rd, sizeof(double), 1, logfile); if (read<1) break;
-        val3Rec[numread] = rd;
-    }
-    fclose(logfile);
-    assert(numread==_numRecords);
-    _preamble << "# numrecords=" << numread << endl;
     logfile = fopen(_logfilename.c_str(),"wbS");
     if (logfile==0) {
         cerr << "Failed to open logfile " << _logfilename << endl;
@@ -129,22 +276,36 @@ Logfile::transposeLog() {
         fputs(thisLine, logfile);
         fputs("\n", logfile);
     }
-    fputs("# transpose=0\n",logfile);
+    if (_encoder)
+        fputs("# format=columnar\n",logfile);
+    else
+        fputs("# transpose=0\n",logfile);
     fputs("# TRACE\n",logfile);
-    for (int i=0; i < numread; i++) {
-        fwrite(&timeRec[i], sizeof(double), 1, logfile);
-        fwrite(&typeRec[i], sizeof(uint32_t), 1, logfile);
-        fwrite(&idRec[i],   sizeof(uint32_t), 1, logfile);
-        fwrite(&evRec[i],   sizeof(uint32_t), 1, logfile);
-        fwrite(&val1Rec[i], sizeof(double), 1, logfile);
-        fwrite(&val2Rec[i], sizeof(double), 1, logfile);
-        fwrite(&val3Rec[i], sizeof(double), 1, logfile);
+
+    rewind(_logfile);
+    const size_t bufsize = LogWriter::BATCH_RECORDS * sizeof(LogRecord);
+    char* buf = new char[bufsize];
+    uint64_t numread = 0;
+    size_t read;
+    while ((read = fread(buf, 1, bufsize, _logfile)) > 0) {
+        if (fwrite(buf, 1, read, logfile) != read) {
+            cerr << "Failed to write logfile " << _logfilename << endl;
+            exit(1);
+        }
+        numread += read;
+    }
+    delete[] buf;
+    if (_encoder) {
+        assert(numread == _encoder->bytes_written());
+        string footer;
+        _encoder->encode_footer(footer);
+        if (fwrite(footer.data(), 1, footer.size(), logfile) != footer.size()) {
+            cerr << "Failed to write logfile " << _logfilename << endl;
+            exit(1);
+        }
+    } else {
+        assert(numread == _numRecords * sizeof(LogRecord));
     }
     fclose(logfile);
-    delete[] timeRec;
-    delete[] typeRec;
-    delete[] idRec;
-    delete[] evRec;
-    delete[] val1Rec;
-    delete[] val2Rec;
+    fclose(_logfile);
 }
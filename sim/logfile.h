@@ -19,6 +19,21 @@
 
 class Logfile;
 class Logger;
+class LogWriter;
+class TraceEncoder;
+
+// One trace record, laid out exactly as it is stored in the log file.
+#pragma pack(push, 1)
+struct LogRecord {
+    double _time;
+    uint32_t _type;
+    uint32_t _id;
+    uint32_t _ev;
+    double _val1;
+    double _val2;
+    double _val3;
+};
+#pragma pack(pop)
 
 class RawLogEvent {
  public:
@@ -45,6 +60,17 @@ class Logfile {
     void writeRecord(uint32_t type, uint32_t id, uint32_t ev, 
                      double val1, double val2, double val3); // prepend uint64_t time
     void addLogger(Logger& logger);
+    // Records are packed into large batches in memory.  With the async
+    // writer (the default) a background thread writes the batches out;
+    // otherwise they are written from the simulation thread.  Must be
+    // called before the Logfile is constructed.
+    static void set_async_writer(bool async) {_async_writer = async;}
+    // RAW stores the records as they are laid out in LogRecord;
+    // COLUMNAR stores them compressed, with an index by type and id
+    // (see trace_codec.h).  Must be called before the Logfile is
+    // constructed.
+    enum format {RAW, COLUMNAR};
+    static void set_format(format f) {_format = f;}
     simtime_picosec _starttime;
  private:
     EventList& _eventlist;
@@ -53,9 +79,14 @@ class Logfile {
     void transposeLog();
     stringstream _preamble;
     string _logfilename;
+    string _recordfilename;
     FILE* _logfile;
+    LogWriter* _writer;
+    TraceEncoder* _encoder;
     //bool _startedTrace;
     long int _numRecords;
+    static bool _async_writer;
+    static format _format;
 };
 
 #endif
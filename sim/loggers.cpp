@@ -22,18 +22,28 @@ void LoggedManager::dump_idmap() {
     fout.close();
 }
 
-LoggedManager Logged::_logged_manager;
-
 string Logger::event_to_str(RawLogEvent& event) {
     return event.str();
 }
 
 QueueLoggerFactory::QueueLoggerFactory(Logfile* lg, QueueLoggerType logtype, EventList& eventlist)
-    :_logfile(lg), _logger_type(logtype), _eventlist(eventlist)
+    :_logfile(lg), _logger_type(logtype), _eventlist(eventlist), _lazy(false), _lazy_logger(*this)
 {
 };
 
 QueueLogger *QueueLoggerFactory::createQueueLogger() {
+    if (_lazy)
+        return &_lazy_logger;
+    return newQueueLogger();
+}
+
+void QueueLoggerLazy::logQueue(BaseQueue& queue, QueueEvent ev, Packet& pkt) {
+    QueueLogger* logger = _factory.newQueueLogger();
+    queue.setLogger(logger);
+    logger->logQueue(queue, ev, pkt);
+}
+
+QueueLogger *QueueLoggerFactory::newQueueLogger() {
     QueueLogger* queue_logger = 0;
     switch(_logger_type) {
     case LOGGER_SIMPLE:
@@ -95,7 +95,21 @@ class MultipathTcpLoggerSimple: public MultipathTcpLogger {
 // what type of logging we want right now - just configure the
 // QueueLoggerManager, and it will create QueueLoggers when requested
 // according to its config.
+class QueueLoggerFactory;
+
+// Stands in for the logger of a queue that hasn't logged anything yet.
+// On the queue's first event it creates the queue's real logger and
+// hands it to the queue.
+class QueueLoggerLazy : public QueueLogger {
+public:
+    QueueLoggerLazy(QueueLoggerFactory& factory) : _factory(factory) {}
+    virtual void logQueue(BaseQueue& queue, QueueEvent ev, Packet& pkt);
+private:
+    QueueLoggerFactory& _factory;
+};
+
 class QueueLoggerFactory {
+    friend class QueueLoggerLazy;
 public:
     enum QueueLoggerType {LOGGER_SIMPLE, LOGGER_SAMPLING, MULTIQUEUE_SAMPLING, LOGGER_EMPTY};
     QueueLoggerFactory(Logfile* lg, QueueLoggerType logtype, EventList& eventlist);
@@ -103,12 +117,20 @@ public:
     void set_sample_period(simtime_picosec sample_period) {
         _sample_period = sample_period;
     }
+    // Create each queue's logger when the queue first logs something,
+    // so that queues which never see a packet cost no logger and no
+    // sampling events.  Loggers get different IDs and sampling starts
+    // when the logger is created, so it is off by default.
+    void set_lazy(bool lazy) {_lazy = lazy;}
 private:
+    QueueLogger* newQueueLogger();
     Logfile* _logfile;
     QueueLoggerType _logger_type;
     simtime_picosec _sample_period;
     EventList& _eventlist;
     vector <QueueLogger*> _loggers;
+    bool _lazy;
+    QueueLoggerLazy _lazy_logger;
 };
 
 class QueueLoggerSimple : public QueueLogger {
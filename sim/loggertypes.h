@@ -2,6 +2,7 @@
 #ifndef LOGGERTYPES_H
 #define LOGGERTYPES_H
 #include <vector>
+#include "simcontext.h"
 
 class Packet;
 class PacketFlow;
@@ -35,19 +36,17 @@ private:
 class Logged {
  public:
     typedef uint32_t id_t;
-    Logged(const string& name) {_name=name; _log_id=LASTIDNUM; Logged::LASTIDNUM++; _logged_manager.add_logged(this);}
+    Logged(const string& name) {_name=name; _log_id=SimContext::current().addLogged(this);}
     virtual ~Logged() {}
     virtual void setName(const string& name) { _name=name; }
     virtual const string& str() { return _name; };
     inline id_t get_id() const {return _log_id;}
     // usually things get their own IDs, but flows, for example, get associated with the sender ID
-    void set_id(id_t id) {assert(id < LASTIDNUM); _log_id = id;}
+    void set_id(id_t id) {assert(id < SimContext::current().nextLoggedId()); _log_id = id;}
     string _name;
-    static void dump_idmap() {_logged_manager.dump_idmap();}
+    static void dump_idmap() {SimContext::current().dump_idmap();}
  private:
     id_t _log_id;
-    static id_t LASTIDNUM;
-    static LoggedManager _logged_manager;
 };
 
 class Logger {
@@ -726,10 +726,7 @@ SwiftSink::receivePacket(Packet& pkt) {
     if (seqno == _cumulative_ack+1) { // it's the next expected seq no
 	_cumulative_ack = seqno + size - 1;
 	// are there any additional received packets we can now ack?
-	while (!_received.empty() && (_received.front() == _cumulative_ack+1) ) {
-	    _received.pop_front();
-	    _cumulative_ack += size;
-	}
+	_cumulative_ack += _received.advance(_cumulative_ack) * size;
     } else if (seqno < _cumulative_ack+1) {
 	// it is before the next expected sequence - must be a spurious retransmit.
 	// We want to see if this happens - it generally shouldn't
@@ -737,24 +734,11 @@ SwiftSink::receivePacket(Packet& pkt) {
     } else {
         // it's not the next expected sequence number
 	if (_received.empty()) {
-	    _received.push_front(seqno);
 	    //it's a drop - in this simulator there are no reorderings.
 	    // [Note: if we ever add multipath, fix this!]
 	    _drops += (size + seqno-_cumulative_ack-1)/size;
-	} else if (seqno > _received.back()) {
-            // likely case - new packet above a hole
-	    _received.push_back(seqno);
-	} else {
-            // uncommon case - it fills a hole, but not first hole
-	    list<uint64_t>::iterator i;
-	    for (i = _received.begin(); i != _received.end(); i++) {
-		if (seqno == *i) break; // it's a bad retransmit
-		if (seqno < (*i)) {
-		    _received.insert(i, seqno);
-		    break;
-		}
-	    }
 	}
+	_received.insert(seqno, size); // false if it's a bad retransmit
     }
     // whatever the cumulative ack does (eg filling holes), the echoed TS is always from
     // the packet we just received
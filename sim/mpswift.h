@@ -8,6 +8,7 @@
 
 #include <list>
 #include "config.h"
+#include "receive_bitmap.h"
 #include "network.h"
 #include "swiftpacket.h"
 #include "eventlist.h"
@@ -173,8 +174,7 @@ class SwiftSink : public PacketSink, public DataReceiver {
     uint32_t get_id(){ return id;}
     virtual const string& nodename() { return _nodename; }
 
-    list<SwiftAck::seq_t> _received; /* list of packets above a hole, that 
-				      we've received */
+    ReceiveBitmap _received; /* packets above a hole, that we've received */
 
 
     uint64_t cumulative_ack() {
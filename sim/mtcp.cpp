@@ -636,26 +636,10 @@ MultipathTcpSink::receivePacket(Packet& pkt) {
     if (seqno == _cumulative_ack+1) { // it's the next expected seq no
         _cumulative_ack = seqno + size - 1;
         // are there any additional received packets we can now ack?
-        while (!_received.empty() && (_received.front() == _cumulative_ack+1) ) {
-            _received.pop_front();
-            _cumulative_ack+= size;
-        }
+        _cumulative_ack += _received.advance(_cumulative_ack) * size;
     } else if (seqno < _cumulative_ack+1) { //must have been a bad retransmit
     } else { // it's not the next expected sequence number
-        if (_received.empty()) {
-            _received.push_front(seqno);
-        } else if (seqno > _received.back()) { // likely case
-            _received.push_back(seqno);
-        } else { // uncommon case - it fills a hole
-            list<uint64_t>::iterator i;
-            for (i = _received.begin(); i != _received.end(); i++) {
-                if (seqno == *i) break; // it's a bad retransmit
-                if (seqno < (*i)) {
-                    _received.insert(i, seqno);
-                    break;
-                }
-            }
-        }
+        _received.insert(seqno, size); // false if it's a bad retransmit
     }
 #endif
 }        
@@ -9,6 +9,7 @@
 #include <math.h>
 #include <list>
 #include "config.h"
+#include "receive_bitmap.h"
 #include "network.h"
 #include "tcp.h"
 #include "eventlist.h"
@@ -106,7 +107,7 @@ public:
 
     void doNextEvent();
     virtual const string& nodename() { return _nodename; }
-    list<TcpAck::seq_t> _received; // list of packets above a hole, that we've received
+    ReceiveBitmap _received; // packets above a hole, that we've received
 private:
 
     // Connectivity
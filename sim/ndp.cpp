@@ -3,6 +3,7 @@
 #include <iostream>
 #include <algorithm>
 #include "ndp.h"
+#include "flowstats.h"
 #include "queue.h"
 #include <stdio.h>
 #include "switch.h"
@@ -55,12 +56,13 @@ double NdpSink::_g = 1.0/16.0;
 int ooo_distance = 0;
 
 NdpSrc::NdpSrc(NdpLogger* logger, TrafficLogger* pktlogger, EventList &eventlist, bool rts, NdpRTSPacer* rts_pacer)
-    : EventSource(eventlist,"ndp"), _logger(logger), _flow(pktlogger)
+    : EventSource(eventlist,"ndp"), _rtx_timer(*this), _logger(logger), _flow(pktlogger)
 {
     _mss = Packet::data_packet_size();
 
     _rts = rts;
     _rts_pacer = rts_pacer;
+    _rts_slot = UINT32_MAX;
     _stop_time = 0;
     _base_rtt = timeInf;
     _acked_packets = 0;
@@ -87,6 +89,8 @@ NdpSrc::NdpSrc(NdpLogger* logger, TrafficLogger* pktlogger, EventList &eventlist
     _mdev = 0;
     _drops = 0;
     _flow_size = ((uint64_t)1)<<63;
+    _flow_start_time = 0;
+    _fct_recorded = false;
     _last_pull = 0;
     _max_pull = 0;
     _pull_window = 0;
@@ -101,6 +105,8 @@ NdpSrc::NdpSrc(NdpLogger* logger, TrafficLogger* pktlogger, EventList &eventlist
 
     _rtx_timeout_pending = false;
     _rtx_timeout = timeInf;
+    _rtx_scanner = NULL;
+    _rtx_scanner_id = 0;
     _node_num = _global_node_count++;
     _nodename = "ndpsrc " + to_string(_node_num);
 
@@ -269,13 +275,14 @@ void NdpSrc::set_paths(vector<const Route*>* rt_list){
 
 void NdpSrc::startflow(){
     cout << "startflow " <<  _flow._name <<  " CWND " << _cwnd << " rts " << _rts << " at " << timeAsUs(eventlist().now()) << endl;
+    _flow_start_time = eventlist().now();
     _highest_sent = 0;
     _last_acked = 0;
     
     _acked_packets = 0;
     _packets_sent = 0;
     _rtx_timeout_pending = false;
-    _rtx_timeout = timeInf;
+    set_rto_timeout(timeInf);
     _pull_window = 0;
     
     _flight_size = 0;
@@ -313,7 +320,7 @@ void NdpSrc::startflow(){
             }
         
             if (_rts_pacer){
-                _rts_pacer->enqueue_rts(p);
+                _rts_pacer->enqueue_rts(p, _rts_slot);
                 //cout << "Enqueue RTS packet requesting grant " << nodename()  << endl;
             }
             else {
@@ -337,6 +344,8 @@ void NdpSrc::connect(Route* routeout, Route* routeback, NdpSink& sink, simtime_p
     _flow.set_id(get_id()); // identify the packet flow with the NDP source that generated it
     _flow._name = _name;
     _sink->connect(*this, routeback);
+    if (_rts_pacer)
+        _rts_slot = _rts_pacer->add_flow(_flow.flow_id());
 
     if (starttime != TRIGGER_START) {
         eventlist().sourceIsPending(*this,starttime);
@@ -659,6 +668,10 @@ void NdpSrc::processAck(const NdpAck& ack) {
 
     if (cum_ackno >= _flow_size){
         cout << "Flow " << _name << " flow_id " << flow_id() << " finished at " << timeAsUs(eventlist().now()) << " total bytes " << cum_ackno << endl;
+        if (!_fct_recorded) {
+            SimContext::current().flowStats().flow_finished(_flow_size, _flow_start_time, eventlist().now());
+            _fct_recorded = true;
+        }
         if (_end_trigger) {
             _end_trigger->activate();
         }
@@ -926,7 +939,7 @@ int NdpSrc::send_packet(NdpPull::seq_t pacer_no) {
         _rtx_packets_sent++;
         update_rtx_time();
         if (_rtx_timeout == timeInf) {
-            _rtx_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }
     } else {
         // there are no packets in the RTX queue, so we'll send a new one
@@ -1012,7 +1025,7 @@ int NdpSrc::send_packet(NdpPull::seq_t pacer_no) {
         _first_sent_times[p->seqno()] = eventlist().now();
 
         if (_rtx_timeout == timeInf) {
-            _rtx_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }
     }
     return packets_sent;
@@ -1022,7 +1035,7 @@ void
 NdpSrc::update_rtx_time() {
     //simtime_picosec now = eventlist().now();
     if (_sent_times.empty()) {
-        _rtx_timeout = timeInf;
+        set_rto_timeout(timeInf);
         return;
     }
     map<NdpPacket::seq_t, simtime_picosec>::iterator i;
@@ -1035,7 +1048,7 @@ NdpSrc::update_rtx_time() {
         }
         c++;
     }
-    _rtx_timeout = first_senttime + _rto;
+    set_rto_timeout(first_senttime + _rto);
 }
  
 void 
@@ -1138,6 +1151,12 @@ NdpSrc::retransmit_packet() {
     update_rtx_time();
 }
 
+void NdpSrc::set_rto_timeout(simtime_picosec timeout) {
+    _rtx_timeout = timeout;
+    if (_rtx_scanner)
+        _rtx_scanner->deadlineChanged(_rtx_scanner_id, timeout);
+}
+
 void NdpSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
 #ifndef RESEND_ON_TIMEOUT
     return;  // if we're using RTS, we shouldn't need to also use
@@ -1165,7 +1184,7 @@ void NdpSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
             cout << "late_rtx_timeout: " << _rtx_timeout << " now: " << now << " now+rto: " << now + _rto << " rto: " << _rto << endl;
             too_early = 0;
         }
-        eventlist().sourceIsPendingRel(*this, too_early);
+        _rtx_timer.armRel(too_early);
     }
 }
 
@@ -1178,7 +1197,7 @@ void NdpSrc::log_rtt(simtime_picosec sent_time) {
 }
 
 void NdpSrc::doNextEvent() {
-    if (_rtx_timeout_pending) {
+    if (_rtx_timer.expired()) {
         _rtx_timeout_pending = false;
     
         if (_logger) _logger->logNdp(*this, NdpLogger::NDP_TIMEOUT);
@@ -1215,6 +1234,7 @@ NdpSink::NdpSink(EventList& event, linkspeed_bps linkspeed, double pull_rate_mod
 {
     _src = 0;
     _pacer = new NdpPullPacer(event, linkspeed, pull_rate_modifier);
+    _pull_slot = UINT32_MAX;
     //_pacer = new NdpPullPacer(event, "/Users/localadmin/poli/new-datacenter-protocol/data/1500.recv.cdf.pretty");
     
     _nodename = "ndpsink";
@@ -1253,6 +1273,7 @@ NdpSink::NdpSink(NdpPullPacer* pacer) : DataReceiver("ndp_sink"),_cumulative_ack
 {
     _src = 0;
     _pacer = pacer;
+    _pull_slot = UINT32_MAX;
     _nodename = "ndpsink";
     _priority = 100; // lower is better
     _end_trigger = 0;
@@ -1300,6 +1321,7 @@ void NdpSink::log_me() {
 void NdpSink::connect(NdpSrc& src, Route* route)
 {
     _src = &src;
+    _pull_slot = _pacer->add_flow(flow_id());
     switch (_route_strategy) {
     case SINGLE_PATH:
     case ECMP_FIB:
@@ -1549,35 +1571,20 @@ void NdpSink::receivePacket(Packet& pkt) {
     if (seqno == _cumulative_ack+1) { // it's the next expected seq no
                 _cumulative_ack = seqno + size - 1;
                 // are there any additional received packets we can now ack?
-                while (!_received.empty() && (_received.front() == _cumulative_ack+1) ) {
-                        _received.pop_front();
+                for (uint32_t n = _received.advance(_cumulative_ack); n > 0; n--) {
                         _cumulative_ack+= size;
                         if (_buffer_logger) _buffer_logger->logBuffer(ReorderBufferLogger::BUF_DEQUEUE);
                 }
     } else if (seqno < _cumulative_ack+1) {
                 //must have been a bad retransmit
     } else { // it's not the next expected sequence number
-                if (_received.empty()) {
-                        _received.push_front(seqno);
-                        if (_buffer_logger) _buffer_logger->logBuffer(ReorderBufferLogger::BUF_ENQUEUE);
-                        
-                        //commenting out the code below, probably copied from TCP and innacurate for NDP where reordering is expected
-                        //it's a drop in this simulator there are no reorderings.
-                        //_drops += (size + seqno-_cumulative_ack-1)/size;
-                } else if (seqno > _received.back()) { // likely case
-                        _received.push_back(seqno);
+                //commenting out the code below, probably copied from TCP and innacurate for NDP where reordering is expected
+                //it's a drop in this simulator there are no reorderings.
+                //_drops += (size + seqno-_cumulative_ack-1)/size;
+
+                // insert returns false for a bad retransmit
+                if (_received.insert(seqno, size)) {
                         if (_buffer_logger) _buffer_logger->logBuffer(ReorderBufferLogger::BUF_ENQUEUE);
-                } 
-                else { // uncommon case - it fills a hole
-                        list<uint64_t>::iterator i;
-                        for (i = _received.begin(); i != _received.end(); i++) {
-                                if (seqno == *i) break; // it's a bad retransmit
-                                if (seqno < (*i)) {
-                                        _received.insert(i, seqno);
-                                        if (_buffer_logger) _buffer_logger->logBuffer(ReorderBufferLogger::BUF_ENQUEUE);
-                                        break;
-                                }
-                    }
                 }
                 if (_ooo < _received.size())
                         _ooo = _received.size();
@@ -1806,13 +1813,27 @@ void NdpSink::permute_paths() {
 
 double* NdpPullPacer::_pull_spacing_cdf = NULL;
 int NdpPullPacer::_pull_spacing_cdf_count = 0;
+uint32_t NdpPullPacer::_pull_batch = 1;
+bool NdpPullPacer::_active_order = false;
+
+BasePullQueue<NdpPull>* NdpPullPacer::new_pull_queue() {
+#ifdef FIFO_PULL_QUEUE
+    return new FifoPullQueue<NdpPull>();
+#elif defined(FAIR_PULL_QUEUE)
+    if (_active_order)
+        return new FlowSlotPullQueue<NdpPull>();
+    return new FairPullQueue<NdpPull>();
+#else
+    return new PrioPullQueue<NdpPull>(_active_order);
+#endif
+}
 
 
 /* Every NdpSink needs an NdpPullPacer to pace out it's PULL packets.
    Multiple incoming flows at the same receiving node must share a
    single pacer */
 NdpPullPacer::NdpPullPacer(EventList& event, linkspeed_bps linkspeed, double pull_rate_modifier)  : 
-    EventSource(event, "ndp_pacer"), _last_pull(0)
+    EventSource(event, "ndp_pacer"), _pull_queue(new_pull_queue()), _last_pull(0)
 {
     _packet_drain_time = (simtime_picosec)((Packet::data_packet_size()+NdpPacket::ACKSIZE) * (pow(10.0,12.0) * 8) / linkspeed) / pull_rate_modifier;
   //cout << "Packet drain time " << timeAsUs(_packet_drain_time) << "us" << endl;
@@ -1821,7 +1842,7 @@ NdpPullPacer::NdpPullPacer(EventList& event, linkspeed_bps linkspeed, double pul
 }
 
 NdpPullPacer::NdpPullPacer(EventList& event, char* filename)  : 
-    EventSource(event, "ndp_pacer"), _last_pull(0)
+    EventSource(event, "ndp_pacer"), _pull_queue(new_pull_queue()), _last_pull(0)
 {
     int t;
     _packet_drain_time = 0;
@@ -1845,6 +1866,10 @@ NdpPullPacer::NdpPullPacer(EventList& event, char* filename)  :
     _pacer_no = 0;
 }
 
+NdpPullPacer::~NdpPullPacer() {
+    delete _pull_queue;
+}
+
 void NdpPullPacer::log_me() {
     // avoid looping
     if (_log_me == true)
@@ -1884,21 +1909,12 @@ void NdpPullPacer::sendPacket(Packet* ack, NdpPacket::seq_t rcvd_pacer_no, NdpSi
         receiver->increase_window();
     }
 
-    simtime_picosec drain_time;
-
-    if (_packet_drain_time>0) {
-        drain_time = _packet_drain_time;
-    } else {
-        int t = (int)(drand()*_pull_spacing_cdf_count);
-        drain_time = 10*timeFromNs(_pull_spacing_cdf[t])/20;
-        //cout << "Drain time is " << timeAsUs(drain_time);
-    }
-            
+    simtime_picosec drain_time = pull_spacing();
 
-    if (_pull_queue.empty()){
-        simtime_picosec delta = eventlist().now()-_last_pull;
+    if (idle()){
+        simtime_picosec next_pull = _last_pull + drain_time;
     
-        if (delta >= drain_time){
+        if (eventlist().now() >= next_pull){
             //send out as long as last NACK/ACK was sent more than packetDrain time ago.
             ack->flow().logTraffic(*ack,*this,TrafficLogger::PKT_SEND);
 
@@ -1922,7 +1938,7 @@ void NdpPullPacer::sendPacket(Packet* ack, NdpPacket::seq_t rcvd_pacer_no, NdpSi
             _last_pull = eventlist().now();
             return;
         } else {
-            eventlist().sourceIsPendingRel(*this,drain_time - delta);
+            eventlist().sourceIsPending(*this,next_pull);
         }
     }
 
@@ -1952,7 +1968,7 @@ void NdpPullPacer::sendPacket(Packet* ack, NdpPacket::seq_t rcvd_pacer_no, NdpSi
     }
     pull_pkt->flow().logTraffic(*pull_pkt,*this,TrafficLogger::PKT_CREATE);
 
-    _pull_queue.enqueue(*pull_pkt, receiver->priority());
+    _pull_queue->enqueue_slot(*pull_pkt, receiver->pull_slot(), receiver->priority());
 
     ack->flow().logTraffic(*ack,*this,TrafficLogger::PKT_SEND);
     //cout << "Sending Plain ACK with pullno " <<  ((NdpAck*)ack)->pullno() << endl;
@@ -1981,31 +1997,37 @@ void NdpPullPacer::sendPacket(Packet* ack, NdpPacket::seq_t rcvd_pacer_no, NdpSi
 // queue too, causing any retransmitted packets from the tail of the
 // file to be received earlier
 void NdpPullPacer::release_pulls(uint32_t flow_id, NdpSink* receiver) {
-    _pull_queue.flush_flow(flow_id, receiver->priority());
+    _pull_queue->flush_slot(receiver->pull_slot(), flow_id, receiver->priority());
 }
 
 void NdpPullPacer::enqueue_pull(NdpPull* pkt, NdpSink* receiver){
-    simtime_picosec delta = eventlist().now()-_last_pull;
-    bool should_tx = _pull_queue.empty() && (_last_pull==0 || (delta >= _packet_drain_time));
-    bool should_schedule = _pull_queue.empty() && delta < _packet_drain_time;
+    simtime_picosec next_pull = _last_pull + _packet_drain_time;
+    bool should_tx = idle() && (_last_pull==0 || eventlist().now() >= next_pull);
+    bool should_schedule = idle() && eventlist().now() < next_pull;
 
-    _pull_queue.enqueue(*pkt, receiver->priority());
+    _pull_queue->enqueue_slot(*pkt, receiver->pull_slot(), receiver->priority());
     /*
     if (_log_me){
-        cout << "Enqueue pull, pull queue size is " << _pull_queue.pull_count() << " should_tx is " << should_tx << " delta " << timeAsUs(delta) << " drain " << timeAsUs(_packet_drain_time) << endl;
+        cout << "Enqueue pull, pull queue size is " << _pull_queue->pull_count() << " should_tx is " << should_tx << " delta " << timeAsUs(delta) << " drain " << timeAsUs(_packet_drain_time) << endl;
     }
     */
   
     if (should_tx)
         eventlist().sourceIsPendingRel(*this,0);
     else if (should_schedule){
-        eventlist().sourceIsPendingRel(*this,_packet_drain_time-delta);
+        eventlist().sourceIsPending(*this,next_pull);
     }
 }
 
 
 void NdpPullPacer::doNextEvent(){
-    if (_pull_queue.empty()) {
+    if (_batch.empty()) {
+        for (uint32_t i = 0; i < _pull_batch && !_pull_queue->empty(); i++) {
+            NdpPull* pkt = _pull_queue->dequeue();
+            _batch.push(pkt);
+        }
+    }
+    if (_batch.empty()) {
         // this can happen if we released all the acks at the end of
         // the connection.  we didn't cancel the timer, so we end up
         // here.
@@ -2016,8 +2038,27 @@ void NdpPullPacer::doNextEvent(){
         return;
     }
 
-    Packet *pkt = _pull_queue.dequeue();
+    send_pull(_batch.pop());
+    _last_pull = eventlist().now();
 
+    simtime_picosec drain_time = pull_spacing();
+    if (!idle()){
+        eventlist().sourceIsPending(*this,eventlist().now() + drain_time);//*(0.5+drand()));
+        /*
+        if (_log_me){
+            cout << "Next pull planned for "<<timeAsUs(eventlist().now()+drain_time)<<endl;
+        }
+        */
+    }
+    else {
+        /*
+        if (_log_me)
+            cout << "Empty pacer queue at " << timeAsMs(eventlist().now()) << endl;
+        */
+    }
+}
+
+void NdpPullPacer::send_pull(NdpPull* pkt){
     //   cout << "Sending NACK for packet " << nack->ackno() << endl;
     pkt->flow().logTraffic(*pkt,*this,TrafficLogger::PKT_SEND);
     if (pkt->flow().log_me()) {
@@ -2039,33 +2080,14 @@ void NdpPullPacer::doNextEvent(){
         cout << "Pacer sending PULL at "<<timeAsUs(eventlist().now())<<endl;
     }
     */
+}
 
-    _last_pull = eventlist().now();
-   
-    simtime_picosec drain_time;
-
+simtime_picosec NdpPullPacer::pull_spacing(){
     if (_packet_drain_time>0)
-        drain_time = _packet_drain_time;
-    else {
-        int t = (int)(drand()*_pull_spacing_cdf_count);
-        drain_time = 10*timeFromNs(_pull_spacing_cdf[t])/20;
-        //cout << "Drain time is " << timeAsUs(drain_time);
-    }
-
-    if (!_pull_queue.empty()){
-        eventlist().sourceIsPendingRel(*this,drain_time);//*(0.5+drand()));
-        /*
-        if (_log_me){
-            cout << "Next pull planned for "<<timeAsUs(eventlist().now()+drain_time)<<endl;
-        }
-        */
-    }
-    else {
-        /*
-        if (_log_me)
-            cout << "Empty pacer queue at " << timeAsMs(eventlist().now()) << endl;
-        */
-    }
+        return _packet_drain_time;
+    int t = (int)(drand()*_pull_spacing_cdf_count);
+    //cout << "Drain time is " << timeAsUs(10*timeFromNs(_pull_spacing_cdf[t])/20);
+    return 10*timeFromNs(_pull_spacing_cdf[t])/20;
 }
 
 
@@ -2074,19 +2096,31 @@ void NdpPullPacer::doNextEvent(){
 NdpRTSPacer::NdpRTSPacer(EventList& event, linkspeed_bps linkspeed, double pull_rate_modifier)  : 
     EventSource(event, "ndp_pacer")
 {
+#ifdef RTS_FIFO_PULL_QUEUE
+    _rts_queue = new FifoPullQueue<NdpRTS>();
+#else
+    if (NdpPullPacer::active_order())
+        _rts_queue = new FlowSlotPullQueue<NdpRTS>();
+    else
+        _rts_queue = new FairPullQueue<NdpRTS>();
+#endif
     _last_rts = 0;
     _first = true;
     _packet_drain_time = (simtime_picosec)((Packet::data_packet_size()+NdpPacket::ACKSIZE) * (pow(10.0,12.0) * 8) / linkspeed) / pull_rate_modifier;
 }
 
-void NdpRTSPacer::enqueue_rts(NdpRTS* pkt){
+NdpRTSPacer::~NdpRTSPacer() {
+    delete _rts_queue;
+}
+
+void NdpRTSPacer::enqueue_rts(NdpRTS* pkt, uint32_t slot){
     simtime_picosec delta = eventlist().now()-_last_rts;
-    bool should_tx = _rts_queue.empty() && (_first || (delta >= _packet_drain_time));
-    bool should_schedule = _rts_queue.empty() && delta < _packet_drain_time;
+    bool should_tx = _rts_queue->empty() && (_first || (delta >= _packet_drain_time));
+    bool should_schedule = _rts_queue->empty() && delta < _packet_drain_time;
 
-    _rts_queue.enqueue(*pkt);
+    _rts_queue->enqueue_slot(*pkt, slot);
 
-    //cout << "Enqueue RTS, RTS queue size is " << _rts_queue.pull_count() << " should_tx is " << should_tx << " delta " << timeAsUs(delta) << " drain " << timeAsUs(_packet_drain_time) << endl;
+    //cout << "Enqueue RTS, RTS queue size is " << _rts_queue->pull_count() << " should_tx is " << should_tx << " delta " << timeAsUs(delta) << " drain " << timeAsUs(_packet_drain_time) << endl;
 
   
     if (should_tx)
@@ -2098,11 +2132,11 @@ void NdpRTSPacer::enqueue_rts(NdpRTS* pkt){
 
 
 void NdpRTSPacer::doNextEvent(){
-    if (_rts_queue.empty()) {
+    if (_rts_queue->empty()) {
         cout << "RTS  queue empty at " << timeAsUs(eventlist().now()) << endl;;
         return;
     }
-    Packet *pkt = _rts_queue.dequeue();
+    Packet *pkt = _rts_queue->dequeue();
     pkt->sendOn();
 
     //cout << "RTS Pacer sending PULL at "<<timeAsUs(eventlist().now())<<endl;
@@ -2110,7 +2144,7 @@ void NdpRTSPacer::doNextEvent(){
     _last_rts = eventlist().now();
    
 
-    if (!_rts_queue.empty()){
+    if (!_rts_queue->empty()){
         eventlist().sourceIsPendingRel(*this,_packet_drain_time);
     }
     else {
@@ -2124,25 +2158,12 @@ void NdpRTSPacer::doNextEvent(){
 ////////////////////////////////////////////////////////////////
 
 NdpRtxTimerScanner::NdpRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
-  : EventSource(eventlist,"RtxScanner"), 
-    _scanPeriod(scanPeriod)
+  : RtxTimerScanner<NdpSrc>(scanPeriod, 0, eventlist)
 {
-    eventlist.sourceIsPendingRel(*this, 0);
 }
 
 void 
 NdpRtxTimerScanner::registerNdp(NdpSrc &tcpsrc)
 {
-    _tcps.push_back(&tcpsrc);
-}
-
-void
-NdpRtxTimerScanner::doNextEvent() 
-{
-    simtime_picosec now = eventlist().now();
-    tcps_t::iterator i;
-    for (i = _tcps.begin(); i!=_tcps.end(); i++) {
-        (*i)->rtx_timer_hook(now,_scanPeriod);
-    }
-    eventlist().sourceIsPendingRel(*this, _scanPeriod);
+    tcpsrc.set_rtx_scanner(this, addSrc(tcpsrc));
 }
@@ -10,11 +10,15 @@
 #include <list>
 #include <map>
 #include "config.h"
+#include "receive_bitmap.h"
+#include "circular_buffer.h"
 #include "network.h"
 #include "ndppacket.h"
 #include "priopullqueue.h"
 #include "trigger.h"
 #include "eventlist.h"
+#include "timerwheel.h"
+#include "rtxscanner.h"
 
 #define timeInf 0
 #define NDP_PACKET_SCATTER
@@ -86,6 +90,11 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
     void replace_route(Route* newroute);
 
     virtual void rtx_timer_hook(simtime_picosec now,simtime_picosec period);
+    void set_rtx_scanner(RtxTimerScanner<NdpSrc>* scanner, uint32_t id) {
+        _rtx_scanner = scanner;
+        _rtx_scanner_id = id;
+    }
+    void set_rto_timeout(simtime_picosec timeout); // always use this to set _rtx_timeout
     
     //used by all routing strategies except SINGLE and ECMP_FIB
     void set_paths(vector<const Route*>* rt);
@@ -159,6 +168,9 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
  
     simtime_picosec _rtx_timeout;
     bool _rtx_timeout_pending;
+    Timer _rtx_timer;
+    RtxTimerScanner<NdpSrc>* _rtx_scanner;
+    uint32_t _rtx_scanner_id;
     const Route* _route;
 
     int choose_route();
@@ -195,6 +207,7 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
 
     bool _rts;
     NdpRTSPacer* _rts_pacer;
+    uint32_t _rts_slot; // our slot in _rts_pacer's queue
 
     enum  FeedbackType {ACK, ECN, NACK, BOUNCE, UNKNOWN};
     static const int HIST_LEN=12;
@@ -217,6 +230,8 @@ class NdpSrc : public PacketSink, public EventSource, public TriggerTarget {
     NdpPull::seq_t _last_pull;
     NdpPull::seq_t _max_pull;
     uint64_t _flow_size;  //The flow size in bytes.  Stop sending after this amount.
+    simtime_picosec _flow_start_time;
+    bool _fct_recorded;
     simtime_picosec _stop_time;
     map <NdpPacket::seq_t, NdpPacket*> _rtx_queue; //Packets queued for (hopefuly) imminent retransmission
 };
@@ -253,7 +268,7 @@ class NdpSink : public PacketSink, public DataReceiver {
     void set_src(uint32_t s) {_srcaddr = s;}
     void set_end_trigger(Trigger& trigger);
 
-    list<NdpAck::seq_t> _received; // list of packets above a hole, that we've received
+    ReceiveBitmap _received; // packets above a hole, that we've received
  
     NdpSrc* _src;
 
@@ -279,6 +294,7 @@ class NdpSink : public PacketSink, public DataReceiver {
 
     void set_priority(int priority) {_priority = priority;}
     inline int priority() const {return _priority;}
+    inline uint32_t pull_slot() const {return _pull_slot;}
     static bool _oversubscribed_congestion_control;
     static double _g;
  private:
@@ -310,6 +326,7 @@ class NdpSink : public PacketSink, public DataReceiver {
     uint64_t _total_received;
     NdpPacket::seq_t _highest_seqno;
     int _priority; // this receiver's priority relative to others on same pacer - low is best
+    uint32_t _pull_slot; // our slot in _pacer's queue, from when we connected
 
     uint32_t _parked_cwnd;
     uint32_t _parked_increase;
@@ -345,6 +362,7 @@ class NdpPullPacer : public EventSource {
  public:
     NdpPullPacer(EventList& ev, linkspeed_bps linkspeed, double pull_rate_modifier);  
     NdpPullPacer(EventList& ev, char* fn);  
+    ~NdpPullPacer();
     // pull_rate_modifier is the multiplier of link speed used when
     // determining pull rate.  Generally 1 for FatTree, probable 2 for BCube
     // as there are two distinct paths between each node pair.
@@ -361,21 +379,40 @@ class NdpPullPacer : public EventSource {
     //void set_preferred_flow(int id) { _preferred_flow = id;cout << "Preferring flow "<< id << endl;};
     NdpPull::seq_t pacer_no() {return _pacer_no;}
 
+    // Take up to this many pulls off the pull queue at a time rather
+    // than one.  Each is still sent in its own slot, a drain time
+    // apart; only the choice of which flows get pulled is made early.
+    // Default 1.
+    static void set_pull_batch(uint32_t batch) {assert(batch > 0); _pull_batch = batch;}
+
+    // Round robin between flows in the order they became active
+    // (FlowSlotPullQueue) rather than flow id order (FairPullQueue).
+    // Cheaper with many senders, but pulls interleave differently, so
+    // it's off by default.  Applies to the RTS pacers too, and only to
+    // pacers created after it's set.
+    static void set_active_order(bool active_order) {_active_order = active_order;}
+    static bool active_order() {return _active_order;}
+
+    // a flow registers for the slot it passes with its pulls
+    uint32_t add_flow(flowid_t flow_id) {return _pull_queue->add_flow(flow_id);}
+
  private:
     void set_pacerno(Packet *pkt, NdpPull::seq_t pacer_no);
+    void send_pull(NdpPull* pkt);
+    // nothing queued or waiting for its slot
+    bool idle() {return _pull_queue->empty() && _batch.empty();}
+    simtime_picosec pull_spacing(); // the drain time for the next pull
 
     //#define FIFO_PULL_QUEUE
 #define FAIR_PULL_QUEUE
-#ifdef FIFO_PULL_QUEUE
-    FifoPullQueue<NdpPull> _pull_queue;
-#elifdef FAIR_PULL_QUEUE
-    FairPullQueue<NdpPull> _pull_queue;
-#else
-    PrioPullQueue<NdpPull> _pull_queue;
-#endif
+    BasePullQueue<NdpPull>* _pull_queue; // which one depends on the defines above
+    static BasePullQueue<NdpPull>* new_pull_queue();
+    static bool _active_order;
+    CircularBuffer<NdpPull*> _batch; // taken off _pull_queue, not yet sent
     simtime_picosec _last_pull;
     simtime_picosec _packet_drain_time;
     NdpPull::seq_t _pacer_no; // pull sequence number, shared by all connections on this pacer
+    static uint32_t _pull_batch;
 
     //pull distribution from real life
     static int _pull_spacing_cdf_count;
@@ -391,6 +428,7 @@ class NdpPullPacer : public EventSource {
 class NdpRTSPacer : public EventSource {
  public:
     NdpRTSPacer(EventList& ev, linkspeed_bps linkspeed, double pull_rate_modifier);  
+    ~NdpRTSPacer();
 
     // pull_rate_modifier is the multiplier of link speed used when
     // determining pull rate.  Generally 1 for FatTree, probable 2 for BCube
@@ -398,16 +436,14 @@ class NdpRTSPacer : public EventSource {
 
     virtual void doNextEvent();
 
-    void enqueue_rts(NdpRTS* pkt);
+    // a flow registers for the slot it passes with its RTSs
+    uint32_t add_flow(flowid_t flow_id) {return _rts_queue->add_flow(flow_id);}
+    void enqueue_rts(NdpRTS* pkt, uint32_t slot);
 
  private:
     //#define RTS_FIFO_PULL_QUEUE
 
-#ifdef RTS_FIFO_PULL_QUEUE
-    FifoPullQueue<NdpRTS> _rts_queue;
-#else
-    FairPullQueue<NdpRTS> _rts_queue;
-#endif
+    BasePullQueue<NdpRTS>* _rts_queue;
     
     simtime_picosec _last_rts;
     bool _first;
@@ -415,15 +451,10 @@ class NdpRTSPacer : public EventSource {
 };
 
 
-class NdpRtxTimerScanner : public EventSource {
+class NdpRtxTimerScanner : public RtxTimerScanner<NdpSrc> {
  public:
     NdpRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
-    void doNextEvent();
     void registerNdp(NdpSrc &tcpsrc);
- private:
-    simtime_picosec _scanPeriod;
-    typedef list<NdpSrc*> tcps_t;
-    tcps_t _tcps;
 };
 
 #endif
@@ -71,7 +71,7 @@ public:
   
     virtual inline void  strip_payload() {
         Packet::strip_payload(); _size = ACKSIZE;_trim_hop = _nexthop;
-        _trim_direction = _direction;
+        _trim_direction = get_direction();
     };
 
     virtual inline void set_route(const Route &route) {
@@ -117,7 +117,7 @@ protected:
     bool _last_packet;  // set to true in the last packet in a flow.
     int32_t _trim_hop;
     packet_direction _trim_direction;
-    static PacketDB<NdpPacket> _packetdb;
+    static thread_local PacketDB<NdpPacket> _packetdb;
 };
 
 class NdpAck : public Packet {
@@ -172,7 +172,7 @@ protected:
     int32_t _path_id; //see comment in NdpPull
     bool _pull;
     bool _ecn_echo;
-    static PacketDB<NdpAck> _packetdb;
+    static thread_local PacketDB<NdpAck> _packetdb;
 };
 
 
@@ -228,7 +228,7 @@ protected:
     int32_t _path_id;
     bool _pull;
     bool _ecn_echo;
-    static PacketDB<NdpNack> _packetdb;
+    static thread_local PacketDB<NdpNack> _packetdb;
 };
 
 class NdpRTS : public Packet {
@@ -279,7 +279,7 @@ protected:
     simtime_picosec _ts;
     seq_t _grants;
     int32_t _path_id; // indicates ??
-    static PacketDB<NdpRTS> _packetdb;
+    static thread_local PacketDB<NdpRTS> _packetdb;
 };
 
 
@@ -400,7 +400,7 @@ protected:
     seq_t _cumulative_ack;
     seq_t _pullno;
     int32_t _path_id; // indicates ??
-    static PacketDB<NdpPull> _packetdb;
+    static thread_local PacketDB<NdpPull> _packetdb;
 };
 
 #endif
@@ -77,6 +77,8 @@ NdpTunnelSrc::NdpTunnelSrc(NdpTunnelLogger* logger, TrafficLogger* pktlogger, Ev
 
     _rtx_timeout_pending = false;
     _rtx_timeout = timeInf;
+    _rtx_scanner = NULL;
+    _rtx_scanner_id = 0;
     _node_num = _global_node_count++;
     _nodename = "ndptunnelsrc" + to_string(_node_num);
 
@@ -132,7 +134,7 @@ void NdpTunnelSrc::startflow(){
     _acked_packets = 0;
     _packets_sent = 0;
     _rtx_timeout_pending = false;
-    _rtx_timeout = timeInf;
+    set_rto_timeout(timeInf);
     _pull_window = 0;
     
     _flight_size = 0;
@@ -468,7 +470,7 @@ int NdpTunnelSrc::send_packet(NdpPull::seq_t pacer_no) {
         _rtx_packets_sent++;
         update_rtx_time();
         if (_rtx_timeout == timeInf) {
-            _rtx_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }
         return 1;
     }
@@ -520,7 +522,7 @@ int NdpTunnelSrc::send_packet(NdpPull::seq_t pacer_no) {
         p->sendOn();
       
         if (_rtx_timeout == timeInf) {
-            _rtx_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }
         return 1;
     }
@@ -541,7 +543,7 @@ void
 NdpTunnelSrc::update_rtx_time() {
     //simtime_picosec now = eventlist().now();
     if (_sent_times.empty()) {
-        _rtx_timeout = timeInf;
+        set_rto_timeout(timeInf);
         return;
     }
     map<NdpTunnelPacket::seq_t, simtime_picosec>::iterator i;
@@ -554,7 +556,7 @@ NdpTunnelSrc::update_rtx_time() {
         }
         c++;
     }
-    _rtx_timeout = first_senttime + _rto;
+    set_rto_timeout(first_senttime + _rto);
 }
  
 void 
@@ -645,6 +647,12 @@ NdpTunnelSrc::retransmit_packet() {
     update_rtx_time();*/
 }
 
+void NdpTunnelSrc::set_rto_timeout(simtime_picosec timeout) {
+    _rtx_timeout = timeout;
+    if (_rtx_scanner)
+        _rtx_scanner->deadlineChanged(_rtx_scanner_id, timeout);
+}
+
 void NdpTunnelSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
 #ifndef RESEND_ON_TIMEOUT
     return;  // if we're using RTS, we shouldn't need to also use
@@ -1197,25 +1205,12 @@ void NdpTunnelPullPacer::doNextEvent(){
 ////////////////////////////////////////////////////////////////
 
 NdpTunnelRtxTimerScanner::NdpTunnelRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
-  : EventSource(eventlist,"RtxScanner"), 
-    _scanPeriod(scanPeriod)
+  : RtxTimerScanner<NdpTunnelSrc>(scanPeriod, 0, eventlist)
 {
-    eventlist.sourceIsPendingRel(*this, 0);
 }
 
 void 
 NdpTunnelRtxTimerScanner::registerNdp(NdpTunnelSrc &tcpsrc)
 {
-    _tcps.push_back(&tcpsrc);
-}
-
-void
-NdpTunnelRtxTimerScanner::doNextEvent() 
-{
-    simtime_picosec now = eventlist().now();
-    tcps_t::iterator i;
-    for (i = _tcps.begin(); i!=_tcps.end(); i++) {
-        (*i)->rtx_timer_hook(now,_scanPeriod);
-    }
-    eventlist().sourceIsPendingRel(*this, _scanPeriod);
+    tcpsrc.set_rtx_scanner(this, addSrc(tcpsrc));
 }
@@ -22,6 +22,7 @@ enum RouteStrategy {NOT_SET, SINGLE_PATH, SCATTER_PERMUTE, SCATTER_RANDOM, PULL_
 #include "ndptunnelpacket.h"
 #include "fairpullqueue.h"
 #include "eventlist.h"
+#include "rtxscanner.h"
 
 #define timeInf 0
 #define NDP_PACKET_SCATTER
@@ -57,6 +58,11 @@ public:
     void replace_route(Route* newroute);
 
     virtual void rtx_timer_hook(simtime_picosec now,simtime_picosec period);
+    void set_rtx_scanner(RtxTimerScanner<NdpTunnelSrc>* scanner, uint32_t id) {
+        _rtx_scanner = scanner;
+        _rtx_scanner_id = id;
+    }
+    void set_rto_timeout(simtime_picosec timeout); // always use this to set _rtx_timeout
     void set_paths(vector<const Route*>* rt);
 
     // should really be private, but loggers want to see:
@@ -105,6 +111,8 @@ public:
  
     simtime_picosec _rtx_timeout;
     bool _rtx_timeout_pending;
+    RtxTimerScanner<NdpTunnelSrc>* _rtx_scanner;
+    uint32_t _rtx_scanner_id;
 
     const Route* _route;
     const Route *choose_route();
@@ -260,15 +268,10 @@ class NdpTunnelPullPacer : public EventSource {
 };
 
 
-class NdpTunnelRtxTimerScanner : public EventSource {
+class NdpTunnelRtxTimerScanner : public RtxTimerScanner<NdpTunnelSrc> {
  public:
     NdpTunnelRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
-    void doNextEvent();
     void registerNdp(NdpTunnelSrc &tcpsrc);
- private:
-    simtime_picosec _scanPeriod;
-    typedef list<NdpTunnelSrc*> tcps_t;
-    tcps_t _tcps;
 };
 
 #endif
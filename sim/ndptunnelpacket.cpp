@@ -1,3 +1,3 @@
 #include "ndptunnelpacket.h"
 
-PacketDB<NdpTunnelPacket> NdpTunnelPacket::_packetdb;
+thread_local PacketDB<NdpTunnelPacket> NdpTunnelPacket::_packetdb;
@@ -71,14 +71,14 @@ public:
     void free() {_encap_packet->free();_packetdb.freePacket(this);}
 
     void save_state(){
-        _oldnexthop = _nexthop;
-        _oldsize = _size;
+        cold()._oldnexthop = _nexthop;
+        _cold->_oldsize = _size;
     }
 
     void load_state(){
         _is_header = false;
-        _nexthop = _oldnexthop;
-        _size = _oldsize;
+        _nexthop = cold()._oldnexthop;
+        _size = _cold->_oldsize;
     }
     
     virtual ~NdpTunnelPacket(){}
@@ -115,7 +115,7 @@ protected:
     Packet* _encap_packet;
     bool _last_packet;  // set to true in the last packet in a flow.
     
-    static PacketDB<NdpTunnelPacket> _packetdb;
+    static thread_local PacketDB<NdpTunnelPacket> _packetdb;
 };
 
 #endif
@@ -1,10 +1,25 @@
 // -*- c-basic-offset: 4; indent-tabs-mode: nil -*- 
 #include "network.h"
+#include <iomanip>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
 
 #define DEFAULTDATASIZE 1500
+// PacketDB starts each packet on a cache line, and everything up to and
+// including the cold state pointer must fit in that line.  Packet isn't
+// standard layout (it has a vtable), but GCC and Clang lay it out
+// predictably, so offsetof is fine here.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+struct PacketLayout {
+    static_assert(offsetof(Packet, _cold) + sizeof(PacketColdState*) <= CACHE_LINE_BYTES,
+                  "Packet's per-hop fields no longer fit in one cache line");
+};
+#pragma GCC diagnostic pop
+
 int Packet::_data_packet_size = DEFAULTDATASIZE;
 bool Packet::_packet_size_fixed = false;
-PacketFlow Packet::_defaultFlow(nullptr);
 
 // use set_attrs only when we want to do a late binding of the route -
 // otherwise use set_route or set_rg
@@ -12,10 +27,8 @@ void
 Packet::set_attrs(PacketFlow& flow, int pkt_size, packetid_t id){
     _flow = &flow;
     _size = pkt_size;
-    _oldsize = pkt_size;
     _id = id;
     _nexthop = 0;
-    _oldnexthop = 0;
     //_detour = NULL;
     _route = 0;
     _is_header = 0;
@@ -28,10 +41,8 @@ Packet::set_route(PacketFlow& flow, const Route &route, int pkt_size,
                   packetid_t id){
     _flow = &flow;
     _size = pkt_size;
-    _oldsize = pkt_size;
     _id = id;
     _nexthop = 0;
-    _oldnexthop = 0;    
     //_detour = NULL;
     _route = &route;
     _is_header = 0;
@@ -241,15 +252,13 @@ Packet::str() const {
     return s;
 }
 
-// flow ids above this are dynamically allocated; ones less than this can be manually allocated
-#define FLOW_ID_DYNAMIC_BASE 1000000000
-flowid_t PacketFlow::_max_flow_id = FLOW_ID_DYNAMIC_BASE;
-
 PacketFlow::PacketFlow(TrafficLogger* logger)
     : Logged("PacketFlow"),
-      _logger(logger)
+      _logger(logger),
+      _scheduler(NULL),
+      _scheduler_slot(UINT32_MAX)
 {
-    _flow_id = _max_flow_id++;
+    _flow_id = SimContext::current().allocFlowId();
 }
 
 void PacketFlow::set_flowid(flowid_t id) {
@@ -280,4 +289,53 @@ void print_route(const Route& route) {
     cout << endl;
 }
 
-Logged::id_t Logged::LASTIDNUM = 1;
+thread_local PacketDBStats* PacketDBStats::_first = NULL;
+
+PacketDBStats::PacketDBStats(const std::type_info& type, size_t object_size, size_t slot_size)
+    : _live(0), _peak(0), _allocated(0), _slab_bytes(0), _type(type), _object_size(object_size), _slot_size(slot_size) {
+    _next = _first;
+    _first = this;
+}
+
+PacketDBStats::~PacketDBStats() {
+    PacketDBStats** pp = &_first;
+    while (*pp != this)
+        pp = &(*pp)->_next;
+    *pp = _next;
+}
+
+string
+PacketDBStats::type_name() const {
+#ifdef __GNUC__
+    int status;
+    char* name = abi::__cxa_demangle(_type.name(), NULL, NULL, &status);
+    if (status == 0) {
+        string result(name);
+        free(name);
+        return result;
+    }
+#endif
+    return _type.name();
+}
+
+void
+PacketDBStats::print(ostream& out) {
+    uint64_t total_bytes = 0, total_peak = 0;
+    out << "Packet memory:" << endl;
+    for (PacketDBStats* s = _first; s; s = s->_next) {
+        if (s->_allocated == 0)
+            continue;
+        out << "  " << setw(16) << left << s->type_name() << right
+            << " size " << setw(4) << s->_slot_size
+            << " live " << setw(8) << s->_live
+            << " peak " << setw(8) << s->_peak
+            << " allocated " << setw(8) << s->_allocated
+            << " slab_KB " << (s->_slab_bytes + 1023) / 1024 << endl;
+        total_bytes += s->_slab_bytes;
+        total_peak += s->_peak;
+    }
+    out << "  total slab_KB " << (total_bytes + 1023) / 1024;
+    if (total_peak)
+        out << " bytes per packet at peak " << total_bytes / total_peak;
+    out << endl;
+}
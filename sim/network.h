@@ -4,6 +4,9 @@
 
 #include <vector>
 #include <iostream>
+#include <new>
+#include <typeinfo>
+#include <stdlib.h>
 #include "config.h"
 #include "loggertypes.h"
 #include "route.h"
@@ -11,6 +14,7 @@
 class Packet;
 class PacketFlow;
 class PacketSink;
+class BaseScheduler;
 typedef uint32_t packetid_t;
 typedef uint32_t flowid_t;
 
@@ -35,10 +39,18 @@ class PacketFlow : public Logged {
     void set_flowid(flowid_t id);
     inline flowid_t flow_id() const {return _flow_id;}
     bool log_me() const {return _logger != NULL;}
+    // the host scheduler this flow sends through, and its slot there
+    inline BaseScheduler* scheduler() const {return _scheduler;}
+    inline uint32_t scheduler_slot() const {return _scheduler_slot;}
+    void set_scheduler(BaseScheduler* scheduler, uint32_t slot) {
+        _scheduler = scheduler;
+        _scheduler_slot = slot;
+    }
  protected:
-    static packetid_t _max_flow_id;
     flowid_t _flow_id;
     TrafficLogger* _logger;
+    BaseScheduler* _scheduler;
+    uint32_t _scheduler_slot;
 };
 
 
@@ -61,16 +73,29 @@ class VirtualQueue {
 
 class LosslessInputQueue;
 
+// Packet state that only tunnelled packets and lossless queues use.
+// Packets allocate it the first time they need it and keep it while
+// they're recycled, so lossless queues don't allocate per packet; it's
+// reset when the packet is freed back to its PacketDB, so a recycled
+// packet starts with none of the previous user's state.
+struct PacketColdState {
+    PacketColdState() : _oldsize(0), _oldnexthop(0), _ingressqueue(NULL) {}
+    uint16_t _oldsize;
+    uint32_t _oldnexthop;
+    LosslessInputQueue* _ingressqueue;
+};
+
 // See tcppacket.h to illustrate how Packet is typically used.
 class Packet {
     friend class PacketFlow;
+    friend struct PacketLayout; // see network.cpp
  public:
     // use PRIO_NONE if the packet is never expected to encounter a priority queue, otherwise default to PRIO_LO
     typedef enum {PRIO_LO, PRIO_MID, PRIO_HI, PRIO_NONE} PktPriority;
     
     /* empty constructor; Packet::set must always be called as
        well. It's a separate method, for convenient reuse */
-    Packet() {_is_header = false; _bounced = false; _type = IP; _flags = 0; _refcount = 0; _dst = UINT32_MAX; _pathid = UINT32_MAX; _direction = NONE; _ingressqueue = NULL;} 
+    Packet() {_is_header = false; _bounced = false; _type = IP; _flags = 0; _refcount = 0; _dst = UINT32_MAX; _pathid = UINT32_MAX; _direction = NONE; _cold = NULL;} 
 
     /* say "this packet is no longer wanted". (doesn't necessarily
        destroy it, so it can be reused) */
@@ -102,11 +127,12 @@ class Packet {
 
     uint16_t size() const {return _size;}
     void set_size(int i) {_size = i;}
-    packet_type type() const {return _type;};
+    packet_type type() const {return (packet_type)_type;};
     bool header_only() const {return _is_header;}
     bool bounced() const {return _bounced;}
     PacketFlow& flow() const {return *_flow;}
-    virtual ~Packet() {};
+    virtual ~Packet() {delete _cold;};
+    void reset_cold() {if (_cold) *_cold = PacketColdState();}
     inline const packetid_t id() const {return _id;}
     inline uint32_t flow_id() const {return _flow->flow_id();}
     inline uint32_t dst() const {return _dst;}
@@ -131,14 +157,14 @@ class Packet {
         if ((_direction == NONE) || (_direction == UP && d==DOWN)) 
             _direction = d; 
         else {
-            cout << "Current direction is " << _direction << " trying to change it to " << d << endl;
+            cout << "Current direction is " << (int)_direction << " trying to change it to " << d << endl;
             abort();
         }
     }
 
     virtual PktPriority priority() const = 0;
 
-    virtual packet_direction get_direction() {return _direction;}
+    virtual packet_direction get_direction() {return (packet_direction)_direction;}
 
     void inc_ref_count() { _refcount++;};
     void dec_ref_count() { _refcount--;};
@@ -152,51 +178,62 @@ class Packet {
     virtual void set_route(const Route *route=nullptr);
     virtual void set_route(PacketFlow& flow, const Route &route, int pkt_size, packetid_t id);
 
-    void set_ingress_queue(LosslessInputQueue* t){assert(!_ingressqueue); _ingressqueue = t;}
-    LosslessInputQueue* get_ingress_queue(){assert(_ingressqueue); return _ingressqueue;}
-    void clear_ingress_queue(){assert(_ingressqueue); _ingressqueue = NULL;}
+    void set_ingress_queue(LosslessInputQueue* t){assert(!cold()._ingressqueue); _cold->_ingressqueue = t;}
+    LosslessInputQueue* get_ingress_queue(){assert(_cold && _cold->_ingressqueue); return _cold->_ingressqueue;}
+    void clear_ingress_queue(){assert(_cold && _cold->_ingressqueue); _cold->_ingressqueue = NULL;}
 
     //    void set_detour(PacketSink* n, int rewind) {_detour = n;_nexthop -= rewind;}
     
     string str() const;
  protected:
     void set_attrs(PacketFlow& flow, int pkt_size, packetid_t id);
+    PacketColdState& cold() {
+        if (!_cold)
+            _cold = new PacketColdState();
+        return *_cold;
+    }
 
     static int _data_packet_size; // default size of a TCP or NDP data packet,
                                   // measured in bytes
     static bool _packet_size_fixed; //prevent foot-shooting
     
-    packet_type _type;
-    
-    uint16_t _size,_oldsize;
-    
-    
-    bool _is_header;
-    bool _bounced; // packet has hit a full queue, and is being bounced back to the sender
-    uint32_t _flags; // used for ECN & friends
-
-    uint32_t _dst; //used for packets that do not have a route in switched networks.    
-    uint32_t _pathid;  //used for ECMP hashing.
-    packet_direction _direction; //used to avoid loop in FatTrees.   
+    // The fields up to _cold are read as the packet is forwarded at
+    // each hop, and are ordered to fit in one cache line along with
+    // the vtable pointer and _cold itself; network.cpp checks this.
+    // Add new fields to the subclass, after _cold, or to
+    // PacketColdState unless every hop needs them.
 
     // A packet can contain a route or a routegraph, but not both.
     // Eventually switch over entirely to RouteGraph?
     const Route* _route;
+    PacketFlow* _flow{nullptr};
+
+    //used when using routing tables in switches, i.e. the packet has no route.
+    PacketSink* _next_routed_hop;
 
     //PacketSink* _detour;
-    uint32_t _nexthop,_oldnexthop;
+    uint32_t _nexthop;
+    uint32_t _flags; // used for ECN & friends
+
+    uint32_t _dst; //used for packets that do not have a route in switched networks.    
+    uint32_t _pathid;  //used for ECMP hashing.
+
+    uint16_t _size;
+    uint8_t _type; // a packet_type
+    uint8_t _direction; // a packet_direction, used to avoid loop in FatTrees.
+    bool _is_header;
+    bool _bounced; // packet has hit a full queue, and is being bounced back to the sender
 
     //used for tunneling purposes when one packet can be referenced by multiple classes
     uint8_t _refcount;
 
-    //used when using routing tables in switches, i.e. the packet has no route.
-    PacketSink* _next_routed_hop;
+    PacketColdState* _cold; // see cold()
 
+    // only read at the endpoints, or by BCube
     packetid_t _id;
-    PacketFlow* _flow{nullptr};
-    static PacketFlow _defaultFlow;
-    LosslessInputQueue* _ingressqueue;
-    uint32_t _path_len; // length of the path in hops - used in BCube priority routing with NDP
+    uint16_t _path_len; // length of the path in hops - used in BCube priority routing with NDP
+
+    static PacketFlow& defaultFlow() {return SimContext::current().defaultFlow();}
 };
 
 class PacketSink {
@@ -221,45 +258,123 @@ class PacketSink {
 // For speed, it may be useful to keep a database of all packets that
 // have been allocated -- that way we don't need a malloc for every
 // new packet, we can just reuse old packets. Care, though -- the set()
-// method will need to be invoked properly for each new/reused packet
+// method will need to be invoked properly for each new/reused packet.
+// Packet classes keep their PacketDB thread_local, so simulations on
+// different threads don't share free lists.
+//
+// New packets are carved out of slabs of PACKETDB_SLAB_BYTES, aligned
+// to a cache line, so packets of one type sit together in memory
+// rather than being scattered over the heap.  Slabs are only returned
+// when the PacketDB itself goes away, and the packets in them (free or
+// still in flight) are destroyed then.
+
+#define CACHE_LINE_BYTES 64
+#define PACKETDB_SLAB_BYTES 65536
+
+// Memory accounting for one PacketDB.  Each thread keeps a list of its
+// PacketDBs so main programs can print them all with print().
+class PacketDBStats {
+ public:
+    PacketDBStats(const std::type_info& type, size_t object_size, size_t slot_size);
+    ~PacketDBStats();
+    string type_name() const;
+    size_t object_size() const {return _object_size;} // sizeof the packet class
+    size_t slot_size() const {return _slot_size;}     // what each packet takes in a slab
+    uint64_t live() const {return _live;}           // packets handed out and not yet freed
+    uint64_t peak() const {return _peak;}           // most packets live at once
+    uint64_t allocated() const {return _allocated;} // packets ever constructed
+    uint64_t slab_bytes() const {return _slab_bytes;}
+
+    // one line per packet type used on this thread, plus a total
+    static void print(ostream& out);
+    // this thread's PacketDBs, for walking them with next()
+    static const PacketDBStats* first() {return _first;}
+    const PacketDBStats* next() const {return _next;}
+
+    uint64_t _live, _peak, _allocated, _slab_bytes;
+ private:
+    const std::type_info& _type;
+    size_t _object_size, _slot_size;
+    PacketDBStats* _next;
+    static thread_local PacketDBStats* _first;
+};
 
 template<class P>
 class PacketDB {
  public:
-    PacketDB() : _alloc_count(0) {}
+    PacketDB() : _stats(typeid(P), sizeof(P), slot_size()), _slab_free(NULL), _slab_end(NULL) {}
     ~PacketDB() {
-        //cout << "Pkt count: " << _alloc_count << endl;
-        //cout << "Pkt mem used: " << _alloc_count * sizeof(P) << endl;
+        for (size_t i = 0; i < _slabs.size(); i++) {
+            char* slot = first_slot(_slabs[i]);
+            char* end = i + 1 == _slabs.size() ? _slab_free : slot + slots_per_slab() * slot_size();
+            for (; slot < end; slot += slot_size())
+                ((P*)slot)->~P();
+            free(_slabs[i]);
+        }
     }
     P* allocPacket() {
+        P* p;
         if (_freelist.empty()) {
-            P* p = new P();
-            p->inc_ref_count();
-            /*
-            if (_alloc_count == 0) {
-                cout << "Packet size: " << sizeof(P) << endl;
-            }
-            */
-            _alloc_count++;
-            return p;
+            if (_slab_free == _slab_end)
+                new_slab();
+            p = new (_slab_free) P();
+            _slab_free += slot_size();
+            _stats._allocated++;
         } else {
-            P* p = _freelist.back();
+            p = _freelist.back();
             _freelist.pop_back();
-            p->inc_ref_count();
-            return p;
         }
+        p->inc_ref_count();
+        _stats._live++;
+        if (_stats._live > _stats._peak)
+            _stats._peak = _stats._live;
+        return p;
     };
     void freePacket(P* pkt) {
         assert(pkt->ref_count()>=1);
         pkt->dec_ref_count();
 
-        if (!pkt->ref_count())
+        if (!pkt->ref_count()) {
+            pkt->reset_cold();
             _freelist.push_back(pkt);
+            _stats._live--;
+        }
     };
+    const PacketDBStats& stats() const {return _stats;}
 
  protected:
+    static size_t slot_size() {
+        // start every packet on a cache line, so its per-hop fields
+        // (see Packet) don't straddle two
+        size_t align = alignof(P) > CACHE_LINE_BYTES ? alignof(P) : CACHE_LINE_BYTES;
+        return (sizeof(P) + align - 1) / align * align;
+    }
+    static size_t slots_per_slab() {
+        size_t count = PACKETDB_SLAB_BYTES / slot_size();
+        return count ? count : 1;
+    }
+    // over-allocate slabs so the first packet can start on a cache line
+    static char* first_slot(char* raw) {
+        return raw + (CACHE_LINE_BYTES - (uintptr_t)raw % CACHE_LINE_BYTES) % CACHE_LINE_BYTES;
+    }
+    void new_slab() {
+        size_t count = slots_per_slab();
+        char* raw = (char*)malloc(count * slot_size() + CACHE_LINE_BYTES);
+        if (!raw) {
+            cerr << "PacketDB: out of memory" << endl;
+            abort();
+        }
+        _slabs.push_back(raw);
+        _slab_free = first_slot(raw);
+        _slab_end = _slab_free + count * slot_size();
+        _stats._slab_bytes += count * slot_size() + CACHE_LINE_BYTES;
+    }
+
     vector<P*> _freelist; // Irek says it's faster with vector than with list
-    int _alloc_count;
+    PacketDBStats _stats;
+    vector<char*> _slabs;
+    char* _slab_free; // next unused slot in the newest slab
+    char* _slab_end;
 };
 
 
@@ -0,0 +1,196 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "parallelsim.h"
+#include <thread>
+#include "flowstats.h"
+
+ParallelSim::ParallelSim()
+{
+    _lookahead = 0;
+    _endtime = 0;
+    _waiting = 0;
+    _generation = 0;
+    _parity = 0;
+    _done = false;
+    _window_end = 0;
+    _windows = 0;
+    _out = NULL;
+}
+
+ParallelSim::~ParallelSim()
+{
+    for (size_t i = 0; i < _lps.size(); i++) {
+        delete _lps[i]->eventlist;
+        delete _lps[i]->context;
+        delete _lps[i];
+    }
+}
+
+uint32_t
+ParallelSim::addLP()
+{
+    LP* lp = new LP();
+    lp->context = new SimContext();
+    lp->context->setOut(&lp->out);
+    // an EventList belongs to the context that's current when it's made
+    SimContext* prev = &SimContext::current();
+    SimContext::setCurrent(lp->context);
+    lp->eventlist = new EventList();
+    SimContext::setCurrent(prev);
+    lp->eventlist->setEndtime(_endtime);
+    lp->next = 0;
+    lp->min_posted = UINT64_MAX;
+    lp->posted = 0;
+    _lps.push_back(lp);
+    return _lps.size() - 1;
+}
+
+void
+ParallelSim::setEndtime(simtime_picosec endtime)
+{
+    _endtime = endtime;
+    for (size_t i = 0; i < _lps.size(); i++)
+        _lps[i]->eventlist->setEndtime(endtime);
+}
+
+void
+ParallelSim::addLink(MailboxPipe& pipe)
+{
+    // with no delay between LPs, windows couldn't make progress
+    assert(pipe.delay() > 0);
+    if (_lookahead == 0 || pipe.delay() < _lookahead)
+        _lookahead = pipe.delay();
+}
+
+void
+ParallelSim::post(MailboxPipe& pipe, uint32_t from, uint32_t to, Packet& pkt, simtime_picosec when)
+{
+    LP& lp = *_lps[from];
+    Mail mail = {&pipe, when, &pkt};
+    lp.outbox[_parity][to].push_back(mail);
+    if (when < lp.min_posted)
+        lp.min_posted = when;
+    lp.posted++;
+}
+
+void
+ParallelSim::run()
+{
+    SimContext& context = SimContext::current();
+    _out = &context.out();
+    for (size_t i = 0; i < _lps.size(); i++) {
+        LP& lp = *_lps[i];
+        lp.outbox[0].resize(_lps.size());
+        lp.outbox[1].resize(_lps.size());
+        // flow stats settings, and a random stream of its own
+        lp.context->flowStats() = context.flowStats();
+        lp.context->random_engine().seed(context.random_engine()());
+    }
+
+    vector<std::thread> threads;
+    for (uint32_t i = 0; i < _lps.size(); i++)
+        threads.push_back(std::thread(&ParallelSim::runLP, this, i));
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    uint64_t events = 0;
+    for (size_t i = 0; i < _lps.size(); i++) {
+        context.flowStats().merge(_lps[i]->context->flowStats());
+        events += _lps[i]->eventlist->eventsDispatched();
+    }
+    EventList& eventlist = EventList::getTheEventList();
+    eventlist.setStat("parallel_events", events);
+    eventlist.setStat("parallel_windows", _windows);
+}
+
+void
+ParallelSim::runLP(uint32_t i)
+{
+    LP& lp = *_lps[i];
+    SimContext::setCurrent(lp.context);
+    if (_thread_setup)
+        _thread_setup();
+    lp.next = lp.eventlist->nextEventTime();
+    while (endWindow()) {
+        // last window's mail for us, in the order each LP sent it
+        for (size_t from = 0; from < _lps.size(); from++) {
+            vector<Mail>& mail = _lps[from]->outbox[_parity ^ 1][i];
+            for (size_t m = 0; m < mail.size(); m++)
+                mail[m].pipe->deliver(*mail[m].pkt, mail[m].when);
+            mail.clear();
+        }
+        while (lp.eventlist->doNextEvent(_window_end)) {
+        }
+        lp.next = min(lp.eventlist->nextEventTime(), lp.min_posted);
+        lp.min_posted = UINT64_MAX;
+    }
+    SimContext::setCurrent(NULL);
+}
+
+// Barrier between windows.  The last LP to arrive works out the next
+// window and passes on what the LPs wrote.
+bool
+ParallelSim::endWindow()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    uint64_t generation = _generation;
+    if (++_waiting < _lps.size()) {
+        _window_started.wait(lock, [&]{return _generation != generation;});
+        return !_done;
+    }
+    _waiting = 0;
+    flushOutput();
+    simtime_picosec start = UINT64_MAX;
+    for (size_t i = 0; i < _lps.size(); i++)
+        start = min(start, _lps[i]->next);
+    _done = start == UINT64_MAX || (_endtime && start >= _endtime);
+    _window_end = _lookahead ? start + _lookahead : UINT64_MAX;
+    _parity ^= 1;
+    if (!_done)
+        _windows++;
+    _generation++;
+    _window_started.notify_all();
+    return !_done;
+}
+
+void
+ParallelSim::flushOutput()
+{
+    for (size_t i = 0; i < _lps.size(); i++) {
+        stringstream& out = _lps[i]->out;
+        if (out.tellp() > 0) {
+            *_out << out.str();
+            out.str("");
+        }
+    }
+}
+
+void
+ParallelSim::print_stats(ostream& os) const
+{
+    uint64_t events = 0, posted = 0, busiest = 0;
+    for (size_t i = 0; i < _lps.size(); i++) {
+        uint64_t e = _lps[i]->eventlist->eventsDispatched();
+        events += e;
+        posted += _lps[i]->posted;
+        busiest = max(busiest, e);
+    }
+    os << "Parallel: " << _lps.size() << " LPs, lookahead " << timeAsUs(_lookahead) << "us, "
+       << _windows << " windows, " << events << " events, " << posted << " packets between LPs" << endl;
+    for (size_t i = 0; i < _lps.size(); i++)
+        os << "  LP " << i << " events " << _lps[i]->eventlist->eventsDispatched()
+           << " sent " << _lps[i]->posted << endl;
+    if (busiest)
+        os << "Busiest LP did " << (double)busiest * 100 / events << "% of events" << endl;
+}
+
+MailboxPipe::MailboxPipe(simtime_picosec delay, ParallelSim& sim, uint32_t from, uint32_t to)
+    : Pipe(delay, sim.eventlist(to)), _sim(sim), _from(from), _to(to)
+{
+    sim.addLink(*this);
+}
+
+void
+MailboxPipe::receivePacket(Packet& pkt)
+{
+    _sim.post(*this, _from, _to, pkt, _sim.eventlist(_from).now() + delay());
+}
@@ -0,0 +1,123 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef PARALLELSIM_H
+#define PARALLELSIM_H
+
+/*
+ * Runs one simulation split into logical processes (LPs), each with its
+ * own SimContext and EventList, on a thread per LP.
+ *
+ * LPs only affect each other through MailboxPipes, and a packet takes
+ * at least the smallest MailboxPipe delay (the lookahead) to cross
+ * one.  Execution proceeds in YAWNS windows: all LPs agree on the
+ * earliest pending time T, then each runs its events before
+ * T + lookahead independently, since nothing another LP does in that
+ * window can reach it before the window ends.  Packets crossing LPs
+ * are posted to the sending LP's outbox for their destination and
+ * delivered at the start of the next window, in the order they were
+ * sent.  Each outbox has one writer and one reader, and the barrier
+ * between windows orders them, so they need no locks.
+ *
+ * Results are deterministic for a given partitioning, but not the same
+ * as a sequential run's: each LP has its own random number stream, and
+ * events at the same time in different LPs aren't ordered.
+ *
+ * Everything must be built on the main thread before run(), with the
+ * right LP's EventList.  Settings that are thread_local (see
+ * SimContext) need copying onto the LP threads with setThreadSetup().
+ * What the LPs write to their context's out() is passed on to the
+ * caller's in LP order at the end of each window, and their flow stats
+ * are added to the caller's at the end.  Packets are freed into the
+ * pool of the thread that frees them, so PacketDB stats are only
+ * meaningful for a sequential run.
+ */
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include "config.h"
+#include "eventlist.h"
+#include "pipe.h"
+#include "simcontext.h"
+
+class MailboxPipe;
+
+class ParallelSim {
+public:
+    ParallelSim();
+    ~ParallelSim();
+
+    // a new LP; returns its number
+    uint32_t addLP();
+    uint32_t no_of_lps() const {return _lps.size();}
+    EventList& eventlist(uint32_t lp) {return *_lps.at(lp)->eventlist;}
+    SimContext& context(uint32_t lp) {return *_lps.at(lp)->context;}
+
+    void setEndtime(simtime_picosec endtime);
+    // run on each LP's thread before it starts
+    void setThreadSetup(std::function<void()> setup) {_thread_setup = setup;}
+    // smallest delay between LPs; zero until a MailboxPipe is added
+    simtime_picosec lookahead() const {return _lookahead;}
+
+    // run until no LP has anything left to do before the end time
+    void run();
+    void print_stats(ostream& os) const;
+
+    // called by MailboxPipe
+    void addLink(MailboxPipe& pipe);
+    void post(MailboxPipe& pipe, uint32_t from, uint32_t to, Packet& pkt, simtime_picosec when);
+
+private:
+    struct Mail {
+        MailboxPipe* pipe;
+        simtime_picosec when;
+        Packet* pkt;
+    };
+    struct LP {
+        SimContext* context;
+        EventList* eventlist;
+        stringstream out;
+        // mail sent, per destination LP.  One parity is being posted
+        // to this window; the other holds last window's, being delivered.
+        vector<vector<Mail> > outbox[2];
+        simtime_picosec next;        // earliest time this LP might do anything
+        simtime_picosec min_posted;  // earliest mail posted this window
+        uint64_t posted;
+    };
+
+    void runLP(uint32_t lp);
+    bool endWindow();  // false when the run is over
+    void flushOutput();
+
+    vector<LP*> _lps;
+    simtime_picosec _lookahead;
+    simtime_picosec _endtime;
+    std::function<void()> _thread_setup;
+
+    // window state, only changed by the last LP to reach the barrier
+    std::mutex _mutex;
+    std::condition_variable _window_started;
+    uint32_t _waiting;
+    uint64_t _generation;
+    uint32_t _parity;    // which outbox LPs post to
+    bool _done;
+    simtime_picosec _window_end;
+    uint64_t _windows;
+    ostream* _out;
+};
+
+// A pipe between LPs.  It's on the receiving LP's EventList; packets
+// are handed to it from the sending LP through the ParallelSim.
+class MailboxPipe : public Pipe {
+public:
+    MailboxPipe(simtime_picosec delay, ParallelSim& sim, uint32_t from, uint32_t to);
+    virtual void receivePacket(Packet& pkt);
+    // on the receiving LP's thread, with mail posted for time when
+    void deliver(Packet& pkt, simtime_picosec when) {arrive(pkt, when);}
+private:
+    ParallelSim& _sim;
+    uint32_t _from, _to;
+};
+
+#endif
@@ -8,6 +8,11 @@
 #include <math.h>
 #include <algorithm>
 #include <vector>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/stat.h>
 using namespace std;
 
 //#ifdef __clang__
@@ -22,6 +27,7 @@ using namespace std;
 
 #include "loggers.h"
 #include "eqds_logger.h"
+#include "trace_codec.h"
 
 struct eqint
 {
@@ -31,9 +37,172 @@ struct eqint
     }
 };
 
+// Format one record the way the logger that wrote it would.
+static string record_to_str(const LogRecord& r, const string& name) {
+    RawLogEvent event(r._time, r._type, r._id, r._ev, r._val1, r._val2, r._val3, name);
+    string out;
+
+    switch((Logger::EventType)r._type) {
+    case Logger::QUEUE_EVENT: //0
+        out = QueueLoggerSimple::event_to_str(event);
+        break;
+    case Logger::TCP_EVENT: //1
+    case Logger::TCP_STATE: //2
+        out = TcpLoggerSimple::event_to_str(event); 
+        break;
+    case Logger::TRAFFIC_EVENT: //3
+        out = TrafficLoggerSimple::event_to_str(event); 
+        break;
+    case Logger::QUEUE_RECORD: //4
+    case Logger::QUEUE_APPROX: //5
+        out = QueueLoggerSampling::event_to_str(event);
+        break;
+    case Logger::TCP_RECORD: //6
+        out = AggregateTcpLogger::event_to_str(event);
+        break;
+    case Logger::QCN_EVENT: //7
+    case Logger::QCNQUEUE_EVENT: //8
+        out = QcnLoggerSimple::event_to_str(event);
+        break;
+    case Logger::TCP_TRAFFIC: //9
+        out = TcpTrafficLogger::event_to_str(event);
+        break;
+    case Logger::NDP_TRAFFIC: //10
+        out = NdpTrafficLogger::event_to_str(event);
+        break;
+    case Logger::ROCE_TRAFFIC: //10
+        out = RoceTrafficLogger::event_to_str(event);
+        break;
+        break;                
+    case Logger::HPCC_TRAFFIC: //10
+        out = HPCCTrafficLogger::event_to_str(event);
+        break;
+    case Logger::TCP_SINK: //11
+        out = TcpSinkLoggerSampling::event_to_str(event);
+        break;
+    case Logger::MTCP: //12
+        out = MultipathTcpLoggerSimple::event_to_str(event);
+        break;
+    case Logger::ENERGY: //13
+        // not currently used, so use default logger
+        out = Logger::event_to_str(event);
+        break;
+    case Logger::TCP_MEMORY: //14
+        out = MemoryLoggerSampling::event_to_str(event);
+        break;
+    case Logger::NDP_EVENT: //15
+    case Logger::NDP_STATE: //16
+    case Logger::NDP_RECORD: //17
+    case Logger::NDP_MEMORY: //19
+        // not currently used, so use default logger
+        out = Logger::event_to_str(event);
+        break;
+    case Logger::EQDS_EVENT: 
+    case Logger::EQDS_STATE: 
+    case Logger::EQDS_RECORD:
+    case Logger::EQDS_MEMORY:
+    case Logger::EQDS_TRAFFIC:
+        // not currently used, so use default logger
+        out = Logger::event_to_str(event);
+        break;
+    case Logger::NDP_SINK: //18
+        out = NdpSinkLoggerSampling::event_to_str(event);
+        break;
+    case Logger::EQDS_SINK: //18
+        out = EqdsSinkLoggerSampling::event_to_str(event);
+        break;
+    case Logger::ROCE_SINK: //18
+        out = RoceSinkLoggerSampling::event_to_str(event);
+        break;
+    case Logger::HPCC_SINK: //18
+        out = HPCCSinkLoggerSampling::event_to_str(event);
+        break;                
+    case Logger::SWIFT_EVENT: //20
+    case Logger::SWIFT_STATE: //21
+        out = SwiftLoggerSimple::event_to_str(event); 
+        break;
+    case Logger::SWIFT_MEMORY: //22
+        // not currently used, so use default logger
+        out = Logger::event_to_str(event);
+        break;
+    case Logger::SWIFT_SINK: //23
+        out = SwiftSinkLoggerSampling::event_to_str(event);
+        out += " ";
+        out.append(to_string(r._type));
+        out += " ";
+        out.append(to_string(r._ev));
+        break;
+    case Logger::SWIFT_TRAFFIC: //10
+        out = SwiftTrafficLogger::event_to_str(event);
+        break;
+    case Logger::STRACK_EVENT:
+    case Logger::STRACK_STATE: 
+        out = STrackLoggerSimple::event_to_str(event); 
+        break;
+    case Logger::STRACK_MEMORY: //22
+        // not currently used, so use default logger
+        out = Logger::event_to_str(event);
+        break;
+    case Logger::STRACK_SINK: //23
+        out = STrackSinkLoggerSampling::event_to_str(event);
+        out += " ";
+        out.append(to_string(r._type));
+        out += " ";
+        out.append(to_string(r._ev));
+        break;
+    case Logger::STRACK_TRAFFIC:
+        out = STrackTrafficLogger::event_to_str(event);
+        break;
+    case Logger::FLOW_EVENT:
+        out = FlowEventLoggerSimple::event_to_str(event);
+        break;
+    }
+    return out;
+}
+
+// Predicates on the raw record fields, checked before any formatting.
+struct RecordFilter {
+    set<uint32_t> types;
+    set<uint32_t> ids;
+    set<uint32_t> evs;  // per-type event numbers, as the loggers print them
+
+    bool match(const LogRecord& r) const {
+        if (!r._time)
+            return false;
+        if (!types.empty() && !types.count(r._type))
+            return false;
+        if (!ids.empty() && !ids.count(r._id))
+            return false;
+        if (!evs.empty() && !evs.count(r._ev - 100*r._type))
+            return false;
+        return true;
+    }
+};
+
+// A run of consecutive records: a slice of the mapped trace, or one
+// block of a columnar trace, decoded when it is processed.
+struct Chunk {
+    const LogRecord* records;
+    size_t count;
+    size_t block;
+};
+static const size_t CHUNK_RECORDS = 1 << 16;
+
+static const LogRecord* chunk_records(const Chunk& c, const TraceReader& reader, const char* trace,
+                                      vector<LogRecord>& decoded, string& scratch) {
+    if (c.records)
+        return c.records;
+    decoded.clear();
+    if (!reader.decode_block(c.block, trace + reader.block(c.block)._offset, decoded, scratch)) {
+        cerr << "Corrupt block " << c.block << " in columnar trace" << endl;
+        exit(1);
+    }
+    return decoded.data();
+}
+
 int main(int argc, char** argv){
     if (argc < 2){
-        printf("Usage %s filename [-show|-verbose|-ascii]\n", argv[0]);
+        printf("Usage %s filename [-show|-verbose|-ascii] [-type N] [-id N] [-ev N] [-threads N]\n", argv[0]);
         return 1;
     }
 
@@ -44,6 +213,8 @@ int main(int argc, char** argv){
     vector <string> filters;
     vector <string> splits;
     vector <int> fields;
+    RecordFilter filter;
+    unsigned threads = thread::hardware_concurrency();
 
     int i = 2;
     while (i<argc) {
@@ -68,6 +239,21 @@ int main(int argc, char** argv){
         } else if (!strcmp(argv[i],"-field")){
             fields.push_back(atoi(argv[i+1]));
             i++;
+        } else if (!strcmp(argv[i],"-type")){
+            // -type, -id and -ev may be repeated; they are tested on the
+            // binary records, and on a columnar trace the index lets
+            // whole blocks be skipped
+            filter.types.insert(atoi(argv[i+1]));
+            i++;
+        } else if (!strcmp(argv[i],"-id")){
+            filter.ids.insert(atoi(argv[i+1]));
+            i++;
+        } else if (!strcmp(argv[i],"-ev")){
+            filter.evs.insert(atoi(argv[i+1]));
+            i++;
+        } else if (!strcmp(argv[i],"-threads")){
+            threads = atoi(argv[i+1]);
+            i++;
         }
         i++;
     }
@@ -104,6 +290,7 @@ int main(int argc, char** argv){
     char* line = new char[10000];
     //cout << "reading preamble\n";
     int numRecords = 0, transpose = 1;
+    bool columnar = false;
     while (1){
         if(!fgets(line, 10000, logfile)) {
             perror("File ended while reading preamble!\n");
@@ -126,6 +313,10 @@ int main(int argc, char** argv){
             transpose = atoi(line+12);
         };
 
+        if (strstr(line, "# format=columnar")) {
+            columnar = true;
+        };
+
         //
         if (strstr(line, ": ")){
             //logged names and ids
@@ -171,51 +362,159 @@ int main(int argc, char** argv){
     }
 
 
-    //must find the number of records here, and go to #TRACE
-
-    int numread = numRecords;
-
-    double* timeRec = new double[numRecords];
-    uint32_t* typeRec = new uint32_t[numRecords];
-    uint32_t* idRec = new uint32_t[numRecords];
-    uint32_t* evRec = new uint32_t[numRecords];
-    double* val1Rec = new double[numRecords];
-    double* val2Rec = new double[numRecords];
-    double *val3Rec = new double[numRecords];
-
-    if (transpose) {
-        /* old-style transposed data */
-        std::ignore = fread(timeRec, sizeof(double), numread, logfile);
-        std::ignore = fread(typeRec, sizeof(uint32_t), numread, logfile);
-        std::ignore = fread(idRec,   sizeof(uint32_t), numread, logfile);
-        std::ignore = fread(evRec,   sizeof(uint32_t), numread, logfile);
-        std::ignore = fread(val1Rec, sizeof(double), numread, logfile);
-        std::ignore = fread(val2Rec, sizeof(double), numread, logfile);
-        std::ignore = fread(val3Rec, sizeof(double), numread, logfile);  
+    // Map the trace.  Raw records are used where they lie in the file;
+    // columnar blocks are decoded as they are processed, and the old
+    // transposed layout is regrouped into records up front.
+    long trace_start = ftell(logfile);
+    struct stat st;
+    if (fstat(fileno(logfile), &st) != 0) {
+        cerr << "Failed to stat logfile " << argv[1] << endl;
+        exit(1);
+    }
+    const char* mapped = (const char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(logfile), 0);
+    if (mapped == MAP_FAILED) {
+        cerr << "Failed to map logfile " << argv[1] << endl;
+        exit(1);
+    }
+    madvise((void*)mapped, st.st_size, MADV_SEQUENTIAL);
+    const char* trace = mapped + trace_start;
+
+    TraceReader reader;
+    vector<Chunk> chunks;
+    vector<LogRecord> transposed;
+    if (columnar) {
+        if (!reader.open(logfile, trace_start)) {
+            cerr << "Failed to read the index of columnar trace " << argv[1] << endl;
+            exit(1);
+        }
+        vector<bool> wanted(reader.blocks(), true);
+        if (!filter.types.empty() || !filter.ids.empty()) {
+            wanted.assign(reader.blocks(), false);
+            TraceReader::index_t::const_iterator k;
+            for (k = reader.index().begin(); k != reader.index().end(); k++) {
+                if (!filter.types.empty() && !filter.types.count(TraceReader::key_type(k->first)))
+                    continue;
+                if (!filter.ids.empty() && !filter.ids.count(TraceReader::key_id(k->first)))
+                    continue;
+                for (size_t b = 0; b < k->second.size(); b++)
+                    wanted[k->second[b]] = true;
+            }
+        }
+        for (size_t b = 0; b < reader.blocks(); b++) {
+            if (wanted[b]) {
+                Chunk c = {NULL, reader.block(b)._records, b};
+                chunks.push_back(c);
+            }
+        }
     } else {
-        /* new-style one record at a time */
-        for (int i = 0; i < numRecords; i++) {
-            std::ignore = fread(&timeRec[i], sizeof(double), 1, logfile);
-            std::ignore = fread(&typeRec[i], sizeof(uint32_t), 1, logfile);
-            std::ignore = fread(&idRec[i],   sizeof(uint32_t), 1, logfile);
-            std::ignore = fread(&evRec[i],   sizeof(uint32_t), 1, logfile);
-            std::ignore = fread(&val1Rec[i], sizeof(double), 1, logfile);
-            std::ignore = fread(&val2Rec[i], sizeof(double), 1, logfile);
-            std::ignore = fread(&val3Rec[i], sizeof(double), 1, logfile);  
+        if (st.st_size - trace_start < (long)(numRecords * sizeof(LogRecord))) {
+            cerr << "Logfile " << argv[1] << " is truncated" << endl;
+            exit(1);
+        }
+        const LogRecord* records = (const LogRecord*)trace;
+        if (transpose) {
+            /* old-style transposed data */
+            const char* col = trace;
+            transposed.resize(numRecords);
+            for (int i = 0; i < numRecords; i++, col += sizeof(double))
+                memcpy(&transposed[i]._time, col, sizeof(double));
+            for (int i = 0; i < numRecords; i++, col += sizeof(uint32_t))
+                memcpy(&transposed[i]._type, col, sizeof(uint32_t));
+            for (int i = 0; i < numRecords; i++, col += sizeof(uint32_t))
+                memcpy(&transposed[i]._id, col, sizeof(uint32_t));
+            for (int i = 0; i < numRecords; i++, col += sizeof(uint32_t))
+                memcpy(&transposed[i]._ev, col, sizeof(uint32_t));
+            for (int i = 0; i < numRecords; i++, col += sizeof(double))
+                memcpy(&transposed[i]._val1, col, sizeof(double));
+            for (int i = 0; i < numRecords; i++, col += sizeof(double))
+                memcpy(&transposed[i]._val2, col, sizeof(double));
+            for (int i = 0; i < numRecords; i++, col += sizeof(double))
+                memcpy(&transposed[i]._val3, col, sizeof(double));
+            records = transposed.data();
+        }
+        for (size_t r = 0; r < (size_t)numRecords; r += CHUNK_RECORDS) {
+            Chunk c = {records + r, min(CHUNK_RECORDS, numRecords - r), 0};
+            chunks.push_back(c);
         }
     }
 
+    if (ascii) {
+        // Each round the workers format a window of chunks, which are
+        // then written out in order, so the output stays in time order.
+        if (threads < 1)
+            threads = 1;
+        size_t window = threads * 4;
+        vector<string> out(window);
+        for (size_t first = 0; first < chunks.size(); first += window) {
+            size_t last = min(chunks.size(), first + window);
+            atomic<size_t> next(first);
+            auto work = [&]() {
+                vector<LogRecord> decoded;
+                string scratch;
+                size_t c;
+                while ((c = next++) < last) {
+                    const LogRecord* recs = chunk_records(chunks[c], reader, trace, decoded, scratch);
+                    string& text = out[c - first];
+                    text.clear();
+                    for (size_t r = 0; r < chunks[c].count; r++) {
+                        if (!filter.match(recs[r]))
+                            continue;
+                        hashmap<int, string>::const_iterator name = object_names.find(recs[r]._id);
+                        string line = record_to_str(recs[r], name == object_names.end() ? string() : name->second);
+                        bool do_output = true;
+                        for (size_t f=0; f < filters.size(); f++) {
+                            if (line.find(filters[f]) == string::npos) {
+                                do_output = false;
+                                break;
+                            }
+                        }
+                        if (!do_output)
+                            continue;
+                        if (fields.size() > 0) {
+                            std::istringstream iss(line);
+                            string item;
+                            int inum = 0;
+                            while (std::getline(iss, item, ' ')) {
+                                for (vector<int>::const_iterator fi = fields.begin(); fi != fields.end(); fi++) {
+                                    if (inum == *fi) {
+                                        text += item;
+                                        text += ' ';
+                                    }
+                                }
+                                inum++;
+                            }
+                        } else {
+                            text += line;
+                        }
+                        text += '\n';
+                    }
+                }
+            };
+            vector<thread> pool;
+            for (unsigned t = 1; t < threads && t < last - first; t++)
+                pool.push_back(thread(work));
+            work();
+            for (size_t t = 0; t < pool.size(); t++)
+                pool[t].join();
+            for (size_t c = first; c < last; c++)
+                fwrite(out[c - first].data(), 1, out[c - first].size(), stdout);
+        }
+        fflush(stdout);
+        exit(0);
+    }
+
     //type=mtcp
     //ev=rate
     //group by ID
 
-    //lets compute 
+    //lets compute
     hashmap<int, double> flow_rates;
     hashmap<int, double> flow_count;
 
     hashmap<int, double> flow_rates2;
     hashmap<int, double> flow_count2;
 
+
     int TYPE = 11, EV = 1100;
 
     if (argc>2&&!strcmp(argv[2], "-memory")) {
@@ -250,194 +549,44 @@ int main(int argc, char** argv){
         TYPE = -1; EV = -1;
     }
 
-    for (int i=0;i<numRecords;i++){
-        if (!timeRec[i]) {
-            continue;
-        }
-
-        if (ascii) {
-            RawLogEvent event(timeRec[i], typeRec[i], idRec[i], evRec[i], 
-                              val1Rec[i], val2Rec[i], val3Rec[i],object_names[idRec[i]]);
-            //cout << Logger::event_to_str(event) << endl;
-            string out;
-            //cout << "ev type: " << (Logger::EventType)typeRec[i] << endl;
-            switch((Logger::EventType)typeRec[i]) {
-            case Logger::QUEUE_EVENT: //0
-                out = QueueLoggerSimple::event_to_str(event);
-                break;
-            case Logger::TCP_EVENT: //1
-            case Logger::TCP_STATE: //2
-                out = TcpLoggerSimple::event_to_str(event); 
-                break;
-            case Logger::TRAFFIC_EVENT: //3
-                out = TrafficLoggerSimple::event_to_str(event); 
-                break;
-            case Logger::QUEUE_RECORD: //4
-            case Logger::QUEUE_APPROX: //5
-                out = QueueLoggerSampling::event_to_str(event);
-                break;
-            case Logger::TCP_RECORD: //6
-                out = AggregateTcpLogger::event_to_str(event);
-                break;
-            case Logger::QCN_EVENT: //7
-            case Logger::QCNQUEUE_EVENT: //8
-                out = QcnLoggerSimple::event_to_str(event);
-                break;
-            case Logger::TCP_TRAFFIC: //9
-                out = TcpTrafficLogger::event_to_str(event);
-                break;
-            case Logger::NDP_TRAFFIC: //10
-                out = NdpTrafficLogger::event_to_str(event);
-                break;
-            case Logger::ROCE_TRAFFIC: //10
-                out = RoceTrafficLogger::event_to_str(event);
-                break;
-                break;                
-            case Logger::HPCC_TRAFFIC: //10
-                out = HPCCTrafficLogger::event_to_str(event);
-                break;
-            case Logger::TCP_SINK: //11
-                out = TcpSinkLoggerSampling::event_to_str(event);
-                break;
-            case Logger::MTCP: //12
-                out = MultipathTcpLoggerSimple::event_to_str(event);
-                break;
-            case Logger::ENERGY: //13
-                // not currently used, so use default logger
-                out = Logger::event_to_str(event);
-                break;
-            case Logger::TCP_MEMORY: //14
-                out = MemoryLoggerSampling::event_to_str(event);
-                break;
-            case Logger::NDP_EVENT: //15
-            case Logger::NDP_STATE: //16
-            case Logger::NDP_RECORD: //17
-            case Logger::NDP_MEMORY: //19
-                // not currently used, so use default logger
-                out = Logger::event_to_str(event);
-                break;
-            case Logger::EQDS_EVENT: 
-            case Logger::EQDS_STATE: 
-            case Logger::EQDS_RECORD:
-            case Logger::EQDS_MEMORY:
-            case Logger::EQDS_TRAFFIC:
-                // not currently used, so use default logger
-                out = Logger::event_to_str(event);
-                break;
-            case Logger::NDP_SINK: //18
-                out = NdpSinkLoggerSampling::event_to_str(event);
-                break;
-            case Logger::EQDS_SINK: //18
-                out = EqdsSinkLoggerSampling::event_to_str(event);
-                break;
-            case Logger::ROCE_SINK: //18
-                out = RoceSinkLoggerSampling::event_to_str(event);
-                break;
-            case Logger::HPCC_SINK: //18
-                out = HPCCSinkLoggerSampling::event_to_str(event);
-                break;                
-            case Logger::SWIFT_EVENT: //20
-            case Logger::SWIFT_STATE: //21
-                out = SwiftLoggerSimple::event_to_str(event); 
-                break;
-            case Logger::SWIFT_MEMORY: //22
-                // not currently used, so use default logger
-                out = Logger::event_to_str(event);
-                break;
-            case Logger::SWIFT_SINK: //23
-                out = SwiftSinkLoggerSampling::event_to_str(event);
-                out += " ";
-                out.append(to_string(typeRec[i]));
-                out += " ";
-                out.append(to_string(evRec[i]));
-                break;
-            case Logger::SWIFT_TRAFFIC: //10
-                out = SwiftTrafficLogger::event_to_str(event);
-                break;
-            case Logger::STRACK_EVENT:
-            case Logger::STRACK_STATE: 
-                out = STrackLoggerSimple::event_to_str(event); 
-                break;
-            case Logger::STRACK_MEMORY: //22
-                // not currently used, so use default logger
-                out = Logger::event_to_str(event);
-                break;
-            case Logger::STRACK_SINK: //23
-                out = STrackSinkLoggerSampling::event_to_str(event);
-                out += " ";
-                out.append(to_string(typeRec[i]));
-                out += " ";
-                out.append(to_string(evRec[i]));
-                break;
-            case Logger::STRACK_TRAFFIC:
-                out = STrackTrafficLogger::event_to_str(event);
-                break;
-            case Logger::FLOW_EVENT:
-                out = FlowEventLoggerSimple::event_to_str(event);
-                break;
-            }
-            bool do_output = true;
-            for (size_t f=0; f < filters.size(); f++) {
-                size_t pos = out.find(filters[f]);
-                if (pos == string::npos) {
-                    // not found
-                    do_output = false;
-                    break;
-                }
-            }
-            if (do_output) {
-                if (fields.size() > 0) {
-                    stringstream out2(ios_base::out);
-                    //out2.str(std::string());
-                    std::istringstream iss(out);
-                    string item;
-                    int inum = 0;
-                    while (std::getline(iss, item, ' ')) {
-                        for (vector<int>::const_iterator fi = fields.begin(); fi != fields.end(); fi++) {
-                            if (inum == *fi) {
-                                out2 << item << " ";
-                            }
-                        }
-                        inum++;
-                    }
-                    cout << out2.str() << endl;
-                } else {
-                    cout << out << endl;
-                }
-            }
-        } else {
-            if ((typeRec[i]==(uint32_t)TYPE || TYPE==-1) 
-                && (evRec[i]==(uint32_t)EV || EV==-1)) {
+    vector<LogRecord> decoded;
+    string scratch;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        const LogRecord* recs = chunk_records(chunks[c], reader, trace, decoded, scratch);
+        for (size_t i = 0; i < chunks[c].count; i++) {
+            const LogRecord& r = recs[i];
+            if (!filter.match(r))
+                continue;
+            if ((r._type==(uint32_t)TYPE || TYPE==-1)
+                && (r._ev==(uint32_t)EV || EV==-1)) {
                 if (verbose)
-                    cout << timeRec[i] << " Type=" << typeRec[i] << " EV=" << evRec[i] 
-                         << " ID=" << idRec[i] << " VAL1=" << val1Rec[i] 
-                         << " VAL2=" << val2Rec[i] << " VAL3=" << val3Rec[i] << endl;        
-
-                if (!isnan((long double)val3Rec[i])) {
-                    if (flow_rates.find(idRec[i]) == flow_rates.end()){
-                        flow_rates[idRec[i]] = val3Rec[i];
-                        flow_count[idRec[i]] = 1;
+                    cout << r._time << " Type=" << r._type << " EV=" << r._ev
+                         << " ID=" << r._id << " VAL1=" << r._val1
+                         << " VAL2=" << r._val2 << " VAL3=" << r._val3 << endl;
+
+                if (!isnan((long double)r._val3)) {
+                    if (flow_rates.find(r._id) == flow_rates.end()){
+                        flow_rates[r._id] = r._val3;
+                        flow_count[r._id] = 1;
                     } else {
-                        flow_rates[idRec[i]] += val3Rec[i];
-                        flow_count[idRec[i]]++;
+                        flow_rates[r._id] += r._val3;
+                        flow_count[r._id]++;
                     }
                 }
 
-                if (!isnan((long double)val2Rec[i])) {
-                    if (flow_rates2.find(idRec[i]) == flow_rates2.end()) {
-                        flow_rates2[idRec[i]] = val2Rec[i];
-                        flow_count2[idRec[i]] = 1;
+                if (!isnan((long double)r._val2)) {
+                    if (flow_rates2.find(r._id) == flow_rates2.end()) {
+                        flow_rates2[r._id] = r._val2;
+                        flow_count2[r._id] = 1;
                     } else {
-                        flow_rates2[idRec[i]]+= val2Rec[i];
-                        flow_count2[idRec[i]]++;
+                        flow_rates2[r._id]+= r._val2;
+                        flow_count2[r._id]++;
                     }
                 }
             }
         }
     }
-    if (ascii) {
-        exit(0);
-    }
+
 
     //now print rates;
     vector<double> rates;
@@ -487,11 +636,6 @@ int main(int argc, char** argv){
            cnt, (total/cnt)*8/1000000, mean_rate/rates.size()*8/1000000, 
            mean_rate2/flow_rates2.size()*8/1000000);
   
-    delete[] timeRec;
-    delete[] typeRec;
-    delete[] idRec;
-    delete[] evRec;
-    delete[] val1Rec;
-    delete[] val2Rec;
+    munmap((void*)mapped, st.st_size);
     delete[] line;
 }
@@ -20,11 +20,17 @@ void
 Pipe::receivePacket(Packet& pkt)
 {
     //pkt.flow().logTraffic(pkt,*this,TrafficLogger::PKT_ARRIVE);
+    arrive(pkt, eventlist().now() + _delay);
+}
+
+void
+Pipe::arrive(Packet& pkt, simtime_picosec when)
+{
     //if (_inflight.empty()){
     if (_count == 0){
         /* no packets currently inflight; need to notify the eventlist
            we've an event pending */
-            eventlist().sourceIsPendingRel(*this,_delay);
+            eventlist().sourceIsPending(*this,when);
     }
     _count++;
     if (_count == _size) {
@@ -43,7 +49,7 @@ Pipe::receivePacket(Packet& pkt)
         }
         _size += _size;
     }
-    _inflight_v[_next_insert].time = eventlist().now() + _delay;
+    _inflight_v[_next_insert].time = when;
     _inflight_v[_next_insert].pkt = &pkt;
     _next_insert = (_next_insert +1) % _size;
     //_inflight.push_front(make_pair(eventlist().now() + _delay, &pkt));
@@ -35,6 +35,9 @@ class Pipe : public EventSource, public PacketSink, public Drawable {
             return _next_sink;
     }
 protected:
+    // take pkt, to be sent on at time when, which mustn't be before the
+    // last packet taken's
+    void arrive(Packet& pkt, simtime_picosec when);
     string _nodename;
     //typedef pair<simtime_picosec,Packet*> pktrecord_t;
     //list<pktrecord_t> _inflight; // the packets in flight (or being serialized)
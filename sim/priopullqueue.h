@@ -13,30 +13,26 @@
 #include "circular_buffer.h"
 #include "fairpullqueue.h"
 
+// Strict priority between levels (lower values first), and a
+// FairPullQueue within each level, or a FlowSlotPullQueue if
+// active_order is set.  Flows don't pass their slot to the levels, as
+// a flow's slot in one level means nothing in another; a
+// FlowSlotPullQueue level looks them up by flow id.
 template<class PullPkt>
 class PrioPullQueue : public BasePullQueue<PullPkt>{
 public:
-    PrioPullQueue();
+    PrioPullQueue(bool active_order = false);
+    virtual ~PrioPullQueue();
     virtual void enqueue(PullPkt& pkt, int priority);
     virtual PullPkt* dequeue();
     virtual void flush_flow(flowid_t flow_id, int priority);
 protected:
-    //QueueMap _queue_map;  // map flow id to pull queue
+    // there are only ever a few priorities in use
+    typedef map <int, BasePullQueue<PullPkt>*> PrioMap;
+    PrioMap _prio_queue_map; // maps priorities to a fair queue of the flows at that priority
+    bool _active_order;
 
-    typedef map<flowid_t, CircularBuffer<PullPkt*>*> QueueMap;
-    typedef map <int, QueueMap*> PrioMap;
-    typedef map <int, int> PrioCounts;
-    typedef map <int, typename QueueMap::iterator> CurrentQueueMap;    
-
-    PrioMap _prio_queue_map; // maps priorities to a map of queues at same priority
-    CurrentQueueMap _current_queue_map;
-    PrioCounts _prio_counts;
-
-    bool queue_exists(const PullPkt& pkt, int priority);
-    CircularBuffer<PullPkt*>* find_queue(const PullPkt& pkt, int priority);
-    CircularBuffer<PullPkt*>* create_queue(const PullPkt& pkt, int priority);
     void self_check();
-    //typename QueueMap::iterator _current_queue;
 };
 
 #endif
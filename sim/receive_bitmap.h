@@ -0,0 +1,123 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef RECEIVE_BITMAP_H
+#define RECEIVE_BITMAP_H
+
+/*
+ * The packets a sink has received above a hole, for the byte-sequenced
+ * transports (NDP, TCP, Swift, STrack).  It replaces the sorted
+ * list<seq_t> the sinks used to keep: with per-packet spraying,
+ * reordering is normal, and inserting into the list was a linear
+ * walk.  Here each packet is one bit in a circular array of 64-bit
+ * words, so inserting is O(1), and advancing the cumulative ack past
+ * the packets that were waiting on a hole scans a word at a time.
+ *
+ * Like the list code, this assumes every packet is the same size:
+ * that size, fixed by the first packet inserted, is the distance
+ * between the sequence numbers of consecutive packets.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+class ReceiveBitmap {
+public:
+    typedef uint64_t seq_t;
+
+    ReceiveBitmap() : _stride(0), _phase(0), _base(0), _top(0), _count(0) {}
+
+    bool empty() const {return _count == 0;}
+    size_t size() const {return _count;}
+
+    // forget everything, for a sink that's reused for another flow
+    void clear() {
+        std::fill(_words.begin(), _words.end(), 0);
+        _stride = 0;
+        _count = 0;
+    }
+
+    // Record the packet of 'size' bytes starting at 'seqno', which is
+    // above the next expected byte.  Returns false if we already had it.
+    bool insert(seq_t seqno, uint32_t size) {
+        if (_stride == 0) {
+            _stride = size;
+            _phase = seqno % size;
+        }
+        assert(size == _stride && seqno % _stride == _phase);
+        seq_t index = seqno / _stride;
+        if (_count == 0) {
+            _base = index;
+            _top = index + 1;
+        } else {
+            seq_t base = index < _base ? index : _base;
+            seq_t top = index >= _top ? index + 1 : _top;
+            if (((top - 1) >> 6) - (base >> 6) >= _words.size())
+                grow(((top - 1) >> 6) - (base >> 6) + 1);
+            _base = base;
+            _top = top;
+        }
+        if (_words.empty())
+            grow(1);
+        uint64_t& word = _words[(index >> 6) & (_words.size() - 1)];
+        uint64_t bit = (uint64_t)1 << (index & 63);
+        if (word & bit)
+            return false;
+        word |= bit;
+        _count++;
+        return true;
+    }
+
+    // The cumulative ack has reached 'cum_ack' (the last byte received
+    // in order).  Removes the packets that follow on directly from it,
+    // and returns how many there were.
+    uint32_t advance(seq_t cum_ack) {
+        seq_t next = cum_ack + 1;
+        if (_count == 0 || next % _stride != _phase)
+            return 0;
+        seq_t index = next / _stride;
+        if (index < _base)
+            return 0;
+        uint32_t n = 0;
+        while (_count > 0) {
+            uint64_t& word = _words[(index >> 6) & (_words.size() - 1)];
+            // the run of ones starting at index, up to the end of this word
+            uint64_t run = ~(word >> (index & 63));
+            uint32_t ones = run ? __builtin_ctzll(run) : 64;
+            if (ones == 0)
+                break;
+            uint64_t mask = ones == 64 ? ~(uint64_t)0 : (((uint64_t)1 << ones) - 1) << (index & 63);
+            word &= ~mask;
+            _count -= ones;
+            n += ones;
+            index += ones;
+            if (index & 63)
+                break; // stopped at a zero within the word
+        }
+        _base = index;
+        return n;
+    }
+
+private:
+    void grow(seq_t words) {
+        size_t n = _words.empty() ? 1 : _words.size();
+        while (n < words)
+            n *= 2;
+        std::vector<uint64_t> old(n, 0);
+        old.swap(_words);
+        if (old.empty())
+            return;
+        for (seq_t w = _base >> 6; w <= (_top - 1) >> 6; w++)
+            _words[w & (_words.size() - 1)] = old[w & (old.size() - 1)];
+    }
+
+    std::vector<uint64_t> _words;
+    uint32_t _stride;
+    seq_t _phase; // seqno % _stride, the same for every packet
+    seq_t _base;  // no packet below this index is set
+    seq_t _top;   // nor at or above this one
+    size_t _count;
+};
+
+#endif
@@ -1,19 +1,20 @@
 #include <cstdlib>
 #include <climits>
 #include <random>
+#include "simcontext.h"
 
 using namespace std;
 
-static mt19937 random_engine;
+// each simulation has its own generator, see SimContext
 
 void srand(unsigned seed)
 {
-    random_engine = mt19937(seed);
+    SimContext::current().random_engine() = mt19937(seed);
 }
 
 int rand()
 {
-    return random_engine() & INT_MAX;
+    return SimContext::current().random_engine()() & INT_MAX;
 }
 
 void srandom(unsigned seed)
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <algorithm>
 #include "roce.h"
+#include "flowstats.h"
 #include "queue.h"
 #include <stdio.h>
 #include "switch.h"
@@ -58,6 +59,7 @@ RoceSrc::RoceSrc(RoceLogger* logger, TrafficLogger* pktlogger, EventList &eventl
     _mdev = 0;
     _drops = 0;
     _flow_size = ((uint64_t)1)<<63;
+    _flow_start_time = 0;
   
     _node_num = _global_node_count++;
     _nodename = "rocesrc " + to_string(_node_num);
@@ -103,6 +105,7 @@ void RoceSrc::log_me() {
 void RoceSrc::startflow(){
     cout << "startflow " << _flow._name << " at " << timeAsUs(eventlist().now()) << endl;
     _flow_started = true;
+    _flow_start_time = eventlist().now();
     _highest_sent = 0;
     _last_acked = 0;
     
@@ -201,6 +204,8 @@ void RoceSrc::processAck(const RoceAck& ack) {
         cout << "Src " << get_id() << " ackno " << ackno << endl;
     if (ackno >= _flow_size){
         cout << "Flow " << _name << " " << get_id() << " finished at " << timeAsUs(eventlist().now()) << " total bytes " << ackno << endl;
+        if (!_done)
+            SimContext::current().flowStats().flow_finished(_flow_size, _flow_start_time, eventlist().now());
         _done = true;
         if (_end_trigger) {
             _end_trigger->activate();
@@ -135,6 +135,7 @@ private:
     void clear_timer(uint64_t start,uint64_t end);
 
     uint64_t _flow_size;  //The flow size in bytes.  Stop sending after this amount.
+    simtime_picosec _flow_start_time;
     simtime_picosec _stop_time;
     simtime_picosec _packet_spacing;
     simtime_picosec _time_last_sent;
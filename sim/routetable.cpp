@@ -4,18 +4,45 @@
 #include "network.h"
 #include "queue.h"
 #include "pipe.h"
+#include <unordered_set>
+
+RouteTable::~RouteTable(){
+    unordered_set<vector<FibEntry>*> sets(_fib.begin(), _fib.end());
+    for (vector<FibEntry>* routes : sets) {
+        if (!routes)
+            continue;
+        for (size_t i = 0; i < routes->size(); i++)
+            delete (*routes)[i].getEgressPort();
+        delete routes;
+    }
+    for (size_t dst = 0; dst < _hostfib.size(); dst++) {
+        if (!_hostfib[dst])
+            continue;
+        for (auto& entry : *_hostfib[dst]) {
+            delete entry.second->getEgressPort();
+            delete entry.second;
+        }
+        delete _hostfib[dst];
+    }
+}
 
 void RouteTable::addRoute(int destination, Route* port, int cost, packet_direction direction){  
-    if (_fib.find(destination) == _fib.end())
-        _fib[destination] = new vector<FibEntry*>(); 
+    assert(destination >= 0);
+    if ((size_t)destination >= _fib.size())
+        _fib.resize(destination + 1, NULL);
+    if (!_fib[destination])
+        _fib[destination] = new vector<FibEntry>(); 
     
     assert(port!=NULL);
 
-    _fib[destination]->push_back(new FibEntry(port,cost,direction));
+    _fib[destination]->push_back(FibEntry(port,cost,direction));
 }
 
 void RouteTable::addHostRoute(int destination, Route* port, int flowid){  
-    if (_hostfib.find(destination) == _hostfib.end())
+    assert(destination >= 0);
+    if ((size_t)destination >= _hostfib.size())
+        _hostfib.resize(destination + 1, NULL);
+    if (!_hostfib[destination])
         _hostfib[destination] = new unordered_map<int, HostFibEntry*>(); 
     
     assert(port!=NULL);
@@ -23,23 +50,18 @@ void RouteTable::addHostRoute(int destination, Route* port, int flowid){
     (*_hostfib[destination])[flowid] = new HostFibEntry(port,flowid);
 }
 
-
-vector<FibEntry*>* RouteTable::getRoutes(int destination){
-    if (_fib.find(destination) == _fib.end())
-        return NULL;
-    else        
-        return _fib[destination];
-}
-
 HostFibEntry* RouteTable::getHostRoute(int destination,int flowid){
-    if (_hostfib.find(destination) == _hostfib.end() ||
-        _hostfib[destination]->find(flowid) == _hostfib[destination]->end())
+    if ((size_t)destination >= _hostfib.size() || !_hostfib[destination])
         return NULL;
-    else {
-        return (*_hostfib[destination])[flowid];
-    }
+    unordered_map<int,HostFibEntry*>::iterator i = _hostfib[destination]->find(flowid);
+    if (i == _hostfib[destination]->end())
+        return NULL;
+    return i->second;
 }
 
-void RouteTable::setRoutes(int destination, vector<FibEntry*>* routes){
+void RouteTable::setRoutes(int destination, vector<FibEntry>* routes){
+    assert(destination >= 0);
+    if ((size_t)destination >= _fib.size())
+        _fib.resize(destination + 1, NULL);
     _fib[destination] = routes;
-}
\ No newline at end of file
+}
@@ -14,14 +14,16 @@
 
 class FibEntry{
 public:
-    FibEntry(Route* outport, uint32_t cost, packet_direction direction){ _out = outport; _cost = cost;_direction = direction;}
+    FibEntry(Route* outport, uint32_t cost, packet_direction direction){ _out = outport; _cost = cost;_direction = direction; _queue = (BaseQueue*)outport->at(0);}
 
     Route* getEgressPort(){return _out;}
+    BaseQueue* getEgressQueue(){return _queue;} // the first hop of getEgressPort()
     uint32_t getCost(){return _cost;}
     packet_direction getDirection(){return _direction;}
     
 protected:
     Route* _out;
+    BaseQueue* _queue;
     uint32_t _cost;
     packet_direction _direction;
 };
@@ -39,18 +41,29 @@ protected:
 
 };
 
+// Destinations are host addresses, which are numbered densely from
+// zero, so the tables are arrays indexed by destination.  Each
+// destination's ECMP set is an array of FibEntry values, so choosing
+// among them doesn't chase a pointer per entry.
 class RouteTable {
 public:
     RouteTable() {};
+    ~RouteTable();
     void addRoute(int destination, Route* port, int cost, packet_direction direction);  
     void addHostRoute(int destination, Route* port, int flowid);  
-    void setRoutes(int destination, vector<FibEntry*>* routes);  
-    vector <FibEntry*>* getRoutes(int destination);
+    void setRoutes(int destination, vector<FibEntry>* routes);  
+    vector<FibEntry>* getRoutes(int destination) {
+        if ((size_t)destination >= _fib.size())
+            return NULL;
+        return _fib[destination];
+    }
     HostFibEntry* getHostRoute(int destination, int flowid);
     
 private:
-    unordered_map<int,vector<FibEntry*>* > _fib;
-    unordered_map<int,unordered_map<int,HostFibEntry*>*> _hostfib;
+    // several destinations may share one ECMP set.  The table owns the
+    // sets and the routes in them.
+    vector<vector<FibEntry>*> _fib;
+    vector<unordered_map<int,HostFibEntry*>*> _hostfib;
 };
 
 #endif
@@ -0,0 +1,124 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef RTXSCANNER_H
+#define RTXSCANNER_H
+
+/*
+ * Periodic retransmission timer scanner, shared by the protocols that
+ * check their RTO from a scanner rather than running their own timer
+ * (TCP, NDP, Swift, STrack, NDP tunnel).
+ *
+ * The scanner still runs every scan period, but rather than calling
+ * rtx_timer_hook() on every registered source, it keeps a min-heap of
+ * the sources' RTO deadlines and only calls the hook on sources whose
+ * deadline falls within the current scan period.  Sources tell the
+ * scanner whenever they change their deadline, by calling
+ * deadlineChanged(); deadlines that move later (which happens on most
+ * ACKs) are updated lazily, so this is O(1) in the common case.
+ *
+ * Hooks are called in registration order, as the original scan of
+ * the whole source list did, and the hooks still make the final
+ * decision about whether the timer has expired, so results are the
+ * same either way.  setScanAll(true) restores the original scan of
+ * every source, for validation.
+ */
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include "config.h"
+#include "eventlist.h"
+
+template <class Src>
+class RtxTimerScanner : public EventSource {
+public:
+    RtxTimerScanner(simtime_picosec scanPeriod, simtime_picosec firstScan, EventList& eventlist)
+        : EventSource(eventlist, "RtxScanner"), _scanPeriod(scanPeriod), _scan_all(false) {
+        eventlist.sourceIsPendingRel(*this, firstScan);
+    }
+    void doNextEvent();
+    void setScanAll(bool scan_all) {_scan_all = scan_all;}
+    // deadline is the source's new RTO deadline, or zero if there isn't one
+    void deadlineChanged(uint32_t id, simtime_picosec deadline);
+protected:
+    // returns the id the source should pass to deadlineChanged()
+    uint32_t addSrc(Src& src);
+    simtime_picosec _scanPeriod;
+private:
+    void push(uint32_t id, simtime_picosec deadline);
+
+    typedef pair<simtime_picosec, uint32_t> deadline_t;
+    bool _scan_all;
+    vector<Src*> _srcs;
+    vector<simtime_picosec> _deadline; // latest deadline each source has told us about
+    vector<simtime_picosec> _queued;   // deadline of each source's live heap entry, or zero
+    priority_queue<deadline_t, vector<deadline_t>, greater<deadline_t> > _heap;
+    vector<uint32_t> _due;
+};
+
+template <class Src>
+uint32_t
+RtxTimerScanner<Src>::addSrc(Src& src) {
+    _srcs.push_back(&src);
+    _deadline.push_back(0);
+    _queued.push_back(0);
+    return _srcs.size() - 1;
+}
+
+template <class Src>
+void
+RtxTimerScanner<Src>::push(uint32_t id, simtime_picosec deadline) {
+    _queued[id] = deadline;
+    _heap.push(deadline_t(deadline, id));
+}
+
+template <class Src>
+void
+RtxTimerScanner<Src>::deadlineChanged(uint32_t id, simtime_picosec deadline) {
+    _deadline[id] = deadline;
+    // if the deadline moved later, the old heap entry will find out when it comes up
+    if (deadline != 0 && (_queued[id] == 0 || deadline < _queued[id]))
+        push(id, deadline);
+}
+
+template <class Src>
+void
+RtxTimerScanner<Src>::doNextEvent() {
+    simtime_picosec now = eventlist().now();
+    if (_scan_all) {
+        for (size_t i = 0; i < _srcs.size(); i++)
+            _srcs[i]->rtx_timer_hook(now, _scanPeriod);
+        eventlist().sourceIsPendingRel(*this, _scanPeriod);
+        return;
+    }
+
+    simtime_picosec horizon = now + _scanPeriod;
+    while (!_heap.empty() && _heap.top().first <= horizon) {
+        deadline_t entry = _heap.top();
+        _heap.pop();
+        uint32_t id = entry.second;
+        if (_queued[id] != entry.first)
+            continue;  // superseded by an earlier deadline
+        _queued[id] = 0;
+        if (_deadline[id] == 0)
+            continue;
+        if (_deadline[id] > horizon) {
+            push(id, _deadline[id]);
+            continue;
+        }
+        _due.push_back(id);
+    }
+
+    sort(_due.begin(), _due.end());
+    for (size_t i = 0; i < _due.size(); i++) {
+        uint32_t id = _due[i];
+        _srcs[id]->rtx_timer_hook(now, _scanPeriod);
+        // if the hook didn't move the deadline, look again next scan
+        if (_queued[id] == 0 && _deadline[id] != 0)
+            push(id, _deadline[id]);
+    }
+    _due.clear();
+    eventlist().sourceIsPendingRel(*this, _scanPeriod);
+}
+
+#endif
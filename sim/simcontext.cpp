@@ -0,0 +1,72 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "simcontext.h"
+#include "eventlist.h"
+#include "network.h"
+#include "flowstats.h"
+#include "timerwheel.h"
+
+thread_local SimContext* SimContext::_current = NULL;
+
+SimContext::SimContext()
+{
+    _eventlist = NULL;
+    _timerwheel = NULL;
+    _next_logged_id = 1;
+    _logged_manager = new LoggedManager();
+    _next_flow_id = FLOW_ID_DYNAMIC_BASE;
+    _out = &std::cout;
+    _log = &std::cout;
+    _flow_stats = NULL;
+
+    // the default flow is always the first thing created, so a
+    // simulation gets the same IDs whichever context it runs in
+    SimContext* prev = _current;
+    _current = this;
+    _default_flow = new PacketFlow(NULL);
+    _current = prev;
+}
+
+SimContext::~SimContext()
+{
+    if (_current == this)
+        _current = NULL;
+    delete _logged_manager;
+    delete _flow_stats;
+    delete _timerwheel;
+    delete _default_flow;
+}
+
+SimContext&
+SimContext::current()
+{
+    if (_current == NULL)
+        _current = new SimContext();
+    return *_current;
+}
+
+void
+SimContext::setCurrent(SimContext* ctx)
+{
+    _current = ctx;
+}
+
+uint32_t
+SimContext::addLogged(Logged* logged)
+{
+    _logged_manager->add_logged(logged);
+    return _next_logged_id++;
+}
+
+FlowStats&
+SimContext::flowStats()
+{
+    if (_flow_stats == NULL)
+        _flow_stats = new FlowStats();
+    return *_flow_stats;
+}
+
+void
+SimContext::dump_idmap()
+{
+    _logged_manager->dump_idmap();
+}
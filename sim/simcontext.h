@@ -0,0 +1,87 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef SIMCONTEXT_H
+#define SIMCONTEXT_H
+
+/*
+ * State that belongs to one simulation rather than to the process:
+ * the EventList, the counters that hand out Logged IDs and dynamic
+ * flow IDs, the ID->name map, the random number generator behind
+ * random()/rand(), the timer wheel, the flow completion stats, and
+ * the streams results and progress messages are written to.
+ *
+ * Each thread has a current context, which everything built on that
+ * thread uses.  A program that runs one simulation never needs to know
+ * about this - a thread gets a fresh context the first time it needs
+ * one.  To run several simulations in one process, run each on its own
+ * thread, and either let it get a fresh context or create one and make
+ * it current before building anything.  A context must only be used by
+ * one thread at a time.  To split one simulation over several threads,
+ * see ParallelSim, which gives each part its own context.
+ *
+ * Packet pools are per-thread.  Class-wide protocol and topology
+ * settings (EqdsSrc::_hdr_size, FatTreeSwitch::_strategy, etc) are still
+ * shared by all simulations, so set them before starting threads.
+ * The few that a parameter sweep varies per run are thread_local.
+ */
+
+#include <random>
+#include <iostream>
+#include "config.h"
+
+// flow ids above this are dynamically allocated; ones less than this can be manually allocated
+#define FLOW_ID_DYNAMIC_BASE 1000000000
+
+class EventList;
+class FlowStats;
+class Logged;
+class LoggedManager;
+class PacketFlow;
+class TimerWheel;
+
+class SimContext {
+public:
+    SimContext();
+    ~SimContext();
+
+    static SimContext& current();
+    static void setCurrent(SimContext* ctx);
+
+    // Logged IDs
+    uint32_t addLogged(Logged* logged);
+    inline uint32_t nextLoggedId() const {return _next_logged_id;}
+    void dump_idmap();
+
+    inline uint32_t allocFlowId() {return _next_flow_id++;}
+    inline std::mt19937& random_engine() {return _random_engine;}
+    // flow for packets that don't belong to any other
+    inline PacketFlow& defaultFlow() {return *_default_flow;}
+    // where results (eg flow completion times) are written; cout by default
+    inline std::ostream& out() {return *_out;}
+    void setOut(std::ostream* out) {_out = out;}
+    // where progress messages (eg a topology describing itself) are
+    // written; cout by default
+    inline std::ostream& log() {return *_log;}
+    void setLog(std::ostream* log) {_log = log;}
+    // completion times of the flows that have finished
+    FlowStats& flowStats();
+
+    // set by their constructors (or created on first use)
+    EventList* _eventlist;
+    TimerWheel* _timerwheel;
+
+    SimContext(const SimContext&) = delete;
+    void operator=(const SimContext&) = delete;
+private:
+    uint32_t _next_logged_id;
+    LoggedManager* _logged_manager;
+    uint32_t _next_flow_id;
+    std::mt19937 _random_engine;
+    PacketFlow* _default_flow;
+    std::ostream* _out;
+    std::ostream* _log;
+    FlowStats* _flow_stats;
+
+    static thread_local SimContext* _current;
+};
+
+#endif
@@ -14,7 +14,7 @@ STrackSrc::STrackSrc(STrackRtxTimerScanner& rtx_scanner, STrackLogger* logger,
                      TrafficLogger* pktlogger, 
                      EventList &eventlst)
     : EventSource(eventlst,"strack"),
-      _flow(pktlogger),  _pacer(*this, eventlist()), _logger(logger),
+      _rtx_timer(*this), _flow(pktlogger),  _pacer(*this, eventlist()), _logger(logger),
      _traffic_logger(pktlogger), _rtx_timer_scanner(&rtx_scanner)
 {
     _mss = Packet::data_packet_size();
@@ -72,6 +72,8 @@ STrackSrc::STrackSrc(STrackRtxTimerScanner& rtx_scanner, STrackLogger* logger,
 
     _rtx_timeout_pending = false;
     _RFC2988_RTO_timeout = timeInf;
+    _rtx_scanner = NULL;
+    _rtx_scanner_id = 0;
 
     _sink = NULL;
     _nodename = "strack_src" + std::to_string(get_id());
@@ -155,11 +157,11 @@ void
 STrackSrc::handle_ack(STrackAck::seq_t ackno) {
     simtime_picosec now = eventlist().now();
     if (ackno > _last_acked) { // a brand new ack
-        _RFC2988_RTO_timeout = now + _rto;// RFC 2988 5.3
+        set_rto_timeout(now + _rto);// RFC 2988 5.3
     
         if (ackno >= _highest_sent) {
             _highest_sent = ackno;
-            _RFC2988_RTO_timeout = timeInf;// RFC 2988 5.2
+            set_rto_timeout(timeInf);// RFC 2988 5.2
         }
 
         if (!_in_fast_recovery) {
@@ -271,7 +273,7 @@ STrackSrc::send_packets() {
         p->sendOn();
 
         if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-            _RFC2988_RTO_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }        
         //cout << "Sending SYN, waiting for SYN/ACK" << endl;
         return sent_count;
@@ -328,7 +330,7 @@ STrackSrc::send_packets() {
         }
 
         if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-            _RFC2988_RTO_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
             //cout << timeAsUs(eventlist().now()) << " " << nodename() << " RTO at " << timeAsUs(_RFC2988_RTO_timeout) << "us" << endl;
         }
     }
@@ -338,7 +340,7 @@ STrackSrc::send_packets() {
 bool
 STrackSrc::send_next_packet() {
     // ask the scheduler if we can send now
-    if (queuesize(_flow.flow_id()) > 2) {
+    if (queuesize(_flow) > 2) {
         // no, we can't send.  We'll be called back when we can.
         _deferred_send = true;
         return false;
@@ -391,7 +393,7 @@ STrackSrc::retransmit_packet() {
     _packets_sent += mss();
 
     if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-        _RFC2988_RTO_timeout = eventlist().now() + _rto;
+        set_rto_timeout(eventlist().now() + _rto);
     }
 }
 
@@ -444,6 +446,13 @@ STrackSrc::receivePacket(Packet& pkt)
     handle_ack(ackno);
 }
 
+void
+STrackSrc::set_rto_timeout(simtime_picosec timeout) {
+    _RFC2988_RTO_timeout = timeout;
+    if (_rtx_scanner)
+        _rtx_scanner->deadlineChanged(_rtx_scanner_id, timeout);
+}
+
 void
 STrackSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
     //cout << timeAsUs(eventlist().now()) << " " << nodename() << " rtx_timer_hook" << endl;
@@ -475,20 +484,20 @@ STrackSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
         // carry over the difference for restarting
         simtime_picosec rtx_off = (period - too_late)/200;
  
-        eventlist().sourceIsPendingRel(*this, rtx_off);
+        _rtx_timer.armRel(rtx_off);
 
         //reset our rtx timerRFC 2988 5.5 & 5.6
 
         _rto *= 2;
         //if (_rto > timeFromMs(1000))
         //  _rto = timeFromMs(1000);
-        _RFC2988_RTO_timeout = now + _rto;
+        set_rto_timeout(now + _rto);
     }
 }
 
 void STrackSrc::doNextEvent() {
     cout << "src " << get_id() << " doNextEvent" << endl;
-    if(_rtx_timeout_pending) {
+    if(_rtx_timer.expired()) {
         _rtx_timeout_pending = false;
 
         log(STrackLogger::STRACK_TIMEOUT);
@@ -531,8 +540,8 @@ STrackSrc::log(STrackLogger::STrackEvent event) {
 }
 
 int
-STrackSrc::queuesize(int flow_id) {
-    return _scheduler->src_queuesize(flow_id);
+STrackSrc::queuesize(const PacketFlow& flow) {
+    return _scheduler->src_queuesize(flow);
 }
 
 bool
@@ -631,7 +640,7 @@ STrackSrc::connect(const Route& routeout, const Route& routeback, STrackSink& si
     _route = cloned_rt;
     _flow.set_id(get_id()); // identify the packet flow with the source that generated it
     cout << "connect, src " << get_id() << " flow id is now " << _flow.get_id()  << endl;
-    _scheduler->add_src(_flow.flow_id(), this);
+    _scheduler->add_src(_flow, this);
     _rtx_timer_scanner->registerSrc(*this);
     _sink=&sink;
 
@@ -672,7 +681,7 @@ STrackSrc::targetDelay(const Route& route) {
 
 /* XXX currently it's one src per pacer - maybe should be shared via carousel */
 STrackPacer::STrackPacer(STrackSrc& src, EventList& event_list)
-    : EventSource(event_list,"strack_pacer"), _src(&src), _interpacket_delay(0) {
+    : EventSource(event_list,"strack_pacer"), _src(&src), _interpacket_delay(0), _send_timer(*this) {
     _last_send = eventlist().now();
 }
 
@@ -689,14 +698,14 @@ STrackPacer::schedule_send(simtime_picosec delay) {
         doNextEvent();
         return;
     }
-    eventlist().sourceIsPending(*this, _next_send);
+    _send_timer.arm(_next_send);
 }
 
 void
 STrackPacer::cancel() {
     _interpacket_delay = 0;
     _next_send = 0;
-    eventlist().cancelPendingSource(*this);
+    _send_timer.cancel();
 }
 
 // called when we're in window-mode to update the send time so it's always correct if we
@@ -708,6 +717,8 @@ STrackPacer::just_sent() {
 
 void
 STrackPacer::doNextEvent() {
+    // we're also called directly from schedule_send, so this may not be the timer
+    _send_timer.expired();
     assert(eventlist().now() == _next_send);
     _src->send_next_packet();
     _last_send = eventlist().now();
@@ -764,8 +775,7 @@ STrackSink::receivePacket(Packet& pkt) {
         _cumulative_ack = seqno + size - 1;
         _total_received += size;
         // are there any additional received packets we can now ack?
-        while (!_received.empty() && (_received.front() == _cumulative_ack+1) ) {
-            _received.pop_front();
+        for (uint32_t n = _received.advance(_cumulative_ack); n > 0; n--) {
             _cumulative_ack += size;
             _total_received += size;
             if (_buffer_logger) _buffer_logger->logBuffer(ReorderBufferLogger::BUF_DEQUEUE);
@@ -776,22 +786,9 @@ STrackSink::receivePacket(Packet& pkt) {
         cout << "Spurious retransmit received!\n";
     } else {
         // it's not the next expected sequence number
-        if (_received.empty()) {
-            _received.push_front(seqno);
-        } else if (seqno > _received.back()) {
-            // likely case - new packet above a hole
-            _received.push_back(seqno);
-        } else {
-            // uncommon case - it fills a hole, but not first hole
-            list<uint64_t>::iterator i;
-            for (i = _received.begin(); i != _received.end(); i++) {
-                if (seqno == *i) break; // it's a bad retransmit
-                if (seqno < (*i)) {
-                    _received.insert(i, seqno);
-                    if (_buffer_logger) _buffer_logger->logBuffer(ReorderBufferLogger::BUF_ENQUEUE);
-                    break;
-                }
-            }
+        // insert returns false for a bad retransmit
+        if (_received.insert(seqno, size)) {
+            if (_buffer_logger) _buffer_logger->logBuffer(ReorderBufferLogger::BUF_ENQUEUE);
         }
     }
     if (_ooo < _received.size())
@@ -827,20 +824,10 @@ STrackSink::drops() {
 ////////////////////////////////////////////////////////////////
 
 STrackRtxTimerScanner::STrackRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
-    : EventSource(eventlist,"RtxScanner"), _scanPeriod(scanPeriod) {
-    eventlist.sourceIsPendingRel(*this, _scanPeriod);
+    : RtxTimerScanner<STrackSrc>(scanPeriod, scanPeriod, eventlist) {
 }
 
 void 
 STrackRtxTimerScanner::registerSrc(STrackSrc &src) {
-    _srcs.push_back(&src);
-}
-
-void STrackRtxTimerScanner::doNextEvent() {
-    simtime_picosec now = eventlist().now();
-    srcs_t::iterator i;
-    for (i = _srcs.begin(); i!=_srcs.end(); i++) {
-        (*i)->rtx_timer_hook(now,_scanPeriod);
-    }
-    eventlist().sourceIsPendingRel(*this, _scanPeriod);
+    src.set_rtx_scanner(this, addSrc(src));
 }
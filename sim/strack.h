@@ -9,10 +9,13 @@
 #include <list>
 #include <set>
 #include "config.h"
+#include "receive_bitmap.h"
 #include "network.h"
 #include "strackpacket.h"
 #include "swift_scheduler.h"
 #include "eventlist.h"
+#include "timerwheel.h"
+#include "rtxscanner.h"
 #include "sent_packets.h"
 
 //#define MODEL_RECEIVE_WINDOW 1
@@ -37,6 +40,7 @@ private:
     simtime_picosec _interpacket_delay; // the interpacket delay, or zero if we're not pacing
     simtime_picosec _last_send;  // when the last packet was sent (always set, even when we're not pacing)
     simtime_picosec _next_send;  // when the next scheduled packet should be sent
+    Timer _send_timer;
 };
 
 class STrackSrc : public EventSource, public PacketSink, public ScheduledSrc {
@@ -121,7 +125,7 @@ class STrackSrc : public EventSource, public PacketSink, public ScheduledSrc {
     // STrack helper functions
     simtime_picosec targetDelay(const Route& route);
 
-    int queuesize(int flow_id);
+    int queuesize(const PacketFlow& flow);
 
     virtual const string& nodename() { return _nodename; }
     void connect(STrackSink& sink, const Route& routeout, const Route& routeback, uint32_t flow_id, BaseScheduler* scheduler);
@@ -133,6 +137,10 @@ class STrackSrc : public EventSource, public PacketSink, public ScheduledSrc {
     void move_path();
     void reroute(const Route &route);
     void rtx_timer_hook(simtime_picosec now, simtime_picosec period);
+    void set_rtx_scanner(RtxTimerScanner<STrackSrc>* scanner, uint32_t id) {
+        _rtx_scanner = scanner;
+        _rtx_scanner_id = id;
+    }
     inline simtime_picosec pacing_delay() const {return _pacing_delay;}
     PacketFlow& flow() {return _flow;}
     uint32_t drops() { return _drops;}
@@ -160,6 +168,10 @@ protected:
 
     uint32_t _drops;
     bool _rtx_timeout_pending;
+    Timer _rtx_timer;
+    RtxTimerScanner<STrackSrc>* _rtx_scanner;
+    uint32_t _rtx_scanner_id;
+    void set_rto_timeout(simtime_picosec timeout); // always use this to set _RFC2988_RTO_timeout
 
     // Connectivity
     PacketFlow _flow;
@@ -222,8 +234,7 @@ class STrackSink : public PacketSink, public DataReceiver {
     // Mechanism
     void send_ack(simtime_picosec ts);
 
-    list<STrackAck::seq_t> _received; /* list of packets above a hole, that 
-                                      we've received */
+    ReceiveBitmap _received; /* packets above a hole, that we've received */
     uint64_t _ooo; // out of order max
     uint64_t _total_received;
     string _nodename;
@@ -232,15 +243,10 @@ class STrackSink : public PacketSink, public DataReceiver {
     ReorderBufferLogger* _buffer_logger;
 };
 
-class STrackRtxTimerScanner : public EventSource {
+class STrackRtxTimerScanner : public RtxTimerScanner<STrackSrc> {
  public:
     STrackRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
-    void doNextEvent();
     void registerSrc(STrackSrc &src);
- private:
-    simtime_picosec _scanPeriod;
-    typedef list<STrackSrc*> srcs_t;
-    srcs_t _srcs;
 };
 
 #endif
@@ -1,4 +1,4 @@
 #include "strackpacket.h"
 
-PacketDB<STrackPacket> STrackPacket::_packetdb;
-PacketDB<STrackAck> STrackAck::_packetdb;
+thread_local PacketDB<STrackPacket> STrackPacket::_packetdb;
+thread_local PacketDB<STrackAck> STrackAck::_packetdb;
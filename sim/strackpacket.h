@@ -43,7 +43,7 @@ protected:
     seq_t _seqno;
     bool _syn;
     simtime_picosec _ts;
-    static PacketDB<STrackPacket> _packetdb;
+    static thread_local PacketDB<STrackPacket> _packetdb;
 };
 
 class STrackAck : public Packet {
@@ -75,7 +75,7 @@ protected:
     seq_t _ackno;
 
     simtime_picosec _ts_echo;
-    static PacketDB<STrackAck> _packetdb;
+    static thread_local PacketDB<STrackAck> _packetdb;
 };
 
 #endif
@@ -1,5 +1,6 @@
 // -*- c-basic-offset: 4; indent-tabs-mode: nil -*- 
 #include "swift.h"
+#include "flowstats.h"
 #include <iostream>
 #include <math.h>
 
@@ -10,7 +11,7 @@
 uint32_t SwiftSubflowSrc::_default_cwnd = 12;
 
 SwiftSubflowSrc::SwiftSubflowSrc(SwiftSrc& src, TrafficLogger* pktlogger, int sub_id)
-    : EventSource(src.eventlist(), "swift_subflow_src"), _flow(pktlogger), _src(src), _pacer(*this, src.eventlist())
+    : EventSource(src.eventlist(), "swift_subflow_src"), _rtx_timer(*this), _flow(pktlogger), _src(src), _pacer(*this, src.eventlist())
 {
     cout << "subflow src constructor\n";
     _subflow_sink = NULL;
@@ -44,6 +45,8 @@ SwiftSubflowSrc::SwiftSubflowSrc(SwiftSrc& src, TrafficLogger* pktlogger, int su
     
     _rtx_timeout_pending = false;
     _RFC2988_RTO_timeout = timeInf;
+    _rtx_scanner = NULL;
+    _rtx_scanner_id = 0;
 
     _nodename = "swift_subsrc" + std::to_string(_src.get_id()) + "_" + std::to_string(sub_id);
 }
@@ -173,13 +176,13 @@ void
 SwiftSubflowSrc::handle_ack(SwiftAck::seq_t ackno) {
     simtime_picosec now = eventlist().now();
     if (ackno > _last_acked) { // a brand new ack
-        _RFC2988_RTO_timeout = now + _rto;// RFC 2988 5.3
+        set_rto_timeout(now + _rto);// RFC 2988 5.3
     
         if (ackno >= _highest_sent) {
             
             _highest_sent = ackno;
             //cout << timeAsUs(now) << " " << nodename() << " highest_sent now  " << _highest_sent << endl;
-            _RFC2988_RTO_timeout = timeInf;// RFC 2988 5.2
+            set_rto_timeout(timeInf);// RFC 2988 5.2
         }
 
         if (!_in_fast_recovery) {
@@ -291,7 +294,7 @@ SwiftSubflowSrc::send_packets() {
         p->sendOn();
 
         if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-            _RFC2988_RTO_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }        
         //cout << "Sending SYN, waiting for SYN/ACK" << endl;
         return sent_count;
@@ -348,7 +351,7 @@ SwiftSubflowSrc::send_packets() {
         }
 
         if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-            _RFC2988_RTO_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
             //cout << timeAsUs(eventlist().now()) << " " << nodename() << " RTO at " << timeAsUs(_RFC2988_RTO_timeout) << "us" << endl;
         }
     }
@@ -358,7 +361,7 @@ SwiftSubflowSrc::send_packets() {
 bool
 SwiftSubflowSrc::send_next_packet() {
     // ask the scheduler if we can send now
-    if (_src.queuesize(_flow.flow_id()) > 2) {
+    if (_src.queuesize(_flow) > 2) {
         // no, we can't send.  We'll be called back when we can.
         _deferred_send = true;
         return false;
@@ -423,7 +426,7 @@ SwiftSubflowSrc::retransmit_packet() {
     _packets_sent += mss();
 
     if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-        _RFC2988_RTO_timeout = eventlist().now() + _rto;
+        set_rto_timeout(eventlist().now() + _rto);
     }
 }
 
@@ -464,6 +467,13 @@ SwiftSubflowSrc::receivePacket(Packet& pkt)
     handle_ack(ackno);
 }
 
+void
+SwiftSubflowSrc::set_rto_timeout(simtime_picosec timeout) {
+    _RFC2988_RTO_timeout = timeout;
+    if (_rtx_scanner)
+        _rtx_scanner->deadlineChanged(_rtx_scanner_id, timeout);
+}
+
 void
 SwiftSubflowSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
     //cout << timeAsUs(eventlist().now()) << " " << nodename() << " rtx_timer_hook" << endl;
@@ -495,19 +505,19 @@ SwiftSubflowSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
         // carry over the difference for restarting
         simtime_picosec rtx_off = (period - too_late)/200;
  
-        eventlist().sourceIsPendingRel(*this, rtx_off);
+        _rtx_timer.armRel(rtx_off);
 
         //reset our rtx timerRFC 2988 5.5 & 5.6
 
         _rto *= 2;
         //if (_rto > timeFromMs(1000))
         //  _rto = timeFromMs(1000);
-        _RFC2988_RTO_timeout = now + _rto;
+        set_rto_timeout(now + _rto);
     }
 }
 
 void SwiftSubflowSrc::doNextEvent() {
-    if(_rtx_timeout_pending) {
+    if(_rtx_timer.expired()) {
         _rtx_timeout_pending = false;
 
         _src.log(this, SwiftLogger::SWIFT_TIMEOUT);
@@ -549,7 +559,7 @@ SwiftSubflowSrc::connect(SwiftSink& sink, const Route& routeout, const Route& ro
     _flow.set_id(get_id()); // identify the packet flow with the source that generated it
     cout << "connect, flow id is now " << _flow.get_id() << endl;
     assert(scheduler);
-    scheduler->add_src(_flow.flow_id(), this);
+    scheduler->add_src(_flow, this);
 }
 
 void
@@ -596,6 +606,8 @@ SwiftSrc::SwiftSrc(SwiftRtxTimerScanner& rtx_scanner, SwiftLogger* logger, Traff
     _scheduler = NULL;
     _maxcwnd = 0xffffffff;//200*_mss;
     _flow_size = ((uint64_t)1)<<63;
+    _flow_start_time = 0;
+    _fct_recorded = false;
     _stop_time = 0;
     _stopped = false;
     _app_limited = -1;
@@ -635,8 +647,8 @@ SwiftSrc::log(SwiftSubflowSrc* sub, SwiftLogger::SwiftEvent event) {
 }
 
 int
-SwiftSrc::queuesize(int flow_id) {
-    return _scheduler->src_queuesize(flow_id);
+SwiftSrc::queuesize(const PacketFlow& flow) {
+    return _scheduler->src_queuesize(flow);
 }
 
 bool
@@ -715,6 +727,8 @@ SwiftSrc::permute_paths() {
 
 void 
 SwiftSrc::startflow() {
+    if (_flow_start_time == 0)
+        _flow_start_time = eventlist().now();
     for (size_t i = 0; i < _subs.size(); i++) {
         if (_subs[i]->_established)
             continue; // don't start twice
@@ -797,6 +811,11 @@ void SwiftSrc::update_dsn_ack(SwiftAck::seq_t ds_ackno) {
     //cout << "Flow " << _name << " dsn ack " << ds_ackno << endl;
     if (ds_ackno >= _flow_size){
         cout << "Flow " << _name << " finished at " << timeAsUs(eventlist().now()) << " total bytes " << ds_ackno << endl;
+        if (!_fct_recorded) {
+            // set_flowsize() added a packet to the flow size
+            SimContext::current().flowStats().flow_finished(_flow_size - mss(), _flow_start_time, eventlist().now());
+            _fct_recorded = true;
+        }
     }
 }
 
@@ -821,7 +840,7 @@ void SwiftSrc::doNextEvent() {
 
 /* XXX currently it's one subflow per pacer - maybe should be shared via carousel */
 SwiftPacer::SwiftPacer(SwiftSubflowSrc& sub, EventList& event_list)
-    : EventSource(event_list,"swift_pacer"), _sub(&sub), _interpacket_delay(0) {
+    : EventSource(event_list,"swift_pacer"), _sub(&sub), _interpacket_delay(0), _send_timer(*this) {
     _last_send = eventlist().now();
 }
 
@@ -838,14 +857,14 @@ SwiftPacer::schedule_send(simtime_picosec delay) {
         doNextEvent();
         return;
     }
-    eventlist().sourceIsPending(*this, _next_send);
+    _send_timer.arm(_next_send);
 }
 
 void
 SwiftPacer::cancel() {
     _interpacket_delay = 0;
     _next_send = 0;
-    eventlist().cancelPendingSource(*this);
+    _send_timer.cancel();
 }
 
 // called when we're in window-mode to update the send time so it's always correct if we
@@ -857,6 +876,8 @@ SwiftPacer::just_sent() {
 
 void
 SwiftPacer::doNextEvent() {
+    // we're also called directly from schedule_send, so this may not be the timer
+    _send_timer.expired();
     assert(eventlist().now() == _next_send);
     _sub->send_next_packet();
     _last_send = eventlist().now();
@@ -911,10 +932,7 @@ SwiftSubflowSink::receivePacket(Packet& pkt) {
     if (seqno == _cumulative_ack+1) { // it's the next expected seq no
         _cumulative_ack = seqno + size - 1;
         // are there any additional received packets we can now ack?
-        while (!_received.empty() && (_received.front() == _cumulative_ack+1) ) {
-            _received.pop_front();
-            _cumulative_ack += size;
-        }
+        _cumulative_ack += _received.advance(_cumulative_ack) * size;
     } else if (seqno < _cumulative_ack+1) {
         // it is before the next expected sequence - must be a spurious retransmit.
         // We want to see if this happens - it generally shouldn't
@@ -922,24 +940,11 @@ SwiftSubflowSink::receivePacket(Packet& pkt) {
     } else {
         // it's not the next expected sequence number
         if (_received.empty()) {
-            _received.push_front(seqno);
             //it's a drop - in this simulator there are no reorderings.
             // [Note: if we ever add multipath, fix this!]
             _drops += (size + seqno-_cumulative_ack-1)/size;
-        } else if (seqno > _received.back()) {
-            // likely case - new packet above a hole
-            _received.push_back(seqno);
-        } else {
-            // uncommon case - it fills a hole, but not first hole
-            list<uint64_t>::iterator i;
-            for (i = _received.begin(); i != _received.end(); i++) {
-                if (seqno == *i) break; // it's a bad retransmit
-                if (seqno < (*i)) {
-                    _received.insert(i, seqno);
-                    break;
-                }
-            }
         }
+        _received.insert(seqno, size); // false if it's a bad retransmit
     }
 
     _sink.receivePacket(pkt);
@@ -1046,20 +1051,10 @@ SwiftSink::drops(){
 ////////////////////////////////////////////////////////////////
 
 SwiftRtxTimerScanner::SwiftRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
-    : EventSource(eventlist,"RtxScanner"), _scanPeriod(scanPeriod) {
-    eventlist.sourceIsPendingRel(*this, _scanPeriod);
+    : RtxTimerScanner<SwiftSubflowSrc>(scanPeriod, scanPeriod, eventlist) {
 }
 
 void 
 SwiftRtxTimerScanner::registerSubflow(SwiftSubflowSrc &subflow_src) {
-    _subflows.push_back(&subflow_src);
-}
-
-void SwiftRtxTimerScanner::doNextEvent() {
-    simtime_picosec now = eventlist().now();
-    subflows_t::iterator i;
-    for (i = _subflows.begin(); i!=_subflows.end(); i++) {
-        (*i)->rtx_timer_hook(now,_scanPeriod);
-    }
-    eventlist().sourceIsPendingRel(*this, _scanPeriod);
+    subflow_src.set_rtx_scanner(this, addSrc(subflow_src));
 }
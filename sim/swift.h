@@ -9,10 +9,13 @@
 #include <list>
 #include <set>
 #include "config.h"
+#include "receive_bitmap.h"
 #include "network.h"
 #include "swiftpacket.h"
 #include "swift_scheduler.h"
 #include "eventlist.h"
+#include "timerwheel.h"
+#include "rtxscanner.h"
 #include "sent_packets.h"
 
 //#define MODEL_RECEIVE_WINDOW 1
@@ -38,6 +41,7 @@ private:
     simtime_picosec _interpacket_delay; // the interpacket delay, or zero if we're not pacing
     simtime_picosec _last_send;  // when the last packet was sent (always set, even when we're not pacing)
     simtime_picosec _next_send;  // when the next scheduled packet should be sent
+    Timer _send_timer;
 };
 
 // stuff that is specific to a subflow rather than the whole connection
@@ -57,6 +61,10 @@ public:
     void reroute(const Route &route);
     void doNextEvent();
     void rtx_timer_hook(simtime_picosec now, simtime_picosec period);
+    void set_rtx_scanner(RtxTimerScanner<SwiftSubflowSrc>* scanner, uint32_t id) {
+        _rtx_scanner = scanner;
+        _rtx_scanner_id = id;
+    }
     inline simtime_picosec pacing_delay() const {return _pacing_delay;}
     PacketFlow& flow() {return _flow;}
     uint32_t drops() const { return _drops;}
@@ -97,6 +105,10 @@ protected:
     uint32_t _drops;
     simtime_picosec _RFC2988_RTO_timeout;
     bool _rtx_timeout_pending;
+    Timer _rtx_timer;
+    RtxTimerScanner<SwiftSubflowSrc>* _rtx_scanner;
+    uint32_t _rtx_scanner_id;
+    void set_rto_timeout(simtime_picosec timeout); // always use this to set _RFC2988_RTO_timeout
 
     // Connectivity
     PacketFlow _flow;
@@ -170,6 +182,8 @@ public:
     // should really be private, but loggers want to see:
     uint64_t _highest_dsn_sent;  //seqno is in bytes - data sequence number, for MPSwift
     uint64_t _flow_size;
+    simtime_picosec _flow_start_time;
+    bool _fct_recorded;
     simtime_picosec _stop_time;
     bool _stopped;
     uint32_t _maxcwnd;
@@ -209,7 +223,7 @@ public:
     // Swift helper functions
     simtime_picosec targetDelay(uint32_t cwnd, const Route& route);
 
-    int queuesize(int flow_id);
+    int queuesize(const PacketFlow& flow);
 
 private:
     // Housekeeping
@@ -246,8 +260,7 @@ public:
     uint32_t _drops;
     uint32_t drops();
 
-    list<SwiftAck::seq_t> _received; /* list of packets above a hole, that 
-                                        we've received */
+    ReceiveBitmap _received; /* packets above a hole, that we've received */
 private:
     // Connectivity
     void connect(SwiftSubflowSrc& src, const Route& route);
@@ -293,15 +306,10 @@ private:
     ReorderBufferLogger* _buffer_logger;
 };
 
-class SwiftRtxTimerScanner : public EventSource {
+class SwiftRtxTimerScanner : public RtxTimerScanner<SwiftSubflowSrc> {
 public:
     SwiftRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
-    void doNextEvent();
     void registerSubflow(SwiftSubflowSrc &subflow_src);
-private:
-    simtime_picosec _scanPeriod;
-    typedef list<SwiftSubflowSrc*> subflows_t;
-    subflows_t _subflows;
 };
 
 #endif
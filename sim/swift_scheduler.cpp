@@ -19,23 +19,45 @@ BaseScheduler::BaseScheduler(linkspeed_bps bitrate, EventList &eventlist, QueueL
     : BaseQueue(bitrate, eventlist, logger), _pkt_count(0) {
 }
 
+uint32_t
+BaseScheduler::lookup_slot(PacketFlow& flow) {
+    unordered_map<flowid_t, uint32_t>::iterator i = _slots.find(flow.flow_id());
+    if (i != _slots.end())
+        return i->second;
+    uint32_t slot = _flows.size();
+    _flows.push_back(FlowState{0, NULL});
+    _slots[flow.flow_id()] = slot;
+    return slot;
+}
+
 void
-BaseScheduler::add_src(int32_t flow_id, ScheduledSrc* src) {
-    //cout << "add_subflow " << flow_id << " src " << src << endl;
-    // make sure we don't add the same flow_id more than once
-    assert(_queue_counts.find(flow_id) == _queue_counts.end());
-    
-    _queue_counts[flow_id] = 0;
-    _srcs[flow_id] = src;
+BaseScheduler::add_src(PacketFlow& flow, ScheduledSrc* src) {
+    //cout << "add_subflow " << flow.flow_id() << " src " << src << endl;
+    // make sure we don't add the same flow more than once
+    assert(flow.scheduler() != this);
+    assert(_slots.find(flow.flow_id()) == _slots.end());
+    uint32_t slot = _flows.size();
+    _flows.push_back(FlowState{0, src});
+    flow.set_scheduler(this, slot);
+}
+
+int
+BaseScheduler::src_queuesize(const PacketFlow& flow) {
+    if (flow.scheduler() == this)
+        return _flows[flow.scheduler_slot()].queue_count;
+    unordered_map<flowid_t, uint32_t>::const_iterator i = _slots.find(flow.flow_id());
+    if (i == _slots.end())
+        return 0;
+    return _flows[i->second].queue_count;
 }
 
 void
 BaseScheduler::receivePacket(Packet & pkt) {
-    int flow_id = pkt.flow_id();
-    //cout << "recv_packet " << this << " flow_id " << flow_id << " count " << _pkt_count << " flow_count " << _queue_counts[flow_id] << endl;
+    //cout << "recv_packet " << this << " flow_id " << pkt.flow_id() << " count " << _pkt_count << endl;
     if (pkt.type() == SWIFT) {
-      assert(_srcs.find(flow_id) != _srcs.end());
-      _queue_counts[flow_id]++;
+      FlowState& flow = _flows[flow_slot(pkt.flow())];
+      assert(flow.src);
+      flow.queue_count++;
     }
     enqueue(pkt);
     //cout << "recv_packet2 " << this << " count " << _pkt_count << endl;
@@ -71,8 +93,9 @@ BaseScheduler::completeService()
     //cout << "comp_svc " << this << endl;
     /* dequeue the packet */
     Packet* pkt = dequeue();
-    int flow_id = pkt->flow_id();
     packet_type ptype = pkt->type();
+    // the packet may be gone once sent on
+    uint32_t slot = ptype == SWIFT ? flow_slot(pkt->flow()) : 0;
     pkt->flow().logTraffic(*pkt, *this, TrafficLogger::PKT_DEPART);
     if (_logger) _logger->logQueue(*this, QueueLogger::PKT_SERVICE, *pkt);
 
@@ -86,8 +109,9 @@ BaseScheduler::completeService()
 
     // request more packets
     if (ptype == SWIFT) {
-      _queue_counts[flow_id]--;
-      _srcs[flow_id]->send_callback();
+      FlowState& flow = _flows[slot];
+      flow.queue_count--;
+      flow.src->send_callback();
     }
 }
 
@@ -102,23 +126,23 @@ FifoScheduler::FifoScheduler(linkspeed_bps bitrate, EventList &eventlist, QueueL
 
 void
 FifoScheduler::enqueue(Packet& pkt) {
-    _queue.push_front(&pkt);
+    Packet* p = &pkt;
+    _queue.push(p);
     _pkt_count++;
-    assert(_pkt_count == _queue.size());
+    assert(_pkt_count == (uint32_t)_queue.size());
 }
 
 Packet*
 FifoScheduler::next_packet() {
-    return _queue.back();
+    return _queue.next_to_pop();
 }
 
 Packet*
 FifoScheduler::dequeue() {
     assert (_pkt_count > 0);
-    Packet* packet = _queue.back();
-    _queue.pop_back();
+    Packet* packet = _queue.pop();
     _pkt_count--;
-    assert(_pkt_count == _queue.size());
+    assert(_pkt_count == (uint32_t)_queue.size());
     return packet;
 }
 
@@ -203,3 +227,52 @@ FairScheduler::create_queue(const Packet& pkt) {
 }
 
 
+
+
+/************************************************************************/
+/* Round Robin Scheduler                                                */
+/************************************************************************/
+
+RoundRobinScheduler::RoundRobinScheduler(linkspeed_bps bitrate, EventList &eventlist, QueueLogger* logger)
+    : BaseScheduler(bitrate, eventlist, logger), _next_packet(NULL) {
+}
+
+void
+RoundRobinScheduler::enqueue(Packet& pkt) {
+    uint32_t slot = flow_slot(pkt.flow());
+    if (slot >= _queues.size()) {
+        _queues.resize(_flows.size());
+        _active.resize(_flows.size());
+    }
+    CircularBuffer<Packet*>& q = _queues[slot];
+    if (q.empty())
+        _active.insert(slot);
+    Packet* p = &pkt;
+    q.push(p);
+    _pkt_count++;
+}
+
+Packet*
+RoundRobinScheduler::next_packet() {
+    assert(_pkt_count > 0);
+    assert(!_next_packet);
+    uint32_t slot = _active.current();
+    assert(slot != ActiveRing::NONE);
+    CircularBuffer<Packet*>& q = _queues[slot];
+    _next_packet = q.pop();
+    if (q.empty())
+        _active.remove(slot);
+    else
+        _active.advance();
+    return _next_packet;
+}
+
+Packet*
+RoundRobinScheduler::dequeue() {
+    assert(_next_packet);  // we expect a call to next_packet() first
+    Packet *p = _next_packet;
+    _next_packet = NULL;
+    assert(_pkt_count > 0);
+    _pkt_count--;
+    return p;
+}
@@ -7,10 +7,13 @@
  */
 
 #include <list>
+#include <unordered_map>
 #include "config.h"
 #include "eventlist.h"
 #include "network.h"
 #include "queue.h"
+#include "circular_buffer.h"
+#include "active_ring.h"
 //#include "swift.h"
 
 class ScheduledSrc {
@@ -39,12 +42,27 @@ class BaseScheduler : public BaseQueue {
     inline simtime_picosec drainTime(Packet *pkt) { 
         return (simtime_picosec)(pkt->size() * _ps_per_byte); 
     }
-    void add_src(int32_t flowid, ScheduledSrc* src);
-    int src_queuesize(int32_t flowid) {return _queue_counts[flowid];}
+    void add_src(PacketFlow& flow, ScheduledSrc* src);
+    int src_queuesize(const PacketFlow& flow);
  protected:
     uint32_t _pkt_count;
-    map <flowid_t, int32_t> _queue_counts;  // map from flow id to packet count
-    map <flowid_t, ScheduledSrc*> _srcs; // map from flow id to SubflowSrc for callbacks
+
+    // Per-flow state is kept in slots.  A source is given its slot in
+    // add_src and the flow carries it from then on, so the per-packet
+    // paths index _flows directly.  Flows that never call add_src get
+    // a slot through _slots when they first send.
+    struct FlowState {
+        int32_t queue_count; // packets queued
+        ScheduledSrc* src;   // for callbacks
+    };
+    vector<FlowState> _flows;
+    unordered_map<flowid_t, uint32_t> _slots; // flow id to slot, for flows not added
+    inline uint32_t flow_slot(PacketFlow& flow) {
+        if (flow.scheduler() == this)
+            return flow.scheduler_slot();
+        return lookup_slot(flow);
+    }
+    uint32_t lookup_slot(PacketFlow& flow);
 };
 
 class FifoScheduler : public BaseScheduler {
@@ -54,7 +72,7 @@ class FifoScheduler : public BaseScheduler {
     virtual Packet* next_packet();
     virtual Packet* dequeue();
  protected:
-    list<Packet*> _queue;
+    CircularBuffer<Packet*> _queue;
 };
 
 
@@ -75,4 +93,20 @@ class FairScheduler : public BaseScheduler{
     map<flowid_t, list<Packet*>*>::iterator _current_queue;
 };
 
+// FairScheduler for hosts with many flows: each flow's packets wait
+// in a buffer at its slot, and an ActiveRing picks the next flow.
+// Flows take turns in the order they became active, not flow id
+// order, so the interleaving differs from FairScheduler.
+class RoundRobinScheduler : public BaseScheduler {
+ public:
+    RoundRobinScheduler(linkspeed_bps bitrate, EventList &eventlist, QueueLogger* logger);
+    virtual void enqueue(Packet& pkt);
+    virtual Packet* next_packet();
+    virtual Packet* dequeue();
+ protected:
+    vector<CircularBuffer<Packet*> > _queues; // indexed by flow slot
+    ActiveRing _active;
+    Packet *_next_packet; // as for FairScheduler
+};
+
 #endif
@@ -1,4 +1,4 @@
 #include "swiftpacket.h"
 
-PacketDB<SwiftPacket> SwiftPacket::_packetdb;
-PacketDB<SwiftAck> SwiftAck::_packetdb;
+thread_local PacketDB<SwiftPacket> SwiftPacket::_packetdb;
+thread_local PacketDB<SwiftAck> SwiftAck::_packetdb;
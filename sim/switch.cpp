@@ -7,7 +7,7 @@
 #include "queue_lossless_input.h"
 #include "loggers.h"
 
-uint32_t Switch::id = 0;
+thread_local uint32_t Switch::id = 0;
 
 int Switch::addPort(BaseQueue* q){
     _ports.push_back(q);
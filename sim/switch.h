@@ -68,6 +68,6 @@ protected:
 
     RouteTable* _fib;
  
-    static uint32_t id;
+    static thread_local uint32_t id;
 };
 #endif
@@ -1,5 +1,6 @@
 // -*- c-basic-offset: 4; indent-tabs-mode: nil -*- 
 #include "tcp.h"
+#include "flowstats.h"
 #include "mtcp.h"
 #include "ecn.h"
 #include <iostream>
@@ -22,6 +23,8 @@ TcpSrc::TcpSrc(TcpLogger* logger, TrafficLogger* pktlogger,
     _base_rtt = timeInf;
     _cap = 0;
     _flow_size = ((uint64_t)1)<<63;
+    _flow_start_time = 0;
+    _fct_recorded = false;
     _highest_sent = 0;
     _packets_sent = 0;
     _app_limited = -1;
@@ -59,6 +62,8 @@ TcpSrc::TcpSrc(TcpLogger* logger, TrafficLogger* pktlogger,
 
     _rtx_timeout_pending = false;
     _RFC2988_RTO_timeout = timeInf;
+    _rtx_scanner = NULL;
+    _rtx_scanner_id = 0;
 
     _nodename = "tcpsrc";
 }
@@ -91,6 +96,7 @@ void
 TcpSrc::startflow() {
     _unacked = _cwnd;
     _established = false;
+    _flow_start_time = eventlist().now();
 
     send_packets();
 }
@@ -185,6 +191,11 @@ TcpSrc::receivePacket(Packet& pkt)
 
     if (seqno >= _flow_size){
         cout << "Flow " << nodename() << " finished at " << timeAsMs(eventlist().now()) << endl;        
+        if (!_fct_recorded) {
+            // set_flowsize() added a packet for the SYN
+            SimContext::current().flowStats().flow_finished(_flow_size - _mss, _flow_start_time, eventlist().now());
+            _fct_recorded = true;
+        }
     }
   
     if (seqno > _last_acked) { // a brand new ack
@@ -195,12 +206,12 @@ TcpSrc::receivePacket(Packet& pkt)
                 //printf("Deleted old route\n");
             }
         }
-        _RFC2988_RTO_timeout = eventlist().now() + _rto;// RFC 2988 5.3
+        set_rto_timeout(eventlist().now() + _rto);// RFC 2988 5.3
         _last_ping = eventlist().now();
     
         if (seqno >= _highest_sent) {
             _highest_sent = seqno;
-            _RFC2988_RTO_timeout = timeInf;// RFC 2988 5.2
+            set_rto_timeout(timeInf);// RFC 2988 5.2
             _last_ping = timeInf;
         }
 
@@ -392,7 +403,7 @@ TcpSrc::send_packets() {
         p->sendOn();
 
         if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-            _RFC2988_RTO_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }        
         //cout << "Sending SYN, waiting for SYN/ACK" << endl;
         return;
@@ -470,7 +481,7 @@ TcpSrc::send_packets() {
         p->sendOn();
 
         if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-            _RFC2988_RTO_timeout = eventlist().now() + _rto;
+            set_rto_timeout(eventlist().now() + _rto);
         }
     }
 }
@@ -525,10 +536,16 @@ TcpSrc::retransmit_packet() {
     _packets_sent += _mss;
 
     if(_RFC2988_RTO_timeout == timeInf) {// RFC2988 5.1
-        _RFC2988_RTO_timeout = eventlist().now() + _rto;
+        set_rto_timeout(eventlist().now() + _rto);
     }
 }
 
+void TcpSrc::set_rto_timeout(simtime_picosec timeout) {
+    _RFC2988_RTO_timeout = timeout;
+    if (_rtx_scanner)
+        _rtx_scanner->deadlineChanged(_rtx_scanner_id, timeout);
+}
+
 void TcpSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
     if (now <= _RFC2988_RTO_timeout || _RFC2988_RTO_timeout==timeInf) 
         return;
@@ -565,7 +582,7 @@ void TcpSrc::rtx_timer_hook(simtime_picosec now, simtime_picosec period) {
         _rto *= 2;
         //if (_rto > timeFromMs(1000))
         //  _rto = timeFromMs(1000);
-        _RFC2988_RTO_timeout = now + _rto;
+        set_rto_timeout(now + _rto);
     }
 }
 
@@ -658,28 +675,14 @@ TcpSink::receivePacket(Packet& pkt) {
         _cumulative_ack = seqno + size - 1;
         //cout << "New cumulative ack is " << _cumulative_ack << endl;
         // are there any additional received packets we can now ack?
-        while (!_received.empty() && (_received.front() == _cumulative_ack+1) ) {
-            _received.pop_front();
-            _cumulative_ack+= size;
-        }
+        _cumulative_ack += _received.advance(_cumulative_ack) * size;
     } else if (seqno < _cumulative_ack+1) {
     } else { // it's not the next expected sequence number
         if (_received.empty()) {
-            _received.push_front(seqno);
             //it's a drop in this simulator there are no reorderings.
             _drops += (1000 + seqno-_cumulative_ack-1)/1000;
-        } else if (seqno > _received.back()) { // likely case
-            _received.push_back(seqno);
-        } else { // uncommon case - it fills a hole
-            list<uint64_t>::iterator i;
-            for (i = _received.begin(); i != _received.end(); i++) {
-                if (seqno == *i) break; // it's a bad retransmit
-                if (seqno < (*i)) {
-                    _received.insert(i, seqno);
-                    break;
-                }
-            }
         }
+        _received.insert(seqno, size); // false if it's a bad retransmit
     }
     send_ack(ts,marked);
 }
@@ -731,20 +734,10 @@ void TcpSink::set_paths(vector<const Route*>* rt) {
 ////////////////////////////////////////////////////////////////
 
 TcpRtxTimerScanner::TcpRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist)
-    : EventSource(eventlist,"RtxScanner"), _scanPeriod(scanPeriod) {
-    eventlist.sourceIsPendingRel(*this, _scanPeriod);
+    : RtxTimerScanner<TcpSrc>(scanPeriod, scanPeriod, eventlist) {
 }
 
 void 
 TcpRtxTimerScanner::registerTcp(TcpSrc &tcpsrc) {
-    _tcps.push_back(&tcpsrc);
-}
-
-void TcpRtxTimerScanner::doNextEvent() {
-    simtime_picosec now = eventlist().now();
-    tcps_t::iterator i;
-    for (i = _tcps.begin(); i!=_tcps.end(); i++) {
-        (*i)->rtx_timer_hook(now,_scanPeriod);
-    }
-    eventlist().sourceIsPendingRel(*this, _scanPeriod);
+    tcpsrc.set_rtx_scanner(this, addSrc(tcpsrc));
 }
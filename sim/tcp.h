@@ -8,9 +8,11 @@
 
 #include <list>
 #include "config.h"
+#include "receive_bitmap.h"
 #include "network.h"
 #include "tcppacket.h"
 #include "eventlist.h"
+#include "rtxscanner.h"
 #include "sent_packets.h"
 
 //#define MODEL_RECEIVE_WINDOW 1
@@ -55,12 +57,19 @@ public:
 
     uint32_t effective_window();
     virtual void rtx_timer_hook(simtime_picosec now,simtime_picosec period);
+    void set_rtx_scanner(RtxTimerScanner<TcpSrc>* scanner, uint32_t id) {
+        _rtx_scanner = scanner;
+        _rtx_scanner_id = id;
+    }
+    void set_rto_timeout(simtime_picosec timeout); // always use this to set _RFC2988_RTO_timeout
     virtual const string& nodename() { return _nodename; }
 
     // should really be private, but loggers want to see:
     uint64_t _highest_sent;  //seqno is in bytes
     uint64_t _packets_sent;
     uint64_t _flow_size;
+    simtime_picosec _flow_start_time;
+    bool _fct_recorded;
     uint32_t _cwnd;
     uint32_t _maxcwnd;
     uint64_t _last_acked;
@@ -95,6 +104,8 @@ public:
     MultipathTcpSrc* _mSrc;
     simtime_picosec _RFC2988_RTO_timeout;
     bool _rtx_timeout_pending;
+    RtxTimerScanner<TcpSrc>* _rtx_scanner;
+    uint32_t _rtx_scanner_id;
 
     void set_app_limit(int pktps);
 
@@ -158,8 +169,7 @@ public:
     virtual const string& nodename() { return _nodename; }
 
     MultipathTcpSink* _mSink;
-    list<TcpAck::seq_t> _received; /* list of packets above a hole, that 
-                                      we've received */
+    ReceiveBitmap _received; /* packets above a hole, that we've received */
 
 #ifdef PACKET_SCATTER
     vector<const Route*>* _paths;
@@ -182,15 +192,10 @@ private:
     string _nodename;
 };
 
-class TcpRtxTimerScanner : public EventSource {
+class TcpRtxTimerScanner : public RtxTimerScanner<TcpSrc> {
 public:
     TcpRtxTimerScanner(simtime_picosec scanPeriod, EventList& eventlist);
-    void doNextEvent();
     void registerTcp(TcpSrc &tcpsrc);
-private:
-    simtime_picosec _scanPeriod;
-    typedef list<TcpSrc*> tcps_t;
-    tcps_t _tcps;
 };
 
 #endif
@@ -34,7 +34,7 @@ void TcpSrcPeriodic::reset(){
   _mSrc = NULL;
 
   _rtx_timeout_pending = false;
-  _RFC2988_RTO_timeout = timeInf;
+  set_rto_timeout(timeInf);
 }
 
 void 
@@ -50,7 +50,7 @@ void TcpSrcTransfer::reset(uint64_t bb, int shouldRestart){
     _established = false;
   
     _rtx_timeout_pending = false;
-    _RFC2988_RTO_timeout = timeInf;
+    set_rto_timeout(timeInf);
   
     //_bytes_to_send = bb;
 
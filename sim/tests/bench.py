@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+
+# Simulation throughput benchmarks.  Runs a fixed set of scenarios for
+# each protocol binary, writes events/sec, simulated seconds per wall
+# second, peak RSS and setup time to a JSON file, and compares them
+# against a stored baseline.  The figures come from the summary
+# EventList appends to $HTSIM_STATS when a simulation ends.
+#
+#   python3 bench.py                        run everything, compare with bench_baseline.json
+#   python3 bench.py -only eqds             just the runs whose name contains "eqds"
+#   python3 bench.py -update-baseline       make this machine's results the baseline
+#
+# Baselines are only comparable on the machine that recorded them.
+
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+import argparse
+
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DATACENTER = os.path.join(HERE, '../datacenter')
+FLOW_SIZE = 2000000  # bytes, every scenario but the dumbbell
+
+# Dumbbell runs use the test binaries with their default parameters;
+# the others use the datacenter binaries on a generated traffic matrix.
+DUMBBELL = ['ndp', 'tcp', 'swift', 'roce', 'hpcc', 'strack']
+
+def incast(nodes: int, senders: int):
+	rng = random.Random(1)
+	return [(s, 0) for s in rng.sample(range(1, nodes), senders)]
+
+def permutation(nodes: int):
+	rng = random.Random(1)
+	dsts = list(range(nodes))
+	while any(s == d for s, d in enumerate(dsts)):
+		rng.shuffle(dsts)
+	return list(enumerate(dsts))
+
+def all_to_all(nodes: int):
+	return [(s, d) for s in range(nodes) for d in range(nodes) if s != d]
+
+# name: (nodes, end time in us, connections as (src, dst) pairs)
+SCENARIOS = {
+	'incast128': (1024, 1000, incast(1024, 128)),
+	'perm1024': (1024, 500, permutation(1024)),
+	'alltoall128': (128, 200, all_to_all(128)),
+}
+
+# Datacenter binaries and the arguments they need for a scenario.
+def datacenter_args(proto: str, nodes: int, end_us: int, tm: str):
+	if proto == 'tcp':
+		# no traffic matrix support; it always runs a permutation
+		return ['-nodes', str(nodes), '-conns', str(nodes), '-end', str(end_us)]
+	args = ['-tm', tm, '-nodes', str(nodes), '-end', str(end_us)]
+	if proto == 'ndp':
+		args += ['-strat', 'perm']
+	elif proto in ('roce', 'hpcc'):
+		args += ['-strat', 'ecmp_host', '-paths', '8']
+	elif proto == 'swift':
+		# swift ignores the matrix's flow sizes; -flowsize is in 4000 byte packets
+		args += ['-flowsize', str(FLOW_SIZE // 4000)]
+	return args
+
+DATACENTER_PROTOS = ['eqds', 'ndp', 'roce', 'hpcc', 'swift', 'tcp']
+
+
+def write_matrix(filename: str, nodes: int, conns: list):
+	with open(filename, 'w') as f:
+		print(f'Nodes {nodes}', file=f)
+		print(f'Connections {len(conns)}', file=f)
+		for i, (s, d) in enumerate(conns):
+			print(f'{s}->{d} id {i + 1} start 0 size {FLOW_SIZE}', file=f)
+
+
+def runs(workdir: str):
+	for proto in DUMBBELL:
+		yield (f'dumbbell/{proto}', os.path.join(HERE, f'htsim_dumbell_{proto}'), [])
+	for scenario, (nodes, end_us, conns) in SCENARIOS.items():
+		tm = os.path.join(workdir, scenario + '.cm')
+		write_matrix(tm, nodes, conns)
+		for proto in DATACENTER_PROTOS:
+			if proto == 'tcp' and not scenario.startswith('perm'):
+				continue
+			yield (f'{scenario}/{proto}', os.path.join(DATACENTER, 'htsim_' + proto),
+			       datacenter_args(proto, nodes, end_us, tm))
+
+
+def run_once(executable: str, args: list, workdir: str):
+	stats_file = os.path.join(workdir, 'stats.json')
+	if os.path.exists(stats_file):
+		os.remove(stats_file)
+	env = dict(os.environ, HTSIM_STATS = stats_file)
+	start = time.monotonic()
+	proc = subprocess.Popen([executable] + args, cwd = workdir, env = env,
+				stdout = subprocess.DEVNULL, stderr = subprocess.DEVNULL)
+	_, status, usage = os.wait4(proc.pid, 0)
+	wall = time.monotonic() - start
+	if os.waitstatus_to_exitcode(status) != 0:
+		raise RuntimeError(f'exit status {os.waitstatus_to_exitcode(status)}')
+	try:
+		with open(stats_file) as f:
+			stats = json.loads(f.readlines()[-1])
+	except (OSError, IndexError):
+		raise RuntimeError('no stats written')
+	return {
+		'wall_s': round(wall, 3),
+		'setup_s': round(stats['setup_s'], 3),
+		'run_s': round(stats['run_s'], 3),
+		'events': stats['events'],
+		'events_per_s': round(stats['events'] / stats['run_s']) if stats['run_s'] > 0 else 0,
+		'sim_s': stats['sim_s'],
+		'sim_per_wall': float(f"{stats['sim_s'] / wall:.6g}"),
+		# ru_maxrss is in kilobytes on Linux
+		'peak_rss_mb': round(usage.ru_maxrss / 1024, 1),
+	}
+
+
+# metric: (higher is better, minimum absolute change worth reporting)
+CHECKED = {
+	'events_per_s': (True, 0),
+	'sim_per_wall': (True, 0),
+	'setup_s': (False, 0.05),
+	'peak_rss_mb': (False, 2),
+}
+
+def compare(results: dict, baseline: dict, threshold: float):
+	regressions = 0
+	for name, r in results.items():
+		b = baseline.get(name)
+		if b is None or 'error' in r or 'error' in b:
+			continue
+		notes = []
+		for metric, (higher_better, slack) in CHECKED.items():
+			old, new = b[metric], r[metric]
+			worse = old - new if higher_better else new - old
+			if old > 0 and worse > slack and worse / old * 100 > threshold:
+				notes.append(f'{metric} {old:g} -> {new:g}')
+		if abs(r['events'] - b['events']) > b['events'] / 100:
+			# not a regression in itself, but the runs aren't doing the same
+			# work (some binaries seed from the clock, so small drift is normal)
+			print(f'  {name}: events changed {b["events"]} -> {r["events"]}')
+		if notes:
+			regressions += 1
+			print(f'  REGRESSION {name}: ' + ', '.join(notes))
+	return regressions
+
+
+def main():
+	parser = argparse.ArgumentParser(description = 'htsim throughput benchmarks')
+	parser.add_argument('-only', help = 'only runs whose name contains this')
+	parser.add_argument('-repeat', type = int, default = 3, help = 'runs of each, the fastest is kept')
+	parser.add_argument('-out', default = os.path.join(HERE, 'bench_results.json'))
+	parser.add_argument('-baseline', default = os.path.join(HERE, 'bench_baseline.json'))
+	parser.add_argument('-threshold', type = float, default = 10, help = 'percent change that counts as a regression')
+	parser.add_argument('-update-baseline', action = 'store_true')
+	args = parser.parse_args()
+
+	results = {}
+	with tempfile.TemporaryDirectory() as workdir:
+		for name, executable, params in runs(workdir):
+			if args.only and args.only not in name:
+				continue
+			print(f'{name:24}', end = '', flush = True)
+			best = None
+			try:
+				for _ in range(args.repeat):
+					r = run_once(executable, params, workdir)
+					if best is None or r['wall_s'] < best['wall_s']:
+						best = r
+			except (OSError, RuntimeError) as e:
+				print(f' failed: {e}')
+				results[name] = {'error': str(e)}
+				continue
+			results[name] = best
+			print(f' {best["events_per_s"]:>12,} events/s {best["sim_per_wall"]:>10.6f} sim s/s'
+			      f' setup {best["setup_s"]:>7.3f}s rss {best["peak_rss_mb"]:>8.1f}MB')
+
+	with open(args.out, 'w') as f:
+		json.dump(results, f, indent = 1, sort_keys = True)
+	print(f'Results written to {args.out}')
+
+	if args.update_baseline:
+		baseline = {}
+		if os.path.exists(args.baseline):
+			with open(args.baseline) as f:
+				baseline = json.load(f)
+		baseline.update(results)
+		with open(args.baseline, 'w') as f:
+			json.dump(baseline, f, indent = 1, sort_keys = True)
+		print(f'Baseline {args.baseline} updated')
+		return 0
+
+	if not os.path.exists(args.baseline):
+		print(f'No baseline {args.baseline} to compare with')
+		return 0
+	with open(args.baseline) as f:
+		baseline = json.load(f)
+	regressions = compare(results, baseline, args.threshold)
+	failed = sum('error' in r for r in results.values())
+	print(f'{regressions} regressions, {failed} failed runs')
+	return 1 if regressions or failed else 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,282 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "timerwheel.h"
+
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+
+////////////////////////////////////////////////////////////////
+//  TIMER
+////////////////////////////////////////////////////////////////
+
+Timer::Timer(EventSource& owner) : _owner(owner)
+{
+    _state = IDLE;
+    _when = 0;
+    _order = 0;
+    _handle = EventList::nullHandle();
+    _prev = NULL;
+    _next = NULL;
+    _level = 0;
+    _slot = 0;
+}
+
+Timer::~Timer()
+{
+    cancel();
+}
+
+bool
+Timer::arm(simtime_picosec when)
+{
+    return TimerWheel::getTheTimerWheel().arm(*this, when);
+}
+
+void
+Timer::cancel()
+{
+    if (_state != IDLE)
+        TimerWheel::getTheTimerWheel().cancel(*this);
+}
+
+bool
+Timer::expired()
+{
+    if (_state == SCHEDULED && _owner.eventlist().currentOrder() == _order) {
+        _state = IDLE;
+        _handle = EventList::nullHandle();
+        return true;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////
+//  TIMER WHEEL
+////////////////////////////////////////////////////////////////
+
+/*
+ * Level L slot i holds timers whose tick, shifted right by
+ * L*TW_SLOT_BITS, is i (mod TW_SLOTS), and which are less than
+ * TW_SLOTS level-L slots ahead of _current.  When _current crosses a
+ * level-L boundary, that level's slot is cascaded down to lower
+ * levels.  Level 0 timers are handed to the EventList at the start
+ * of their tick.
+ *
+ * We only wake up when there's work to do: at the next non-empty
+ * level 0 slot, or at the next level 1 boundary if there's anything
+ * in the upper levels.  Wakeups are scheduled ahead of all other
+ * events at the same time, so timers are always in the EventList
+ * before anything that should happen after them.
+ */
+
+TimerWheel::TimerWheel(EventList& eventlist) : EventSource(eventlist, "timerwheel")
+{
+    for (int l = 0; l < TW_LEVELS; l++) {
+        for (int s = 0; s < TW_SLOTS; s++)
+            _slots[l][s] = NULL;
+        for (int w = 0; w < TW_SLOTS / 64; w++)
+            _occupied[l][w] = 0;
+        _level_count[l] = 0;
+    }
+    _count = 0;
+    _current = 0;
+    _wake_pending = false;
+    _wake_tick = 0;
+    _wake_handle = EventList::nullHandle();
+    _processing = false;
+}
+
+TimerWheel&
+TimerWheel::getTheTimerWheel()
+{
+    // one per simulation, created on first use, so the Logged IDs of
+    // everything created before the simulation starts are unaffected
+    SimContext& context = SimContext::current();
+    if (context._timerwheel == NULL)
+        context._timerwheel = new TimerWheel(EventList::getTheEventList());
+    return *context._timerwheel;
+}
+
+bool
+TimerWheel::arm(Timer& t, simtime_picosec when)
+{
+    assert(when >= eventlist().now());
+    if (t._state != Timer::IDLE)
+        cancel(t);
+
+    simtime_picosec endtime = eventlist().endtime();
+    if (endtime != 0 && when >= endtime)
+        return false;
+
+    t._when = when;
+    t._order = eventlist().reserveOrder();
+    place(t);
+    return true;
+}
+
+void
+TimerWheel::cancel(Timer& t)
+{
+    if (t._state == Timer::IN_WHEEL) {
+        // we don't bother pulling in the wakeup - an early wakeup is harmless
+        unlink(t);
+    } else if (t._state == Timer::SCHEDULED) {
+        eventlist().cancelPendingSourceByHandle(t._owner, t._handle);
+        t._handle = EventList::nullHandle();
+    }
+    t._state = Timer::IDLE;
+}
+
+void
+TimerWheel::place(Timer& t)
+{
+    // nothing can be due between _current and now, or we'd have a
+    // wakeup pending before now.
+    uint64_t nowtick = tickOf(eventlist().now());
+    if (_current < nowtick)
+        _current = nowtick;
+
+    uint64_t tick = tickOf(t._when);
+    if (tick <= _current) {
+        schedule(t);
+        return;
+    }
+    for (uint16_t level = 0; level < TW_LEVELS; level++) {
+        uint32_t shift = level * TW_SLOT_BITS;
+        if ((tick >> shift) - (_current >> shift) < TW_SLOTS) {
+            link(t, level, (tick >> shift) & TW_SLOT_MASK);
+            if (level == 0)
+                scheduleWake(tick);
+            else
+                scheduleWake(((_current >> TW_SLOT_BITS) + 1) << TW_SLOT_BITS);
+            return;
+        }
+    }
+    // too far in the future for the wheel
+    schedule(t);
+}
+
+void
+TimerWheel::schedule(Timer& t)
+{
+    t._handle = eventlist().sourceIsPendingGetHandle(t._owner, t._when, t._order);
+    t._state = t._handle == EventList::nullHandle() ? Timer::IDLE : Timer::SCHEDULED;
+}
+
+void
+TimerWheel::link(Timer& t, uint16_t level, uint16_t slot)
+{
+    t._level = level;
+    t._slot = slot;
+    t._prev = NULL;
+    t._next = _slots[level][slot];
+    if (t._next)
+        t._next->_prev = &t;
+    _slots[level][slot] = &t;
+    _occupied[level][slot / 64] |= (uint64_t)1 << (slot % 64);
+    _level_count[level]++;
+    _count++;
+    t._state = Timer::IN_WHEEL;
+}
+
+void
+TimerWheel::unlink(Timer& t)
+{
+    assert(t._state == Timer::IN_WHEEL);
+    if (t._prev)
+        t._prev->_next = t._next;
+    else
+        _slots[t._level][t._slot] = t._next;
+    if (t._next)
+        t._next->_prev = t._prev;
+    if (_slots[t._level][t._slot] == NULL)
+        _occupied[t._level][t._slot / 64] &= ~((uint64_t)1 << (t._slot % 64));
+    _level_count[t._level]--;
+    _count--;
+    t._prev = NULL;
+    t._next = NULL;
+}
+
+void
+TimerWheel::cascade(uint16_t level, uint16_t slot)
+{
+    while (_slots[level][slot]) {
+        Timer* t = _slots[level][slot];
+        unlink(*t);
+        place(*t);
+    }
+}
+
+void
+TimerWheel::scheduleWake(uint64_t tick)
+{
+    if (_processing)
+        return; // doNextEvent will work out the next wakeup when it's done
+    if (_wake_pending) {
+        if (_wake_tick <= tick)
+            return;
+        eventlist().cancelPendingSourceByHandle(*this, _wake_handle);
+    }
+    assert(tick > _current);
+    _wake_tick = tick;
+    // order zero puts us ahead of everything else that happens at this time
+    _wake_handle = eventlist().sourceIsPendingGetHandle(*this, tick << TW_TICK_SHIFT, 0);
+    _wake_pending = _wake_handle != EventList::nullHandle();
+}
+
+void
+TimerWheel::setNextWake()
+{
+    if (_count == 0)
+        return;
+
+    uint64_t next = UINT64_MAX;
+    if (_level_count[0] > 0) {
+        // first occupied level 0 slot after _current, wrapping round
+        uint16_t cur = _current & TW_SLOT_MASK;
+        for (uint16_t d = 1; d < TW_SLOTS; d++) {
+            uint16_t s = (cur + d) & TW_SLOT_MASK;
+            uint64_t word = _occupied[0][s / 64] >> (s % 64);
+            if (word == 0) {
+                // skip the rest of this word
+                d += 63 - (s % 64);
+                continue;
+            }
+            d += __builtin_ctzll(word);
+            next = _current + d;
+            break;
+        }
+        assert(next != UINT64_MAX);
+    }
+    if (_count > _level_count[0]) {
+        uint64_t boundary = ((_current >> TW_SLOT_BITS) + 1) << TW_SLOT_BITS;
+        if (boundary < next)
+            next = boundary;
+    }
+    scheduleWake(next);
+}
+
+void
+TimerWheel::doNextEvent()
+{
+    _wake_pending = false;
+    _wake_handle = EventList::nullHandle();
+    uint64_t t = tickOf(eventlist().now());
+    assert(eventlist().now() == t << TW_TICK_SHIFT);
+    _current = t;
+
+    _processing = true;
+    // cascade from the top, so timers can fall through several levels
+    for (int level = TW_LEVELS - 1; level >= 1; level--) {
+        uint32_t shift = level * TW_SLOT_BITS;
+        if ((t & (((uint64_t)1 << shift) - 1)) == 0)
+            cascade(level, (t >> shift) & TW_SLOT_MASK);
+    }
+    uint16_t slot = t & TW_SLOT_MASK;
+    while (_slots[0][slot]) {
+        Timer* timer = _slots[0][slot];
+        unlink(*timer);
+        schedule(*timer);
+    }
+    _processing = false;
+
+    setNextWake();
+}
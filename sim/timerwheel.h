@@ -0,0 +1,98 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+/*
+ * A hierarchical timer wheel for timers that are armed, re-armed and
+ * cancelled far more often than they expire (retransmission timers,
+ * pacers).
+ *
+ * A Timer is embedded in the EventSource that owns it.  Arming,
+ * re-arming and cancelling a timer are O(1): the timer just moves
+ * between wheel slots, and the EventList only gets involved when the
+ * timer's tick comes round.  At that point it's scheduled at its exact
+ * expiry time, ordered as if it had been scheduled directly with
+ * EventList::sourceIsPending when it was armed - so simulations give
+ * identical results with or without the wheel.
+ *
+ * When a timer expires, the wheel calls its owner's doNextEvent().  If
+ * the owner has other reasons to be called, it should call
+ * Timer::expired() to find out whether it was the timer.
+ */
+
+#include "config.h"
+#include "eventlist.h"
+
+class TimerWheel;
+
+class Timer {
+    friend class TimerWheel;
+public:
+    Timer(EventSource& owner);
+    ~Timer();
+
+    // arm (or re-arm) the timer to expire at absolute time when.
+    // Returns false if when is after the end of the simulation, in
+    // which case the timer is not pending.
+    bool arm(simtime_picosec when);
+    bool armRel(simtime_picosec timefromnow) {return arm(_owner.eventlist().now() + timefromnow);}
+    void cancel();
+    // call from the owner's doNextEvent().  Returns true (and clears
+    // the timer) if this timer is the reason we were called.
+    bool expired();
+
+    inline bool pending() const {return _state != IDLE;}
+    inline simtime_picosec expiry() const {return _when;}
+private:
+    Timer(const Timer&) = delete;
+    void operator=(const Timer&) = delete;
+
+    EventSource& _owner;
+    enum {IDLE, IN_WHEEL, SCHEDULED} _state;
+    simtime_picosec _when;
+    uint64_t _order;            // reserved event order, see EventList::reserveOrder()
+    EventList::Handle _handle;  // valid when SCHEDULED
+    Timer* _prev;               // slot list links, valid when IN_WHEEL
+    Timer* _next;
+    uint16_t _level;
+    uint16_t _slot;
+};
+
+#define TW_LEVELS 4
+#define TW_SLOT_BITS 8
+#define TW_SLOTS (1 << TW_SLOT_BITS)
+#define TW_TICK_SHIFT 20  // level 0 slots are ~1us, level 3 wraps after ~75 minutes
+
+class TimerWheel : public EventSource {
+public:
+    TimerWheel(EventList& eventlist);
+    static TimerWheel& getTheTimerWheel();  // the current simulation's wheel
+
+    bool arm(Timer& t, simtime_picosec when);
+    void cancel(Timer& t);
+    void doNextEvent();
+
+    inline uint64_t pendingTimers() const {return _count;}
+private:
+    inline uint64_t tickOf(simtime_picosec t) const {return t >> TW_TICK_SHIFT;}
+    void place(Timer& t);
+    void schedule(Timer& t);
+    void link(Timer& t, uint16_t level, uint16_t slot);
+    void unlink(Timer& t);
+    void cascade(uint16_t level, uint16_t slot);
+    void scheduleWake(uint64_t tick);
+    void setNextWake();
+
+    Timer* _slots[TW_LEVELS][TW_SLOTS];
+    uint64_t _occupied[TW_LEVELS][TW_SLOTS / 64];  // which slots are non-empty
+    uint64_t _level_count[TW_LEVELS];
+    uint64_t _count;
+
+    uint64_t _current;   // the last tick we processed
+    bool _wake_pending;
+    uint64_t _wake_tick;
+    EventList::Handle _wake_handle;
+    bool _processing;    // in doNextEvent, which sets the next wakeup itself
+};
+
+#endif
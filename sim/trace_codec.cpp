@@ -0,0 +1,279 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#include "trace_codec.h"
+#include <math.h>
+#include <string.h>
+#include <iostream>
+#include <zlib.h>
+
+static inline void put_varint(string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static inline uint64_t zigzag(int64_t v) {return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);}
+static inline int64_t unzigzag(uint64_t v) {return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);}
+
+template <class T> static inline void put_raw(string& out, T v) {
+    out.append((const char*)&v, sizeof(T));
+}
+
+template <class T> static inline bool get_raw(const uint8_t*& p, const uint8_t* end, T& v) {
+    if (end - p < (ptrdiff_t)sizeof(T))
+        return false;
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+// Values that hold an integer exactly become an even varint, anything
+// else (fractions, NaN, -0.0, huge values) is a 1 followed by the raw
+// double.
+static inline void put_value(string& out, double v) {
+    if (v >= -9007199254740992.0 && v <= 9007199254740992.0
+        && v == (double)(int64_t)v && !(v == 0 && signbit(v))) {
+        put_varint(out, zigzag((int64_t)v) << 1);
+    } else {
+        put_varint(out, 1);
+        put_raw(out, v);
+    }
+}
+
+static inline bool get_value(const uint8_t*& p, const uint8_t* end, double& v) {
+    uint64_t x;
+    if (!get_varint(p, end, x))
+        return false;
+    if (x == 1)
+        return get_raw(p, end, v);
+    v = (double)unzigzag(x >> 1);
+    return true;
+}
+
+// Log times are timeAsSec() of a picosecond count, which converts back
+// exactly for any simulated time below 2^52 ps (about 75 minutes).  A
+// block holding a time that doesn't stores its times as raw doubles;
+// the time column starts with which it is.
+enum {TIMES_PS = 0, TIMES_RAW = 1};
+
+static inline bool time_as_ps(double t, uint64_t& ps) {
+    if (!(t >= 0 && t < 9000000.0)) // llround() range, and NaN
+        return false;
+    ps = llround(t * 1000000000000.0);
+    return timeAsSec(ps) == t;
+}
+
+void TraceEncoder::encode_block(const LogRecord* records, size_t n, string& out) {
+    _columns.clear();
+    uint64_t ps, last_ps = 0;
+    size_t exact = 0;
+    while (exact < n && time_as_ps(records[exact]._time, ps))
+        exact++;
+    if (exact == n) {
+        put_varint(_columns, TIMES_PS);
+        for (size_t i = 0; i < n; i++) {
+            time_as_ps(records[i]._time, ps);
+            put_varint(_columns, zigzag((int64_t)(ps - last_ps)));
+            last_ps = ps;
+        }
+    } else {
+        put_varint(_columns, TIMES_RAW);
+        for (size_t i = 0; i < n; i++)
+            put_raw(_columns, records[i]._time);
+    }
+    for (size_t i = 0; i < n; i++)
+        put_varint(_columns, records[i]._type);
+    for (size_t i = 0; i < n; i++)
+        put_varint(_columns, records[i]._id);
+    for (size_t i = 0; i < n; i++)
+        put_varint(_columns, records[i]._ev);
+    for (size_t i = 0; i < n; i++)
+        put_value(_columns, records[i]._val1);
+    for (size_t i = 0; i < n; i++)
+        put_value(_columns, records[i]._val2);
+    for (size_t i = 0; i < n; i++)
+        put_value(_columns, records[i]._val3);
+
+    uLongf bytes = compressBound(_columns.size());
+    size_t base = out.size();
+    out.resize(base + bytes);
+    if (compress2((Bytef*)&out[base], &bytes, (const Bytef*)_columns.data(), _columns.size(),
+                  Z_BEST_SPEED) != Z_OK) {
+        cerr << "Failed to compress trace block" << endl;
+        abort();
+    }
+    out.resize(base + bytes);
+
+    uint32_t block = _blocks.size();
+    TraceBlockInfo info;
+    info._offset = _offset;
+    info._bytes = bytes;
+    info._raw_bytes = _columns.size();
+    info._records = n;
+    info._first_time = n ? records[0]._time : 0;
+    info._last_time = n ? records[n-1]._time : 0;
+    _blocks.push_back(info);
+    _offset += bytes;
+
+    for (size_t i = 0; i < n; i++) {
+        vector<uint32_t>& blocks = _index[((uint64_t)records[i]._type << 32) | records[i]._id];
+        if (blocks.empty() || blocks.back() != block)
+            blocks.push_back(block);
+    }
+}
+
+void TraceEncoder::encode_footer(string& out) {
+    uint64_t footer = _offset;
+    put_raw(out, (uint32_t)_blocks.size());
+    for (size_t i = 0; i < _blocks.size(); i++) {
+        put_raw(out, _blocks[i]._offset);
+        put_raw(out, _blocks[i]._bytes);
+        put_raw(out, _blocks[i]._raw_bytes);
+        put_raw(out, _blocks[i]._records);
+        put_raw(out, _blocks[i]._first_time);
+        put_raw(out, _blocks[i]._last_time);
+    }
+    put_raw(out, (uint32_t)_index.size());
+    map<uint64_t, vector<uint32_t> >::iterator i;
+    for (i = _index.begin(); i != _index.end(); i++) {
+        put_raw(out, (uint32_t)(i->first >> 32));
+        put_raw(out, (uint32_t)(i->first & 0xffffffff));
+        put_raw(out, (uint32_t)i->second.size());
+        for (size_t b = 0; b < i->second.size(); b++)
+            put_raw(out, i->second[b]);
+    }
+    put_raw(out, footer);
+    put_raw(out, (uint64_t)TRACE_MAGIC);
+}
+
+bool TraceReader::open(FILE* file, long trace_start) {
+    _file = file;
+    _start = trace_start;
+    _blocks.clear();
+    _index.clear();
+
+    uint64_t trailer[2];
+    if (fseek(_file, -(long)sizeof(trailer), SEEK_END) != 0
+        || fread(trailer, sizeof(trailer), 1, _file) != 1
+        || trailer[1] != TRACE_MAGIC)
+        return false;
+    long end = ftell(_file) - sizeof(trailer);
+    long footer = _start + trailer[0];
+    if (footer > end || fseek(_file, footer, SEEK_SET) != 0)
+        return false;
+    string buf(end - footer, 0);
+    if (buf.size() && fread(&buf[0], buf.size(), 1, _file) != 1)
+        return false;
+
+    const uint8_t* p = (const uint8_t*)buf.data();
+    const uint8_t* e = p + buf.size();
+    uint32_t n;
+    if (!get_raw(p, e, n))
+        return false;
+    _blocks.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+        TraceBlockInfo& b = _blocks[i];
+        if (!get_raw(p, e, b._offset) || !get_raw(p, e, b._bytes) || !get_raw(p, e, b._raw_bytes)
+            || !get_raw(p, e, b._records) || !get_raw(p, e, b._first_time) || !get_raw(p, e, b._last_time))
+            return false;
+    }
+    if (!get_raw(p, e, n))
+        return false;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t type, id, count;
+        if (!get_raw(p, e, type) || !get_raw(p, e, id) || !get_raw(p, e, count))
+            return false;
+        vector<uint32_t>& blocks = _index[((uint64_t)type << 32) | id];
+        blocks.resize(count);
+        for (uint32_t b = 0; b < count; b++)
+            if (!get_raw(p, e, blocks[b]))
+                return false;
+    }
+    return true;
+}
+
+uint64_t TraceReader::records() const {
+    uint64_t n = 0;
+    for (size_t i = 0; i < _blocks.size(); i++)
+        n += _blocks[i]._records;
+    return n;
+}
+
+bool TraceReader::read_block(size_t i, vector<LogRecord>& out) {
+    const TraceBlockInfo& b = _blocks[i];
+    _compressed.resize(b._bytes);
+    if (fseek(_file, _start + b._offset, SEEK_SET) != 0
+        || (b._bytes && fread(&_compressed[0], b._bytes, 1, _file) != 1))
+        return false;
+    return decode_block(i, _compressed.data(), out, _columns);
+}
+
+bool TraceReader::decode_block(size_t i, const char* compressed, vector<LogRecord>& out,
+                               string& columns) const {
+    const TraceBlockInfo& b = _blocks[i];
+    columns.resize(b._raw_bytes);
+    uLongf raw = b._raw_bytes;
+    if (uncompress((Bytef*)&columns[0], &raw, (const Bytef*)compressed, b._bytes) != Z_OK
+        || raw != b._raw_bytes)
+        return false;
+
+    size_t base = out.size();
+    out.resize(base + b._records);
+    LogRecord* r = &out[base];
+    const uint8_t* p = (const uint8_t*)columns.data();
+    const uint8_t* e = p + columns.size();
+    uint64_t v, ps = 0;
+    if (!get_varint(p, e, v))
+        return false;
+    if (v == TIMES_PS) {
+        for (uint32_t j = 0; j < b._records; j++) {
+            if (!get_varint(p, e, v))
+                return false;
+            ps += unzigzag(v);
+            r[j]._time = timeAsSec(ps);
+        }
+    } else if (v == TIMES_RAW) {
+        for (uint32_t j = 0; j < b._records; j++)
+            if (!get_raw(p, e, r[j]._time))
+                return false;
+    } else {
+        return false;
+    }
+    for (uint32_t j = 0; j < b._records; j++) {
+        if (!get_varint(p, e, v))
+            return false;
+        r[j]._type = v;
+    }
+    for (uint32_t j = 0; j < b._records; j++) {
+        if (!get_varint(p, e, v))
+            return false;
+        r[j]._id = v;
+    }
+    for (uint32_t j = 0; j < b._records; j++) {
+        if (!get_varint(p, e, v))
+            return false;
+        r[j]._ev = v;
+    }
+    for (uint32_t j = 0; j < b._records; j++)
+        if (!get_value(p, e, r[j]._val1))
+            return false;
+    for (uint32_t j = 0; j < b._records; j++)
+        if (!get_value(p, e, r[j]._val2))
+            return false;
+    for (uint32_t j = 0; j < b._records; j++)
+        if (!get_value(p, e, r[j]._val3))
+            return false;
+    return p == e;
+}
@@ -0,0 +1,91 @@
+// -*- c-basic-offset: 4; indent-tabs-mode: nil -*-
+#ifndef TRACE_CODEC_H
+#define TRACE_CODEC_H
+
+/*
+ * Columnar, compressed trace format (Logfile::COLUMNAR).
+ *
+ * The records of a trace are cut into blocks, one LogWriter batch
+ * each.  Within a block every field is stored as its own column: times
+ * as zigzag varint deltas in picoseconds (or raw doubles, if a time in
+ * the block doesn't convert exactly), type, id and ev as varints, and
+ * each value as a zigzag varint when it holds an integer, or as a raw
+ * double when it doesn't.  The columns of a block are compressed
+ * together with zlib.
+ *
+ * After the blocks comes a footer listing every block and, for every
+ * (type, id) pair in the trace, the blocks that pair appears in, so a
+ * reader after one or two queues only has to decompress their blocks.
+ *
+ * Layout of the trace section, which follows the "# TRACE" line:
+ *   block*    compressed columns
+ *   footer    uint32 nblocks, TraceBlockInfo[nblocks],
+ *             uint32 nkeys, { uint32 type, uint32 id, uint32 n, uint32 block[n] }[nkeys]
+ *   trailer   uint64 footer offset, uint64 TRACE_MAGIC
+ * Offsets are from the start of the trace section.
+ */
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "logfile.h"
+
+#define TRACE_MAGIC 0x31524c4f43534d48ULL
+
+struct TraceBlockInfo {
+    uint64_t _offset;      // of the compressed block
+    uint32_t _bytes;       // compressed size
+    uint32_t _raw_bytes;   // size of the columns once uncompressed
+    uint32_t _records;
+    double _first_time;
+    double _last_time;
+};
+
+class TraceEncoder {
+public:
+    TraceEncoder() : _offset(0) {}
+    // Encode n records as the next block, appending it to out.
+    void encode_block(const LogRecord* records, size_t n, string& out);
+    // The footer and trailer, to go after the last block.
+    void encode_footer(string& out);
+    uint64_t bytes_written() const {return _offset;}
+private:
+    uint64_t _offset;
+    vector<TraceBlockInfo> _blocks;
+    map<uint64_t, vector<uint32_t> > _index; // type<<32 | id -> blocks
+    string _columns;
+};
+
+class TraceReader {
+public:
+    // trace_start is the file offset just after the "# TRACE" line.
+    // Returns false if the footer is missing or corrupt.
+    bool open(FILE* file, long trace_start);
+
+    size_t blocks() const {return _blocks.size();}
+    const TraceBlockInfo& block(size_t i) const {return _blocks[i];}
+    uint64_t records() const;
+
+    typedef map<uint64_t, vector<uint32_t> > index_t;
+    const index_t& index() const {return _index;}
+    static uint32_t key_type(uint64_t key) {return key >> 32;}
+    static uint32_t key_id(uint64_t key) {return key & 0xffffffff;}
+
+    // Decode block i, appending its records to out.
+    bool read_block(size_t i, vector<LogRecord>& out);
+    // Decode block i from its compressed bytes (at block(i)._offset
+    // in the trace section), using scratch as working space.  Safe to
+    // call from several threads at once.
+    bool decode_block(size_t i, const char* compressed, vector<LogRecord>& out,
+                      string& scratch) const;
+private:
+    FILE* _file;
+    long _start;
+    vector<TraceBlockInfo> _blocks;
+    index_t _index;
+    string _compressed;
+    string _columns;
+};
+
+#endif
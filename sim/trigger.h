@@ -32,6 +32,7 @@ public:
 class Trigger {
 public:
     Trigger(EventList& eventlist, triggerid_t id);
+    virtual ~Trigger() {}
     void add_target(TriggerTarget& target);
     virtual void activate() = 0;
 protected: